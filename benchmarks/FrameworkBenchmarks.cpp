@@ -0,0 +1,256 @@
+#include <benchmark/benchmark.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "TestCore.h"
+#include "FakeSubject.h"
+#include "EventHistory.h"
+#include "Logger.h"
+#include "HwStubEncoder.h"
+#include "LogMatcher.h"
+#include "TimerWheel.h"
+#include "notification_types.h"
+
+/* ==================================================================================================================== */
+/**
+ * @file FrameworkBenchmarks.cpp
+ *
+ * @brief Benchmarks of framework hot paths - code executed for every frame exchanged with the subject.
+ *
+ * @details
+ *    Only public API of the framework is used. Handling of received frame is measured by its parts - decoding
+ *    and storing in history, history lookup is measured in running test (with step logged to file).
+ *    Other benchmarks run with logger not writing to file (formatting only), cost of writing the log file is
+ *    measured separately by Logger_send_to_file. Console output of the framework is discarded while benchmarks run.
+ *    Results are written to logs/FrameworkBenchmarks.json, unless --benchmark_out is given.
+ *    Framework has to be configured with FRAMEWORK_BENCHMARK_BUILD=ON, so it is optimized and not instrumented.
+ *
+ * @benchmarks
+ * - Logger_send_format
+ * - Logger_send_to_file
+ * - Decode_bytes_from_string
+ * - Encode_hw_stub_frame
+ * - Encode_hw_stub_transaction
+ * - Event_history_push
+ * - Was_app_ntf_sent_lookup
+ * - Log_matcher_scan
+ * - Timer_wheel_schedule_and_expire
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ==================================================================================================================== */
+
+namespace
+{
+/** Message as received by SocketDriver - space separated decimal bytes, zero terminated */
+std::vector<uint8_t> make_message(const std::vector<uint8_t>& bytes)
+{
+   std::string text;
+   for (uint8_t byte : bytes)
+   {
+      text += (text.empty()? "" : " ") + std::to_string(byte);
+   }
+   std::vector<uint8_t> result(text.begin(), text.end());
+   result.push_back(0x00);
+   return result;
+}
+std::vector<uint8_t> make_payload(size_t size, uint8_t seed)
+{
+   std::vector<uint8_t> result(size);
+   for (size_t i = 0; i < size; i++)
+   {
+      result[i] = (uint8_t)(seed * 31 + i * 97);
+   }
+   return result;
+}
+/** Discards framework console output, so it does not mix with results */
+class NullBuffer : public std::streambuf
+{
+protected:
+   int overflow(int c) override { return c; }
+};
+}
+
+static void Logger_send_format(benchmark::State& state)
+{
+   const std::string text(state.range(0), 'x');
+   logger_initialize("");
+   for (auto _ : state)
+   {
+      logger_send(TF_TC, __func__, "frame %u: %s", 1u, text.c_str());
+   }
+   logger_deinitialize();
+   state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(Logger_send_format)->Arg(16)->Arg(128)->Arg(1024);
+
+static void Logger_send_to_file(benchmark::State& state)
+{
+   const std::string text(state.range(0), 'x');
+   if (!logger_initialize("FrameworkBenchmarks"))
+   {
+      state.SkipWithError("cannot create log file");
+   }
+   for (auto _ : state)
+   {
+      logger_send(TF_TC, __func__, "frame %u: %s", 1u, text.c_str());
+   }
+   logger_deinitialize();
+   state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(Logger_send_to_file)->Arg(16)->Arg(128)->Arg(1024);
+
+static void Decode_bytes_from_string(benchmark::State& state)
+{
+   const std::vector<uint8_t> message = make_message(make_payload(state.range(0), 1));
+   const size_t size = message.size() - 1;
+   std::vector<uint8_t> bytes((size + 1) / 2);
+   for (auto _ : state)
+   {
+      benchmark::DoNotOptimize(hw_stub::decode((const char*)message.data(), size, bytes.data(), bytes.size()));
+   }
+   state.SetBytesProcessed(state.iterations() * size);
+}
+/* I2C notification, DHT frame, notifications up to history payload size */
+BENCHMARK(Decode_bytes_from_string)->Arg(5)->Arg(8)->Arg(16)->Arg(HISTORY_PAYLOAD_SIZE);
+
+static void Encode_hw_stub_frame(benchmark::State& state)
+{
+   uint16_t i2c_state = 0;
+   for (auto _ : state)
+   {
+      /* the same work as sendToHwStub() does before writing to socket */
+      hw_stub::FrameBatch<hw_stub::text_size<hw_stub::Frame<I2C_STATE_SET>().size()>(), 1> batch;
+      batch.add(hw_stub::make_i2c_frame<I2C_STATE_SET>(RELAYS_I2C_ADDRESS, i2c_state++));
+      benchmark::DoNotOptimize(batch.frames());
+   }
+}
+BENCHMARK(Encode_hw_stub_frame);
+
+static void Encode_hw_stub_transaction(benchmark::State& state)
+{
+   for (auto _ : state)
+   {
+      hw_stub::FrameBatch<TC_TRANSACTION_MAX_FRAMES * hw_stub::text_size<hw_stub::Frame<DHT_STATE_SET>().size()>(), TC_TRANSACTION_MAX_FRAMES> batch;
+      for (int64_t i = 0; i < state.range(0); i++)
+      {
+         batch.add(hw_stub::make_dht_frame(i % 4, 1, 20 + i, 50));
+      }
+      benchmark::DoNotOptimize(batch.frames());
+   }
+   state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(Encode_hw_stub_transaction)->Arg(4)->Arg(TC_TRANSACTION_MAX_FRAMES);
+
+static void Event_history_push(benchmark::State& state)
+{
+   /* range(0) == 0 - I2C state, otherwise notification with given size (longer than inline payload kept in arena) */
+   EventHistory history;
+   history.configure("", HISTORY_DEFAULT_MEMORY_LIMIT);
+   const std::vector<uint8_t> payload = make_payload(state.range(0), 4);
+   uint16_t value = 0;
+   for (auto _ : state)
+   {
+      history.push(SLM_I2C_ADDRESS, value++, payload.data(), payload.size());
+   }
+   state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(Event_history_push)->Arg(0)->Arg(8)->Arg(HISTORY_PAYLOAD_SIZE + 24);
+
+static void Was_app_ntf_sent_lookup(benchmark::State& state)
+{
+   /* history filled by fake subject, last notification marks that all of them were received */
+   FakeSubject subject;
+   TestCore tc;
+   const std::vector<uint8_t> last = {NTF_RELAYS_STATE, NTF_NTF, 2, 0xFE, RELAY_STATE_ON};
+   subject.addBehavior({FakeTrigger::HUMIDITY_ABOVE, DHT_SENSOR2, 70, {{FakeActionType::APP_NTF, 0, 0, 0, last}}});
+   tc.useFakeSubject(&subject);
+   bool filled = tc.runTest("FrameworkBenchmarks_lookup");
+   if (filled)
+   {
+      subject.setTraffic(FakeTraffic::APP_NTF, 20000, {NTF_RELAYS_STATE, NTF_NTF, 2, 1, RELAY_STATE_ON});
+      filled = TestWait::until(TEST_WAIT_SITE, std::chrono::seconds(10), [&]() { return subject.sentFrames() >= (uint64_t)state.range(0); });
+      subject.setTraffic(FakeTraffic::APP_NTF, 0, {});
+      tc.setSensorState(DHT_SENSOR2, DHT_TYPE_DHT11, 24, 71);
+      filled = filled && TestWait::until(TEST_WAIT_SITE, std::chrono::seconds(5), [&]() { return tc.wasAppNtfSent(NTF_RELAYS_STATE, last); });
+   }
+   if (!filled)
+   {
+      state.SkipWithError("history not filled by fake subject");
+   }
+   /* not present notification - whole history is searched */
+   const std::vector<uint8_t> missing = {NTF_RELAYS_STATE, NTF_NTF, 2, 0xFF, RELAY_STATE_ON};
+   for (auto _ : state)
+   {
+      benchmark::DoNotOptimize(tc.wasAppNtfSent(NTF_RELAYS_STATE, missing));
+   }
+   state.SetItemsProcessed(state.iterations() * subject.sentFrames());
+   tc.stopTest();
+}
+BENCHMARK(Was_app_ntf_sent_lookup)->Arg(16)->Arg(256)->Arg(4096);
+
+static void Log_matcher_scan(benchmark::State& state)
+{
+   /* range(0) patterns watched, none of them present - cost per byte shall not depend on their number */
+   LogMatcher matcher;
+   for (int64_t i = 0; i < state.range(0); i++)
+   {
+      matcher.add("MODULE_" + std::to_string(i) + ": unexpected state");
+   }
+   const std::string trace = "[12:00:00:000] SLM: state changed to ONGOING_ON, step 3, i2c state 0x0007";
+   for (auto _ : state)
+   {
+      benchmark::DoNotOptimize(matcher.scan((const uint8_t*)trace.data(), trace.size()));
+   }
+   state.SetBytesProcessed(state.iterations() * trace.size());
+}
+BENCHMARK(Log_matcher_scan)->Arg(1)->Arg(64)->Arg(1024);
+
+static void Timer_wheel_schedule_and_expire(benchmark::State& state)
+{
+   /* range(0) frames waiting in the wheel (impaired channel), one scheduled and one released per iteration */
+   TimerWheel<uint32_t> wheel(std::chrono::microseconds(100), 1024);
+   auto now = TimerWheel<uint32_t>::Clock::now();
+   const auto delay = std::chrono::microseconds(100 * state.range(0));
+   for (int64_t i = 0; i < state.range(0); i++)
+   {
+      wheel.schedule(now + std::chrono::microseconds(100 * i), (uint32_t)i);
+   }
+   uint64_t released = 0;
+   for (auto _ : state)
+   {
+      now += std::chrono::microseconds(100);
+      wheel.schedule(now + delay, 0);
+      wheel.advance(now, [&released](uint32_t&) { released++; });
+   }
+   benchmark::DoNotOptimize(released);
+   state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(Timer_wheel_schedule_and_expire)->Arg(16)->Arg(1024)->Arg(65536);
+
+int main(int argc, char** argv)
+{
+   /* default output can be overridden by arguments given later */
+   std::string out = std::string("--benchmark_out=") + PROJECT_ROOT_PATH + "/logs/FrameworkBenchmarks.json";
+   std::string out_format = "--benchmark_out_format=json";
+   std::vector<char*> args(argv, argv + argc);
+   args.insert(args.begin() + 1, {&out[0], &out_format[0]});
+   int count = args.size();
+   benchmark::Initialize(&count, args.data());
+   if (benchmark::ReportUnrecognizedArguments(count, args.data()))
+   {
+      return 1;
+   }
+
+   std::ostream console(std::cout.rdbuf());
+   NullBuffer null_buffer;
+   std::cout.rdbuf(&null_buffer);
+   benchmark::ConsoleReporter reporter;
+   reporter.SetOutputStream(&console);
+   reporter.SetErrorStream(&std::cerr);
+   benchmark::RunSpecifiedBenchmarks(&reporter);
+   std::cout.rdbuf(console.rdbuf());
+   benchmark::Shutdown();
+   return 0;
+}
@@ -4,10 +4,17 @@ then
     mkdir build
 fi
 
+# tests passed before with the same binaries are not run again, unless --force is given
+if [[ "$1" == "--force" ]]
+then
+    export TEST_CACHE_FORCE=1
+fi
+
 cd build
 
 cmake ..
 
 make
 
-ctest --output-on-failure --schedule-random --timeout 6000
+# executables which failed last time first (ctest cost data), tests inside are ordered by the runner (recent failures first, then longest)
+ctest --output-on-failure --timeout 6000
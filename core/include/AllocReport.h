@@ -0,0 +1,80 @@
+#ifndef _ALLOCREPORT_H_
+#define _ALLOCREPORT_H_
+
+/* ============================= */
+/**
+ * @file AllocReport.h
+ *
+ * @brief Allocation report of the tested binary, built from raw report of allocation tracking preload library.
+ *
+ * @details
+ *    Raw report (see AllocTracker.h) contains per-thread call site counters, live bytes curve and memory mappings
+ *    of the subject. Call sites are merged across threads, resolved with SymbolResolver and sorted by number
+ *    of allocations, so the report shows allocation hot spots of the scenario.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <string>
+#include <vector>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+#include "AllocTracker.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define ALLOC_REPORT_HOT_SPOTS 20      /**< Call sites written to report */
+/* =============================
+ *       Data structures
+ * =============================*/
+typedef struct
+{
+   std::string site;             /**< Resolved function which called allocator */
+   AllocKind kind;
+   uint64_t count;
+   uint64_t bytes;               /**< Requested bytes */
+} AllocHotSpot;
+
+typedef struct
+{
+   uint32_t ms;                  /**< Time since subject start */
+   uint64_t live_bytes;
+} AllocCurvePoint;
+
+typedef struct
+{
+   bool complete = false;                 /**< Raw report was fully written */
+   uint64_t allocations = 0;
+   uint64_t frees = 0;
+   uint64_t requested_bytes = 0;
+   uint64_t allocated_bytes = 0;          /**< Usable size of allocated blocks */
+   uint64_t freed_bytes = 0;
+   uint64_t peak_live_bytes = 0;
+   uint32_t threads = 0;
+   std::vector<AllocHotSpot> hot_spots;   /**< All call sites, most frequent first */
+   std::vector<AllocCurvePoint> curve;
+} AllocSummary;
+
+class AllocReport
+{
+public:
+   /**
+    * @brief Reads raw report and resolves call sites.
+    * @param[in] raw_path - file written by preload library
+    * @return True if complete report was read.
+    */
+   bool load(const std::string& raw_path);
+   const AllocSummary& summary();
+   bool exportJson(const std::string& file_path, const std::string& test_name);
+private:
+   AllocSummary m_summary;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _ALLOCTRACKER_H_
+#define _ALLOCTRACKER_H_
+
+/* ============================= */
+/**
+ * @file AllocTracker.h
+ *
+ * @brief Definitions shared by allocation tracking preload library (libAllocTracker.so) and the framework.
+ *
+ * @details
+ *    Library is injected to the tested binary with LD_PRELOAD (see TestSubjectExecutor::set_alloc_tracking()).
+ *    It replaces malloc/calloc/realloc/reallocarray/free, memalign/valloc/pvalloc family and operator new/delete,
+ *    real allocation is done by glibc (__libc_malloc etc.).
+ *    Every thread counts allocations in its own buffer (mmap'ed, registered once in lock-free list), so hooks
+ *    do not take any lock. Call site is the return address of the hooked function, counted in per-thread table.
+ *    Live bytes (usable size of allocated minus freed blocks) are sampled periodically by allocating threads.
+ *    Raw report is written on ALLOC_TRACKER_DUMP_SIGNAL and at exit of the process, using only
+ *    async-signal-safe calls. Addresses are resolved offline by the framework (see AllocReport).
+ *
+ *    Raw report format (one record per line):
+ *       totals <allocs> <frees> <requested_bytes> <allocated_bytes> <freed_bytes> <threads>
+ *       site <address> <kind> <count> <requested_bytes>      (per thread, address in hex)
+ *       curve <ms> <live_bytes>
+ *       map <line of /proc/self/maps>
+ *       end
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <signal.h>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+/* =============================
+ *          Defines
+ * =============================*/
+#define ALLOC_TRACKER_OUTPUT_ENV "ALLOC_TRACKER_OUTPUT"   /**< Path of raw report */
+#define ALLOC_TRACKER_DUMP_SIGNAL SIGUSR2                 /**< Writes report without stopping the process */
+#define ALLOC_TRACKER_SITES 1024                          /**< Call sites counted by single thread */
+#define ALLOC_TRACKER_CURVE_POINTS 4096                   /**< Points of live bytes curve */
+#define ALLOC_TRACKER_CURVE_PERIOD_MS 10                  /**< Minimal distance of curve points */
+/* =============================
+ *       Data structures
+ * =============================*/
+enum AllocKind
+{
+   ALLOC_KIND_MALLOC,      /**< malloc, calloc, realloc, memalign and valloc family */
+   ALLOC_KIND_NEW,         /**< operator new, new[] */
+   ALLOC_KIND_COUNT,
+};
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef _APPNOTIFICATION_H_
+#define _APPNOTIFICATION_H_
+
+/* ============================= */
+/**
+ * @file AppNotification.h
+ *
+ * @brief Typed views of application notifications (app_ntf channel).
+ *
+ * @details
+ *    Notification is [NTF_CMD_ID, NTF_REQ_TYPE, data size, data...]. Layout of data for every NTF_CMD_ID is
+ *    described by NtfSchema, decode<ID>() checks received bytes against it and returns view, which reads
+ *    fields directly from the buffer (no copy, buffer has to outlive the view).
+ *    Notifications without schema cannot be decoded (compilation error).
+ *    Typical use with TestCore::wasAppNtfSent<ID>(predicate):
+ *       tc.wasAppNtfSent<NTF_RELAYS_STATE>(app_ntf::relay_is(RELAY_BATHROOM_FAN, RELAY_STATE_ON));
+ *       tc.wasAppNtfSent<NTF_ENV_SENSOR_DATA>([](const app_ntf::EnvReadingView& ntf) { return ntf.humidity() > 70; });
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <stddef.h>
+#include <optional>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+#include "notification_types.h"
+#include "relays_types.h"
+#include "inputs_types.h"
+#include "env_types.h"
+#include "fan_types.h"
+#include "stairs_led_types.h"
+/* =============================
+ *       Data structures
+ * =============================*/
+namespace app_ntf
+{
+/* =============================
+ *            Views
+ * =============================*/
+class NtfView
+{
+public:
+   NtfView(const uint8_t* data): m_data(data) {}
+   NTF_CMD_ID id() const { return (NTF_CMD_ID)m_data[0]; }
+   NTF_REQ_TYPE type() const { return (NTF_REQ_TYPE)m_data[1]; }
+   uint8_t dataSize() const { return m_data[2]; }
+   const uint8_t* data() const { return m_data + NTF_HEADER_SIZE; }
+protected:
+   const uint8_t* m_data;
+};
+
+/** List of (id, state) pairs - relays and inputs */
+template <typename ID, typename STATE>
+class StateListView : public NtfView
+{
+public:
+   struct Entry
+   {
+      ID id;
+      STATE state;
+   };
+   StateListView(const uint8_t* data): NtfView(data) {}
+   size_t count() const { return dataSize() / 2; }
+   Entry operator[](size_t idx) const { return {(ID)data()[2 * idx], (STATE)data()[2 * idx + 1]}; }
+   /**
+    * @brief Returns state of given id, empty if id is not in the notification.
+    */
+   std::optional<STATE> state(ID id) const
+   {
+      for (size_t i = 0; i < count(); i++)
+      {
+         if (data()[2 * i] == id)
+         {
+            return (STATE)data()[2 * i + 1];
+         }
+      }
+      return std::nullopt;
+   }
+   bool contains(ID id, STATE state) const
+   {
+      std::optional<STATE> current = this->state(id);
+      return current && *current == state;
+   }
+};
+typedef StateListView<RELAY_ID, RELAY_STATE> RelayListView;
+typedef StateListView<INPUT_ID, INPUT_STATE> InputListView;
+
+template <typename STATE>
+class StateView : public NtfView
+{
+public:
+   StateView(const uint8_t* data): NtfView(data) {}
+   STATE state() const { return (STATE)data()[0]; }
+};
+typedef StateView<FAN_STATE> FanStateView;
+typedef StateView<SLM_STATE> SlmStateView;
+
+/** DHT sensor reading - sensor id, temperature and humidity (integer and fractional part) */
+class EnvReadingView : public NtfView
+{
+public:
+   EnvReadingView(const uint8_t* data): NtfView(data) {}
+   DHT_SENSOR_ID sensor() const { return (DHT_SENSOR_ID)data()[0]; }
+   int8_t temperature() const { return (int8_t)data()[1]; }
+   uint8_t temperatureFraction() const { return data()[2]; }
+   uint8_t humidity() const { return data()[3]; }
+   uint8_t humidityFraction() const { return data()[4]; }
+};
+/* =============================
+ *            Schema
+ * =============================*/
+/** Data of notification is ENTRY_SIZE bytes repeated MIN_ENTRIES..MAX_ENTRIES times */
+template <NTF_CMD_ID ID> struct NtfSchema;
+template <> struct NtfSchema<NTF_RELAYS_STATE>     { typedef RelayListView View;  static constexpr uint8_t ENTRY_SIZE = 2; static constexpr uint8_t MIN_ENTRIES = 1; static constexpr uint8_t MAX_ENTRIES = 1; };
+template <> struct NtfSchema<NTF_RELAYS_STATE_ALL> { typedef RelayListView View;  static constexpr uint8_t ENTRY_SIZE = 2; static constexpr uint8_t MIN_ENTRIES = 0; static constexpr uint8_t MAX_ENTRIES = 127; };
+template <> struct NtfSchema<NTF_INPUTS_STATE>     { typedef InputListView View;  static constexpr uint8_t ENTRY_SIZE = 2; static constexpr uint8_t MIN_ENTRIES = 1; static constexpr uint8_t MAX_ENTRIES = 1; };
+template <> struct NtfSchema<NTF_INPUTS_STATE_ALL> { typedef InputListView View;  static constexpr uint8_t ENTRY_SIZE = 2; static constexpr uint8_t MIN_ENTRIES = 0; static constexpr uint8_t MAX_ENTRIES = 127; };
+template <> struct NtfSchema<NTF_ENV_SENSOR_DATA>  { typedef EnvReadingView View; static constexpr uint8_t ENTRY_SIZE = 5; static constexpr uint8_t MIN_ENTRIES = 1; static constexpr uint8_t MAX_ENTRIES = 1; };
+template <> struct NtfSchema<NTF_FAN_STATE>        { typedef FanStateView View;   static constexpr uint8_t ENTRY_SIZE = 1; static constexpr uint8_t MIN_ENTRIES = 1; static constexpr uint8_t MAX_ENTRIES = 1; };
+template <> struct NtfSchema<NTF_SLM_STATE>        { typedef SlmStateView View;   static constexpr uint8_t ENTRY_SIZE = 1; static constexpr uint8_t MIN_ENTRIES = 1; static constexpr uint8_t MAX_ENTRIES = 1; };
+
+/**
+ * @brief Checks notification bytes against schema of ID.
+ * @param[in] data - notification with header
+ * @param[in] size - number of bytes
+ * @return View of the notification, empty if bytes do not match the schema.
+ */
+template <NTF_CMD_ID ID>
+std::optional<typename NtfSchema<ID>::View> decode(const uint8_t* data, size_t size)
+{
+   typedef NtfSchema<ID> Schema;
+   static_assert(Schema::ENTRY_SIZE > 0 && Schema::MIN_ENTRIES <= Schema::MAX_ENTRIES, "invalid notification schema");
+   static_assert(NTF_HEADER_SIZE + Schema::ENTRY_SIZE * Schema::MAX_ENTRIES <= UINT8_MAX + NTF_HEADER_SIZE, "notification data too long");
+   if (size < NTF_HEADER_SIZE || data[0] != ID || (size_t)NTF_HEADER_SIZE + data[2] != size || data[2] % Schema::ENTRY_SIZE != 0)
+   {
+      return std::nullopt;
+   }
+   size_t entries = data[2] / Schema::ENTRY_SIZE;
+   if (entries < Schema::MIN_ENTRIES || entries > Schema::MAX_ENTRIES)
+   {
+      return std::nullopt;
+   }
+   return typename Schema::View(data);
+}
+/* =============================
+ *           Matchers
+ * =============================*/
+inline auto relay_is(RELAY_ID id, RELAY_STATE state)
+{
+   return [id, state](const RelayListView& ntf) { return ntf.contains(id, state); };
+}
+inline auto input_is(INPUT_ID id, INPUT_STATE state)
+{
+   return [id, state](const InputListView& ntf) { return ntf.contains(id, state); };
+}
+inline auto fan_is(FAN_STATE state)
+{
+   return [state](const FanStateView& ntf) { return ntf.state() == state; };
+}
+inline auto slm_is(SLM_STATE state)
+{
+   return [state](const SlmStateView& ntf) { return ntf.state() == state; };
+}
+
+}
+
+#endif
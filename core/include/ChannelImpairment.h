@@ -0,0 +1,145 @@
+#ifndef _CHANNELIMPAIRMENT_H_
+#define _CHANNELIMPAIRMENT_H_
+
+/* ============================= */
+/**
+ * @file ChannelImpairment.h
+ *
+ * @brief Impairment of socket channel - delay, jitter, bandwidth limit, frame drops and receive stalls.
+ *
+ * @details
+ *    Every direction of the channel has own ImpairmentProfile. Frame submitted to impaired direction is:
+ *    - dropped with drop_permille probability,
+ *    - serialized on the link with bandwidth_bps (next frame waits until previous one is transmitted),
+ *    - released to the sink after delay_us and random 0..jitter_us, in order of submission unless reorder is set.
+ *    Frames wait in TimerWheel with IMPAIRMENT_TICK_US resolution, served by one thread which sleeps until the
+ *    next expiry - no sleep per frame, so delays stay precise at high frame rates.
+ *    Random values are drawn from generator seeded with profile seed, in order of submission, so the same
+ *    seed and the same frames give the same drops and delays.
+ *    Receive stall (pauseReceive()) is handled by the reading thread, which stops reading the socket -
+ *    kernel buffers fill up and the writer (tested application) is blocked, like with slow consumer.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <random>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+#include "Metrics.h"
+#include "TimerWheel.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define IMPAIRMENT_TICK_US 100
+#define IMPAIRMENT_WHEEL_BUCKETS 1024    /**< One revolution is ~100 ms */
+/* =============================
+ *       Data structures
+ * =============================*/
+enum class ImpairmentDirection : uint8_t
+{
+   INBOUND,       /**< Frames received from tested application, before listener is called */
+   OUTBOUND,      /**< Frames written to tested application */
+   COUNT,
+};
+
+struct ImpairmentProfile
+{
+   uint32_t delay_us = 0;           /**< Fixed delay of every frame */
+   uint32_t jitter_us = 0;          /**< Random additional delay 0..jitter_us */
+   bool reorder = false;            /**< Frames may overtake each other because of jitter */
+   uint32_t bandwidth_bps = 0;      /**< Bytes per second, 0 - not limited */
+   uint16_t drop_permille = 0;      /**< Probability of frame drop */
+   uint32_t seed = 0;
+};
+
+struct ImpairmentMetrics
+{
+   MetricValue frames_delayed;      /**< Frames passed through impaired direction */
+   MetricValue frames_dropped;
+   MetricValue queued_frames;       /**< Frames waiting for release */
+};
+
+class ChannelImpairment
+{
+public:
+   typedef std::function<void(std::vector<uint8_t>& frame)> Sink;
+
+   ChannelImpairment();
+   ~ChannelImpairment();
+   /**
+    * @brief Sets receiver of released frames of the direction, has to be called before the first configure().
+    */
+   void setSink(ImpairmentDirection direction, Sink sink);
+   /**
+    * @brief Sets profile of the direction, frames already waiting keep their release time.
+    *        Default profile disables impairment.
+    */
+   void configure(ImpairmentDirection direction, const ImpairmentProfile& profile);
+   /**
+    * @brief Disables impairment of both directions, waiting frames are dropped and receive is resumed.
+    */
+   void reset();
+   /**
+    * @brief Returns true if frames of the direction have to be submitted (impaired or some frames still wait,
+    *        so frames written directly would overtake them).
+    */
+   bool isActive(ImpairmentDirection direction);
+   void submit(ImpairmentDirection direction, const uint8_t* data, size_t size);
+   /**
+    * @brief Stops reading of the channel for given time, zero resumes reading immediately.
+    */
+   void pauseReceive(std::chrono::microseconds duration);
+   /**
+    * @brief Called by the reading thread with received frame, blocks while receive is paused.
+    */
+   void waitReceive();
+   const ImpairmentMetrics& getMetrics(ImpairmentDirection direction);
+
+private:
+   struct Frame
+   {
+      ImpairmentDirection direction;
+      std::vector<uint8_t> data;
+   };
+   struct Direction
+   {
+      ImpairmentProfile profile;
+      bool enabled = false;
+      std::mt19937 random;
+      std::chrono::steady_clock::time_point link_free;      /**< End of transmission of the last frame */
+      std::chrono::steady_clock::time_point last_release;
+      size_t pending = 0;                                   /**< Frames in the wheel or in the sink */
+      Sink sink;
+      ImpairmentMetrics metrics;
+   };
+
+   void threadExecute();
+   void stopThread();
+
+   std::mutex m_mtx;
+   std::condition_variable m_cv;
+   TimerWheel<Frame> m_wheel;
+   Direction m_directions [(size_t)ImpairmentDirection::COUNT];
+   std::thread m_thread;
+   bool m_thread_running;
+   std::chrono::steady_clock::time_point m_wake_at;      /**< Time the thread sleeps until, min() while it is awake */
+   std::mutex m_rx_mtx;
+   std::condition_variable m_rx_cv;
+   std::chrono::steady_clock::time_point m_rx_resume;
+};
+
+#endif
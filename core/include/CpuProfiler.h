@@ -0,0 +1,90 @@
+#ifndef _CPUPROFILER_H_
+#define _CPUPROFILER_H_
+
+/* ============================= */
+/**
+ * @file CpuProfiler.h
+ *
+ * @brief Sampling CPU profiler of the tested process, based on perf_event_open().
+ *
+ * @details
+ *    Software task-clock event is attached to the subject (and threads created by it later) with given frequency,
+ *    one event (and ring buffer) per CPU, as kernel does not allow to map inherited per-task event.
+ *    only user space is sampled, so no special hardware or privileges (beyond perf_event_paranoid <= 2) are needed.
+ *    Reader thread drains the ring buffer and counts identical call chains by raw addresses.
+ *    Addresses are resolved when profiling is stopped (see SymbolResolver) and written as folded stacks (one "root;caller;callee count" line per stack),
+ *    which can be read by flamegraph tools.
+ *    Call chains are complete only if the subject is built with frame pointers (default for -O0).
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <sys/types.h>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+#include "SymbolResolver.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define PROFILER_DEFAULT_FREQUENCY_HZ 999    /**< Not a multiple of timer tick, to avoid lockstep with periodic work */
+#define PROFILER_RING_PAGES 16               /**< Data pages of the ring buffer of single CPU (power of two) */
+/* =============================
+ *       Data structures
+ * =============================*/
+class CpuProfiler
+{
+public:
+   CpuProfiler();
+   ~CpuProfiler();
+   /**
+    * @brief Attaches sampling event to the process and starts reader thread.
+    * @param[in] pid - process to profile, threads created later are profiled too
+    * @param[in] frequency_hz - samples per second of CPU time
+    * @return True if started (false e.g. if perf events are not permitted).
+    */
+   bool start(pid_t pid, uint32_t frequency_hz);
+   /**
+    * @brief Stops sampling, resolves symbols and writes folded stacks. Has to be called while process still exists,
+    *        so its memory mappings can be read.
+    * @param[in] folded_path - output file
+    * @return True if file was written.
+    */
+   bool stop(const std::string& folded_path);
+   bool isRunning();
+   uint64_t sampleCount();
+   uint64_t lostCount();
+
+private:
+   void threadExecute();
+   void drainRingBuffer(uint8_t* ring);
+   void closeEvents();
+
+   pid_t m_pid;
+   std::vector<int> m_fds;                            /**< Event of every CPU */
+   std::vector<uint8_t*> m_rings;                     /**< Mapped ring buffer of every event */
+   size_t m_ring_size;
+   size_t m_page_size;
+   std::string m_root;                                /**< Name of the subject, root of every stack */
+   std::thread m_thread;
+   std::atomic<bool> m_running;
+   std::mutex m_mtx;
+   std::map<std::vector<uint64_t>, uint64_t> m_stacks;  /**< Call chain (leaf first) -> number of samples */
+   uint64_t m_samples;
+   uint64_t m_lost;
+   SymbolResolver m_resolver;
+};
+
+#endif
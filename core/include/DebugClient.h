@@ -0,0 +1,135 @@
+#ifndef _DEBUGCLIENT_H_
+#define _DEBUGCLIENT_H_
+
+/* ============================= */
+/**
+ * @file DebugClient.h
+ *
+ * @brief Pipelined client of debug interface of tested application (bluetooth channel).
+ *
+ * @details
+ *    Every command gets a request id and is sent as "#<id> <command>". Application answers with
+ *    "#<id> <response>" in any order, frames without '#' prefix are debug traces and are not consumed.
+ *    Any number of commands (up to DEBUG_MAX_OUTSTANDING) can wait for response at the same time,
+ *    send() returns std::future, which is always completed - with the response, on timeout or when
+ *    the client is stopped. Timeouts are handled by single thread of the client.
+ *    Request id protocol has to be implemented by the tested application - it shall copy "#<id>" of the command
+ *    to its response. FakeSubject does it for commands configured with FakeSubject::addDebugResponse(),
+ *    SmartHome binary without this support answers with untagged frames, which are taken as traces - commands
+ *    sent to it end with TIMEOUT.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+#include "SocketDriver.h"
+#include "Metrics.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define DEBUG_DEFAULT_TIMEOUT_MS 1000
+#define DEBUG_MAX_OUTSTANDING 1024        /**< Commands waiting for response, next ones are rejected */
+#define DEBUG_REQUEST_PREFIX '#'
+#define DEBUG_REQUEST_HEADER_SIZE 12      /**< Prefix, request id (up to 10 digits) and separator added to command */
+/* =============================
+ *       Data structures
+ * =============================*/
+enum class DebugStatus : uint8_t
+{
+   OK,                  /**< Response received */
+   TIMEOUT,             /**< No response in time */
+   SEND_ERROR,          /**< Command could not be written */
+   REJECTED,            /**< Too many outstanding commands or client not started */
+   STOPPED,             /**< Client stopped before response */
+};
+
+typedef struct
+{
+   DebugStatus status = DebugStatus::STOPPED;
+   std::string text;                      /**< Response without request id */
+   uint32_t latency_us = 0;               /**< Time from sending to response */
+} DebugResponse;
+
+/** Writes request frames to the application, returns true if written */
+typedef std::function<bool(const SocketFrame* frames, size_t count)> DebugWriter;
+
+class DebugClient
+{
+public:
+   DebugClient();
+   ~DebugClient();
+   /**
+    * @brief Starts timeout thread, commands can be sent from now.
+    * @param[in] writer - function writing frames to bluetooth channel
+    * @return True if started.
+    */
+   bool start(DebugWriter writer);
+   /**
+    * @brief Stops the client, waiting commands are completed with STOPPED status.
+    */
+   void stop();
+   /**
+    * @brief Sends command without waiting for response.
+    * @param[in] command - command text
+    * @param[in] timeout_ms - time for response
+    * @return Future completed with the response.
+    */
+   std::future<DebugResponse> send(const std::string& command, uint32_t timeout_ms = DEBUG_DEFAULT_TIMEOUT_MS);
+   /**
+    * @brief Sends several commands in one write.
+    * @return Futures in order of commands.
+    */
+   std::vector<std::future<DebugResponse>> send(const std::vector<std::string>& commands, uint32_t timeout_ms = DEBUG_DEFAULT_TIMEOUT_MS);
+   /**
+    * @brief Handles frame received on bluetooth channel.
+    * @return True if frame was response (matching or late), false for debug traces.
+    */
+   bool onFrame(const uint8_t* data, size_t size);
+   size_t outstanding();
+   void registerMetrics(MetricsRegistry& registry);
+
+private:
+   struct Request
+   {
+      std::promise<DebugResponse> promise;
+      std::chrono::steady_clock::time_point sent;
+      std::chrono::steady_clock::time_point deadline;
+   };
+
+   void threadExecute();
+   void complete(std::map<uint32_t, Request>::iterator it, DebugStatus status, const std::string& text);
+
+   DebugWriter m_writer;
+   std::thread m_thread;
+   std::atomic<bool> m_running;
+   std::mutex m_mtx;
+   std::condition_variable m_cv;
+   std::map<uint32_t, Request> m_requests;
+   uint32_t m_next_id;
+   MetricValue m_sent;
+   MetricValue m_responses;
+   MetricValue m_timeouts;
+   MetricValue m_late_responses;
+   MetricValue m_rejected;
+   MetricValue m_latency_max_us;
+};
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef _EVENTHISTORY_H_
+#define _EVENTHISTORY_H_
+
+/* ============================= */
+/**
+ * @file EventHistory.h
+ *
+ * @brief Bounded storage of received events (I2C states, application notifications) for long test runs.
+ *
+ * @details
+ *    Events are kept in fixed-size records, grouped in segments taken from slab owned by history.
+ *    Number of segments kept in memory is limited - when limit is reached, the oldest segment is appended
+ *    to spill file and its memory is reused for new records. Spilled records are still available,
+ *    they are read from memory-mapped spill file. Memory usage does not depend on test duration.
+ *    If there is no spill file, the oldest records are dropped.
+ *    Payload longer than HISTORY_PAYLOAD_SIZE is kept whole in payload arena (record is marked with
+ *    HISTORY_FLAG_EXTERNAL and keeps only the beginning inline). Arena is made of segments taken from the same
+ *    slab, so it is part of the memory limit - the oldest record segment is evicted first, arena segment only if
+ *    there is no other record segment. Evicted arena segment is spilled to <spill file>.payload.
+ *    Payload longer than one segment is not kept (HISTORY_FLAG_TRUNCATED).
+ *    History is not thread-safe, owner has to serialize access.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <array>
+#include <deque>
+#include <memory>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+/* =============================
+ *          Defines
+ * =============================*/
+#define HISTORY_RECORD_SIZE 64
+#define HISTORY_PAYLOAD_SIZE 40                          /**< Payload stored inline in the record */
+#define HISTORY_SEGMENT_RECORDS 256                       /**< 16 KB segments */
+#define HISTORY_SEGMENT_SIZE (HISTORY_RECORD_SIZE * HISTORY_SEGMENT_RECORDS)
+#define HISTORY_DEFAULT_MEMORY_LIMIT (1024 * 1024)        /**< Memory limit of single history */
+/* =============================
+ *       Data structures
+ * =============================*/
+enum HistoryRecordFlags : uint8_t
+{
+   HISTORY_FLAG_EXTERNAL = 0x01,   /**< Payload longer than HISTORY_PAYLOAD_SIZE, whole payload kept in arena */
+   HISTORY_FLAG_TRUNCATED = 0x02,  /**< Payload longer than HISTORY_PAYLOAD_SIZE, only the beginning is known */
+};
+
+typedef struct
+{
+   uint64_t timestamp_ns;                    /**< steady_clock time of reception */
+   uint64_t arena_offset;                    /**< Position of whole payload in arena (HISTORY_FLAG_EXTERNAL) */
+   uint16_t value;                           /**< I2C state */
+   uint16_t size;                            /**< Original payload size */
+   uint8_t id;                               /**< I2C address or NTF_CMD_ID */
+   uint8_t flags;                            /**< HistoryRecordFlags */
+   uint8_t reserved [2];
+   uint8_t payload [HISTORY_PAYLOAD_SIZE];
+} HistoryRecord;
+static_assert(sizeof(HistoryRecord) == HISTORY_RECORD_SIZE, "HistoryRecord has to fit single record");
+
+class EventHistory
+{
+public:
+   EventHistory();
+   ~EventHistory();
+   EventHistory(const EventHistory&) = delete;
+   EventHistory& operator=(const EventHistory&) = delete;
+   /**
+    * @brief Clears history and sets storage limits.
+    * @param[in] spill_path - file for records evicted from memory (created on first eviction), empty if evicted records shall be dropped
+    * @param[in] memory_limit - memory for records and long payloads in bytes, at least one segment is always used
+    * @return None.
+    */
+   void configure(const std::string& spill_path, size_t memory_limit);
+   void push(const HistoryRecord& record);
+   /**
+    * @brief Stores the event, payload up to HISTORY_SEGMENT_SIZE is kept whole.
+    */
+   void push(uint8_t id, uint16_t value, const uint8_t* payload, size_t size);
+   /**
+    * @brief Reads record from memory or spill file.
+    * @param[in] idx - index of the record, counted from the first record since last clear()
+    * @param[out] record - record data
+    * @return True if record is available (false if out of range or dropped).
+    */
+   bool get(size_t idx, HistoryRecord& record);
+   /**
+    * @brief Returns record in memory or in mapped spill file without copying.
+    * @return Pointer valid until next push() or clear(), nullptr if record is not available.
+    */
+   const HistoryRecord* at(size_t idx);
+   /**
+    * @brief Returns whole payload (record.size bytes) of the record taken from this history.
+    * @return Pointer valid until next push() or clear(), nullptr if payload beyond HISTORY_PAYLOAD_SIZE is lost.
+    */
+   const uint8_t* payload(const HistoryRecord& record);
+   /**
+    * @brief Returns the newest record, which is always kept in memory.
+    */
+   const HistoryRecord* back() const;
+   size_t size() const;
+   bool empty() const;
+   size_t spilledCount() const;
+   size_t droppedCount() const;
+   /**
+    * @brief Returns memory taken by records and payload arena, it does not grow above configured limit.
+    */
+   size_t memoryUsage() const;
+   void clear();
+
+   /**
+    * @brief Creates record with payload stored inline, payload longer than HISTORY_PAYLOAD_SIZE is marked HISTORY_FLAG_TRUNCATED.
+    */
+   static HistoryRecord makeRecord(uint8_t id, uint16_t value, const uint8_t* payload, size_t size);
+
+private:
+   typedef std::array<HistoryRecord, HISTORY_SEGMENT_RECORDS> Segment;
+
+   Segment* takeSegment();
+   void evictOldestSegment();
+   void evictArenaSegment();
+   uint8_t* allocArena(size_t size, uint64_t& offset);
+   bool mapSpilledRecords();
+   bool mapSpilledArena();
+   void closeSpillFile();
+
+   std::vector<std::unique_ptr<Segment>> m_slab;   /**< All segments allocated so far, never freed before destruction */
+   std::vector<Segment*> m_segments;               /**< Segments in memory, oldest first */
+   std::vector<Segment*> m_free;                   /**< Segments ready for reuse */
+   size_t m_max_segments;
+   size_t m_count;                                 /**< Records pushed since last clear */
+   size_t m_memory_first;                          /**< Index of the oldest record in memory */
+   size_t m_spilled;                               /**< Records in spill file (indexes 0..m_spilled-1) */
+   std::string m_spill_path;
+   int m_spill_fd;
+   bool m_spill_failed;
+   uint8_t* m_map;
+   size_t m_map_size;
+   std::deque<Segment*> m_arena;                   /**< Payloads of EXTERNAL records in memory, oldest first */
+   uint64_t m_arena_first;                         /**< Arena offset of the first byte of m_arena */
+   uint64_t m_arena_end;                           /**< Arena offset of the next payload */
+   uint64_t m_arena_spilled;                       /**< Arena bytes in payload spill file (offsets 0..m_arena_spilled-1) */
+   int m_arena_fd;
+   uint8_t* m_arena_map;
+   size_t m_arena_map_size;
+};
+
+#endif
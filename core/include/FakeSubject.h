@@ -0,0 +1,216 @@
+#ifndef _FAKESUBJECT_H_
+#define _FAKESUBJECT_H_
+
+/* ============================= */
+/**
+ * @file FakeSubject.h
+ *
+ * @brief Scriptable replacement of SmartHome binary, used to run the test framework without real tested application.
+ *
+ * @details
+ *    FakeSubject connects to the 3 TestCore servers like the real SmartHome binary does and emulates:
+ *    - I2C boards - state set by I2C_STATE_SET is stored, writes done by behaviors are notified by I2C_STATE_NTF,
+ *    - DHT sensors - data set by DHT_STATE_SET is stored and checked against humidity behaviors,
+ *    - I2C bus - transactions with devices configured by I2C_BUS_SET/I2C_RESULT_SET take modelled time (one
+ *      transaction on the bus at a time) and may fail: failed write does not change the board, failed read of
+ *      inputs board does not fire input behaviors. Result of every such transaction is sent as I2C_TRANSFER_NTF,
+ *      transactions with other devices are instant and always succeed,
+ *    - notifications and logs - sent on app_ntf and bluetooth channels,
+ *    - debug interface - commands "#<id> <command>" received on bluetooth channel are answered with
+ *      "#<id> <response>" according to the table set with addDebugResponse().
+ *    The reaction on stimulus is described by behavior table (trigger -> list of delayed actions).
+ *    Additionally, constant traffic with configurable rate can be generated on every channel.
+ *
+ *    All sockets and timers are handled by single thread.
+ *    By default subject connects to the ports of SmartHome binary, other ports can be set with setPorts()
+ *    (e.g. when many subjects are served by TestCluster).
+ *    Subject can be run in process (start()/stop()) or in child process (runAsChild(), stopped by SIGINT).
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+#include "HwStubEncoder.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define FAKE_RECONNECT_PERIOD_MS 10
+#define FAKE_MAX_TRAFFIC_BURST 64
+#define FAKE_DEBUG_UNKNOWN_RESPONSE "ERROR unknown command"
+/* =============================
+ *       Data structures
+ * =============================*/
+enum class FakeTrigger : uint8_t
+{
+   INPUT_ACTIVATED,     /**< Input (INPUT_ID) is active during I2C interrupt, while it was inactive before */
+   INPUT_DEACTIVATED,   /**< Input (INPUT_ID) is inactive during I2C interrupt, while it was active before */
+   HUMIDITY_ABOVE,      /**< Humidity of DHT sensor (DHT_SENSOR_ID) rised above threshold */
+   HUMIDITY_BELOW,      /**< Humidity of DHT sensor (DHT_SENSOR_ID) dropped below threshold */
+};
+
+enum class FakeActionType : uint8_t
+{
+   RELAY_SET,           /**< Sets relay (RELAY_ID) to given RELAY_STATE, I2C_STATE_NTF is sent */
+   I2C_WRITE,           /**< Writes raw state to I2C board, I2C_STATE_NTF is sent */
+   APP_NTF,             /**< Sends notification bytes on app_ntf channel */
+   LOG,                 /**< Sends text on bluetooth channel */
+};
+
+enum class FakeTraffic : uint8_t
+{
+   LOGS,                /**< Text frames on bluetooth channel */
+   APP_NTF,             /**< Notification frames on app_ntf channel */
+   I2C_NTF,             /**< I2C_STATE_NTF frames on hw_stub channel */
+   COUNT,
+};
+
+typedef struct
+{
+   FakeActionType type;
+   uint32_t delay_ms;               /**< Delay counted from the trigger */
+   uint8_t id;                      /**< RELAY_ID for RELAY_SET, I2C address for I2C_WRITE */
+   uint16_t value;                  /**< RELAY_STATE for RELAY_SET, raw state for I2C_WRITE */
+   std::vector<uint8_t> payload;    /**< Notification bytes for APP_NTF, text for LOG */
+} FakeAction;
+
+typedef struct
+{
+   FakeTrigger trigger;
+   uint8_t id;                      /**< INPUT_ID or DHT_SENSOR_ID */
+   uint8_t threshold;               /**< Threshold for HUMIDITY triggers */
+   std::vector<FakeAction> actions;
+} FakeBehavior;
+
+class FakeSubject
+{
+public:
+   FakeSubject();
+   ~FakeSubject();
+   void addBehavior(const FakeBehavior& behavior);
+   void clearBehaviors();
+   /**
+    * @brief Starts generation of constant traffic.
+    * @param[in] traffic - type of traffic
+    * @param[in] frames_per_s - frame rate, 0 disables generation
+    * @param[in] payload - notification bytes for APP_NTF, text for LOGS, I2C address for I2C_NTF
+    * @return None.
+    */
+   void setTraffic(FakeTraffic traffic, uint32_t frames_per_s, const std::vector<uint8_t>& payload);
+   /**
+    * @brief Sets ports of TestCore servers, used from next start().
+    * @return None.
+    */
+   void setPorts(uint16_t hw_stub, uint16_t bluetooth, uint16_t app_ntf);
+   /**
+    * @brief Sets response to debug command, unknown commands are answered with FAKE_DEBUG_UNKNOWN_RESPONSE.
+    * @param[in] command - whole command text
+    * @param[in] response - response text
+    * @param[in] delay_ms - delay of the response, responses to other commands are not delayed
+    * @return None.
+    */
+   void addDebugResponse(const std::string& command, const std::string& response, uint32_t delay_ms = 0);
+   /**
+    * @brief Starts subject thread, which connects to TestCore servers.
+    * @param[in] ip_address - address of TestCore
+    * @return True if started.
+    */
+   bool start(const std::string& ip_address = "127.0.0.1");
+   void stop();
+   bool isConnected();
+   /**
+    * @brief Runs the subject until SIGINT or SIGTERM is received - to be called in child process.
+    * @return Exit code of the child.
+    */
+   int runAsChild();
+
+   uint16_t getI2CState(uint8_t address);
+   uint64_t sentFrames();
+   uint64_t receivedFrames();
+
+private:
+   enum Channel
+   {
+      CHANNEL_HW_STUB,
+      CHANNEL_BLUETOOTH,
+      CHANNEL_APP_NTF,
+      CHANNEL_COUNT,
+   };
+   typedef struct
+   {
+      uint32_t frames_per_s;
+      std::vector<uint8_t> payload;
+      std::chrono::steady_clock::time_point next;
+      uint16_t counter;
+   } TrafficGenerator;
+   typedef struct
+   {
+      I2CBusModel model;
+      uint32_t random;                 /**< State of xorshift generator */
+      I2C_RESULT forced_result;
+      uint8_t forced_count;            /**< Transactions left with forced_result */
+   } I2CBusDevice;
+   typedef struct
+   {
+      uint8_t address;
+      bool read;                       /**< Read of inputs board, write of state otherwise */
+      uint16_t state;                  /**< State written */
+      I2C_RESULT result;
+      uint32_t duration_us;
+   } I2CTransfer;
+
+   void threadExecute();
+   void connectChannels();
+   void closeChannel(Channel ch);
+   bool readFrame(Channel ch, std::vector<uint8_t>& frame);
+   bool sendFrame(Channel ch, const char* data, size_t size);
+   void onHwStubFrame(const std::vector<uint8_t>& frame);
+   void onDebugCommand(const std::vector<uint8_t>& frame);
+   void onInterrupt();
+   void onSensorUpdate(uint8_t id, uint8_t humidity);
+   void fireBehavior(const FakeBehavior& behavior);
+   void executeAction(const FakeAction& action);
+   void writeI2C(uint8_t address, uint16_t state);
+   void startTransfer(uint8_t address, bool read, uint16_t state);
+   void completeTransfer(const I2CTransfer& transfer);
+   void sampleInputs();
+   void sendBytes(Channel ch, const std::vector<uint8_t>& bytes);
+   void generateTraffic(std::chrono::steady_clock::time_point now);
+   int nextTimeout(std::chrono::steady_clock::time_point now);
+
+   std::string m_address;
+   uint16_t m_ports[CHANNEL_COUNT];
+   int m_fds[CHANNEL_COUNT];
+   std::thread m_thread;
+   std::atomic<bool> m_thread_running;
+   std::atomic<bool> m_logging;
+   std::mutex m_mtx;
+   std::vector<FakeBehavior> m_behaviors;
+   std::map<std::string, std::pair<std::string, uint32_t>> m_debug_responses;   /**< command -> response, delay */
+   TrafficGenerator m_traffic[(size_t)FakeTraffic::COUNT];
+   std::multimap<std::chrono::steady_clock::time_point, FakeAction> m_pending;
+   std::map<uint8_t, uint16_t> m_i2c_states;
+   std::map<uint8_t, I2CBusDevice> m_i2c_bus;                        /**< Modelled devices */
+   std::multimap<std::chrono::steady_clock::time_point, I2CTransfer> m_transfers;   /**< By completion time */
+   std::chrono::steady_clock::time_point m_bus_free;                  /**< End of the last transaction on the bus */
+   uint16_t m_sampled_inputs;
+   std::map<uint8_t, uint8_t> m_humidity;
+   std::atomic<uint64_t> m_sent_frames;
+   std::atomic<uint64_t> m_recv_frames;
+};
+
+#endif
@@ -0,0 +1,300 @@
+#ifndef _HWSTUBENCODER_H_
+#define _HWSTUBENCODER_H_
+
+/* ============================= */
+/**
+ * @file HwStubEncoder.h
+ *
+ * @brief Fixed-size frames of hw_stub protocol and conversion of relay/input ids to I2C bit masks.
+ *
+ * @details
+ *    Frame layout is known at compile time for every HW_STUB_EVENT_ID, so frames are kept in std::array
+ *    and encoded to text on the stack - no heap allocation is needed to send a stimulus.
+ *    RELAYS_MATCH/INPUTS_MATCH tables are converted at compile time to id->mask lookup tables.
+ *    FrameBatch collects several encoded frames in fixed buffer, so they can be written to socket at once.
+ *    I2CBusModel describes timing and errors of transactions with one I2C device (set by I2C_BUS_SET),
+ *    every modelled transaction is reported back by I2C_TRANSFER_NTF.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <stddef.h>
+#include <array>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+#include "relays_types.h"
+#include "inputs_types.h"
+#include "SocketDriver.h"
+/* =============================
+ *       Data structures
+ * =============================*/
+typedef enum
+{
+/* Below enumerations are cloned in test framework, any change here must lead to change in both places*/
+//TODO: move to common space
+   I2C_STATE_SET = 1,       /*< Sets current state of I2C board - in raw format, e.g. 0xFFFF */
+   I2C_STATE_NTF = 2,       /*< Event sent to test framework to notify that new data was written to I2C device */
+   DHT_STATE_SET = 3,       /*< Sets current state of DHT sensor */
+   I2C_INT_TRIGGER = 4,     /*< Event to simulate I2C interrupt */
+   I2C_BUS_SET = 5,         /*< Sets timing and error model of transactions with I2C device */
+   I2C_RESULT_SET = 6,      /*< Forces result of next transactions with I2C device */
+   I2C_TRANSFER_NTF = 7,    /*< Event sent to test framework with result and duration of modelled I2C transaction */
+   HW_STUB_EV_ENUM_COUNT,
+} HW_STUB_EVENT_ID;
+
+typedef enum
+{
+   I2C_RESULT_OK = 0,
+   I2C_RESULT_NACK = 1,     /*< Device did not acknowledge its address, transaction aborted after first byte */
+   I2C_RESULT_BUS_ERROR = 2,/*< Transaction aborted on the bus (arbitration lost, timeout), data not transferred */
+   I2C_RESULT_COUNT,
+} I2C_RESULT;
+
+struct I2CBusModel
+{
+   uint16_t latency_us = 0;         /**< Fixed time of every transaction (driver, start and stop conditions) */
+   uint16_t clock_khz = 0;          /**< SCL frequency, 9 clocks per byte, 0 - transfer time not modelled */
+   uint16_t stretch_us = 0;         /**< Maximum clock stretching by device, random 0..stretch_us per transaction */
+   uint16_t nack_permille = 0;      /**< Probability of I2C_RESULT_NACK */
+   uint16_t error_permille = 0;     /**< Probability of I2C_RESULT_BUS_ERROR */
+   uint8_t seed = 0;                /**< The same seed gives the same sequence of results and stretching */
+};
+
+namespace hw_stub
+{
+/* =============================
+ *     Relay/input id to mask
+ * =============================*/
+constexpr RELAY_ID RELAY_ID_MATCH [RELAYS_RELAY_COUNT + 1] = RELAYS_MATCH;
+constexpr INPUT_ID INPUT_ID_MATCH [INPUTS_INPUT_COUNT + 1] = INPUTS_MATCH;
+
+constexpr uint16_t relay_no_to_mask(size_t relay_no)
+{
+   return (uint16_t)(1 << (relay_no - 1));
+}
+constexpr uint16_t input_no_to_mask(size_t input_no)
+{
+   return input_no < 9? (uint16_t)(1 << (16 - input_no)) : (uint16_t)(1 << (input_no - 9));
+}
+template <typename ID, size_t N>
+constexpr size_t mask_table_size(const ID (&match)[N])
+{
+   size_t result = 0;
+   for (size_t i = 0; i < N; i++)
+   {
+      result = (size_t)match[i] + 1 > result? (size_t)match[i] + 1 : result;
+   }
+   return result;
+}
+/**
+ * @brief Builds id->mask table from MATCH table (index is the relay/input number).
+ *        Id placed at index 0 marks unused positions and gets no mask, for duplicated ids first position wins.
+ */
+template <size_t SIZE, uint16_t (*NO_TO_MASK)(size_t), typename ID, size_t N>
+constexpr std::array<uint16_t, SIZE> make_mask_table(const ID (&match)[N])
+{
+   std::array<uint16_t, SIZE> result {};
+   for (size_t i = 1; i < N; i++)
+   {
+      if (match[i] != match[0] && result[match[i]] == 0)
+      {
+         result[match[i]] = NO_TO_MASK(i);
+      }
+   }
+   return result;
+}
+
+constexpr size_t RELAY_MASKS_SIZE = mask_table_size(RELAY_ID_MATCH);
+constexpr size_t INPUT_MASKS_SIZE = mask_table_size(INPUT_ID_MATCH);
+constexpr std::array<uint16_t, RELAY_MASKS_SIZE> RELAY_MASKS = make_mask_table<RELAY_MASKS_SIZE, relay_no_to_mask>(RELAY_ID_MATCH);
+constexpr std::array<uint16_t, INPUT_MASKS_SIZE> INPUT_MASKS = make_mask_table<INPUT_MASKS_SIZE, input_no_to_mask>(INPUT_ID_MATCH);
+
+constexpr uint16_t relay_mask(RELAY_ID id)
+{
+   return (size_t)id < RELAY_MASKS.size()? RELAY_MASKS[id] : 0;
+}
+constexpr uint16_t input_mask(INPUT_ID id)
+{
+   return (size_t)id < INPUT_MASKS.size()? INPUT_MASKS[id] : 0;
+}
+/* =============================
+ *        I2C bus timing
+ * =============================*/
+constexpr size_t I2C_BOARD_TRANSFER_BYTES = 3;   /**< Address and 16-bit state of I2C board */
+/**
+ * @brief Time of transaction without clock stretching.
+ * @param[in] model - bus model of the device
+ * @param[in] bytes - bytes transferred, including address byte
+ */
+constexpr uint32_t i2c_transfer_us(const I2CBusModel& model, size_t bytes)
+{
+   return model.latency_us + (model.clock_khz? (uint32_t)(bytes * 9 * 1000 / model.clock_khz) : 0);
+}
+/* =============================
+ *           Frames
+ * =============================*/
+template <HW_STUB_EVENT_ID ID> struct FrameTraits;
+template <> struct FrameTraits<I2C_STATE_SET>   { static constexpr uint8_t LENGTH = 3; };  /**< address, state low, state high */
+template <> struct FrameTraits<I2C_STATE_NTF>   { static constexpr uint8_t LENGTH = 3; };  /**< address, state low, state high */
+template <> struct FrameTraits<DHT_STATE_SET>   { static constexpr uint8_t LENGTH = 6; };  /**< id, type, temp, 0, hum, 0 */
+template <> struct FrameTraits<I2C_INT_TRIGGER> { static constexpr uint8_t LENGTH = 0; };
+template <> struct FrameTraits<I2C_BUS_SET>     { static constexpr uint8_t LENGTH = 12; }; /**< address, I2CBusModel fields (16-bit little endian) */
+template <> struct FrameTraits<I2C_RESULT_SET>  { static constexpr uint8_t LENGTH = 3; };  /**< address, I2C_RESULT, transactions count */
+template <> struct FrameTraits<I2C_TRANSFER_NTF>{ static constexpr uint8_t LENGTH = 6; };  /**< address, read, I2C_RESULT, duration [us] (24-bit little endian) */
+
+/** Frame with event id and length header */
+template <HW_STUB_EVENT_ID ID>
+using Frame = std::array<uint8_t, FrameTraits<ID>::LENGTH + 2>;
+
+template <HW_STUB_EVENT_ID ID, typename... Data>
+constexpr Frame<ID> make_frame(Data... data)
+{
+   static_assert(sizeof...(Data) == FrameTraits<ID>::LENGTH, "invalid number of bytes for hw_stub event");
+   return Frame<ID> {{(uint8_t)ID, FrameTraits<ID>::LENGTH, (uint8_t)data...}};
+}
+template <HW_STUB_EVENT_ID ID>
+constexpr Frame<ID> make_i2c_frame(uint8_t address, uint16_t state)
+{
+   return make_frame<ID>(address, state & 0xFF, (state >> 8) & 0xFF);
+}
+constexpr Frame<DHT_STATE_SET> make_dht_frame(uint8_t id, uint8_t type, int8_t temp, uint8_t hum)
+{
+   return make_frame<DHT_STATE_SET>(id, type, temp, 0x00, hum, 0x00);
+}
+constexpr Frame<I2C_BUS_SET> make_bus_frame(uint8_t address, const I2CBusModel& model)
+{
+   return make_frame<I2C_BUS_SET>(address, model.latency_us & 0xFF, model.latency_us >> 8, model.clock_khz & 0xFF, model.clock_khz >> 8,
+                                  model.stretch_us & 0xFF, model.stretch_us >> 8, model.nack_permille & 0xFF, model.nack_permille >> 8,
+                                  model.error_permille & 0xFF, model.error_permille >> 8, model.seed);
+}
+/**
+ * @brief Reads I2CBusModel from data of I2C_BUS_SET frame (after address byte).
+ */
+constexpr I2CBusModel decode_bus_model(const uint8_t* data)
+{
+   I2CBusModel model;
+   model.latency_us = data[0] | (data[1] << 8);
+   model.clock_khz = data[2] | (data[3] << 8);
+   model.stretch_us = data[4] | (data[5] << 8);
+   model.nack_permille = data[6] | (data[7] << 8);
+   model.error_permille = data[8] | (data[9] << 8);
+   model.seed = data[10];
+   return model;
+}
+constexpr Frame<I2C_TRANSFER_NTF> make_transfer_frame(uint8_t address, bool read, I2C_RESULT result, uint32_t duration_us)
+{
+   return make_frame<I2C_TRANSFER_NTF>(address, read? 1 : 0, result, duration_us & 0xFF, (duration_us >> 8) & 0xFF, (duration_us >> 16) & 0xFF);
+}
+/* =============================
+ *        Text encoding
+ * =============================*/
+/** Text size needed for N bytes - up to 3 digits and separator per byte */
+template <size_t N>
+constexpr size_t text_size()
+{
+   return N * 4;
+}
+/**
+ * @brief Writes bytes as space separated decimal numbers (format expected by hw_stub).
+ * @param[in] frame - frame to encode
+ * @param[out] out - output buffer, at least text_size<N>() bytes
+ * @return Number of characters written (without terminating zero, which is not written).
+ */
+template <size_t N>
+size_t encode(const std::array<uint8_t, N>& frame, char* out)
+{
+   size_t idx = 0;
+   for (uint8_t byte : frame)
+   {
+      if (byte >= 100)
+      {
+         out[idx++] = '0' + byte / 100;
+      }
+      if (byte >= 10)
+      {
+         out[idx++] = '0' + (byte / 10) % 10;
+      }
+      out[idx++] = '0' + byte % 10;
+      out[idx++] = ' ';
+   }
+   return idx > 0? idx - 1 : 0;
+}
+/**
+ * @brief Reads bytes written as space separated decimal numbers (format of hw_stub and notifications).
+ * @param[in] text - encoded bytes, does not have to be zero terminated
+ * @param[in] size - number of characters
+ * @param[out] out - decoded bytes
+ * @param[in] capacity - size of out, (size + 1) / 2 is always enough
+ * @return Number of bytes written to out.
+ */
+inline size_t decode(const char* text, size_t size, uint8_t* out, size_t capacity)
+{
+   size_t count = 0;
+   bool in_number = false;
+   unsigned value = 0;
+   for (size_t i = 0; i <= size && count < capacity; i++)
+   {
+      if (i < size && text[i] >= '0' && text[i] <= '9')
+      {
+         value = value * 10 + (text[i] - '0');
+         in_number = true;
+      }
+      else if (in_number)
+      {
+         out[count++] = (uint8_t)value;
+         value = 0;
+         in_number = false;
+      }
+   }
+   return count;
+}
+/**
+ * @brief Encoded frames kept one after another in fixed-size buffer.
+ * @tparam CAPACITY - size of text buffer
+ * @tparam MAX_FRAMES - maximum number of frames
+ */
+template <size_t CAPACITY, size_t MAX_FRAMES>
+class FrameBatch
+{
+public:
+   FrameBatch(): m_size(0), m_count(0) {}
+   template <size_t N>
+   bool add(const std::array<uint8_t, N>& frame)
+   {
+      bool result = false;
+      if (m_count < MAX_FRAMES && m_size + text_size<N>() <= CAPACITY)
+      {
+         size_t size = encode(frame, (char*)m_text + m_size);
+         m_events[m_count] = frame[0];
+         m_addresses[m_count] = N > 2? frame[2] : 0;
+         m_frames[m_count++] = {m_text + m_size, size};
+         m_size += size;
+         result = true;
+      }
+      return result;
+   }
+   const SocketFrame* frames() const { return m_frames; }
+   size_t count() const { return m_count; }
+   /** Event id of the frame */
+   uint8_t event(size_t idx) const { return m_events[idx]; }
+   /** First data byte of the frame (I2C address, sensor id), 0 if frame has no data */
+   uint8_t address(size_t idx) const { return m_addresses[idx]; }
+private:
+   uint8_t m_text [CAPACITY];
+   SocketFrame m_frames [MAX_FRAMES];
+   uint8_t m_events [MAX_FRAMES];
+   uint8_t m_addresses [MAX_FRAMES];
+   size_t m_size;
+   size_t m_count;
+};
+
+}
+
+#endif
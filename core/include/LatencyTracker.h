@@ -0,0 +1,125 @@
+#ifndef _LATENCYTRACKER_H_
+#define _LATENCYTRACKER_H_
+
+/* ============================= */
+/**
+ * @file LatencyTracker.h
+ *
+ * @brief Measurement of the time between stimulus sent to tested application and its response.
+ *
+ * @details
+ *    Test declares stimulus/response pairs (e.g. I2C interrupt trigger -> first I2C_STATE_NTF from SLM board).
+ *    When stimulus is sent, the pair is armed with stimulus timestamp (next stimulus re-arms the pair).
+ *    First matching response received while pair is armed is measured and disarms the pair.
+ *    Latencies are kept in log-linear (HDR-like) histogram with constant relative precision,
+ *    so recording is O(1) and memory does not depend on number of samples.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+/* =============================
+ *          Defines
+ * =============================*/
+#define LATENCY_SUB_BUCKET_BITS 5     /**< 32 sub-buckets per power of two - ~3% precision */
+#define LATENCY_MAX_EXPONENT 40       /**< values up to 2^40 us */
+/* =============================
+ *       Data structures
+ * =============================*/
+enum class StimulusType : uint8_t
+{
+   RELAY_SET,        /**< State of relays board set by framework */
+   INPUT_SET,        /**< State of inputs board set by framework */
+   SENSOR_SET,       /**< DHT sensor data set by framework */
+   INT_TRIGGER,      /**< I2C interrupt triggered by framework */
+};
+
+enum class ResponseType : uint8_t
+{
+   I2C_STATE,        /**< I2C_STATE_NTF received, id is I2C address */
+   APP_NTF,          /**< Application notification received, id is NTF_CMD_ID */
+};
+
+class LatencyHistogram
+{
+public:
+   LatencyHistogram();
+   void record(uint64_t value_us);
+   void clear();
+   uint64_t count() const;
+   uint64_t min() const;
+   uint64_t max() const;
+   double mean() const;
+   /**
+    * @brief Returns value below which given percent of samples falls.
+    * @param[in] percentile - percentile in range 0-100
+    * @return Highest value equivalent to the bucket containing requested percentile.
+    */
+   uint64_t percentile(double percentile) const;
+
+private:
+   static size_t bucketIndex(uint64_t value);
+   static uint64_t bucketHighestValue(size_t idx);
+
+   std::vector<uint64_t> m_counts;
+   uint64_t m_count;
+   uint64_t m_min;
+   uint64_t m_max;
+   uint64_t m_sum;
+};
+
+class LatencyTracker
+{
+public:
+   LatencyTracker();
+   /**
+    * @brief Declares new stimulus/response pair.
+    * @param[in] name - name used in report
+    * @param[in] stimulus - stimulus type
+    * @param[in] response - response type
+    * @param[in] response_id - I2C address or NTF_CMD_ID
+    * @return None.
+    */
+   void addPair(const std::string& name, StimulusType stimulus, ResponseType response, uint8_t response_id);
+   void clear();
+   LatencyHistogram getHistogram(const std::string& name);
+   void onStimulus(StimulusType stimulus, std::chrono::steady_clock::time_point timestamp);
+   void onResponse(ResponseType response, uint8_t id, std::chrono::steady_clock::time_point timestamp);
+   /**
+    * @brief Writes percentiles of all pairs as JSON document, file is not created if no pair is declared.
+    * @param[in] file_path - path to output file
+    * @param[in] test_name - name of the test
+    * @return True if file written.
+    */
+   bool exportJson(const std::string& file_path, const std::string& test_name);
+
+private:
+   typedef struct
+   {
+      std::string name;
+      StimulusType stimulus;
+      ResponseType response;
+      uint8_t response_id;
+      bool armed;
+      std::chrono::steady_clock::time_point stimulus_time;
+      uint64_t unanswered;
+      LatencyHistogram histogram;
+   } LatencyPair;
+
+   std::mutex m_mtx;
+   std::vector<LatencyPair> m_pairs;
+};
+
+#endif
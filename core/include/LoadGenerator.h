@@ -0,0 +1,148 @@
+#ifndef _LOADGENERATOR_H_
+#define _LOADGENERATOR_H_
+
+/* ============================= */
+/**
+ * @file LoadGenerator.h
+ *
+ * @brief Open-loop generator of stimulus events, used to find the saturation point of tested application.
+ *
+ * @details
+ *    Generator thread emits events with constant rate, in bursts or with Poisson distributed intervals.
+ *    Events are emitted according to schedule, regardless of the responses (open loop), so when tested
+ *    application is saturated, the backlog (events not answered yet) grows.
+ *    Responses are reported by the owner (TestCore) from socket threads.
+ *    Backlog and transmit queue are sampled periodically, report contains achieved rates, number of events
+ *    which were dropped or coalesced by application and backlog growth.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <random>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+#include "inputs_types.h"
+#include "LatencyTracker.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define LOAD_SAMPLE_PERIOD_MS 100
+/* =============================
+ *       Data structures
+ * =============================*/
+enum class LoadPattern : uint8_t
+{
+   CONSTANT,      /**< Events in equal intervals */
+   BURST,         /**< burst_size events sent back-to-back, bursts spaced to keep average rate */
+   POISSON,       /**< Exponentially distributed intervals with average rate */
+};
+
+typedef struct
+{
+   LoadPattern pattern = LoadPattern::CONSTANT;
+   uint32_t rate_per_s = 100;                /**< Average number of events per second */
+   uint32_t burst_size = 10;                 /**< Events in single burst (BURST only) */
+   uint32_t duration_ms = 0;                 /**< Time of generation, 0 - until stopped. Every event scheduled in it is emitted */
+   uint32_t seed = 1;                        /**< Seed of POISSON intervals - same seed gives same schedule */
+   std::vector<INPUT_ID> inputs;             /**< Inputs toggled in round robin, every event toggles one input */
+   bool trigger_interrupt = true;            /**< I2C_INT_TRIGGER sent together with every input change */
+   ResponseType response = ResponseType::APP_NTF;  /**< Response expected for every event */
+   uint8_t response_id = 0;                  /**< I2C address or NTF_CMD_ID of expected response */
+} LoadProfile;
+
+typedef struct
+{
+   uint32_t elapsed_ms;
+   uint64_t events;
+   uint64_t responses;
+   uint64_t backlog;
+   uint64_t tx_queue_bytes;
+} LoadSample;
+
+typedef struct
+{
+   uint64_t events = 0;                /**< Events emitted */
+   uint64_t send_failures = 0;         /**< Events which could not be written */
+   uint64_t late_events = 0;           /**< Events emitted after schedule (generator could not keep up) */
+   uint64_t i2c_ntf = 0;               /**< All I2C_STATE_NTF received during load */
+   uint64_t app_ntf = 0;               /**< All application notifications received during load */
+   uint64_t responses = 0;             /**< Responses matching the profile */
+   uint64_t dropped = 0;               /**< Events without response - dropped or coalesced by application */
+   uint32_t duration_ms = 0;           /**< Time from start to the end of drain */
+   double event_rate = 0;              /**< Achieved events per second */
+   double response_rate = 0;           /**< Sustained responses per second during generation */
+   uint64_t max_backlog = 0;           /**< Highest number of events waiting for response */
+   double backlog_growth = 0;          /**< Backlog growth per second during generation (least squares) */
+   uint64_t max_tx_queue_bytes = 0;    /**< Highest number of bytes not read by application */
+   std::vector<LoadSample> samples;
+} LoadReport;
+
+/** Emits single event - toggles given input, returns true if written */
+typedef std::function<bool(INPUT_ID id)> LoadStimulus;
+/** Returns number of bytes written to application, but not read by it yet */
+typedef std::function<uint64_t()> LoadQueueProbe;
+
+class LoadGenerator
+{
+public:
+   LoadGenerator();
+   ~LoadGenerator();
+   /**
+    * @brief Starts generator thread.
+    * @param[in] profile - load description
+    * @param[in] stimulus - function emitting single event
+    * @param[in] probe - function returning transmit queue size, can be empty
+    * @return True if started.
+    */
+   bool start(const LoadProfile& profile, LoadStimulus stimulus, LoadQueueProbe probe);
+   /**
+    * @brief Stops generation, waits for remaining responses and prepares report.
+    * @param[in] drain_ms - time to wait for responses after the last event
+    * @return Load report.
+    */
+   LoadReport stop(uint32_t drain_ms);
+   bool isRunning();
+   void onI2CNotification(uint8_t address);
+   void onAppNotification(uint8_t id);
+   bool exportJson(const LoadReport& report, const std::string& file_path, const std::string& test_name);
+
+private:
+   void threadExecute();
+   std::chrono::nanoseconds nextInterval(uint64_t event_no);
+   void takeSample(std::chrono::steady_clock::time_point now);
+
+   LoadProfile m_profile;
+   LoadStimulus m_stimulus;
+   LoadQueueProbe m_probe;
+   std::thread m_thread;
+   std::atomic<bool> m_running;
+   std::mutex m_mtx;
+   std::condition_variable m_cv;
+   std::chrono::steady_clock::time_point m_start;
+   std::chrono::steady_clock::time_point m_generation_end;
+   std::atomic<uint64_t> m_events;
+   std::atomic<uint64_t> m_send_failures;
+   std::atomic<uint64_t> m_late_events;
+   std::atomic<uint64_t> m_i2c_ntf;
+   std::atomic<uint64_t> m_app_ntf;
+   std::atomic<uint64_t> m_responses;
+   std::vector<LoadSample> m_samples;
+   std::mt19937 m_random;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef _LOGMATCHER_H_
+#define _LOGMATCHER_H_
+
+/* ============================= */
+/**
+ * @file LogMatcher.h
+ *
+ * @brief Matches received traces against all watched patterns at once.
+ *
+ * @details
+ *    Patterns are compiled to one Aho-Corasick automaton (DFA over classes of bytes used in patterns),
+ *    so every received frame is scanned once, in time linear to the frame size, regardless of number of
+ *    watched patterns. Every frame is a separate trace, matches do not cross frame boundaries.
+ *    Automaton is rebuilt when pattern is added or removed - this is done by the test thread, outside of
+ *    the hot path. Patterns are literal texts.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+/* =============================
+ *       Data structures
+ * =============================*/
+typedef uint32_t LogPatternId;         /**< 0 is invalid id */
+
+class LogMatcher
+{
+public:
+   LogMatcher();
+   /**
+    * @brief Starts watching the pattern, occurrences are counted from now.
+    * @param[in] pattern - literal text
+    * @return Id of the pattern, 0 if pattern is empty.
+    */
+   LogPatternId add(const std::string& pattern);
+   void remove(LogPatternId id);
+   void clear();
+   /**
+    * @brief Scans one received frame for all watched patterns.
+    * @return Number of found occurrences.
+    */
+   size_t scan(const uint8_t* data, size_t size);
+   /**
+    * @brief Returns number of occurrences of pattern found since it was added.
+    */
+   uint32_t hits(LogPatternId id);
+   /**
+    * @brief Waits until pattern is found, returns immediately if it was found already.
+    * @return True if found.
+    */
+   bool waitForHit(LogPatternId id, uint32_t timeout_ms);
+   size_t patterns();
+
+private:
+   struct Pattern
+   {
+      std::string text;
+      uint32_t hits;
+   };
+   void build();
+
+   std::mutex m_mtx;
+   std::condition_variable m_cv;
+   std::map<LogPatternId, Pattern> m_patterns;
+   LogPatternId m_next_id;
+   /* automaton - state * m_class_count + class of byte gives next state */
+   std::array<uint16_t, 256> m_classes;
+   size_t m_class_count;
+   std::vector<uint32_t> m_next;
+   /* patterns found in state s are m_outputs[m_output_begin[s]..m_output_begin[s + 1]) */
+   std::vector<uint32_t> m_output_begin;
+   std::vector<Pattern*> m_outputs;
+};
+
+#endif
@@ -37,6 +37,8 @@ enum LogGroup
    TF_ERROR,         /**< Error logs */
    TF_SOCKDRV,       /**< Logs from test framework - Socket driver */
    TF_TC,            /**< Logs from TestCore */
+   TF_FAKE,          /**< Logs from FakeSubject */
+   TF_CLUSTER,       /**< Logs from TestCluster */
    LOG_ENUM_MAX,
 };
 
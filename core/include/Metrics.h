@@ -0,0 +1,129 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+/* ============================= */
+/**
+ * @file Metrics.h
+ *
+ * @brief Runtime counters and gauges of the test framework with Prometheus/JSON export.
+ *
+ * @details
+ *    MetricValue is a single atomic value placed in its own cache line, so values updated from different
+ *    threads (socket drivers, test thread) do not share cache lines. Update path is lock-free.
+ *    MetricsRegistry keeps named references to values (or sampling functions) and formats them
+ *    as Prometheus text or JSON document. Values can be written to file or served over local TCP socket
+ *    (any request is answered with current snapshot, request containing "json" gets JSON format).
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+/* =============================
+ *          Defines
+ * =============================*/
+#define METRICS_CACHE_LINE_SIZE 64
+#define METRICS_PREFIX "smarthome_tf_"
+/* =============================
+ *       Data structures
+ * =============================*/
+enum class MetricType
+{
+   COUNTER,       /**< Monotonic value */
+   GAUGE,         /**< Current value, may go up and down */
+};
+
+enum class MetricsFormat
+{
+   PROMETHEUS,    /**< Prometheus text exposition format */
+   JSON,          /**< JSON document */
+};
+
+class alignas(METRICS_CACHE_LINE_SIZE) MetricValue
+{
+public:
+   MetricValue(): m_value(0) {}
+   void add(uint64_t value = 1) { m_value.fetch_add(value, std::memory_order_relaxed); }
+   void set(uint64_t value) { m_value.store(value, std::memory_order_relaxed); }
+   void setMax(uint64_t value)
+   {
+      uint64_t current = m_value.load(std::memory_order_relaxed);
+      while (value > current && !m_value.compare_exchange_weak(current, value, std::memory_order_relaxed));
+   }
+   uint64_t get() const { return m_value.load(std::memory_order_relaxed); }
+private:
+   std::atomic<uint64_t> m_value;
+};
+
+typedef std::function<uint64_t()> MetricSampler;
+
+class MetricsRegistry
+{
+public:
+   MetricsRegistry();
+   ~MetricsRegistry();
+   /**
+    * @brief Registers value under given name and label.
+    * @param[in] name - metric name (without prefix)
+    * @param[in] help - description of the metric
+    * @param[in] type - metric type
+    * @param[in] label - label in key=value format (e.g. channel=hw_stub), can be empty
+    * @param[in] value - value to report, has to be valid as long as registry uses it
+    * @return None.
+    */
+   void add(const std::string& name, const std::string& help, MetricType type, const std::string& label, const MetricValue* value);
+   /**
+    * @brief Registers sampling function called on every export - function must be thread-safe.
+    */
+   void add(const std::string& name, const std::string& help, MetricType type, const std::string& label, MetricSampler sampler);
+   void clear();
+   std::string format(MetricsFormat format);
+   bool writeFile(const std::string& file_path, MetricsFormat format);
+   /**
+    * @brief Starts server on 127.0.0.1, which sends current metrics to every connected client.
+    * @param[in] port - TCP port, 0 - any free port chosen by the system
+    * @return True if server started.
+    */
+   bool startServer(uint16_t port);
+   void stopServer();
+   /**
+    * @brief Returns port the server listens on, valid after successful startServer().
+    */
+   uint16_t serverPort();
+
+private:
+   typedef struct
+   {
+      std::string name;
+      std::string help;
+      MetricType type;
+      std::string label_key;
+      std::string label_value;
+      const MetricValue* value;
+      MetricSampler sampler;
+   } MetricEntry;
+
+   void serverExecute();
+
+   std::mutex m_mtx;
+   std::vector<MetricEntry> m_entries;
+   int m_server_fd;
+   uint16_t m_server_port;
+   std::thread m_server_thread;
+   std::atomic<bool> m_server_running;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef _RESOURCESAMPLER_H_
+#define _RESOURCESAMPLER_H_
+
+/* ============================= */
+/**
+ * @file ResourceSampler.h
+ *
+ * @brief Periodic sampling of CPU and memory usage of the tested process.
+ *
+ * @details
+ *    Background thread reads /proc/<pid>/stat, statm and status of the subject with given period.
+ *    Files are opened once and re-read with pread(), so single sample costs three reads without any allocation.
+ *    Samples are kept in memory for budget assertions and appended to timeline file (one CSV line per sample).
+ *    Sampling ends when sampler is stopped or the process exits.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <sys/types.h>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+/* =============================
+ *          Defines
+ * =============================*/
+#define SAMPLER_DEFAULT_PERIOD_MS 100
+/* =============================
+ *       Data structures
+ * =============================*/
+typedef struct
+{
+   uint32_t elapsed_ms;                /**< Time since sampling started */
+   uint64_t user_ticks;                /**< utime from /proc/<pid>/stat, in clock ticks */
+   uint64_t system_ticks;              /**< stime from /proc/<pid>/stat, in clock ticks */
+   uint64_t rss_bytes;                 /**< Resident set size from statm */
+   uint64_t vm_bytes;                  /**< Virtual memory size from statm */
+   uint64_t peak_rss_bytes;            /**< VmHWM from status - includes peaks between samples */
+   uint32_t threads;
+   uint64_t voluntary_switches;
+   uint64_t involuntary_switches;
+} ResourceSample;
+
+typedef struct
+{
+   size_t samples = 0;                 /**< Samples in the window */
+   uint32_t duration_ms = 0;           /**< Time between the first and the last sample of the window */
+   double cpu_percent = 0;             /**< Average CPU usage in the window (100% - one core) */
+   uint64_t max_rss_bytes = 0;         /**< Highest RSS in the window (VmHWM included) */
+   double rss_growth_bytes = 0;        /**< RSS growth in the window, from least squares slope */
+} ResourceSummary;
+
+class ResourceSampler
+{
+public:
+   ResourceSampler();
+   ~ResourceSampler();
+   /**
+    * @brief Starts sampling thread.
+    * @param[in] pid - process to sample
+    * @param[in] period_ms - sampling period
+    * @param[in] timeline_path - CSV file for samples, empty if samples shall be kept in memory only
+    * @return True if started.
+    */
+   bool start(pid_t pid, uint32_t period_ms, const std::string& timeline_path);
+   void stop();
+   bool isRunning();
+   /**
+    * @brief Returns time since sampling started (0 if never started).
+    */
+   uint32_t elapsed();
+   /**
+    * @brief Summarizes samples from the last window_ms.
+    * @param[in] window_ms - time window counted back from the last sample, 0 for all samples
+    * @return Summary of the window.
+    */
+   ResourceSummary summarize(uint32_t window_ms);
+   std::vector<ResourceSample> getSamples();
+
+private:
+   void threadExecute();
+   bool takeSample(ResourceSample& sample);
+   void closeFiles();
+
+   pid_t m_pid;
+   uint32_t m_period_ms;
+   int m_stat_fd;
+   int m_statm_fd;
+   int m_status_fd;
+   long m_page_size;
+   long m_clock_ticks;
+   FILE* m_timeline;
+   std::thread m_thread;
+   std::atomic<bool> m_running;
+   std::mutex m_mtx;
+   std::condition_variable m_cv;
+   std::chrono::steady_clock::time_point m_start;
+   std::vector<ResourceSample> m_samples;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef _RESULTCACHE_H_
+#define _RESULTCACHE_H_
+
+/* ============================= */
+/**
+ * @file ResultCache.h
+ *
+ * @brief Cache of passed tests, keyed on content of everything the result depends on.
+ *
+ * @details
+ *    Inputs (tested binary, test executable, configuration headers) are hashed with SHA-256 once per run.
+ *    Key of the test is SHA-256 of the inputs digest and the full test name, passed test is stored as
+ *    <cache_dir>/<key> file (content-addressed - changing any input changes keys of all tests, stale
+ *    entries are never matched). Missing input is hashed as its path, so tests are run again when it appears.
+ *    Test runner (TestRunnerMain.cpp) filters out cached passes before running and stores new passes
+ *    with ResultCache::Listener.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define RESULT_CACHE_DIR ".test_cache"    /**< Relative to PROJECT_ROOT_PATH */
+/* =============================
+ *       Data structures
+ * =============================*/
+class ResultCache
+{
+public:
+   /**
+    * @brief Hashes the inputs, cache can be used from now.
+    * @param[in] cache_dir - directory of cache entries, created if needed
+    * @param[in] inputs - paths of files the test results depend on
+    * @return True if cache directory is usable.
+    */
+   bool open(const std::string& cache_dir, const std::vector<std::string>& inputs);
+   /**
+    * @brief Returns true if test passed before with the same inputs.
+    * @param[in] test_name - <suite>.<test>
+    */
+   bool isPassed(const std::string& test_name);
+   void storePass(const std::string& test_name);
+   /**
+    * @brief Returns hex SHA-256 of the file, empty if file cannot be read.
+    */
+   static std::string hashFile(const std::string& path);
+   static std::string hashText(const std::string& text);
+
+   /** Stores passes of finished tests */
+   class Listener : public testing::EmptyTestEventListener
+   {
+   public:
+      Listener(ResultCache& cache): m_cache(cache) {}
+      void OnTestEnd(const testing::TestInfo& test_info) override;
+   private:
+      ResultCache& m_cache;
+   };
+
+private:
+   std::string entryPath(const std::string& test_name);
+
+   std::string m_dir;
+   std::string m_inputs_digest;
+};
+
+#endif
@@ -10,6 +10,7 @@
  * @description
  *    This class is responsible for communication with TCP clients from tested binary.
  *    Module opens 3 TCP servers (for HW_STUB control, APP_NTF and logs).
+ *    Frames of both directions can be delayed, dropped or stalled by ChannelImpairment (see setImpairment()).
  *
  * @author Jacek Skowronek
  * @date   05/02/2021
@@ -24,22 +25,50 @@
 #include <atomic>
 #include <functional>
 #include <netinet/in.h>
+#include <sys/uio.h>
 /* =============================
  *   Includes of project headers
  * =============================*/
+#include "Metrics.h"
+#include "ChannelImpairment.h"
 /* =============================
  *           Defines
  * =============================*/
 #define SOCKDRV_MAX_RW_SIZE 1024
 #define SOCKDRV_RECV_BUFFER_SIZE 1024
+#define SOCKDRV_MAX_BATCH_FRAMES 64     /**< Frames written together are passed to sendmsg() in chunks of this count */
 enum class DriverEvent
 {
    DRIVER_CONNECTED,    /**< Driver connects successfully to server */
    DRIVER_DISCONNECTED, /**< Driver disconnected - server closed or error appears */
    DRIVER_DATA_RECV,    /**< New data received by driver */
 };
+typedef struct
+{
+   const uint8_t* data;
+   size_t size;
+} SocketFrame;
+
 typedef std::function<void(DriverEvent ev, const std::vector<uint8_t>& data, size_t count)> SocketListener;
 
+/**
+ * @brief Runtime counters of single channel - every value placed in own cache line,
+ *        as receiving thread and test thread update them concurrently.
+ */
+struct SocketMetrics
+{
+   MetricValue frames_in;              /**< Frames received from client */
+   MetricValue bytes_in;               /**< Payload bytes received from client */
+   MetricValue frames_out;             /**< Frames written to client */
+   MetricValue bytes_out;              /**< Payload bytes written to client */
+   MetricValue write_failures;         /**< Frames which could not be written */
+   MetricValue socket_writes;          /**< send() calls on the client socket */
+   MetricValue rx_queue_bytes;         /**< Bytes waiting in socket receive queue after last read */
+   MetricValue callback_count;         /**< Listener calls with received data */
+   MetricValue callback_time_ns;       /**< Total time spent in listener */
+   MetricValue callback_time_max_ns;   /**< Longest single listener call */
+};
+
 class SocketDriver
 {
 public:
@@ -52,10 +81,49 @@ public:
    void addListener(SocketListener callback);
    void removeListener();
    bool write(const std::vector<uint8_t>& data, size_t size = 0);
+   bool write(const uint8_t* data, size_t size);
+   /**
+    * @brief Writes several frames with as few system calls as possible.
+    * @param[in] frames - frames to write
+    * @param[in] count - number of frames
+    * @return True if all frames were written.
+    */
+   bool write(const SocketFrame* frames, size_t count);
+   /**
+    * @brief Registers channel counters in registry.
+    * @param[in] registry - metrics registry
+    * @param[in] channel - name of the channel used as label
+    * @return None.
+    */
+   void registerMetrics(MetricsRegistry& registry, const std::string& channel);
+   const SocketMetrics& getMetrics();
+   /**
+    * @brief Returns number of bytes written to client, but not acknowledged by it yet.
+    */
+   uint64_t pendingTxBytes();
+   /**
+    * @brief Sets impairment of the direction (see ChannelImpairment.h), default profile disables it.
+    *        Impaired frames are written (outbound) or passed to listener (inbound) from impairment thread.
+    * @return None.
+    */
+   void setImpairment(ImpairmentDirection direction, const ImpairmentProfile& profile);
+   /**
+    * @brief Stops reading of the socket for given time (frame received during the pause is held until its end),
+    *        so tested application is blocked on write when socket buffers are full.
+    * @return None.
+    */
+   void pauseReceive(uint32_t duration_ms);
+   /**
+    * @brief Disables impairments, drops impaired frames not released yet and resumes receive.
+    * @return None.
+    */
+   void clearImpairments();
 
 private:
    void setDelimiter(char c);
    void threadExecute();
+   bool sendAll(struct iovec* iov, size_t count);
+   bool sendFrames(const SocketFrame* frames, size_t count, size_t& payload_size);
    void notify_callbacks(DriverEvent ev, const std::vector<uint8_t>& data, size_t count);
 
    std::string m_server_address;
@@ -66,10 +134,13 @@ private:
    std::thread m_thread;
    std::atomic<bool> m_thread_running;
    std::mutex m_mutex;
+   std::mutex m_send_mutex;            /**< Impaired frames are written from impairment thread */
    int m_sock_fd;
    int m_client;
    struct sockaddr_in m_serv_addr;
    SocketListener m_listener;
+   SocketMetrics m_metrics;
+   ChannelImpairment m_impairment;
 };
 
 #endif
@@ -0,0 +1,106 @@
+#ifndef _STEPREPORTLISTENER_H_
+#define _STEPREPORTLISTENER_H_
+
+/* ============================= */
+/**
+ * @file StepReportListener.h
+ *
+ * @brief GoogleTest listener collecting timing of test steps (see TestStep) of every test.
+ *
+ * @details
+ *    Steps finished between start and end of the test are assigned to that test. When test program ends:
+ *    - logs/<report_name>.steps.xml - JUnit XML, every test is a testsuite and every step is a testcase
+ *      with its duration, wait time and outcome. Steps which returned false are reported as failures
+ *      only if the test failed - negative checks are normal part of passing tests.
+ *    - logs/<report_name>.steps.txt - slowest steps of the whole run and time per step type,
+ *      summary is printed to console as well.
+ *    - logs/<report_name>.waits.txt - time spent in waits (see TestWait) per test suite and per call site,
+ *      with idle time, which could be removed by waiting for events instead of fixed time.
+ *    Listener is installed once per test program with StepReportListener::install().
+ *    When tests of one run are split to several processes (see TestRunnerMain.cpp), every process but the last
+ *    appends its records to spool file (STEP_REPORT_SPOOL_ENV), the last one reads them (STEP_REPORT_MERGE_ENV)
+ *    and writes reports of all tests.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <mutex>
+#include <chrono>
+#include "gtest/gtest.h"
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+#include "TestStep.h"
+#include "TestWait.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define STEP_REPORT_SLOWEST_COUNT 10      /**< Number of slowest steps in summary */
+#define STEP_REPORT_SPOOL_ENV "STEP_REPORT_SPOOL"    /**< Records appended to this file, no reports written */
+#define STEP_REPORT_MERGE_ENV "STEP_REPORT_MERGE"    /**< Records from this file added before own ones, file removed */
+/* =============================
+ *       Data structures
+ * =============================*/
+struct StepTestRecord
+{
+   std::string suite;
+   std::string name;
+   std::chrono::steady_clock::time_point start;
+   uint64_t duration_us;
+   bool failed;
+   bool skipped;
+   std::vector<StepEvent> steps;
+   std::vector<WaitEvent> waits;
+};
+
+class StepReportListener : public testing::EmptyTestEventListener
+{
+public:
+   StepReportListener(const std::string& report_name);
+   ~StepReportListener();
+   /**
+    * @brief Creates listener and appends it to GoogleTest listeners (which take the ownership).
+    *        Can be called before main(), e.g. to initialize a static variable of test file.
+    * @param[in] report_name - base name of report files, normally name of test executable
+    * @return True if installed.
+    */
+   static bool install(const std::string& report_name);
+   void OnTestProgramStart(const testing::UnitTest& unit_test) override;
+   void OnTestStart(const testing::TestInfo& test_info) override;
+   void OnTestEnd(const testing::TestInfo& test_info) override;
+   void OnTestProgramEnd(const testing::UnitTest& unit_test) override;
+   /**
+    * @brief Returns records of tests finished so far.
+    */
+   std::vector<StepTestRecord> getRecords();
+
+private:
+   void onStep(const StepEvent& event);
+   void onWait(const WaitEvent& event);
+   bool writeJUnit(const std::string& file_path);
+   bool writeSummary(FILE* file);
+   bool writeWaits(FILE* file, size_t max_sites);
+   bool writeSpool(const std::string& file_path);
+   bool readSpool(const std::string& file_path);
+
+   std::string m_report_name;
+   int m_hook_id;
+   int m_wait_hook_id;
+   std::mutex m_mtx;
+   bool m_test_running;
+   StepTestRecord m_current;
+   std::vector<StepTestRecord> m_records;
+   std::set<std::string> m_site_files;    /**< Storage of WaitSite::file of records read from spool */
+};
+
+#endif
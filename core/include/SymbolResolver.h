@@ -0,0 +1,75 @@
+#ifndef _SYMBOLRESOLVER_H_
+#define _SYMBOLRESOLVER_H_
+
+/* ============================= */
+/**
+ * @file SymbolResolver.h
+ *
+ * @brief Offline resolution of code addresses of the tested process to function names.
+ *
+ * @details
+ *    Executable mappings are taken from /proc/<pid>/maps (or lines in the same format recorded by the process).
+ *    Address is converted to file offset of mapped ELF file, then to virtual address of the file and looked up
+ *    in its .symtab (or .dynsym if the file is stripped). C++ names are demangled.
+ *    Symbol tables are loaded on first use and kept until clear() is called.
+ *    Addresses without symbol are returned as "module+0xoffset".
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <sys/types.h>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+/* =============================
+ *          Defines
+ * =============================*/
+/* =============================
+ *       Data structures
+ * =============================*/
+typedef struct
+{
+   uint64_t start;
+   uint64_t end;
+   uint64_t offset;                 /**< File offset of the mapping start */
+   std::string path;
+} SymbolMapping;
+
+class ElfSymbols;
+
+class SymbolResolver
+{
+public:
+   SymbolResolver();
+   ~SymbolResolver();
+   /**
+    * @brief Reads executable mappings of the process. Process has to exist.
+    */
+   bool loadMappings(pid_t pid);
+   /**
+    * @brief Adds mapping from single line in /proc/<pid>/maps format, non-executable mappings are ignored.
+    * @return True if mapping was added.
+    */
+   bool addMapping(const char* maps_line);
+   std::string resolve(uint64_t address);
+   /**
+    * @brief Removes mappings and loaded symbol tables (binaries may be rebuilt before next use).
+    */
+   void clear();
+
+private:
+   std::vector<SymbolMapping> m_mappings;
+   std::map<std::string, std::unique_ptr<ElfSymbols>> m_files;   /**< Symbols of mapped files, loaded on first use */
+};
+
+#endif
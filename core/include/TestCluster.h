@@ -0,0 +1,183 @@
+#ifndef _TESTCLUSTER_H_
+#define _TESTCLUSTER_H_
+
+/* ============================= */
+/**
+ * @file TestCluster.h
+ *
+ * @brief Many test subjects (SmartHome controllers) served by one test process.
+ *
+ * @details
+ *    TestCluster starts N subjects, each with own set of 3 channels (hw_stub, bluetooth, app_ntf) on ports
+ *    base_port + 3 * index (see setBasePort()). All channels of all subjects are served by single reactor
+ *    thread (epoll), which also executes scheduled stimuli - there is no thread per subject or channel
+ *    on the framework side. Per subject only the channel buffers, I2C states and the last
+ *    CLUSTER_NTF_HISTORY notifications are kept.
+ *    Subjects are FakeSubject instances (SmartHome binary uses fixed ports, so only one of them can run
+ *    on the host), each in forked child process (one thread per process) or in this process (one thread each).
+ *    Stimuli and checks take index of the subject or CLUSTER_ALL_SUBJECTS:
+ *       cluster.setInputState(CLUSTER_ALL_SUBJECTS, INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
+ *       cluster.triggerInterrupt(CLUSTER_ALL_SUBJECTS, 10);
+ *       EXPECT_TRUE(cluster.waitForI2CState(CLUSTER_ALL_SUBJECTS, SLM_I2C_ADDRESS, 0x0007, 1000));
+ *       EXPECT_EQ(cluster.countAppNtfSent(NTF_SLM_STATE, {...}), cluster.size());
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+#include "inputs_types.h"
+#include "env_types.h"
+#include "notification_types.h"
+#include "FakeSubject.h"
+#include "EventHistory.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define CLUSTER_BASE_PORT 20000              /**< Default port of hw_stub channel of the first subject */
+#define CLUSTER_MAX_SUBJECTS 1000
+#define CLUSTER_ALL_SUBJECTS ((size_t)-1)    /**< Index addressing all subjects */
+#define CLUSTER_NTF_HISTORY 16               /**< Notifications kept per subject */
+#define CLUSTER_CONNECT_TIMEOUT_MS 10000     /**< Time for all subjects to connect in start() */
+#define CLUSTER_MAX_EPOLL_EVENTS 64
+/* =============================
+ *       Data structures
+ * =============================*/
+typedef struct
+{
+   bool connected = false;                /**< All 3 channels connected */
+   uint64_t frames_in = 0;                /**< Frames received from subject */
+   uint64_t bytes_in = 0;
+   uint64_t frames_out = 0;               /**< Stimuli sent to subject */
+   uint64_t bytes_out = 0;
+   uint64_t write_failures = 0;
+   uint64_t i2c_ntfs = 0;                 /**< I2C_STATE_NTF frames */
+   uint64_t app_ntfs = 0;                 /**< Notifications on app_ntf channel */
+   uint64_t logs = 0;                     /**< Frames on bluetooth channel */
+} ClusterSubjectStats;
+
+typedef struct
+{
+   size_t subjects = 0;
+   size_t connected = 0;
+   ClusterSubjectStats total;             /**< Sum of all subjects (connected field not used) */
+} ClusterStats;
+
+struct ClusterSubject;
+
+class TestCluster
+{
+public:
+   TestCluster();
+   ~TestCluster();
+   TestCluster(const TestCluster&) = delete;
+   TestCluster& operator=(const TestCluster&) = delete;
+   /**
+    * @brief Adds behavior to every subject started by next start().
+    */
+   void addBehavior(const FakeBehavior& behavior);
+   void setBasePort(uint16_t port);
+   /**
+    * @brief Starts subjects and waits until all of them are connected.
+    * @param[in] count - number of subjects, up to CLUSTER_MAX_SUBJECTS
+    * @param[in] as_child - true if every subject shall run in own child process
+    * @return True if all subjects connected in CLUSTER_CONNECT_TIMEOUT_MS.
+    */
+   bool start(size_t count, bool as_child = true);
+   /**
+    * @brief Stops subjects (all child processes are signalled first and reaped afterwards) and the reactor.
+    */
+   void stop();
+   size_t size();
+   /**
+    * @brief Stimuli are queued and sent by reactor thread, after delay_ms (counted from the call).
+    * @param[in] subject - index of subject or CLUSTER_ALL_SUBJECTS
+    * @return True if queued.
+    */
+   bool setInputState(size_t subject, INPUT_ID id, INPUT_STATE state, uint32_t delay_ms = 0);
+   bool setSensorState(size_t subject, DHT_SENSOR_ID id, DHT_SENSOR_TYPE type, int8_t temp, int8_t hum, uint32_t delay_ms = 0);
+   bool triggerInterrupt(size_t subject, uint32_t delay_ms = 0);
+
+   uint16_t getI2CState(size_t subject, uint8_t address);
+   /**
+    * @brief Waits until current I2C state of the subject (of every subject for CLUSTER_ALL_SUBJECTS) is equal to state.
+    */
+   bool waitForI2CState(size_t subject, uint8_t address, uint16_t state, uint32_t timeout_ms);
+   /**
+    * @brief Waits until the subject (every subject for CLUSTER_ALL_SUBJECTS) sent the notification.
+    *        Only the last CLUSTER_NTF_HISTORY notifications of subject are checked, notifications longer than
+    *        HISTORY_PAYLOAD_SIZE are not kept whole and never match (error is logged).
+    */
+   bool waitForAppNtf(size_t subject, NTF_CMD_ID id, const std::vector<uint8_t>& msg, uint32_t timeout_ms);
+   size_t countI2CState(uint8_t address, uint16_t state);
+   size_t countAppNtfSent(NTF_CMD_ID id, const std::vector<uint8_t>& msg);
+   ClusterSubjectStats getSubjectStats(size_t subject);
+   ClusterStats getStats();
+
+private:
+   enum class StimulusType : uint8_t
+   {
+      INPUT,
+      SENSOR,
+      INTERRUPT,
+   };
+   struct Stimulus
+   {
+      std::chrono::steady_clock::time_point due;
+      uint64_t sequence;                  /**< Keeps order of stimuli with the same due time */
+      size_t subject;
+      StimulusType type;
+      uint8_t id;
+      uint8_t state;                      /**< INPUT_STATE or DHT_SENSOR_TYPE */
+      int8_t temp;
+      int8_t hum;
+      bool operator>(const Stimulus& other) const
+      {
+         return due != other.due? due > other.due : sequence > other.sequence;
+      }
+   };
+
+   bool openListeners(ClusterSubject& subject, size_t idx);
+   bool schedule(Stimulus stimulus, uint32_t delay_ms);
+   void threadExecute();
+   void onAccept(size_t idx, uint8_t channel);
+   bool onReadable(size_t idx, uint8_t channel);
+   void onWritable(size_t idx, uint8_t channel);
+   void onFrame(ClusterSubject& subject, uint8_t channel, const char* data, size_t size);
+   void executeStimulus(ClusterSubject& subject, const Stimulus& stimulus);
+   void sendFrame(ClusterSubject& subject, uint8_t channel, const char* data, size_t size);
+   void closeChannel(ClusterSubject& subject, uint8_t channel);
+   bool waitFor(size_t subject, uint32_t timeout_ms, const std::function<bool(ClusterSubject&)>& predicate);
+   int nextTimeout();
+
+   uint16_t m_base_port;
+   std::vector<FakeBehavior> m_behaviors;
+   std::vector<std::unique_ptr<ClusterSubject>> m_subjects;
+   int m_epoll_fd;
+   int m_wakeup_fd;
+   std::thread m_thread;
+   std::atomic<bool> m_thread_running;
+   std::mutex m_mtx;                      /**< Subject states and stimuli queue */
+   std::condition_variable m_cv;          /**< Notified when state of any subject changes */
+   std::priority_queue<Stimulus, std::vector<Stimulus>, std::greater<Stimulus>> m_stimuli;
+   uint64_t m_sequence;
+};
+
+#endif
@@ -22,6 +22,9 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 /* =============================
  *  Includes of project headers
  * =============================*/
@@ -32,28 +35,44 @@
 #include "notification_types.h"
 #include "SocketDriver.h"
 #include "TestSubjectExecutor.h"
+#include "TraceRecorder.h"
+#include "LatencyTracker.h"
+#include "Metrics.h"
+#include "HwStubEncoder.h"
+#include "LoadGenerator.h"
+#include "EventHistory.h"
+#include "TestStep.h"
+#include "TestWait.h"
+#include "DebugClient.h"
+#include "AppNotification.h"
+#include "LogMatcher.h"
 /* =============================
  *          Defines
  * =============================*/
-#define WAIT_MS(_ms) std::this_thread::sleep_for(std::chrono::milliseconds(_ms));
-#define WAIT_S(_s) std::this_thread::sleep_for(std::chrono::seconds(_s));
+#define WAIT_MS(_ms) TestWait::sleep(TEST_WAIT_SITE, std::chrono::milliseconds(_ms));
+#define WAIT_S(_s) TestWait::sleep(TEST_WAIT_SITE, std::chrono::seconds(_s));
+#define TC_TRANSACTION_MAX_FRAMES 32
+#define TC_MEMORY_GROWTH_TOLERANCE (256 * 1024)   /**< RSS growth treated as noise (allocator, page cache of binary) */
 /* =============================
  *       Data structures
  * =============================*/
+typedef struct
+{
+   uint64_t results [I2C_RESULT_COUNT] = {};   /**< Transactions by I2C_RESULT */
+   LatencyHistogram duration;                 /**< Duration of all transactions [us] */
+} I2CBusStats;
+
 typedef struct
 {
    uint8_t i2c_address;
    uint16_t state = 0xFFFF;
-   std::vector<uint16_t> buffer;
+   EventHistory buffer;                   /**< States received while buffering is enabled (value field) */
    bool buffering_enabled = false;
+   EventHistory history;                  /**< Every change of state reported by I2C_STATE_NTF, in arrival order */
+   size_t history_cursor = 0;             /**< First history element not consumed by expectI2CSequence() */
+   I2CBusStats bus;                       /**< Transactions reported by I2C_TRANSFER_NTF */
 } I2C_Board;
 
-typedef struct
-{
-   NTF_CMD_ID id;
-   std::vector<uint8_t> payload;
-} APP_NTF;
-
 typedef struct
 {
    DHT_SENSOR_ID id;
@@ -64,23 +83,91 @@ typedef struct
    uint8_t hum_l = 0;
 } DHT_Device;
 
-typedef enum
+typedef struct
+{
+   bool active = false;
+   std::vector<std::pair<uint8_t, uint16_t>> i2c_states;   /**< Boards changed in transaction with final state, sent once each
+                                                                 and applied to the board only after successful commit */
+   std::vector<DHT_Device> sensors;       /**< Sensor data set in transaction, last data per sensor */
+   bool trigger_interrupt = false;        /**< Interrupt requested in transaction, sent after all changes */
+   size_t changes = 0;
+} Transaction;
+
+typedef struct
+{
+   MetricValue decode_failures;     /**< Frames which could not be decoded to bytes */
+   MetricValue incomplete_frames;   /**< Frames with length not matching the header */
+} DecoderMetrics;
+
+enum class TestEventType : uint8_t
 {
-/* Below enumerations are cloned in test framework, any change here must lead to change in both places*/
-//TODO: move to common space
-   I2C_STATE_SET = 1,       /*< Sets current state of I2C board - in raw format, e.g. 0xFFFF */
-   I2C_STATE_NTF = 2,       /*< Event sent to test framework to notify that new data was written to I2C device */
-   DHT_STATE_SET = 3,       /*< Sets current state of DHT sensor */
-   I2C_INT_TRIGGER = 4,     /*< Event to simulate I2C interrupt */
-   HW_STUB_EV_ENUM_COUNT,
-} HW_STUB_EVENT_ID;
+   I2C_STATE,        /**< I2C_STATE_NTF received, id is I2C address, value is the state */
+   APP_NTF,          /**< Application notification received, id is NTF_CMD_ID, payload is whole notification */
+};
+
+struct TestEvent
+{
+   TestEventType type;
+   uint8_t id;
+   uint16_t value;
+   std::vector<uint8_t> payload;
+};
+
+typedef std::function<void(const TestEvent&)> TestEventHook;
+
 
 
 class TestCore
 {
 public:
    TestCore();
+   /**
+    * @brief Replaces SmartHome binary with FakeSubject. Has to be called before runTest().
+    * @param[in] subject - subject to run
+    * @param[in] as_child - true if subject shall be run in forked process
+    * @return None.
+    */
+   void useFakeSubject(FakeSubject* subject, bool as_child = false);
+   /**
+    * @brief Sets memory limit of every event history (I2C states, I2C buffers, app notifications).
+    *        Older events are moved to logs/<test_name>.<history>.spill files and remain available.
+    *        Has to be called before runTest().
+    * @param[in] memory_limit - limit in bytes
+    * @return None.
+    */
+   void setHistoryLimit(size_t memory_limit);
+   /**
+    * @brief Sets sampling period of subject CPU and memory usage (subject run as child process only).
+    *        Samples are written to logs/<test_name>.resources.csv. Has to be called before runTest().
+    * @param[in] period_ms - sampling period, 0 disables sampling
+    * @return None.
+    */
+   void setResourceSampling(uint32_t period_ms);
+   /**
+    * @brief Enables CPU profiling of the subject (run as child process) from runTest() to stopTest().
+    *        Folded stacks are written to logs/<test_name>.folded. Has to be called before runTest().
+    * @param[in] frequency_hz - samples per second of subject CPU time, 0 disables profiling
+    * @return None.
+    */
+   void enableProfiling(uint32_t frequency_hz = PROFILER_DEFAULT_FREQUENCY_HZ);
+   /**
+    * @brief Checks if subject is profiled - profiling may be enabled but not permitted (perf_event_paranoid).
+    * @return True if profiler is attached to the running subject.
+    */
+   bool isProfiling();
+   /**
+    * @brief Enables allocation tracking of the subject binary from runTest() to stopTest().
+    *        Hot spots and live bytes curve are written to logs/<test_name>.alloc.json. Has to be called before runTest().
+    * @param[in] enable - true to preload allocation tracker to the subject
+    * @return None.
+    */
+   void enableAllocTracking(bool enable = true);
    bool runTest(const std::string& test_name);
+   /**
+    * @brief Stops the subject, closes the channels and writes test reports. Does nothing if test is not running,
+    *        so it can be called both from the test body and from TearDown().
+    * @return None.
+    */
    void stopTest();
    bool checkRelayState(RELAY_ID id, RELAY_STATE state);
    bool checkInputState(INPUT_ID id, INPUT_STATE state);
@@ -89,13 +176,79 @@ public:
    bool setInputState(INPUT_ID id, INPUT_STATE state);
    bool setSensorState(DHT_SENSOR_ID id, DHT_SENSOR_TYPE type, int8_t temp, int8_t hum);
    bool triggerInterrupt();
+   /**
+    * @brief Starts transaction - relay, input and sensor changes are queued instead of being sent immediately.
+    * @return None.
+    */
+   void begin();
+   /**
+    * @brief Sends all changes queued since begin() in one write. Changes of the same I2C board are merged,
+    *        so tested application sees only the final state of every board.
+    * @param[in] trigger_interrupt - true if I2C_INT_TRIGGER shall be sent after the changes
+    * @return True if all frames were written.
+    */
+   bool commit(bool trigger_interrupt = false);
    RELAY_STATE getRelayState(RELAY_ID);
    INPUT_STATE getInputState(INPUT_ID);
+   uint16_t getI2CState(uint8_t address);
+   /**
+    * @brief Registers hook called for every I2C state and application notification received from the subject.
+    *        Hook is called from socket driver thread and shall return quickly, TestCore cannot be used inside.
+    * @param[in] hook - callback
+    * @return Id used to remove the hook.
+    */
+   int addEventHook(TestEventHook hook);
+   void removeEventHook(int id);
+   /**
+    * @brief Sets timing and error model of transactions with I2C device (see HwStubEncoder.h), applied by hw_stub
+    *        to the following transactions. Every modelled transaction is reported back and counted in getI2CBusStats().
+    * @param[in] address - I2C address of the device
+    * @param[in] model - latency, clock, stretching and error rates
+    * @return True if model was sent.
+    */
+   bool setI2CBusModel(uint8_t address, const I2CBusModel& model);
+   /**
+    * @brief Forces result of next transactions with I2C device, regardless of its model.
+    * @param[in] count - number of transactions
+    * @return True if request was sent.
+    */
+   bool setI2CTransactionResult(uint8_t address, I2C_RESULT result, uint8_t count = 1);
+   I2CBusStats getI2CBusStats(uint8_t address);
+   /**
+    * @brief Impairs frames of the channel in given direction - delay, jitter, bandwidth limit and drops
+    *        (see ChannelImpairment.h). Default profile disables impairment, all impairments end with stopTest().
+    * @param[in] channel - channel to impair
+    * @param[in] direction - INBOUND (from tested application) or OUTBOUND (to tested application)
+    * @param[in] profile - impairment, random values drawn from profile seed
+    * @return None.
+    */
+   void setChannelImpairment(TraceChannel channel, ImpairmentDirection direction, const ImpairmentProfile& profile);
+   /**
+    * @brief Stops reading the channel for given time, so tested application sees slow consumer (blocked writes).
+    * @return None.
+    */
+   void pauseChannelReceive(TraceChannel channel, uint32_t duration_ms);
 
    void startI2CBuffering(uint8_t address);
    void stopI2CBuffering(uint8_t address);
    void clearI2CBuffer(uint8_t address);
    bool waitForI2CNotification(uint8_t address, uint16_t state, uint32_t timeout_ms);
+   /**
+    * @brief Waits until given states appear one after another in the stream of I2C state transitions.
+    * @details
+    *    Matching starts at the first transition not consumed by previous call, consumed transitions are skipped on success.
+    *    Consecutive states have to be received in exact order, without any other transition in between and with
+    *    no more than step_timeout_ms between them. First state has to appear within total_timeout_ms.
+    *    Once the sequence is started, waiting ends step_timeout_ms after the last matched state if the next one
+    *    does not come. Empty sequence is rejected.
+    *    Measured step intervals (or the place where sequence diverged) are written to log.
+    * @param[in] address - I2C address of the board
+    * @param[in] states - expected states in order
+    * @param[in] step_timeout_ms - maximum time between two consecutive states
+    * @param[in] total_timeout_ms - maximum time for whole sequence
+    * @return True if sequence was received.
+    */
+   bool expectI2CSequence(uint8_t address, const std::vector<uint16_t>& states, uint32_t step_timeout_ms, uint32_t total_timeout_ms);
 
    bool checkI2CBufferSize(uint8_t address, size_t size);
    bool checkI2CBufferElement(uint8_t address, uint16_t idx, uint16_t exp);
@@ -105,38 +258,170 @@ public:
    void clearAppDataBuffer();
 
    bool wasAppNtfSent(NTF_CMD_ID id, const std::vector<uint8_t>& msg);
+   /**
+    * @brief Checks if notification with field values matching the predicate was sent.
+    *        Predicate gets typed view of notification (see AppNotification.h), notifications
+    *        not matching the schema of ID are skipped.
+    * @param[in] predicate - e.g. app_ntf::relay_is(RELAY_BATHROOM_FAN, RELAY_STATE_ON)
+    * @return True if such notification was sent.
+    */
+   template <NTF_CMD_ID ID, typename PREDICATE>
+   bool wasAppNtfSent(PREDICATE predicate)
+   {
+      return findAppNtf(ID, [&predicate](const uint8_t* data, size_t size)
+                        {
+                           auto ntf = app_ntf::decode<ID>(data, size);
+                           return ntf && predicate(*ntf);
+                        });
+   }
 
-private:
+   /**
+    * @brief Sends command to debug interface of tested application, does not wait for response.
+    *        Application has to answer with request id of the command (see DebugClient.h).
+    * @param[in] command - command text
+    * @param[in] timeout_ms - time for response
+    * @return Future completed with response, on timeout or at the end of test.
+    */
+   std::future<DebugResponse> sendDebugCommand(const std::string& command, uint32_t timeout_ms = DEBUG_DEFAULT_TIMEOUT_MS);
+   /**
+    * @brief Sends several debug commands in one write, all of them wait for responses in parallel.
+    * @return Futures in order of commands.
+    */
+   std::vector<std::future<DebugResponse>> sendDebugCommands(const std::vector<std::string>& commands, uint32_t timeout_ms = DEBUG_DEFAULT_TIMEOUT_MS);
+   /**
+    * @brief Sends debug command and waits for response.
+    * @return True if expected response received in time.
+    */
+   bool checkDebugResponse(const std::string& command, const std::string& response, uint32_t timeout_ms = DEBUG_DEFAULT_TIMEOUT_MS);
+
+   /**
+    * @brief Starts watching traces of tested application (bluetooth and hw_stub channels) for the text.
+    *        To be called before the stimulus, so trace sent right after it is not missed.
+    * @param[in] pattern - literal text
+    * @return Id for waitForLog(), 0 if pattern is empty.
+    */
+   LogPatternId watchLog(const std::string& pattern);
+   /**
+    * @brief Waits for trace watched with watchLog(), returns immediately if it was received already.
+    *        Pattern is not watched anymore after this call.
+    * @return True if trace received in time.
+    */
+   bool waitForLog(LogPatternId id, uint32_t timeout_ms);
+   /**
+    * @brief Waits for trace containing the text, only traces received after this call are checked.
+    */
+   bool waitForLog(const std::string& pattern, uint32_t timeout_ms);
+   /**
+    * @brief Checks that trace containing the text is not received in given time.
+    * @return True if trace not received.
+    */
+   bool expectNoLog(const std::string& pattern, uint32_t window_ms);
+
+   /**
+    * @brief Declares stimulus/response pair, which latency shall be measured. Percentiles are written to
+    *        logs/<test_name>.latency.json when stopTest() is called.
+    * @param[in] name - name used in report
+    * @param[in] stimulus - stimulus sent by the framework
+    * @param[in] response - expected response type
+    * @param[in] response_id - I2C address for I2C_STATE, NTF_CMD_ID for APP_NTF
+    * @return None.
+    */
+   void addLatencyPair(const std::string& name, StimulusType stimulus, ResponseType response, uint8_t response_id);
+   LatencyHistogram getLatencyHistogram(const std::string& name);
+   /**
+    * @brief Starts local server (127.0.0.1) answering with current metrics of all channels.
+    *        Metrics are also written to logs/<test_name>.metrics.prom and .metrics.json when stopTest() is called.
+    * @param[in] port - TCP port, 0 - any free port, read back with getMetricsServerPort()
+    * @return True if server started.
+    */
+   bool startMetricsServer(uint16_t port);
+   uint16_t getMetricsServerPort();
+   /**
+    * @brief Starts load generator thread, which toggles inputs (and triggers interrupt) according to profile.
+    *        State of inputs shall not be changed by the test while load is running.
+    * @param[in] profile - load description
+    * @return True if started.
+    */
+   bool startLoad(const LoadProfile& profile);
+   /**
+    * @brief Stops load generator and writes report to logs/<test_name>.load.json.
+    * @param[in] drain_ms - time to wait for responses after the last event
+    * @return Load report.
+    */
+   LoadReport stopLoad(uint32_t drain_ms = 500);
+   std::string getMetrics(MetricsFormat format);
+   /**
+    * @brief Checks that subject resident memory (including peaks between samples) never exceeded the limit.
+    * @param[in] bytes - RSS limit
+    * @return True if RSS was below the limit.
+    */
+   bool expectMaxRss(uint64_t bytes);
+   /**
+    * @brief Checks average CPU usage of the subject in the last window. Waits until window is sampled.
+    * @param[in] percent - limit, 100% is one fully used core
+    * @param[in] window_ms - time window counted back from now
+    * @return True if CPU usage was below the limit.
+    */
+   bool expectCpuBelow(double percent, uint32_t window_ms);
+   /**
+    * @brief Checks that subject RSS does not grow in the last window (least squares trend of samples).
+    *        Waits until window is sampled.
+    * @param[in] window_ms - time window counted back from now
+    * @param[in] tolerance_bytes - allowed growth in the window
+    * @return True if RSS growth was within tolerance.
+    */
+   bool expectNoMemoryGrowth(uint32_t window_ms, uint64_t tolerance_bytes = TC_MEMORY_GROWTH_TOLERANCE);
 
+private:
    void onStubEvent(DriverEvent ev, const std::vector<uint8_t>& data, size_t count);
    void onBluetoothEvent(DriverEvent ev, const std::vector<uint8_t>& data, size_t count);
    void onAppEvent(DriverEvent ev, const std::vector<uint8_t>& data, size_t count);
    bool decodeBytesFromString(const std::vector<uint8_t>& data, size_t size);
-   bool sendToHwStub(const std::vector<uint8_t>& data);
-
-
-   uint8_t rel_id_to_relay_no(RELAY_ID id);
-   uint16_t rel_relay_to_mask(uint8_t relay_no);
-   uint16_t rel_id_to_mask(RELAY_ID id);
-   RELAY_ID m_rel_id_match [RELAYS_RELAY_COUNT + 1] = RELAYS_MATCH;
+   bool findAppNtf(NTF_CMD_ID id, const std::function<bool(const uint8_t*, size_t)>& match);
+   template <size_t N>
+   bool sendToHwStub(const std::array<uint8_t, N>& frame);
+   template <typename BATCH>
+   bool sendToHwStub(const BATCH& batch);
+   bool sendToHwStub(const SocketFrame* frames, size_t count);
+   uint16_t& queueI2CState(uint8_t address);
+   void registerStimulus(HW_STUB_EVENT_ID event, uint8_t address);
+   void notifyEvent(const TestEvent& event);
+   void logI2CSequenceResult(I2C_Board& board, const std::vector<uint16_t>& states, size_t pos, size_t matched, bool result);
+   SocketDriver& getDriver(TraceChannel channel);
+   void registerMetrics();
+   void exportMetrics();
+   ResourceSummary waitForResourceWindow(uint32_t window_ms);
 
-   uint16_t inp_input_to_mask(uint8_t input);
-   uint8_t inp_id_to_input_no(INPUT_ID id);
-   uint16_t inp_id_to_mask(INPUT_ID id);
-   INPUT_ID m_inp_id_match [INPUTS_INPUT_COUNT + 1] = INPUTS_MATCH;
 
-   std::vector<APP_NTF> m_app_ntfs;
+   EventHistory m_app_ntfs;
+   size_t m_history_limit;
+   uint32_t m_sampling_period_ms;
+   uint32_t m_profiling_frequency_hz;
+   bool m_alloc_tracking;
    std::map<uint8_t, I2C_Board> m_i2c_map;
 
    SocketDriver m_hwstub_driver;
    SocketDriver m_bluetooth_driver;
    SocketDriver m_app_ntf_driver;
+   DebugClient m_debug;
+   LogMatcher m_log_matcher;
    TestSubjectExecutor m_bin_exec;
+   TraceRecorder m_recorder;
+   LatencyTracker m_latency;
+   MetricsRegistry m_metrics;
+   DecoderMetrics m_stub_decoder_metrics;
+   DecoderMetrics m_app_decoder_metrics;
+   MetricValue m_app_ntf_count;
+   Transaction m_transaction;
+   LoadGenerator m_load;
+   std::string m_test_name;
+   bool m_test_running;
    pid_t m_test_bin_pid;
    std::vector<uint8_t> m_buffer;
    std::mutex m_buf_mtx;
-   std::vector<uint8_t> m_send_buf;
-   std::mutex m_send_buf_mtx;
+   std::vector<std::pair<int, TestEventHook>> m_event_hooks;   /**< Protected by m_buf_mtx */
+   int m_next_event_hook_id;
+   std::condition_variable m_i2c_cv;
 };
 
 
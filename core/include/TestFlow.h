@@ -0,0 +1,173 @@
+#ifndef _TESTFLOW_H_
+#define _TESTFLOW_H_
+
+/* ============================= */
+/**
+ * @file TestFlow.h
+ *
+ * @brief Coroutine based test flows - several scenario flows running concurrently on one thread.
+ *
+ * @details
+ *    Flow is a C++20 coroutine returning Flow, which waits for framework events with co_await:
+ *       co_await tc.i2cState(address, state)   - I2C board reached the state (true) or timeout (false)
+ *       co_await tc.appNtf(id, notification)   - application notification received (true) or timeout (false)
+ *       co_await tc.after(ms)                  - time passed
+ *    Flows are added with TestFlows::spawn() and executed by TestFlows::run() in the calling thread.
+ *    Suspended flows do not occupy any thread, run() sleeps until the next event or timer.
+ *    Events received from the subject are delivered to flows in run() thread. Event which arrives while
+ *    a flow is running (e.g. response to the stimulus it just sent) is delivered after the flow suspends,
+ *    so stimulus followed directly by co_await does not miss the response.
+ *    Event is delivered to every flow waiting for it at that moment. Events are delivered one by one - flows
+ *    completed by an event are resumed before the next one, so events received back to back are not missed.
+ *    i2cState() completes immediately if the board is in that state after the last delivered event.
+ *    Stimuli are sent with the usual TestCore calls (tc.core()), checks use EXPECT_* macros
+ *    (ASSERT_* cannot be used in coroutines). Expected notification shall be a named vector,
+ *    GCC 12 cannot compile braced initializer list inside co_await expression.
+ *    This module requires C++20, which is enabled only for TestFlow library and its users.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <coroutine>
+#include <chrono>
+#include <vector>
+#include <list>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <functional>
+#include <utility>
+#include <condition_variable>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+#include "TestCore.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define FLOW_DEFAULT_TIMEOUT_MS 5000      /**< Timeout of i2cState() and appNtf() */
+/* =============================
+ *       Data structures
+ * =============================*/
+class Flow
+{
+public:
+   struct promise_type
+   {
+      Flow get_return_object()
+      {
+         return Flow(std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+      /* flow is started by TestFlows::run() */
+      std::suspend_always initial_suspend() noexcept { return {}; }
+      /* frame is destroyed by Flow, scheduler checks done() */
+      std::suspend_always final_suspend() noexcept { return {}; }
+      void return_void() {}
+      void unhandled_exception() { std::terminate(); }
+   };
+
+   Flow(Flow&& other);
+   Flow& operator=(Flow&& other);
+   Flow(const Flow&) = delete;
+   Flow& operator=(const Flow&) = delete;
+   ~Flow();
+   std::coroutine_handle<promise_type> handle();
+private:
+   explicit Flow(std::coroutine_handle<promise_type> handle);
+   std::coroutine_handle<promise_type> m_handle;
+};
+
+class TestFlows;
+
+enum class FlowWaitType : uint8_t
+{
+   TIMER,
+   I2C_STATE,
+   APP_NTF,
+};
+
+/**
+ * @brief Awaitable returned by TestFlows::i2cState(), appNtf() and after(). Lives in the frame of waiting flow.
+ */
+class FlowWait
+{
+public:
+   FlowWait(TestFlows& flows, FlowWaitType type, uint8_t id, uint16_t value, const std::vector<uint8_t>& payload, uint32_t timeout_ms);
+   bool await_ready();
+   void await_suspend(std::coroutine_handle<> handle);
+   bool await_resume();
+   bool matches(const TestEvent& event);
+   void complete(bool result);
+
+   FlowWaitType type;
+   std::chrono::steady_clock::time_point deadline;
+   std::coroutine_handle<> handle;
+private:
+   TestFlows& m_flows;
+   uint8_t m_id;
+   uint16_t m_value;
+   std::vector<uint8_t> m_payload;
+   bool m_result;
+};
+
+class TestFlows
+{
+public:
+   TestFlows(TestCore& core);
+   ~TestFlows();
+   TestFlows(const TestFlows&) = delete;
+   TestFlows& operator=(const TestFlows&) = delete;
+   /**
+    * @brief Adds flow started by next run(). Function (with its captures) is kept until run() returns.
+    * @param[in] body - coroutine function, receives this object as argument
+    * @return None.
+    */
+   void spawn(std::function<Flow(TestFlows&)> body);
+   /**
+    * @brief Runs all spawned flows in calling thread until they finish.
+    * @param[in] timeout_ms - maximum time, flows not finished until then are destroyed
+    * @return True if all flows finished.
+    */
+   bool run(uint32_t timeout_ms);
+   /**
+    * @brief Waits until I2C board reaches given state (completes immediately if it is the current state).
+    */
+   FlowWait i2cState(uint8_t address, uint16_t state, uint32_t timeout_ms = FLOW_DEFAULT_TIMEOUT_MS);
+   /**
+    * @brief Waits for application notification.
+    * @param[in] id - notification id
+    * @param[in] notification - whole notification as in TestCore::wasAppNtfSent(), empty matches any with given id
+    */
+   FlowWait appNtf(NTF_CMD_ID id, const std::vector<uint8_t>& notification = {}, uint32_t timeout_ms = FLOW_DEFAULT_TIMEOUT_MS);
+   FlowWait after(uint32_t ms);
+   TestCore& core();
+
+private:
+   friend class FlowWait;
+   void addWait(FlowWait* wait);
+   bool deliveredI2CState(uint8_t address, uint16_t& state);
+   void complete(std::vector<FlowWait*>::iterator& it, bool result);
+   void dispatch(const TestEvent& event);
+   void expire();
+   void resumeReady();
+
+   TestCore& m_core;
+   int m_hook_id;
+   std::mutex m_mtx;
+   std::condition_variable m_cv;
+   std::vector<TestEvent> m_events;                     /**< Received from subject, not taken by run() yet (m_mtx) */
+   std::deque<TestEvent> m_pending;                     /**< Taken by run(), not delivered yet */
+   std::map<uint8_t, uint16_t> m_i2c_states;            /**< The last delivered state of I2C boards */
+   std::list<std::function<Flow(TestFlows&)>> m_bodies;
+   std::vector<Flow> m_flows;
+   std::vector<FlowWait*> m_waits;                      /**< Suspended flows */
+   std::deque<std::coroutine_handle<>> m_ready;         /**< Flows to resume */
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef _TESTHISTORY_H_
+#define _TESTHISTORY_H_
+
+/* ============================= */
+/**
+ * @file TestHistory.h
+ *
+ * @brief History of test durations and results, used to order the tests.
+ *
+ * @details
+ *    History is kept in text file (one line per test: duration, results of the last runs, name), updated
+ *    after every finished test. Tests are scheduled so a broken build is reported as soon as possible:
+ *    - tests failed in the last run,
+ *    - tests failed in any of the last TEST_HISTORY_RUNS runs, most failures first,
+ *    - tests without history (new ones),
+ *    - remaining tests, longest first.
+ *    Tests with the same priority keep the order of registration.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include "gtest/gtest.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define TEST_HISTORY_RUNS 8               /**< Number of results kept per test */
+#define TEST_HISTORY_FILE "history.txt"   /**< In result cache directory */
+/* =============================
+ *       Data structures
+ * =============================*/
+struct TestHistoryEntry
+{
+   uint64_t duration_us = 0;              /**< Moving average of passed and failed runs */
+   uint8_t failures = 0;                  /**< Bit 0 - last run, bit 1 - run before, ... (1 - failed) */
+   uint8_t runs = 0;                      /**< Number of runs in failures, up to TEST_HISTORY_RUNS */
+};
+
+class TestHistory
+{
+public:
+   /**
+    * @brief Reads history file, missing file is empty history.
+    */
+   bool load(const std::string& file_path);
+   /**
+    * @brief Adds result of the test and writes history file.
+    */
+   void record(const std::string& test_name, bool failed, uint64_t duration_us);
+   bool get(const std::string& test_name, TestHistoryEntry& entry);
+   /**
+    * @brief Returns the tests in order of execution (see file description).
+    * @param[in] tests - names in order of registration
+    */
+   std::vector<std::string> schedule(const std::vector<std::string>& tests);
+
+   /** Records results of finished tests */
+   class Listener : public testing::EmptyTestEventListener
+   {
+   public:
+      Listener(TestHistory& history): m_history(history) {}
+      void OnTestEnd(const testing::TestInfo& test_info) override;
+   private:
+      TestHistory& m_history;
+   };
+
+private:
+   bool save();
+
+   std::mutex m_mtx;
+   std::string m_path;
+   std::map<std::string, TestHistoryEntry> m_entries;
+};
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef _TESTSTEP_H_
+#define _TESTSTEP_H_
+
+/* ============================= */
+/**
+ * @file TestStep.h
+ *
+ * @brief Timing of test steps - public TestCore calls like setRelayState() or waitForI2CNotification().
+ *
+ * @details
+ *    Step is measured by TestStep object living for the duration of the call. When step is finished,
+ *    TEST_STEP marker is written to log (as before) and StepEvent with duration, time spent waiting
+ *    and outcome is passed to all registered hooks (e.g. StepReportListener).
+ *    Waits done on behalf of the step (sleeps, condition variables) are added with TestStep::recordWait(),
+ *    which accounts them to the step currently running in calling thread.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <string>
+#include <chrono>
+#include <functional>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+/* =============================
+ *          Defines
+ * =============================*/
+#define TEST_STEP_DETAIL_SIZE 256
+/* =============================
+ *       Data structures
+ * =============================*/
+enum class StepOutcome : uint8_t
+{
+   DONE,          /**< Step without result (e.g. clearI2CBuffer) */
+   PASSED,
+   FAILED,
+};
+
+struct StepEvent
+{
+   std::string name;                                  /**< Name of TestCore method */
+   std::string detail;                                /**< Text of TEST_STEP marker */
+   std::chrono::steady_clock::time_point start;
+   uint64_t duration_us;
+   uint64_t wait_us;                                  /**< Part of duration spent waiting for the subject */
+   StepOutcome outcome;
+};
+
+typedef std::function<void(const StepEvent&)> StepHook;
+
+class TestStep
+{
+public:
+   /**
+    * @brief Starts the step, it becomes current step of calling thread.
+    * @param[in] name - step name, normally __func__
+    */
+   TestStep(const char* name);
+   /**
+    * @brief Finishes step as DONE if not finished explicitly.
+    */
+   ~TestStep();
+   /**
+    * @brief Finishes the step without result, writes TEST_STEP marker.
+    * @param[in] fmt - printf-like marker text
+    * @return None.
+    */
+   void done(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+   /**
+    * @brief Finishes the step with result, writes TEST_STEP marker.
+    * @param[in] result - false if step failed
+    * @param[in] fmt - printf-like marker text
+    * @return None.
+    */
+   void finish(bool result, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+   /**
+    * @brief Finishes the step with result, without TEST_STEP marker.
+    * @param[in] result - false if step failed
+    * @return None.
+    */
+   void finish(bool result);
+   /**
+    * @brief Adds waiting time to the step currently running in calling thread (ignored if there is no step).
+    * @param[in] wait - time spent waiting
+    * @return None.
+    */
+   static void recordWait(std::chrono::steady_clock::duration wait);
+   /**
+    * @brief Registers hook called when any step is finished (in the thread running the step).
+    * @param[in] hook - callback
+    * @return Id used to remove the hook.
+    */
+   static int addHook(StepHook hook);
+   static void removeHook(int id);
+
+private:
+   void complete(StepOutcome outcome, const char* detail);
+
+   StepEvent m_event;
+   bool m_finished;
+   TestStep* m_parent;                                 /**< Step which was current before this one */
+};
+
+#endif
@@ -14,7 +14,17 @@
  *    To stop execution, call stop_test_subject(_pid_).
  *
  * @details
+ *    Instead of the binary, FakeSubject can be used (see use_fake_subject()) - it is started in this process
+ *    or in forked child process.
  *
+ * @details
+ *    Binary is started with posix_spawn(), so nothing is executed between fork and exec in the child of
+ *    multithreaded test process. Child is stopped with SIGINT, escalated to SIGTERM and SIGKILL when it does not
+ *    exit in time. Child is always reaped (waiting on pidfd when available), its exit status, shutdown time and
+ *    resource usage are available with get_exit_info().
+ *    While child is running, its CPU and memory usage is sampled (see set_resource_sampling()) and optionally
+ *    it is profiled (see set_profiling()). Allocations of the binary can be tracked by preloaded library
+ *    (see set_alloc_tracking()).
  *
  * @author Jacek Skowronek
  * @date 05/03/2021
@@ -25,24 +35,126 @@
  *  Includes of common headers
  * =============================*/
 #include <string>
+#include <vector>
+#include <sys/types.h>
 /* =============================
  *  Includes of project headers
  * =============================*/
+#include "FakeSubject.h"
+#include "ResourceSampler.h"
+#include "CpuProfiler.h"
+#include "AllocReport.h"
 /* =============================
  *          Defines
  * =============================*/
+#define SUBJECT_SIGINT_TIMEOUT_MS 3000    /**< Time for graceful shutdown after SIGINT */
+#define SUBJECT_SIGTERM_TIMEOUT_MS 1000   /**< Time for shutdown after SIGTERM, SIGKILL is sent later */
+#define SUBJECT_ALLOC_REPORT_TIMEOUT_MS 500 /**< Time for allocation report requested before stop */
+#define SUBJECT_POLL_PERIOD_MS 5          /**< Polling of exit (without pidfd) and of allocation report */
 /* =============================
  *       Data structures
  * =============================*/
+enum class SubjectMode
+{
+   BINARY,              /**< Binary given in constructor executed in child process */
+   FAKE_IN_PROCESS,     /**< FakeSubject started in this process */
+   FAKE_CHILD,          /**< FakeSubject started in forked child process */
+};
+
+typedef struct
+{
+   bool reaped = false;                   /**< Child process was waited for, fields below are valid */
+   bool exited = false;                   /**< Child called exit(), exit_code is valid */
+   int exit_code = 0;
+   int term_signal = 0;                   /**< Signal which terminated the child, 0 if exited */
+   int stop_signal = 0;                   /**< Last signal sent to stop the child, 0 if it exited before */
+   uint32_t shutdown_ms = 0;              /**< Time from the first stop signal to exit */
+   uint64_t user_cpu_us = 0;
+   uint64_t system_cpu_us = 0;
+   uint64_t max_rss_kb = 0;
+   uint64_t minor_faults = 0;
+   uint64_t major_faults = 0;
+   uint64_t voluntary_switches = 0;       /**< Context switches while waiting for resource */
+   uint64_t involuntary_switches = 0;     /**< Context switches forced by scheduler */
+} SubjectExitInfo;
 
 class TestSubjectExecutor
 {
 public:
    TestSubjectExecutor(const std::string& process_path);
+   /**
+    * @brief Replaces tested binary with FakeSubject. Has to be called before start_test_subject().
+    * @param[in] subject - subject to run, has to be valid until stop_test_subject() is called
+    * @param[in] as_child - true if subject shall be run in forked process
+    * @return None.
+    */
+   void use_fake_subject(FakeSubject* subject, bool as_child);
+   bool is_fake_subject();
    pid_t start_test_subject();
-   void stop_test_subject(pid_t pid);
+   /**
+    * @brief Stops the subject and reaps child process (SIGINT, then SIGTERM and SIGKILL after timeouts).
+    * @param[in] pid - PID returned by start_test_subject()
+    * @return True if child exited after SIGINT (or before it) with code 0.
+    */
+   bool stop_test_subject(pid_t pid);
+   /**
+    * @brief Returns exit status and resource usage of the last stopped child.
+    */
+   const SubjectExitInfo& get_exit_info();
+   /**
+    * @brief Returns allocation summary of the last stopped subject (see set_alloc_tracking()).
+    * @return Summary, not complete if report was not written.
+    */
+   const AllocSummary& get_alloc_summary();
+   bool export_json(const std::string& file_path, const std::string& test_name);
+   /**
+    * @brief Configures sampling of child resources, used from next start_test_subject().
+    *        Subject running in this process is not sampled.
+    * @param[in] period_ms - sampling period, 0 disables sampling
+    * @param[in] timeline_path - CSV file for samples, empty if not needed
+    * @return None.
+    */
+   void set_resource_sampling(uint32_t period_ms, const std::string& timeline_path);
+   ResourceSampler& get_resource_sampler();
+   /**
+    * @brief Enables CPU profiling of the child from next start_test_subject() until stop_test_subject().
+    *        Subject running in this process is not profiled.
+    * @param[in] frequency_hz - sampling frequency, 0 disables profiling
+    * @param[in] folded_path - file for folded stacks
+    * @return None.
+    */
+   void set_profiling(uint32_t frequency_hz, const std::string& folded_path);
+   CpuProfiler& get_profiler();
+   /**
+    * @brief Enables allocation tracking of the binary from next start_test_subject() - allocation tracker library
+    *        is preloaded, its report is requested before the subject is stopped (and written again at exit).
+    *        Fake subject is not tracked.
+    * @param[in] raw_path - raw report written by the library, empty disables tracking
+    * @param[in] report_path - JSON report with resolved hot spots and live bytes curve
+    * @param[in] test_name - name of the test written to the report
+    * @return None.
+    */
+   void set_alloc_tracking(const std::string& raw_path, const std::string& report_path, const std::string& test_name);
 private:
+   std::vector<std::string> build_environment();
+   void request_alloc_report(pid_t pid);
+   void export_alloc_report();
+   bool wait_for_exit(pid_t pid, int pidfd, uint32_t timeout_ms);
+
    std::string m_test_subject_path;
+   SubjectMode m_mode;
+   FakeSubject* m_fake_subject;
+   SubjectExitInfo m_exit_info;
+   ResourceSampler m_sampler;
+   uint32_t m_sampling_period_ms;
+   std::string m_timeline_path;
+   CpuProfiler m_profiler;
+   uint32_t m_profiling_frequency_hz;
+   std::string m_folded_path;
+   std::string m_alloc_raw_path;
+   std::string m_alloc_report_path;
+   std::string m_alloc_test_name;
+   AllocReport m_alloc_report;
 };
 
 
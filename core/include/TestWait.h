@@ -0,0 +1,86 @@
+#ifndef _TESTWAIT_H_
+#define _TESTWAIT_H_
+
+/* ============================= */
+/**
+ * @file TestWait.h
+ *
+ * @brief Instrumented waits - WAIT_MS/WAIT_S and polling waits of the framework.
+ *
+ * @details
+ *    Every wait is reported as WaitEvent with call site, requested and real duration, to the current
+ *    TestStep (see TestStep::recordWait()) and to registered hooks (e.g. StepReportListener).
+ *    Waits are checked against activity of the subject (frames received by TestCore, see markActivity()):
+ *    - fixed sleep - time after the last frame received during the sleep (or whole sleep if nothing was
+ *      received) is reported as idle, the test would most likely pass with shorter or event-driven wait,
+ *    - conditional wait (until()) - reports if condition was true already at first check, idle is the time
+ *      between the frame which made condition true and the check which noticed it (polling delay).
+ *    Condition variable waits (expectI2CSequence(), waitForLog(), ...) are event-driven and are not routed here.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <chrono>
+#include <functional>
+/* =============================
+ *          Defines
+ * =============================*/
+#define TEST_WAIT_POLL_MS 10              /**< Default period of condition checks */
+#define TEST_WAIT_SITE WaitSite{__FILE__, __LINE__}
+/* =============================
+ *       Data structures
+ * =============================*/
+struct WaitSite
+{
+   const char* file;
+   int line;
+};
+
+struct WaitEvent
+{
+   WaitSite site;
+   bool conditional;                   /**< until() - otherwise fixed sleep */
+   bool satisfied;                     /**< condition became true (sleep: subject was active during the sleep) */
+   bool already_satisfied;             /**< condition true at first check, there was nothing to wait for */
+   uint64_t requested_us;              /**< sleep time or timeout */
+   uint64_t waited_us;
+   uint64_t idle_us;                   /**< part of waited_us not needed for the subject */
+};
+
+typedef std::function<void(const WaitEvent&)> WaitHook;
+
+class TestWait
+{
+public:
+   /**
+    * @brief Sleeps for given time.
+    * @param[in] site - call site, TEST_WAIT_SITE
+    * @param[in] time - time to sleep
+    * @return None.
+    */
+   static void sleep(const WaitSite& site, std::chrono::steady_clock::duration time);
+   /**
+    * @brief Waits until condition is true, checking it periodically.
+    * @param[in] site - call site, TEST_WAIT_SITE
+    * @param[in] timeout - maximum waiting time
+    * @param[in] condition - checked immediately and then every poll period
+    * @param[in] poll - time between checks
+    * @return True if condition became true before timeout.
+    */
+   static bool until(const WaitSite& site, std::chrono::steady_clock::duration timeout, const std::function<bool()>& condition,
+                     std::chrono::steady_clock::duration poll = std::chrono::milliseconds(TEST_WAIT_POLL_MS));
+   /**
+    * @brief Marks that subject was active (frame received), called by receiving threads.
+    */
+   static void markActivity();
+   static int addHook(WaitHook hook);
+   static void removeHook(int id);
+};
+
+#endif
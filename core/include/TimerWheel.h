@@ -0,0 +1,180 @@
+#ifndef _TIMERWHEEL_H_
+#define _TIMERWHEEL_H_
+
+/* ============================= */
+/**
+ * @file TimerWheel.h
+ *
+ * @brief Hashed timer wheel - items released at given time points with fixed tick resolution.
+ *
+ * @details
+ *    Expiry time is rounded up to the tick, so item is never released early and at most one tick late.
+ *    Item is kept in bucket (expiry tick % number of buckets), scheduling is O(1) regardless of the number of
+ *    pending items. Buckets keep items until the end of the next revolution, so item is passed over at most once
+ *    before its tick. Items expiring later wait in overflow ordered by tick and are moved to their bucket when
+ *    the next revolution reaches them. Tick of the next expiry is cached - advancing does not visit buckets
+ *    of ticks without items and nextExpiry() is O(1).
+ *    Items are released in order of expiry tick, items of the same tick in order of scheduling.
+ *    Wheel is not thread safe - owner has to serialize the calls.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <utility>
+/* =============================
+ *       Data structures
+ * =============================*/
+template <typename T>
+class TimerWheel
+{
+public:
+   typedef std::chrono::steady_clock Clock;
+
+   TimerWheel(Clock::duration tick, size_t buckets):
+   m_tick(tick),
+   m_buckets(buckets),
+   m_origin(Clock::now()),
+   m_current(0),
+   m_next(NO_TICK),
+   m_size(0)
+   {
+   }
+   void schedule(Clock::time_point when, T item)
+   {
+      uint64_t tick = when > m_origin? (when - m_origin + m_tick - Clock::duration(1)) / m_tick : 0;
+      tick = tick < m_current? m_current : tick;
+      if (tick < horizon())
+      {
+         m_buckets[tick % m_buckets.size()].push_back({tick, std::move(item)});
+      }
+      else
+      {
+         /* multimap keeps items of the same tick in order of insertion */
+         m_overflow.emplace(tick, std::move(item));
+      }
+      m_next = tick < m_next? tick : m_next;
+      m_size++;
+   }
+   /**
+    * @brief Releases items which expired until now.
+    * @param[in] now - current time
+    * @param[in] expire - called with every released item (T&)
+    */
+   template <typename F>
+   void advance(Clock::time_point now, F expire)
+   {
+      uint64_t target = now > m_origin? (now - m_origin) / m_tick : 0;
+      /* buckets of ticks without items are not visited */
+      while (m_next <= target)
+      {
+         m_current = m_next;
+         cascade();
+         std::vector<Entry>& bucket = m_buckets[m_current % m_buckets.size()];
+         size_t kept = 0;
+         for (size_t i = 0; i < bucket.size(); i++)
+         {
+            if (bucket[i].tick == m_current)
+            {
+               expire(bucket[i].item);
+               m_size--;
+            }
+            else
+            {
+               if (kept != i)
+               {
+                  bucket[kept] = std::move(bucket[i]);
+               }
+               kept++;
+            }
+         }
+         bucket.resize(kept);
+         m_next = findNext(m_current + 1);
+      }
+      m_current = target > m_current? target : m_current;
+      cascade();
+   }
+   /**
+    * @brief Returns time when the next item expires, Clock::time_point::max() if empty.
+    */
+   Clock::time_point nextExpiry() const
+   {
+      return m_next == NO_TICK? Clock::time_point::max() : m_origin + m_tick * (Clock::rep)m_next;
+   }
+   size_t size() const { return m_size; }
+   bool empty() const { return m_size == 0; }
+   void clear()
+   {
+      for (std::vector<Entry>& bucket : m_buckets)
+      {
+         bucket.clear();
+      }
+      m_overflow.clear();
+      m_next = NO_TICK;
+      m_size = 0;
+   }
+
+private:
+   static constexpr uint64_t NO_TICK = UINT64_MAX;
+
+   struct Entry
+   {
+      uint64_t tick;
+      T item;
+   };
+
+   /* buckets keep ticks until the end of the next revolution - bucket has items of at most two ticks */
+   uint64_t horizon() const
+   {
+      return (m_current / m_buckets.size() + 2) * m_buckets.size();
+   }
+   /* moves overflow items below horizon to their buckets, before any new item of the same tick is scheduled there */
+   void cascade()
+   {
+      uint64_t limit = horizon();
+      while (!m_overflow.empty() && m_overflow.begin()->first < limit)
+      {
+         auto it = m_overflow.begin();
+         m_buckets[it->first % m_buckets.size()].push_back({it->first, std::move(it->second)});
+         m_overflow.erase(it);
+      }
+   }
+   /* the earliest tick with items from given tick */
+   uint64_t findNext(uint64_t from) const
+   {
+      if (m_size == 0)
+      {
+         return NO_TICK;
+      }
+      for (uint64_t tick = from; tick < horizon(); tick++)
+      {
+         for (const Entry& entry : m_buckets[tick % m_buckets.size()])
+         {
+            if (entry.tick == tick)
+            {
+               return tick;
+            }
+         }
+      }
+      return m_overflow.empty()? NO_TICK : m_overflow.begin()->first;
+   }
+
+   Clock::duration m_tick;
+   std::vector<std::vector<Entry>> m_buckets;   /**< Items expiring before horizon() */
+   std::multimap<uint64_t, T> m_overflow;       /**< Items expiring later, by tick */
+   Clock::time_point m_origin;
+   uint64_t m_current;                          /**< Tick of the bucket checked last */
+   uint64_t m_next;                             /**< The earliest tick with items, NO_TICK if empty */
+   size_t m_size;
+};
+
+#endif
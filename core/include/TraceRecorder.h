@@ -0,0 +1,200 @@
+#ifndef _TRACERECORDER_H_
+#define _TRACERECORDER_H_
+
+/* ============================= */
+/**
+ * @file TraceRecorder.h
+ *
+ * @brief Binary capture of all frames exchanged between test framework and tested application.
+ *
+ * @details
+ *    TraceRecorder stores every inbound and outbound frame together with channel id, monotonic timestamp
+ *    and global sequence number, so frames from all channels can be analyzed in the order of arrival.
+ *    Frames are copied into double buffer and written to file by background thread - when writer is not able
+ *    to keep up, frames are dropped (and counted) instead of blocking the caller.
+ *
+ *    File layout (all values in host byte order):
+ *    - TraceFileHeader
+ *    - records: TraceRecordHeader + payload padded to 8 bytes
+ *    - index: TraceIndexEntry for every TRACE_INDEX_INTERVAL record (written when recorder is closed)
+ *
+ *    TraceReader maps the file into memory and allows to iterate over records with filtering.
+ *    Trace without index (e.g. when test crashed) can still be read - records are scanned sequentially.
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ============================= */
+
+/* =============================
+ *  Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+/* =============================
+ *  Includes of project headers
+ * =============================*/
+/* =============================
+ *          Defines
+ * =============================*/
+#define TRACE_FILE_MAGIC "SHTRACE"
+#define TRACE_FILE_VERSION 1
+#define TRACE_BUFFER_SIZE (256 * 1024)
+#define TRACE_INDEX_INTERVAL 256
+#define TRACE_FLUSH_PERIOD_MS 100
+/* =============================
+ *       Data structures
+ * =============================*/
+enum class TraceChannel : uint8_t
+{
+   HW_STUB,       /**< Frames exchanged over hw_stub channel */
+   BLUETOOTH,     /**< Frames exchanged over bluetooth (debug) channel */
+   APP_NTF,       /**< Frames exchanged over application notification channel */
+   COUNT,
+};
+
+enum class TraceDirection : uint8_t
+{
+   INBOUND,       /**< Frame received from tested application */
+   OUTBOUND,      /**< Frame sent to tested application */
+};
+
+typedef struct
+{
+   char magic[8];
+   uint32_t version;
+   uint32_t header_size;
+   uint64_t record_count;
+   uint64_t dropped_count;
+   uint64_t index_offset;     /**< 0 if trace was not closed correctly */
+   uint64_t index_count;
+} TraceFileHeader;
+
+typedef struct
+{
+   uint64_t seq;
+   uint64_t timestamp_ns;
+   uint32_t length;
+   uint8_t channel;
+   uint8_t direction;
+   uint16_t reserved;
+} TraceRecordHeader;
+
+typedef struct
+{
+   uint64_t seq;
+   uint64_t timestamp_ns;
+   uint64_t offset;
+} TraceIndexEntry;
+
+typedef struct
+{
+   uint64_t seq;
+   uint64_t timestamp_ns;     /**< steady_clock time in nanoseconds */
+   TraceChannel channel;
+   TraceDirection direction;
+   const uint8_t* data;       /**< points to mapped file, valid until reader is closed */
+   uint32_t size;
+} TraceFrame;
+
+typedef struct
+{
+   uint8_t channel_mask = 0xFF;     /**< bit set for every TraceChannel to report */
+   uint8_t direction_mask = 0xFF;   /**< bit set for every TraceDirection to report */
+   uint64_t from_seq = 0;
+   uint64_t to_seq = UINT64_MAX;
+} TraceFilter;
+
+class TraceRecorder
+{
+public:
+   TraceRecorder();
+   ~TraceRecorder();
+   /**
+    * @brief Creates trace file and starts writer thread.
+    * @param[in] file_path - absolute path to the trace file
+    * @return True if file created.
+    */
+   bool open(const std::string& file_path);
+   /**
+    * @brief Writes all buffered frames, index and closes the file.
+    * @return None.
+    */
+   void close();
+   bool isOpened();
+   /**
+    * @brief Stores the frame in trace. Safe to call from many threads.
+    * @param[in] channel - channel on which frame was exchanged
+    * @param[in] direction - frame direction
+    * @param[in] data - frame data
+    * @param[in] size - frame size
+    * @return None.
+    */
+   void record(TraceChannel channel, TraceDirection direction, const uint8_t* data, size_t size);
+   uint64_t recordedFrames();
+   uint64_t droppedFrames();
+   /**
+    * @brief Returns number of failed writes, trace file is incomplete if not zero.
+    */
+   uint64_t writeErrors();
+
+private:
+   void threadExecute();
+   bool writeToFile(const std::vector<uint8_t>& data);
+
+   int m_fd;
+   std::mutex m_mtx;
+   std::condition_variable m_cv;
+   std::thread m_thread;
+   bool m_thread_running;
+   bool m_accepting;                      /**< record() stores frames, cleared under lock before final flush */
+   std::vector<uint8_t> m_active_buf;
+   std::vector<uint8_t> m_pending_buf;
+   std::vector<TraceIndexEntry> m_index;
+   uint64_t m_seq;
+   uint64_t m_file_offset;
+   std::atomic<uint64_t> m_dropped;
+   std::atomic<uint64_t> m_write_errors;
+};
+
+class TraceReader
+{
+public:
+   TraceReader();
+   ~TraceReader();
+   bool open(const std::string& file_path);
+   void close();
+   uint64_t frameCount();
+   uint64_t droppedFrames();
+   /**
+    * @brief Sets filter and moves reader to the first frame matching it.
+    * @return None.
+    */
+   void setFilter(const TraceFilter& filter);
+   /**
+    * @brief Reads next frame matching the filter.
+    * @param[out] frame - read frame
+    * @return True if frame was read, false at the end of trace.
+    */
+   bool next(TraceFrame& frame);
+   void rewind();
+
+private:
+   uint64_t findOffset(uint64_t seq);
+
+   const uint8_t* m_data;
+   size_t m_size;
+   const TraceFileHeader* m_header;
+   const TraceIndexEntry* m_index;
+   uint64_t m_index_count;
+   uint64_t m_records_end;
+   uint64_t m_offset;
+   TraceFilter m_filter;
+};
+
+#endif
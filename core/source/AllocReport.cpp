@@ -0,0 +1,114 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <algorithm>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "AllocReport.h"
+#include "SymbolResolver.h"
+#include "Logger.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define ALLOC_REPORT_LINE_SIZE 1024
+
+bool AllocReport::load(const std::string& raw_path)
+{
+   m_summary = {};
+   FILE* file = fopen(raw_path.c_str(), "r");
+   if (!file)
+   {
+      logger_send(TF_ERROR, __func__, "cannot read %s", raw_path.c_str());
+      return false;
+   }
+
+   /* per-thread entries of the same call site are merged */
+   std::map<std::pair<uint64_t, uint8_t>, std::pair<uint64_t, uint64_t>> sites;
+   SymbolResolver resolver;
+   char line [ALLOC_REPORT_LINE_SIZE];
+   while (fgets(line, sizeof(line), file))
+   {
+      unsigned long a = 0, b = 0, c = 0, d = 0, e = 0, f = 0;
+      unsigned kind = 0;
+      if (strncmp(line, "map ", 4) == 0)
+      {
+         resolver.addMapping(line + 4);
+      }
+      else if (sscanf(line, "site %lx %u %lu %lu", &a, &kind, &b, &c) == 4)
+      {
+         auto& site = sites[{a, (uint8_t)kind}];
+         site.first += b;
+         site.second += c;
+      }
+      else if (sscanf(line, "curve %lu %lu", &a, &b) == 2)
+      {
+         m_summary.curve.push_back({(uint32_t)a, b});
+         m_summary.peak_live_bytes = std::max(m_summary.peak_live_bytes, (uint64_t)b);
+      }
+      else if (sscanf(line, "totals %lu %lu %lu %lu %lu %lu", &a, &b, &c, &d, &e, &f) == 6)
+      {
+         m_summary.allocations = a;
+         m_summary.frees = b;
+         m_summary.requested_bytes = c;
+         m_summary.allocated_bytes = d;
+         m_summary.freed_bytes = e;
+         m_summary.threads = f;
+      }
+      else if (strncmp(line, "end", 3) == 0)
+      {
+         m_summary.complete = true;
+      }
+   }
+   fclose(file);
+
+   for (auto& site : sites)
+   {
+      /* return address points after the call - step back into calling instruction */
+      std::string name = site.first.first? resolver.resolve(site.first.first - 1) : "[overflow]";
+      m_summary.hot_spots.push_back({name, (AllocKind)site.first.second, site.second.first, site.second.second});
+   }
+   std::sort(m_summary.hot_spots.begin(), m_summary.hot_spots.end(),
+             [](const AllocHotSpot& a, const AllocHotSpot& b){ return a.count > b.count; });
+
+   logger_send_if(!m_summary.complete, TF_ERROR, __func__, "%s is not complete", raw_path.c_str());
+   return m_summary.complete;
+}
+const AllocSummary& AllocReport::summary()
+{
+   return m_summary;
+}
+bool AllocReport::exportJson(const std::string& file_path, const std::string& test_name)
+{
+   FILE* file = fopen(file_path.c_str(), "w");
+   if (!file)
+   {
+      logger_send(TF_ERROR, __func__, "cannot create %s", file_path.c_str());
+      return false;
+   }
+   const AllocSummary& s = m_summary;
+   fprintf(file, "{\n  \"test\": \"%s\",\n  \"complete\": %s,\n  \"allocations\": %lu,\n  \"frees\": %lu,\n  \"requested_bytes\": %lu,\n"
+                 "  \"allocated_bytes\": %lu,\n  \"freed_bytes\": %lu,\n  \"peak_live_bytes\": %lu,\n  \"threads\": %u,\n  \"hot_spots\": [",
+                 test_name.c_str(), s.complete? "true" : "false", (unsigned long)s.allocations, (unsigned long)s.frees,
+                 (unsigned long)s.requested_bytes, (unsigned long)s.allocated_bytes, (unsigned long)s.freed_bytes,
+                 (unsigned long)s.peak_live_bytes, s.threads);
+   for (size_t i = 0; i < s.hot_spots.size() && i < ALLOC_REPORT_HOT_SPOTS; i++)
+   {
+      std::string site = s.hot_spots[i].site;
+      std::replace(site.begin(), site.end(), '"', '\'');
+      fprintf(file, "%s\n    {\"site\": \"%s\", \"kind\": \"%s\", \"count\": %lu, \"bytes\": %lu}", i == 0? "" : ",", site.c_str(),
+                    s.hot_spots[i].kind == ALLOC_KIND_NEW? "new" : "malloc", (unsigned long)s.hot_spots[i].count,
+                    (unsigned long)s.hot_spots[i].bytes);
+   }
+   fprintf(file, "\n  ],\n  \"live_bytes_curve\": [");
+   for (size_t i = 0; i < s.curve.size(); i++)
+   {
+      fprintf(file, "%s[%u, %lu]", i == 0? "" : ", ", s.curve[i].ms, (unsigned long)s.curve[i].live_bytes);
+   }
+   fprintf(file, "]\n}\n");
+   fclose(file);
+   return true;
+}
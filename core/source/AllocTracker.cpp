@@ -0,0 +1,508 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <malloc.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <atomic>
+#include <new>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "AllocTracker.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define ALLOC_TRACKER_PROBES 16                 /**< Slots checked before site is counted as overflow */
+#define ALLOC_TRACKER_PATH_SIZE 512
+#define ALLOC_TRACKER_WRITE_BUFFER_SIZE 4096
+#define ALLOC_TRACKER_API extern "C" __attribute__((visibility("default")))
+
+/* glibc allocator, used for real allocations */
+extern "C"
+{
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void* __libc_valloc(size_t size);
+void* __libc_pvalloc(size_t size);
+void __libc_free(void* ptr);
+}
+
+namespace
+{
+/* counters have single writer (owning thread), reader (report) may run in other thread or signal handler */
+struct Counter
+{
+   std::atomic<uint64_t> value;
+   void add(uint64_t delta)
+   {
+      value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+   }
+   uint64_t get() const
+   {
+      return value.load(std::memory_order_relaxed);
+   }
+};
+
+struct SiteEntry
+{
+   std::atomic<uintptr_t> address;
+   std::atomic<uint8_t> kind;
+   Counter count;
+   Counter bytes;
+};
+
+struct ThreadBuffer
+{
+   ThreadBuffer* next;
+   Counter allocs;
+   Counter frees;
+   Counter requested;
+   Counter allocated;
+   Counter freed;
+   SiteEntry overflow;
+   SiteEntry sites [ALLOC_TRACKER_SITES];
+};
+
+struct CurvePoint
+{
+   uint32_t ms;
+   uint64_t live;
+};
+
+std::atomic<bool> g_enabled(false);
+std::atomic<bool> g_dumping(false);
+std::atomic<ThreadBuffer*> g_threads(nullptr);
+std::atomic<uint32_t> g_thread_count(0);
+std::atomic<uint32_t> g_curve_count(0);
+std::atomic<uint64_t> g_next_curve_ms(0);
+CurvePoint g_curve [ALLOC_TRACKER_CURVE_POINTS];
+uint64_t g_start_ms;
+char g_output_path [ALLOC_TRACKER_PATH_SIZE];
+
+__thread ThreadBuffer* t_buffer __attribute__((tls_model("initial-exec")));
+__thread bool t_in_hook __attribute__((tls_model("initial-exec")));
+
+uint64_t now_ms()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+   return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+ThreadBuffer* thread_buffer()
+{
+   if (!t_buffer)
+   {
+      /* not allocated with malloc - it would recurse, memory is zeroed by kernel */
+      void* memory = mmap(NULL, sizeof(ThreadBuffer), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (memory == MAP_FAILED)
+      {
+         return nullptr;
+      }
+      ThreadBuffer* buffer = (ThreadBuffer*)memory;
+      buffer->next = g_threads.load(std::memory_order_relaxed);
+      while (!g_threads.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed));
+      g_thread_count.fetch_add(1, std::memory_order_relaxed);
+      t_buffer = buffer;
+   }
+   return t_buffer;
+}
+
+uint64_t live_bytes()
+{
+   uint64_t allocated = 0;
+   uint64_t freed = 0;
+   for (ThreadBuffer* buffer = g_threads.load(std::memory_order_acquire); buffer; buffer = buffer->next)
+   {
+      allocated += buffer->allocated.get();
+      freed += buffer->freed.get();
+   }
+   return allocated > freed? allocated - freed : 0;
+}
+
+void sample_curve()
+{
+   uint64_t elapsed = now_ms() - g_start_ms;
+   uint64_t next = g_next_curve_ms.load(std::memory_order_relaxed);
+   /* only one thread takes the point */
+   if (elapsed >= next && g_next_curve_ms.compare_exchange_strong(next, elapsed + ALLOC_TRACKER_CURVE_PERIOD_MS, std::memory_order_relaxed))
+   {
+      uint32_t idx = g_curve_count.load(std::memory_order_relaxed);
+      if (idx < ALLOC_TRACKER_CURVE_POINTS)
+      {
+         g_curve[idx].ms = elapsed;
+         g_curve[idx].live = live_bytes();
+         g_curve_count.store(idx + 1, std::memory_order_release);
+      }
+   }
+}
+
+SiteEntry& find_site(ThreadBuffer* buffer, uintptr_t address, AllocKind kind)
+{
+   size_t slot = (address >> 4) * 0x9E3779B97F4A7C15ULL >> 54;
+   for (size_t i = 0; i < ALLOC_TRACKER_PROBES; i++)
+   {
+      SiteEntry& entry = buffer->sites[(slot + i) % ALLOC_TRACKER_SITES];
+      uintptr_t current = entry.address.load(std::memory_order_relaxed);
+      if (current == address)
+      {
+         return entry;
+      }
+      if (current == 0)
+      {
+         entry.kind.store(kind, std::memory_order_relaxed);
+         entry.address.store(address, std::memory_order_release);
+         return entry;
+      }
+   }
+   return buffer->overflow;
+}
+
+void* on_alloc(void* ptr, size_t size, void* caller, AllocKind kind)
+{
+   if (!ptr || !g_enabled.load(std::memory_order_relaxed) || t_in_hook)
+   {
+      return ptr;
+   }
+   t_in_hook = true;
+   ThreadBuffer* buffer = thread_buffer();
+   if (buffer)
+   {
+      buffer->allocs.add(1);
+      buffer->requested.add(size);
+      buffer->allocated.add(malloc_usable_size(ptr));
+      SiteEntry& site = find_site(buffer, (uintptr_t)caller, kind);
+      site.count.add(1);
+      site.bytes.add(size);
+      sample_curve();
+   }
+   t_in_hook = false;
+   return ptr;
+}
+
+void on_free(size_t usable_size)
+{
+   if (!g_enabled.load(std::memory_order_relaxed) || t_in_hook)
+   {
+      return;
+   }
+   t_in_hook = true;
+   ThreadBuffer* buffer = thread_buffer();
+   if (buffer)
+   {
+      buffer->frees.add(1);
+      buffer->freed.add(usable_size);
+   }
+   t_in_hook = false;
+}
+void on_free(void* ptr)
+{
+   if (ptr)
+   {
+      on_free(malloc_usable_size(ptr));
+   }
+}
+void* on_realloc(void* ptr, size_t size, void* caller)
+{
+   /* size of old block has to be taken before it is released */
+   size_t old_size = ptr? malloc_usable_size(ptr) : 0;
+   void* result = __libc_realloc(ptr, size);
+   if (ptr && (result || size == 0))
+   {
+      on_free(old_size);
+   }
+   return on_alloc(result, size, caller, ALLOC_KIND_MALLOC);
+}
+
+/* minimal formatting - snprintf is not async-signal-safe */
+class ReportWriter
+{
+public:
+   explicit ReportWriter(int fd): m_fd(fd), m_size(0) {}
+   ~ReportWriter() { flush(); }
+   ReportWriter& text(const char* text, size_t size)
+   {
+      for (size_t i = 0; i < size; i++)
+      {
+         if (m_size == sizeof(m_buffer))
+         {
+            flush();
+         }
+         m_buffer[m_size++] = text[i];
+      }
+      return *this;
+   }
+   ReportWriter& text(const char* text)
+   {
+      return this->text(text, strlen(text));
+   }
+   ReportWriter& number(uint64_t value, unsigned base = 10)
+   {
+      char digits [24];
+      size_t idx = sizeof(digits);
+      do
+      {
+         digits[--idx] = "0123456789abcdef"[value % base];
+         value /= base;
+      } while (value);
+      return text(digits + idx, sizeof(digits) - idx);
+   }
+   void flush()
+   {
+      size_t written = 0;
+      while (written < m_size)
+      {
+         ssize_t bytes = write(m_fd, m_buffer + written, m_size - written);
+         if (bytes <= 0 && errno != EINTR)
+         {
+            break;
+         }
+         written += bytes > 0? bytes : 0;
+      }
+      m_size = 0;
+   }
+private:
+   int m_fd;
+   size_t m_size;
+   char m_buffer [ALLOC_TRACKER_WRITE_BUFFER_SIZE];
+};
+
+void write_site(ReportWriter& writer, const SiteEntry& site)
+{
+   writer.text("site ").number(site.address.load(std::memory_order_acquire), 16).text(" ").number(site.kind.load(std::memory_order_relaxed))
+         .text(" ").number(site.count.get()).text(" ").number(site.bytes.get()).text("\n");
+}
+
+/* async-signal-safe, file is replaced atomically so reader never sees partial report */
+void write_report()
+{
+   if (g_output_path[0] == 0x00 || g_dumping.exchange(true))
+   {
+      return;
+   }
+   bool in_hook = t_in_hook;
+   t_in_hook = true;
+   char tmp_path [ALLOC_TRACKER_PATH_SIZE + 8];
+   size_t path_size = strlen(g_output_path);
+   memcpy(tmp_path, g_output_path, path_size);
+   memcpy(tmp_path + path_size, ".tmp", 5);
+
+   int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+   if (fd >= 0)
+   {
+      {
+         ReportWriter writer(fd);
+         uint64_t allocs = 0, frees = 0, requested = 0, allocated = 0, freed = 0;
+         for (ThreadBuffer* buffer = g_threads.load(std::memory_order_acquire); buffer; buffer = buffer->next)
+         {
+            allocs += buffer->allocs.get();
+            frees += buffer->frees.get();
+            requested += buffer->requested.get();
+            allocated += buffer->allocated.get();
+            freed += buffer->freed.get();
+         }
+         writer.text("totals ").number(allocs).text(" ").number(frees).text(" ").number(requested).text(" ").number(allocated)
+               .text(" ").number(freed).text(" ").number(g_thread_count.load()).text("\n");
+         for (ThreadBuffer* buffer = g_threads.load(std::memory_order_acquire); buffer; buffer = buffer->next)
+         {
+            for (const SiteEntry& site : buffer->sites)
+            {
+               if (site.address.load(std::memory_order_acquire) != 0)
+               {
+                  write_site(writer, site);
+               }
+            }
+            if (buffer->overflow.count.get() > 0)
+            {
+               write_site(writer, buffer->overflow);
+            }
+         }
+         uint32_t points = g_curve_count.load(std::memory_order_acquire);
+         for (uint32_t i = 0; i < points; i++)
+         {
+            writer.text("curve ").number(g_curve[i].ms).text(" ").number(g_curve[i].live).text("\n");
+         }
+         writer.text("curve ").number(now_ms() - g_start_ms).text(" ").number(live_bytes()).text("\n");
+
+         /* mappings are needed to resolve call sites after the process exits */
+         int maps = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+         if (maps >= 0)
+         {
+            char chunk [1024];
+            bool line_start = true;
+            ssize_t bytes = 0;
+            while ((bytes = read(maps, chunk, sizeof(chunk))) > 0)
+            {
+               for (ssize_t i = 0; i < bytes; i++)
+               {
+                  if (line_start)
+                  {
+                     writer.text("map ");
+                  }
+                  writer.text(chunk + i, 1);
+                  line_start = chunk[i] == '\n';
+               }
+            }
+            close(maps);
+         }
+         writer.text("end\n");
+      }
+      close(fd);
+      rename(tmp_path, g_output_path);
+   }
+   t_in_hook = in_hook;
+   g_dumping.store(false);
+}
+
+void dump_signal_handler(int)
+{
+   int saved_errno = errno;
+   write_report();
+   errno = saved_errno;
+}
+
+__attribute__((constructor)) void alloc_tracker_init()
+{
+   const char* path = getenv(ALLOC_TRACKER_OUTPUT_ENV);
+   if (!path || strlen(path) >= sizeof(g_output_path))
+   {
+      return;
+   }
+   memcpy(g_output_path, path, strlen(path) + 1);
+   g_start_ms = now_ms();
+   /* handler is not installed if the subject already uses the signal (inherited disposition) */
+   struct sigaction current = {};
+   if (sigaction(ALLOC_TRACKER_DUMP_SIGNAL, NULL, &current) == 0 && current.sa_handler == SIG_DFL)
+   {
+      struct sigaction action = {};
+      action.sa_handler = dump_signal_handler;
+      action.sa_flags = SA_RESTART;
+      sigemptyset(&action.sa_mask);
+      sigaction(ALLOC_TRACKER_DUMP_SIGNAL, &action, NULL);
+   }
+   g_enabled = true;
+}
+
+__attribute__((destructor)) void alloc_tracker_deinit()
+{
+   write_report();
+}
+}
+
+ALLOC_TRACKER_API void* malloc(size_t size)
+{
+   return on_alloc(__libc_malloc(size), size, __builtin_return_address(0), ALLOC_KIND_MALLOC);
+}
+ALLOC_TRACKER_API void* calloc(size_t count, size_t size)
+{
+   return on_alloc(__libc_calloc(count, size), count * size, __builtin_return_address(0), ALLOC_KIND_MALLOC);
+}
+ALLOC_TRACKER_API void* realloc(void* ptr, size_t size)
+{
+   return on_realloc(ptr, size, __builtin_return_address(0));
+}
+ALLOC_TRACKER_API void* reallocarray(void* ptr, size_t count, size_t size)
+{
+   size_t bytes = 0;
+   if (__builtin_mul_overflow(count, size, &bytes))
+   {
+      errno = ENOMEM;
+      return nullptr;
+   }
+   return on_realloc(ptr, bytes, __builtin_return_address(0));
+}
+ALLOC_TRACKER_API void* memalign(size_t alignment, size_t size)
+{
+   return on_alloc(__libc_memalign(alignment, size), size, __builtin_return_address(0), ALLOC_KIND_MALLOC);
+}
+ALLOC_TRACKER_API void* aligned_alloc(size_t alignment, size_t size)
+{
+   return on_alloc(__libc_memalign(alignment, size), size, __builtin_return_address(0), ALLOC_KIND_MALLOC);
+}
+ALLOC_TRACKER_API void* valloc(size_t size)
+{
+   return on_alloc(__libc_valloc(size), size, __builtin_return_address(0), ALLOC_KIND_MALLOC);
+}
+ALLOC_TRACKER_API void* pvalloc(size_t size)
+{
+   /* size is rounded up to whole pages, counted as requested */
+   return on_alloc(__libc_pvalloc(size), size, __builtin_return_address(0), ALLOC_KIND_MALLOC);
+}
+ALLOC_TRACKER_API int posix_memalign(void** result, size_t alignment, size_t size)
+{
+   if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+   {
+      return EINVAL;
+   }
+   void* ptr = on_alloc(__libc_memalign(alignment, size), size, __builtin_return_address(0), ALLOC_KIND_MALLOC);
+   if (!ptr)
+   {
+      return ENOMEM;
+   }
+   *result = ptr;
+   return 0;
+}
+ALLOC_TRACKER_API void free(void* ptr)
+{
+   on_free(ptr);
+   __libc_free(ptr);
+}
+
+/* no exceptions in this project - failed operator new aborts */
+__attribute__((visibility("default"))) void* operator new(size_t size)
+{
+   void* ptr = on_alloc(__libc_malloc(size), size, __builtin_return_address(0), ALLOC_KIND_NEW);
+   if (!ptr)
+   {
+      abort();
+   }
+   return ptr;
+}
+__attribute__((visibility("default"))) void* operator new[](size_t size)
+{
+   void* ptr = on_alloc(__libc_malloc(size), size, __builtin_return_address(0), ALLOC_KIND_NEW);
+   if (!ptr)
+   {
+      abort();
+   }
+   return ptr;
+}
+__attribute__((visibility("default"))) void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+   return on_alloc(__libc_malloc(size), size, __builtin_return_address(0), ALLOC_KIND_NEW);
+}
+__attribute__((visibility("default"))) void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+   return on_alloc(__libc_malloc(size), size, __builtin_return_address(0), ALLOC_KIND_NEW);
+}
+__attribute__((visibility("default"))) void operator delete(void* ptr) noexcept
+{
+   on_free(ptr);
+   __libc_free(ptr);
+}
+__attribute__((visibility("default"))) void operator delete[](void* ptr) noexcept
+{
+   on_free(ptr);
+   __libc_free(ptr);
+}
+__attribute__((visibility("default"))) void operator delete(void* ptr, size_t) noexcept
+{
+   on_free(ptr);
+   __libc_free(ptr);
+}
+__attribute__((visibility("default"))) void operator delete[](void* ptr, size_t) noexcept
+{
+   on_free(ptr);
+   __libc_free(ptr);
+}
@@ -0,0 +1,177 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <algorithm>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "ChannelImpairment.h"
+#include "Logger.h"
+
+ChannelImpairment::ChannelImpairment():
+m_wheel(std::chrono::microseconds(IMPAIRMENT_TICK_US), IMPAIRMENT_WHEEL_BUCKETS),
+m_thread_running(false),
+m_wake_at(std::chrono::steady_clock::time_point::max())
+{
+}
+ChannelImpairment::~ChannelImpairment()
+{
+   stopThread();
+}
+void ChannelImpairment::setSink(ImpairmentDirection direction, Sink sink)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   m_directions[(size_t)direction].sink = sink;
+}
+void ChannelImpairment::configure(ImpairmentDirection direction, const ImpairmentProfile& profile)
+{
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      Direction& dir = m_directions[(size_t)direction];
+      dir.profile = profile;
+      dir.enabled = profile.delay_us > 0 || profile.jitter_us > 0 || profile.bandwidth_bps > 0 || profile.drop_permille > 0;
+      dir.random.seed(profile.seed);
+      if (dir.enabled && !m_thread_running)
+      {
+         m_thread_running = true;
+         m_thread = std::thread(&ChannelImpairment::threadExecute, this);
+      }
+   }
+   logger_send(TF_SOCKDRV, __func__, "%s: delay %u us, jitter %u us%s, bandwidth %u B/s, drop %u/1000, seed %u",
+               direction == ImpairmentDirection::INBOUND? "inbound" : "outbound", profile.delay_us, profile.jitter_us,
+               profile.reorder? " (reorder)" : "", profile.bandwidth_bps, profile.drop_permille, profile.seed);
+}
+void ChannelImpairment::reset()
+{
+   stopThread();
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      m_wheel.clear();
+      for (Direction& dir : m_directions)
+      {
+         dir.profile = ImpairmentProfile();
+         dir.enabled = false;
+         dir.pending = 0;
+         dir.metrics.queued_frames.set(0);
+      }
+   }
+   pauseReceive(std::chrono::microseconds(0));
+}
+bool ChannelImpairment::isActive(ImpairmentDirection direction)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   const Direction& dir = m_directions[(size_t)direction];
+   return dir.enabled || dir.pending > 0;
+}
+void ChannelImpairment::submit(ImpairmentDirection direction, const uint8_t* data, size_t size)
+{
+   auto now = std::chrono::steady_clock::now();
+   std::lock_guard<std::mutex> lock(m_mtx);
+   Direction& dir = m_directions[(size_t)direction];
+   const ImpairmentProfile& profile = dir.profile;
+   auto release = now;
+   if (dir.enabled)
+   {
+      if (profile.drop_permille > 0 && std::uniform_int_distribution<uint32_t>(0, 999)(dir.random) < profile.drop_permille)
+      {
+         dir.metrics.frames_dropped.add();
+         return;
+      }
+      if (profile.bandwidth_bps > 0)
+      {
+         dir.link_free = std::max(now, dir.link_free) + std::chrono::microseconds(size * 1000000ULL / profile.bandwidth_bps);
+         release = dir.link_free;
+      }
+      release += std::chrono::microseconds(profile.delay_us);
+      if (profile.jitter_us > 0)
+      {
+         release += std::chrono::microseconds(std::uniform_int_distribution<uint32_t>(0, profile.jitter_us)(dir.random));
+      }
+   }
+   if (!profile.reorder)
+   {
+      release = std::max(release, dir.last_release);
+   }
+   dir.last_release = std::max(release, dir.last_release);
+   m_wheel.schedule(release, {direction, std::vector<uint8_t>(data, data + size)});
+   dir.metrics.queued_frames.set(++dir.pending);
+   if (release < m_wake_at)
+   {
+      m_cv.notify_one();
+   }
+}
+void ChannelImpairment::pauseReceive(std::chrono::microseconds duration)
+{
+   std::lock_guard<std::mutex> lock(m_rx_mtx);
+   m_rx_resume = std::chrono::steady_clock::now() + duration;
+   m_rx_cv.notify_all();
+}
+void ChannelImpairment::waitReceive()
+{
+   std::unique_lock<std::mutex> lock(m_rx_mtx);
+   while (std::chrono::steady_clock::now() < m_rx_resume)
+   {
+      m_rx_cv.wait_until(lock, m_rx_resume);
+   }
+}
+const ImpairmentMetrics& ChannelImpairment::getMetrics(ImpairmentDirection direction)
+{
+   return m_directions[(size_t)direction].metrics;
+}
+void ChannelImpairment::threadExecute()
+{
+   std::vector<Frame> expired;
+   std::unique_lock<std::mutex> lock(m_mtx);
+   while (m_thread_running)
+   {
+      m_wheel.advance(std::chrono::steady_clock::now(), [&expired](Frame& frame)
+                      {
+                         expired.push_back(std::move(frame));
+                      });
+      if (!expired.empty())
+      {
+         /* sinks called without lock - they write to socket or call listener, frames may be submitted meanwhile */
+         lock.unlock();
+         for (Frame& frame : expired)
+         {
+            Direction& dir = m_directions[(size_t)frame.direction];
+            if (dir.sink)
+            {
+               dir.sink(frame.data);
+            }
+            dir.metrics.frames_delayed.add();
+         }
+         lock.lock();
+         for (Frame& frame : expired)
+         {
+            Direction& dir = m_directions[(size_t)frame.direction];
+            dir.metrics.queued_frames.set(--dir.pending);
+         }
+         expired.clear();
+         continue;
+      }
+      m_wake_at = m_wheel.nextExpiry();
+      if (m_wake_at == std::chrono::steady_clock::time_point::max())
+      {
+         m_cv.wait(lock);
+      }
+      else
+      {
+         m_cv.wait_until(lock, m_wake_at);
+      }
+      m_wake_at = std::chrono::steady_clock::time_point::min();
+   }
+}
+void ChannelImpairment::stopThread()
+{
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      if (!m_thread_running)
+      {
+         return;
+      }
+      m_thread_running = false;
+      m_cv.notify_one();
+   }
+   m_thread.join();
+}
@@ -0,0 +1,287 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "CpuProfiler.h"
+#include "Logger.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define PROFILER_POLL_TIMEOUT_MS 100
+#define PROFILER_MAX_RECORD_SIZE 8192
+
+namespace
+{
+int perf_event_open(struct perf_event_attr* attr, pid_t pid, int cpu)
+{
+   return syscall(SYS_perf_event_open, attr, pid, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+}
+}
+
+CpuProfiler::CpuProfiler():
+m_pid(0),
+m_ring_size(0),
+m_page_size(sysconf(_SC_PAGESIZE)),
+m_running(false),
+m_samples(0),
+m_lost(0)
+{
+}
+CpuProfiler::~CpuProfiler()
+{
+   if (m_running)
+   {
+      stop("");
+   }
+}
+bool CpuProfiler::start(pid_t pid, uint32_t frequency_hz)
+{
+   bool result = false;
+   do
+   {
+      if (m_running || pid <= 0 || frequency_hz == 0)
+      {
+         logger_send(TF_ERROR, __func__, "cannot start, running %u, pid %d, frequency %u", m_running.load(), pid, frequency_hz);
+         break;
+      }
+      struct perf_event_attr attr = {};
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_SOFTWARE;
+      attr.config = PERF_COUNT_SW_TASK_CLOCK;
+      attr.freq = 1;
+      attr.sample_freq = frequency_hz;
+      attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.exclude_callchain_kernel = 1;
+      /* threads created later inherit the event - kernel allows to map inherited events only per CPU */
+      attr.inherit = 1;
+      attr.watermark = 1;
+      attr.wakeup_watermark = (PROFILER_RING_PAGES * m_page_size) / 4;
+      attr.disabled = 1;
+      m_ring_size = (PROFILER_RING_PAGES + 1) * m_page_size;
+      long cpus = sysconf(_SC_NPROCESSORS_CONF);
+      for (int cpu = 0; cpu < cpus; cpu++)
+      {
+         int fd = perf_event_open(&attr, pid, cpu);
+         if (fd < 0)
+         {
+            logger_send(TF_ERROR, __func__, "perf_event_open failed for %d: %s (check /proc/sys/kernel/perf_event_paranoid)", pid, strerror(errno));
+            break;
+         }
+         void* ring = mmap(NULL, m_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+         if (ring == MAP_FAILED)
+         {
+            logger_send(TF_ERROR, __func__, "cannot map ring buffer: %s", strerror(errno));
+            close(fd);
+            break;
+         }
+         m_fds.push_back(fd);
+         m_rings.push_back((uint8_t*)ring);
+      }
+      if (m_fds.size() != (size_t)cpus)
+      {
+         closeEvents();
+         break;
+      }
+
+      char exe_path [256];
+      char link [64];
+      snprintf(link, sizeof(link), "/proc/%d/exe", pid);
+      ssize_t len = readlink(link, exe_path, sizeof(exe_path) - 1);
+      exe_path[len > 0? len : 0] = 0x00;
+      m_root = len > 0? basename(exe_path) : std::to_string(pid);
+
+      m_pid = pid;
+      m_stacks.clear();
+      m_resolver.clear();
+      m_samples = 0;
+      m_lost = 0;
+      m_running = true;
+      m_thread = std::thread(&CpuProfiler::threadExecute, this);
+      for (int fd : m_fds)
+      {
+         ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+      result = true;
+   }while(0);
+
+   logger_send(TF_TC, __func__, "pid %d, %u Hz => %u", pid, frequency_hz, result);
+   return result;
+}
+bool CpuProfiler::stop(const std::string& folded_path)
+{
+   if (!m_running)
+   {
+      return false;
+   }
+   for (int fd : m_fds)
+   {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+   }
+   m_running = false;
+   m_thread.join();
+   for (uint8_t* ring : m_rings)
+   {
+      drainRingBuffer(ring);
+   }
+   m_resolver.loadMappings(m_pid);
+   closeEvents();
+
+   if (folded_path.empty())
+   {
+      return false;
+   }
+   FILE* file = fopen(folded_path.c_str(), "w");
+   if (!file)
+   {
+      logger_send(TF_ERROR, __func__, "cannot create %s", folded_path.c_str());
+      return false;
+   }
+   /* chains with the same symbols (different call sites in the same functions) are merged */
+   std::map<std::string, uint64_t> folded;
+   for (auto& stack : m_stacks)
+   {
+      std::string line = m_root;
+      for (auto it = stack.first.rbegin(); it != stack.first.rend(); it++)
+      {
+         line += ";" + m_resolver.resolve(*it);
+      }
+      folded[line] += stack.second;
+   }
+   for (auto& stack : folded)
+   {
+      fprintf(file, "%s %lu\n", stack.first.c_str(), (unsigned long)stack.second);
+   }
+   fclose(file);
+   /* binaries may be rebuilt before next test */
+   m_resolver.clear();
+   logger_send(TF_TC, __func__, "pid %d, %lu samples (%lu lost), %zu stacks written to %s", m_pid, (unsigned long)m_samples,
+                                (unsigned long)m_lost, folded.size(), folded_path.c_str());
+   return true;
+}
+bool CpuProfiler::isRunning()
+{
+   return m_running;
+}
+uint64_t CpuProfiler::sampleCount()
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   return m_samples;
+}
+uint64_t CpuProfiler::lostCount()
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   return m_lost;
+}
+void CpuProfiler::closeEvents()
+{
+   for (uint8_t* ring : m_rings)
+   {
+      munmap(ring, m_ring_size);
+   }
+   for (int fd : m_fds)
+   {
+      close(fd);
+   }
+   m_rings.clear();
+   m_fds.clear();
+}
+void CpuProfiler::threadExecute()
+{
+   std::vector<struct pollfd> fds;
+   for (int fd : m_fds)
+   {
+      fds.push_back({fd, POLLIN, 0});
+   }
+   while (m_running)
+   {
+      poll(fds.data(), fds.size(), PROFILER_POLL_TIMEOUT_MS);
+      for (uint8_t* ring : m_rings)
+      {
+         drainRingBuffer(ring);
+      }
+   }
+}
+void CpuProfiler::drainRingBuffer(uint8_t* ring)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   struct perf_event_mmap_page* header = (struct perf_event_mmap_page*)ring;
+   const uint8_t* data = ring + m_page_size;
+   const uint64_t data_size = PROFILER_RING_PAGES * m_page_size;
+   uint64_t head = __atomic_load_n(&header->data_head, __ATOMIC_ACQUIRE);
+   uint64_t tail = header->data_tail;
+   uint8_t record [PROFILER_MAX_RECORD_SIZE];
+
+   while (tail < head)
+   {
+      struct perf_event_header event;
+      /* records may wrap around the end of the buffer - copy them to contiguous memory */
+      auto copy = [&](uint8_t* dst, uint64_t from, size_t size)
+      {
+         size_t offset = from % data_size;
+         size_t first = std::min((uint64_t)size, data_size - offset);
+         memcpy(dst, data + offset, first);
+         memcpy(dst + first, data, size - first);
+      };
+      copy((uint8_t*)&event, tail, sizeof(event));
+      if (event.size < sizeof(event) || event.size > sizeof(record))
+      {
+         logger_send(TF_ERROR, __func__, "invalid record size %u, dropping buffer", event.size);
+         tail = head;
+         break;
+      }
+      copy(record, tail, event.size);
+      tail += event.size;
+
+      if (event.type == PERF_RECORD_SAMPLE)
+      {
+         /* ip, pid, tid, nr, ips[nr] */
+         const uint8_t* ptr = record + sizeof(event);
+         uint64_t ip = 0, nr = 0;
+         memcpy(&ip, ptr, sizeof(ip));
+         memcpy(&nr, ptr + 16, sizeof(nr));
+         std::vector<uint64_t> chain;
+         if (24 + nr * sizeof(uint64_t) <= event.size - sizeof(event))
+         {
+            const uint8_t* ips = ptr + 24;
+            for (uint64_t i = 0; i < nr; i++)
+            {
+               uint64_t address = 0;
+               memcpy(&address, ips + i * sizeof(uint64_t), sizeof(address));
+               /* context markers (PERF_CONTEXT_USER etc.) are not addresses */
+               if (address < (uint64_t)PERF_CONTEXT_MAX)
+               {
+                  /* return addresses point after the call - step back into calling instruction */
+                  chain.push_back(chain.empty()? address : address - 1);
+               }
+            }
+         }
+         if (chain.empty())
+         {
+            chain.push_back(ip);
+         }
+         m_stacks[chain]++;
+         m_samples++;
+      }
+      else if (event.type == PERF_RECORD_LOST)
+      {
+         uint64_t lost = 0;
+         memcpy(&lost, record + sizeof(event) + 8, sizeof(lost));
+         m_lost += lost;
+      }
+   }
+   __atomic_store_n(&header->data_tail, tail, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,225 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "DebugClient.h"
+#include "Logger.h"
+
+namespace
+{
+std::future<DebugResponse> make_ready_future(DebugStatus status)
+{
+   std::promise<DebugResponse> promise;
+   DebugResponse response;
+   response.status = status;
+   promise.set_value(response);
+   return promise.get_future();
+}
+}
+
+DebugClient::DebugClient():
+m_running(false),
+m_next_id(1)
+{
+}
+DebugClient::~DebugClient()
+{
+   stop();
+}
+bool DebugClient::start(DebugWriter writer)
+{
+   bool result = false;
+   if (!m_running && writer)
+   {
+      m_writer = writer;
+      m_running = true;
+      m_thread = std::thread(&DebugClient::threadExecute, this);
+      result = true;
+   }
+   logger_send_if(!result, TF_ERROR, __func__, "cannot start debug client");
+   return result;
+}
+void DebugClient::stop()
+{
+   if (m_running)
+   {
+      {
+         std::lock_guard<std::mutex> lock(m_mtx);
+         m_running = false;
+         size_t count = m_requests.size();
+         while (!m_requests.empty())
+         {
+            complete(m_requests.begin(), DebugStatus::STOPPED, "");
+         }
+         logger_send_if(count > 0, TF_TC, __func__, "%zu debug commands without response", count);
+      }
+      m_cv.notify_all();
+      m_thread.join();
+   }
+}
+std::future<DebugResponse> DebugClient::send(const std::string& command, uint32_t timeout_ms)
+{
+   std::vector<std::future<DebugResponse>> futures = send(std::vector<std::string>{command}, timeout_ms);
+   return std::move(futures.front());
+}
+std::vector<std::future<DebugResponse>> DebugClient::send(const std::vector<std::string>& commands, uint32_t timeout_ms)
+{
+   std::vector<std::future<DebugResponse>> result;
+   std::vector<std::string> texts;
+   std::vector<uint32_t> ids;
+   result.reserve(commands.size());
+   texts.reserve(commands.size());
+   ids.reserve(commands.size());
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      auto now = std::chrono::steady_clock::now();
+      for (const std::string& command : commands)
+      {
+         if (!m_running || m_requests.size() >= DEBUG_MAX_OUTSTANDING ||
+             command.size() + DEBUG_REQUEST_HEADER_SIZE > SOCKDRV_MAX_RW_SIZE)
+         {
+            m_rejected.add();
+            result.push_back(make_ready_future(DebugStatus::REJECTED));
+            continue;
+         }
+         uint32_t id = m_next_id++;
+         Request& request = m_requests[id];
+         request.sent = now;
+         request.deadline = now + std::chrono::milliseconds(timeout_ms);
+         result.push_back(request.promise.get_future());
+         texts.push_back(DEBUG_REQUEST_PREFIX + std::to_string(id) + " " + command);
+         ids.push_back(id);
+      }
+   }
+   m_cv.notify_all();
+   if (ids.empty())
+   {
+      return result;
+   }
+
+   /* written without the lock - response may be handled before write returns */
+   std::vector<SocketFrame> frames;
+   frames.reserve(texts.size());
+   for (const std::string& text : texts)
+   {
+      frames.push_back({(const uint8_t*)text.data(), text.size()});
+   }
+   bool written = m_writer(frames.data(), frames.size());
+   if (written)
+   {
+      m_sent.add(ids.size());
+   }
+   else
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      for (uint32_t id : ids)
+      {
+         auto it = m_requests.find(id);
+         if (it != m_requests.end())
+         {
+            complete(it, DebugStatus::SEND_ERROR, "");
+         }
+      }
+      logger_send(TF_ERROR, __func__, "cannot write %zu debug commands", ids.size());
+   }
+   return result;
+}
+bool DebugClient::onFrame(const uint8_t* data, size_t size)
+{
+   if (size < 2 || data[0] != DEBUG_REQUEST_PREFIX)
+   {
+      return false;
+   }
+   size_t pos = 1;
+   uint32_t id = 0;
+   while (pos < size && data[pos] >= '0' && data[pos] <= '9')
+   {
+      id = id * 10 + (data[pos++] - '0');
+   }
+   if (pos == 1)
+   {
+      return false;
+   }
+   if (pos < size && data[pos] == ' ')
+   {
+      pos++;
+   }
+
+   std::lock_guard<std::mutex> lock(m_mtx);
+   auto it = m_requests.find(id);
+   if (it != m_requests.end())
+   {
+      complete(it, DebugStatus::OK, std::string((const char*)data + pos, size - pos));
+   }
+   else
+   {
+      /* timed out before or not sent by this client */
+      m_late_responses.add();
+      logger_send(TF_TC, __func__, "response to unknown command %u", id);
+   }
+   return true;
+}
+size_t DebugClient::outstanding()
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   return m_requests.size();
+}
+void DebugClient::registerMetrics(MetricsRegistry& registry)
+{
+   registry.add("debug_commands_total", "Debug commands sent", MetricType::COUNTER, "", &m_sent);
+   registry.add("debug_responses_total", "Debug commands answered in time", MetricType::COUNTER, "", &m_responses);
+   registry.add("debug_timeouts_total", "Debug commands without response in time", MetricType::COUNTER, "", &m_timeouts);
+   registry.add("debug_late_responses_total", "Responses received after timeout", MetricType::COUNTER, "", &m_late_responses);
+   registry.add("debug_rejected_total", "Debug commands not sent", MetricType::COUNTER, "", &m_rejected);
+   registry.add("debug_latency_max_us", "Longest time to debug response", MetricType::GAUGE, "", &m_latency_max_us);
+   registry.add("debug_outstanding", "Debug commands waiting for response", MetricType::GAUGE, "", [this]() -> uint64_t
+                 {
+                    return outstanding();
+                 });
+}
+void DebugClient::complete(std::map<uint32_t, Request>::iterator it, DebugStatus status, const std::string& text)
+{
+   DebugResponse response;
+   response.status = status;
+   response.text = text;
+   response.latency_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - it->second.sent).count();
+   if (status == DebugStatus::OK)
+   {
+      m_responses.add();
+      m_latency_max_us.setMax(response.latency_us);
+   }
+   else if (status == DebugStatus::TIMEOUT)
+   {
+      m_timeouts.add();
+   }
+   it->second.promise.set_value(response);
+   m_requests.erase(it);
+}
+void DebugClient::threadExecute()
+{
+   std::unique_lock<std::mutex> lock(m_mtx);
+   while (m_running)
+   {
+      auto now = std::chrono::steady_clock::now();
+      auto wake_up = now + std::chrono::seconds(1);
+      for (auto it = m_requests.begin(); it != m_requests.end();)
+      {
+         if (it->second.deadline <= now)
+         {
+            auto expired = it++;
+            complete(expired, DebugStatus::TIMEOUT, "");
+         }
+         else
+         {
+            wake_up = std::min(wake_up, it->second.deadline);
+            ++it;
+         }
+      }
+      m_cv.wait_until(lock, wake_up);
+   }
+}
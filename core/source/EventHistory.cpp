@@ -0,0 +1,399 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <chrono>
+#include <algorithm>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "EventHistory.h"
+#include "Logger.h"
+
+EventHistory::EventHistory():
+m_max_segments(std::max((size_t)1, (size_t)(HISTORY_DEFAULT_MEMORY_LIMIT / HISTORY_SEGMENT_SIZE))),
+m_count(0),
+m_memory_first(0),
+m_spilled(0),
+m_spill_fd(-1),
+m_spill_failed(false),
+m_map(nullptr),
+m_map_size(0),
+m_arena_first(0),
+m_arena_end(0),
+m_arena_spilled(0),
+m_arena_fd(-1),
+m_arena_map(nullptr),
+m_arena_map_size(0)
+{
+}
+EventHistory::~EventHistory()
+{
+   closeSpillFile();
+}
+void EventHistory::configure(const std::string& spill_path, size_t memory_limit)
+{
+   closeSpillFile();
+   clear();
+   m_max_segments = std::max((size_t)1, memory_limit / HISTORY_SEGMENT_SIZE);
+   if (m_slab.size() > m_max_segments)
+   {
+      /* all segments are free after clear() - release the ones above new limit */
+      m_slab.resize(m_max_segments);
+      m_free.clear();
+      for (auto& segment : m_slab)
+      {
+         m_free.push_back(segment.get());
+      }
+   }
+   m_spill_path = spill_path;
+   m_spill_failed = false;
+}
+HistoryRecord EventHistory::makeRecord(uint8_t id, uint16_t value, const uint8_t* payload, size_t size)
+{
+   HistoryRecord record = {};
+   record.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+   record.id = id;
+   record.value = value;
+   record.size = size;
+   if (size > HISTORY_PAYLOAD_SIZE)
+   {
+      record.flags |= HISTORY_FLAG_TRUNCATED;
+      size = HISTORY_PAYLOAD_SIZE;
+   }
+   if (payload && size > 0)
+   {
+      memcpy(record.payload, payload, size);
+   }
+   return record;
+}
+void EventHistory::push(uint8_t id, uint16_t value, const uint8_t* payload, size_t size)
+{
+   HistoryRecord record = makeRecord(id, value, payload, size);
+   uint8_t* stored = nullptr;
+   if ((record.flags & HISTORY_FLAG_TRUNCATED) && (stored = allocArena(size, record.arena_offset)))
+   {
+      record.flags = (record.flags & ~HISTORY_FLAG_TRUNCATED) | HISTORY_FLAG_EXTERNAL;
+      memcpy(stored, payload, size);
+   }
+   push(record);
+}
+void EventHistory::push(const HistoryRecord& record)
+{
+   size_t offset = (m_count - m_memory_first) % HISTORY_SEGMENT_RECORDS;
+   if (offset == 0 && (m_count - m_memory_first) == m_segments.size() * HISTORY_SEGMENT_RECORDS)
+   {
+      /* current segment full (or no segment yet) */
+      while (m_segments.size() + m_arena.size() >= m_max_segments)
+      {
+         if (m_segments.empty())
+         {
+            evictArenaSegment();
+         }
+         else
+         {
+            evictOldestSegment();
+         }
+      }
+      m_segments.push_back(takeSegment());
+   }
+   (*m_segments.back())[offset] = record;
+   m_count++;
+}
+EventHistory::Segment* EventHistory::takeSegment()
+{
+   if (m_free.empty())
+   {
+      m_slab.emplace_back(new Segment());
+      m_free.push_back(m_slab.back().get());
+   }
+   Segment* segment = m_free.back();
+   m_free.pop_back();
+   return segment;
+}
+uint8_t* EventHistory::allocArena(size_t size, uint64_t& offset)
+{
+   uint64_t arena_limit = m_arena_first + m_arena.size() * HISTORY_SEGMENT_SIZE;
+   if (size > HISTORY_SEGMENT_SIZE)
+   {
+      return nullptr;
+   }
+   if (m_arena_end + size > arena_limit)
+   {
+      /* payload is not split between segments - rest of the last segment stays unused */
+      while (m_segments.size() + m_arena.size() >= m_max_segments)
+      {
+         /* current record segment is kept, the record of this payload goes there */
+         if (m_segments.size() > 1)
+         {
+            evictOldestSegment();
+         }
+         else if (!m_arena.empty())
+         {
+            evictArenaSegment();
+         }
+         else
+         {
+            return nullptr;
+         }
+      }
+      m_arena_end = m_arena_first + m_arena.size() * HISTORY_SEGMENT_SIZE;
+      m_arena.push_back(takeSegment());
+   }
+   offset = m_arena_end;
+   m_arena_end += size;
+   return (uint8_t*)m_arena.back()->data() + (offset - m_arena_first) % HISTORY_SEGMENT_SIZE;
+}
+void EventHistory::evictOldestSegment()
+{
+   Segment* oldest = m_segments.front();
+   if (m_spill_fd < 0 && !m_spill_path.empty() && !m_spill_failed)
+   {
+      /* file created on first eviction - short tests do not leave empty spill files */
+      m_spill_fd = open(m_spill_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+      m_spill_failed = m_spill_fd < 0;
+      logger_send_if(m_spill_failed, TF_ERROR, __func__, "cannot create %s: %s", m_spill_path.c_str(), strerror(errno));
+   }
+   /* records are spilled only while file is contiguous with memory - after first drop everything is dropped */
+   if (m_spill_fd >= 0 && m_spilled == m_memory_first)
+   {
+      ssize_t written = pwrite(m_spill_fd, oldest->data(), HISTORY_SEGMENT_SIZE, m_spilled * sizeof(HistoryRecord));
+      if (written == (ssize_t)HISTORY_SEGMENT_SIZE)
+      {
+         m_spilled += HISTORY_SEGMENT_RECORDS;
+      }
+      else
+      {
+         logger_send(TF_ERROR, __func__, "cannot write %s, records will be dropped", m_spill_path.c_str());
+      }
+   }
+   /* payloads are stored in order of records - arena segments before the last payload of evicted records are not needed */
+   uint64_t end = m_arena_first;
+   for (const HistoryRecord& record : *oldest)
+   {
+      if (record.flags & HISTORY_FLAG_EXTERNAL)
+      {
+         end = record.arena_offset + record.size;
+      }
+   }
+   while (!m_arena.empty() && m_arena_first + HISTORY_SEGMENT_SIZE <= end)
+   {
+      evictArenaSegment();
+   }
+   m_memory_first += HISTORY_SEGMENT_RECORDS;
+   m_segments.erase(m_segments.begin());
+   m_free.push_back(oldest);
+}
+void EventHistory::evictArenaSegment()
+{
+   Segment* oldest = m_arena.front();
+   if (m_arena_fd < 0 && !m_spill_path.empty() && !m_spill_failed && m_arena_spilled == 0 && m_arena_first == 0)
+   {
+      std::string arena_path = m_spill_path + ".payload";
+      m_arena_fd = open(arena_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+      logger_send_if(m_arena_fd < 0, TF_ERROR, __func__, "cannot create %s: %s", arena_path.c_str(), strerror(errno));
+   }
+   /* payloads are spilled only while file is contiguous with memory, as records */
+   if (m_arena_fd >= 0 && m_arena_spilled == m_arena_first)
+   {
+      if (pwrite(m_arena_fd, oldest->data(), HISTORY_SEGMENT_SIZE, m_arena_first) == (ssize_t)HISTORY_SEGMENT_SIZE)
+      {
+         m_arena_spilled += HISTORY_SEGMENT_SIZE;
+      }
+      else
+      {
+         logger_send(TF_ERROR, __func__, "cannot write %s.payload, long payloads will be lost", m_spill_path.c_str());
+      }
+   }
+   m_arena_first += HISTORY_SEGMENT_SIZE;
+   m_arena_end = std::max(m_arena_end, m_arena_first);
+   m_arena.pop_front();
+   m_free.push_back(oldest);
+}
+bool EventHistory::mapSpilledRecords()
+{
+   size_t required = m_spilled * sizeof(HistoryRecord);
+   if (m_map_size < required)
+   {
+      if (m_map)
+      {
+         munmap(m_map, m_map_size);
+         m_map = nullptr;
+         m_map_size = 0;
+      }
+      void* map = mmap(NULL, required, PROT_READ, MAP_SHARED, m_spill_fd, 0);
+      if (map == MAP_FAILED)
+      {
+         logger_send(TF_ERROR, __func__, "cannot map %s: %s", m_spill_path.c_str(), strerror(errno));
+         return false;
+      }
+      m_map = (uint8_t*)map;
+      m_map_size = required;
+   }
+   return true;
+}
+bool EventHistory::get(size_t idx, HistoryRecord& record)
+{
+   bool result = false;
+   if (idx >= m_memory_first && idx < m_count)
+   {
+      size_t mem_idx = idx - m_memory_first;
+      record = (*m_segments[mem_idx / HISTORY_SEGMENT_RECORDS])[mem_idx % HISTORY_SEGMENT_RECORDS];
+      result = true;
+   }
+   else if (idx < m_spilled && mapSpilledRecords())
+   {
+      memcpy(&record, m_map + idx * sizeof(HistoryRecord), sizeof(HistoryRecord));
+      result = true;
+   }
+   return result;
+}
+bool EventHistory::mapSpilledArena()
+{
+   if (m_arena_map_size < m_arena_spilled)
+   {
+      if (m_arena_map)
+      {
+         munmap(m_arena_map, m_arena_map_size);
+         m_arena_map = nullptr;
+         m_arena_map_size = 0;
+      }
+      void* map = mmap(NULL, m_arena_spilled, PROT_READ, MAP_SHARED, m_arena_fd, 0);
+      if (map == MAP_FAILED)
+      {
+         logger_send(TF_ERROR, __func__, "cannot map %s.payload: %s", m_spill_path.c_str(), strerror(errno));
+         return false;
+      }
+      m_arena_map = (uint8_t*)map;
+      m_arena_map_size = m_arena_spilled;
+   }
+   return true;
+}
+const HistoryRecord* EventHistory::at(size_t idx)
+{
+   const HistoryRecord* result = nullptr;
+   if (idx >= m_memory_first && idx < m_count)
+   {
+      size_t mem_idx = idx - m_memory_first;
+      result = &(*m_segments[mem_idx / HISTORY_SEGMENT_RECORDS])[mem_idx % HISTORY_SEGMENT_RECORDS];
+   }
+   else if (idx < m_spilled && mapSpilledRecords())
+   {
+      result = (const HistoryRecord*)(m_map + idx * sizeof(HistoryRecord));
+   }
+   return result;
+}
+const uint8_t* EventHistory::payload(const HistoryRecord& record)
+{
+   const uint8_t* result = nullptr;
+   if (!(record.flags & (HISTORY_FLAG_EXTERNAL | HISTORY_FLAG_TRUNCATED)))
+   {
+      result = record.payload;
+   }
+   else if (record.flags & HISTORY_FLAG_EXTERNAL)
+   {
+      if (record.arena_offset >= m_arena_first && record.arena_offset + record.size <= m_arena_end)
+      {
+         uint64_t position = record.arena_offset - m_arena_first;
+         result = (const uint8_t*)m_arena[position / HISTORY_SEGMENT_SIZE]->data() + position % HISTORY_SEGMENT_SIZE;
+      }
+      else if (record.arena_offset + record.size <= m_arena_spilled && mapSpilledArena())
+      {
+         result = m_arena_map + record.arena_offset;
+      }
+   }
+   return result;
+}
+const HistoryRecord* EventHistory::back() const
+{
+   const HistoryRecord* result = nullptr;
+   if (m_count > m_memory_first)
+   {
+      size_t mem_idx = m_count - 1 - m_memory_first;
+      result = &(*m_segments[mem_idx / HISTORY_SEGMENT_RECORDS])[mem_idx % HISTORY_SEGMENT_RECORDS];
+   }
+   return result;
+}
+size_t EventHistory::size() const
+{
+   return m_count;
+}
+bool EventHistory::empty() const
+{
+   return m_count == 0;
+}
+size_t EventHistory::spilledCount() const
+{
+   return m_spilled;
+}
+size_t EventHistory::droppedCount() const
+{
+   return m_memory_first - m_spilled;
+}
+size_t EventHistory::memoryUsage() const
+{
+   return m_slab.size() * HISTORY_SEGMENT_SIZE;
+}
+void EventHistory::clear()
+{
+   m_free.insert(m_free.end(), m_segments.begin(), m_segments.end());
+   m_segments.clear();
+   m_count = 0;
+   m_memory_first = 0;
+   m_spilled = 0;
+   m_free.insert(m_free.end(), m_arena.begin(), m_arena.end());
+   m_arena.clear();
+   m_arena_first = 0;
+   m_arena_end = 0;
+   m_arena_spilled = 0;
+   if (m_map)
+   {
+      munmap(m_map, m_map_size);
+      m_map = nullptr;
+      m_map_size = 0;
+   }
+   if (m_arena_map)
+   {
+      munmap(m_arena_map, m_arena_map_size);
+      m_arena_map = nullptr;
+      m_arena_map_size = 0;
+   }
+   if (m_spill_fd >= 0 && ftruncate(m_spill_fd, 0) != 0)
+   {
+      logger_send(TF_ERROR, __func__, "cannot truncate %s", m_spill_path.c_str());
+   }
+   if (m_arena_fd >= 0 && ftruncate(m_arena_fd, 0) != 0)
+   {
+      logger_send(TF_ERROR, __func__, "cannot truncate %s.payload", m_spill_path.c_str());
+   }
+}
+void EventHistory::closeSpillFile()
+{
+   if (m_map)
+   {
+      munmap(m_map, m_map_size);
+      m_map = nullptr;
+      m_map_size = 0;
+   }
+   if (m_spill_fd >= 0)
+   {
+      close(m_spill_fd);
+      m_spill_fd = -1;
+   }
+   if (m_arena_map)
+   {
+      munmap(m_arena_map, m_arena_map_size);
+      m_arena_map = nullptr;
+      m_arena_map_size = 0;
+   }
+   if (m_arena_fd >= 0)
+   {
+      close(m_arena_fd);
+      m_arena_fd = -1;
+   }
+}
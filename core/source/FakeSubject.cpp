@@ -0,0 +1,635 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "FakeSubject.h"
+#include "HwStubEncoder.h"
+#include "SocketDriver.h"
+#include "system_config_values.h"
+#include "Logger.h"
+
+namespace
+{
+std::atomic<bool> g_child_stop_request(false);
+
+void child_signal_handler(int)
+{
+   g_child_stop_request = true;
+}
+
+uint32_t next_random(uint32_t& state)
+{
+   /* xorshift32 - cheap and reproducible for given seed */
+   state ^= state << 13;
+   state ^= state >> 17;
+   state ^= state << 5;
+   return state;
+}
+
+}
+
+FakeSubject::FakeSubject():
+m_address(""),
+m_thread_running(false),
+m_logging(true),
+m_sampled_inputs(0xFFFF),
+m_sent_frames(0),
+m_recv_frames(0)
+{
+   setPorts(HW_STUB_CONTROL_PORT, BLUETOOTH_FORWARDING_PORT, WIFI_NTF_FORWARDING_PORT);
+   for (int& fd : m_fds)
+   {
+      fd = -1;
+   }
+   for (TrafficGenerator& traffic : m_traffic)
+   {
+      traffic.frames_per_s = 0;
+      traffic.counter = 0;
+   }
+   m_i2c_states[RELAYS_I2C_ADDRESS] = 0xFFFF;
+   m_i2c_states[INPUTS_I2C_ADDRESS] = 0xFFFF;
+}
+FakeSubject::~FakeSubject()
+{
+   stop();
+}
+void FakeSubject::addBehavior(const FakeBehavior& behavior)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   m_behaviors.push_back(behavior);
+}
+void FakeSubject::clearBehaviors()
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   m_behaviors.clear();
+}
+void FakeSubject::setTraffic(FakeTraffic traffic, uint32_t frames_per_s, const std::vector<uint8_t>& payload)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   TrafficGenerator& generator = m_traffic[(size_t)traffic];
+   generator.frames_per_s = frames_per_s;
+   generator.payload = payload;
+   generator.next = std::chrono::steady_clock::now();
+}
+void FakeSubject::setPorts(uint16_t hw_stub, uint16_t bluetooth, uint16_t app_ntf)
+{
+   m_ports[CHANNEL_HW_STUB] = hw_stub;
+   m_ports[CHANNEL_BLUETOOTH] = bluetooth;
+   m_ports[CHANNEL_APP_NTF] = app_ntf;
+}
+void FakeSubject::addDebugResponse(const std::string& command, const std::string& response, uint32_t delay_ms)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   m_debug_responses[command] = {response, delay_ms};
+}
+bool FakeSubject::start(const std::string& ip_address)
+{
+   bool result = false;
+   if (!m_thread_running)
+   {
+      m_address = ip_address;
+      m_thread_running = true;
+      m_thread = std::thread(&FakeSubject::threadExecute, this);
+      result = true;
+   }
+   logger_send_if(m_logging, TF_FAKE, __func__, "started => %u", result);
+   return result;
+}
+void FakeSubject::stop()
+{
+   if (m_thread_running)
+   {
+      m_thread_running = false;
+      m_thread.join();
+      logger_send_if(m_logging, TF_FAKE, __func__, "stopped, sent %lu, received %lu", (unsigned long)m_sent_frames, (unsigned long)m_recv_frames);
+   }
+}
+bool FakeSubject::isConnected()
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   return m_fds[CHANNEL_HW_STUB] >= 0 && m_fds[CHANNEL_BLUETOOTH] >= 0 && m_fds[CHANNEL_APP_NTF] >= 0;
+}
+int FakeSubject::runAsChild()
+{
+   /* logger state is inherited from parent process - do not touch it */
+   m_logging = false;
+   signal(SIGINT, child_signal_handler);
+   signal(SIGTERM, child_signal_handler);
+   start();
+   while (!g_child_stop_request)
+   {
+      std::this_thread::sleep_for(std::chrono::milliseconds(FAKE_RECONNECT_PERIOD_MS));
+   }
+   stop();
+   return 0;
+}
+uint16_t FakeSubject::getI2CState(uint8_t address)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   auto it = m_i2c_states.find(address);
+   return it != m_i2c_states.end()? it->second : 0xFFFF;
+}
+uint64_t FakeSubject::sentFrames()
+{
+   return m_sent_frames;
+}
+uint64_t FakeSubject::receivedFrames()
+{
+   return m_recv_frames;
+}
+void FakeSubject::threadExecute()
+{
+   std::vector<uint8_t> frame;
+   frame.reserve(SOCKDRV_RECV_BUFFER_SIZE + 1);
+   auto last_connect = std::chrono::steady_clock::time_point();
+
+   while (m_thread_running)
+   {
+      auto now = std::chrono::steady_clock::now();
+      if ((now - last_connect) >= std::chrono::milliseconds(FAKE_RECONNECT_PERIOD_MS))
+      {
+         connectChannels();
+         last_connect = now;
+      }
+
+      struct pollfd fds [CHANNEL_COUNT];
+      Channel channels [CHANNEL_COUNT];
+      nfds_t fds_count = 0;
+      {
+         std::lock_guard<std::mutex> lock(m_mtx);
+         for (uint8_t i = 0; i < CHANNEL_COUNT; i++)
+         {
+            if (m_fds[i] >= 0)
+            {
+               fds[fds_count].fd = m_fds[i];
+               fds[fds_count].events = POLLIN;
+               fds[fds_count].revents = 0;
+               channels[fds_count++] = (Channel)i;
+            }
+         }
+      }
+
+      if (poll(fds, fds_count, nextTimeout(now)) > 0)
+      {
+         for (nfds_t i = 0; i < fds_count; i++)
+         {
+            if (fds[i].revents == 0)
+            {
+               continue;
+            }
+            if (!readFrame(channels[i], frame))
+            {
+               closeChannel(channels[i]);
+            }
+            else if (channels[i] == CHANNEL_HW_STUB)
+            {
+               onHwStubFrame(frame);
+            }
+            else if (channels[i] == CHANNEL_BLUETOOTH)
+            {
+               onDebugCommand(frame);
+            }
+         }
+      }
+
+      now = std::chrono::steady_clock::now();
+      while (!m_transfers.empty() && m_transfers.begin()->first <= now)
+      {
+         I2CTransfer transfer = m_transfers.begin()->second;
+         m_transfers.erase(m_transfers.begin());
+         completeTransfer(transfer);
+      }
+      while (!m_pending.empty() && m_pending.begin()->first <= now)
+      {
+         FakeAction action = m_pending.begin()->second;
+         m_pending.erase(m_pending.begin());
+         executeAction(action);
+      }
+      generateTraffic(now);
+   }
+
+   for (uint8_t i = 0; i < CHANNEL_COUNT; i++)
+   {
+      closeChannel((Channel)i);
+   }
+   m_pending.clear();
+   m_transfers.clear();
+   m_i2c_bus.clear();
+}
+int FakeSubject::nextTimeout(std::chrono::steady_clock::time_point now)
+{
+   auto deadline = now + std::chrono::milliseconds(FAKE_RECONNECT_PERIOD_MS);
+   if (!m_pending.empty() && m_pending.begin()->first < deadline)
+   {
+      deadline = m_pending.begin()->first;
+   }
+   if (!m_transfers.empty() && m_transfers.begin()->first < deadline)
+   {
+      deadline = m_transfers.begin()->first;
+   }
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      for (TrafficGenerator& traffic : m_traffic)
+      {
+         if (traffic.frames_per_s > 0 && traffic.next < deadline)
+         {
+            deadline = traffic.next;
+         }
+      }
+   }
+   /* rounded up - transfers are shorter than millisecond, poll shall not spin until they complete */
+   return deadline > now? std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count() : 0;
+}
+void FakeSubject::connectChannels()
+{
+   for (uint8_t i = 0; i < CHANNEL_COUNT; i++)
+   {
+      {
+         std::lock_guard<std::mutex> lock(m_mtx);
+         if (m_fds[i] >= 0)
+         {
+            continue;
+         }
+      }
+      int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+      if (fd < 0)
+      {
+         continue;
+      }
+      struct sockaddr_in addr = {};
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(m_ports[i]);
+      inet_pton(AF_INET, m_address.c_str(), &addr.sin_addr);
+      if (::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+      {
+         ::close(fd);
+         continue;
+      }
+      logger_send_if(m_logging, TF_FAKE, __func__, "[%d] connected", m_ports[i]);
+      std::lock_guard<std::mutex> lock(m_mtx);
+      m_fds[i] = fd;
+   }
+}
+void FakeSubject::closeChannel(Channel ch)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   if (m_fds[ch] >= 0)
+   {
+      ::close(m_fds[ch]);
+      m_fds[ch] = -1;
+   }
+}
+bool FakeSubject::readFrame(Channel ch, std::vector<uint8_t>& frame)
+{
+   bool result = false;
+   char header [SOCK_MSG_HEADER_SIZE + 1];
+   if (recv(m_fds[ch], header, SOCK_MSG_HEADER_SIZE, MSG_WAITALL) == SOCK_MSG_HEADER_SIZE)
+   {
+      header[SOCK_MSG_HEADER_SIZE] = 0x00;
+      size_t size = atoi(header);
+      if (size <= SOCKDRV_RECV_BUFFER_SIZE)
+      {
+         frame.resize(size);
+         result = size == 0 || recv(m_fds[ch], frame.data(), size, MSG_WAITALL) == (ssize_t)size;
+         m_recv_frames++;
+      }
+   }
+   return result;
+}
+bool FakeSubject::sendFrame(Channel ch, const char* data, size_t size)
+{
+   bool result = false;
+   char buffer [SOCK_MSG_HEADER_SIZE + SOCKDRV_MAX_RW_SIZE + 1];
+   if (m_fds[ch] >= 0 && size <= SOCKDRV_MAX_RW_SIZE)
+   {
+      /* header and data in one write, so server will never see partial frame */
+      snprintf(buffer, sizeof(buffer), "%.4u", (unsigned)size);
+      memcpy(buffer + SOCK_MSG_HEADER_SIZE, data, size);
+      result = ::send(m_fds[ch], buffer, SOCK_MSG_HEADER_SIZE + size, MSG_NOSIGNAL) == (ssize_t)(SOCK_MSG_HEADER_SIZE + size);
+      m_sent_frames++;
+   }
+   return result;
+}
+void FakeSubject::sendBytes(Channel ch, const std::vector<uint8_t>& bytes)
+{
+   char formatted [SOCKDRV_MAX_RW_SIZE];
+   size_t idx = 0;
+   for (uint8_t byte : bytes)
+   {
+      if (idx + 4 >= sizeof(formatted))
+      {
+         break;
+      }
+      idx += snprintf(formatted + idx, sizeof(formatted) - idx, "%u ", byte);
+   }
+   if (idx > 0)
+   {
+      sendFrame(ch, formatted, idx - 1);
+   }
+}
+void FakeSubject::onHwStubFrame(const std::vector<uint8_t>& frame)
+{
+   std::vector<uint8_t> bytes;
+   std::string text(frame.begin(), frame.end());
+   char* pos = (char*)text.c_str();
+   char* end = nullptr;
+   while (true)
+   {
+      long value = strtol(pos, &end, 10);
+      if (end == pos)
+      {
+         break;
+      }
+      bytes.push_back((uint8_t)value);
+      pos = end;
+   }
+   if (bytes.size() < 2 || bytes[1] != bytes.size() - 2)
+   {
+      logger_send_if(m_logging, TF_FAKE, __func__, "incomplete data");
+      return;
+   }
+
+   switch ((HW_STUB_EVENT_ID)bytes[0])
+   {
+   case I2C_STATE_SET:
+      if (bytes.size() == 5)
+      {
+         std::lock_guard<std::mutex> lock(m_mtx);
+         m_i2c_states[bytes[2]] = bytes[3] | (bytes[4] << 8);
+      }
+      break;
+   case DHT_STATE_SET:
+      if (bytes.size() == 8)
+      {
+         onSensorUpdate(bytes[2], bytes[6]);
+      }
+      break;
+   case I2C_INT_TRIGGER:
+      onInterrupt();
+      break;
+   case I2C_BUS_SET:
+      if (bytes.size() == hw_stub::FrameTraits<I2C_BUS_SET>::LENGTH + 2)
+      {
+         I2CBusDevice& device = m_i2c_bus[bytes[2]];
+         device.model = hw_stub::decode_bus_model(&bytes[3]);
+         device.random = 0x9E3779B9 ^ device.model.seed;
+      }
+      break;
+   case I2C_RESULT_SET:
+      if (bytes.size() == 5 && bytes[3] < I2C_RESULT_COUNT)
+      {
+         I2CBusDevice& device = m_i2c_bus[bytes[2]];
+         device.forced_result = (I2C_RESULT)bytes[3];
+         device.forced_count = bytes[4];
+      }
+      break;
+   default:
+      break;
+   }
+}
+void FakeSubject::onDebugCommand(const std::vector<uint8_t>& frame)
+{
+   std::string text(frame.begin(), frame.end());
+   size_t separator = text.find(' ');
+   if (text.empty() || text[0] != '#' || separator == std::string::npos)
+   {
+      logger_send_if(m_logging, TF_FAKE, __func__, "invalid debug command");
+      return;
+   }
+   std::string command = text.substr(separator + 1);
+   std::string response = FAKE_DEBUG_UNKNOWN_RESPONSE;
+   uint32_t delay_ms = 0;
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      auto it = m_debug_responses.find(command);
+      if (it != m_debug_responses.end())
+      {
+         response = it->second.first;
+         delay_ms = it->second.second;
+      }
+   }
+   /* response is sent as LOG action, so delayed responses do not block the others */
+   response = text.substr(0, separator + 1) + response;
+   FakeAction action = {FakeActionType::LOG, delay_ms, 0, 0, std::vector<uint8_t>(response.begin(), response.end())};
+   if (delay_ms == 0)
+   {
+      executeAction(action);
+   }
+   else
+   {
+      m_pending.insert({std::chrono::steady_clock::now() + std::chrono::milliseconds(delay_ms), action});
+   }
+}
+void FakeSubject::onInterrupt()
+{
+   startTransfer(INPUTS_I2C_ADDRESS, true, 0);
+}
+void FakeSubject::sampleInputs()
+{
+   std::vector<FakeBehavior> to_fire;
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      uint16_t inputs = m_i2c_states[INPUTS_I2C_ADDRESS];
+      for (const FakeBehavior& behavior : m_behaviors)
+      {
+         uint16_t mask = hw_stub::input_mask((INPUT_ID)behavior.id);
+         /* inputs are active low */
+         bool was_active = !(m_sampled_inputs & mask);
+         bool is_active = !(inputs & mask);
+         if ((behavior.trigger == FakeTrigger::INPUT_ACTIVATED && !was_active && is_active) ||
+             (behavior.trigger == FakeTrigger::INPUT_DEACTIVATED && was_active && !is_active))
+         {
+            to_fire.push_back(behavior);
+         }
+      }
+      m_sampled_inputs = inputs;
+   }
+   for (const FakeBehavior& behavior : to_fire)
+   {
+      fireBehavior(behavior);
+   }
+}
+void FakeSubject::onSensorUpdate(uint8_t id, uint8_t humidity)
+{
+   std::vector<FakeBehavior> to_fire;
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      uint8_t previous = m_humidity[id];
+      for (const FakeBehavior& behavior : m_behaviors)
+      {
+         if (behavior.id != id)
+         {
+            continue;
+         }
+         if ((behavior.trigger == FakeTrigger::HUMIDITY_ABOVE && previous <= behavior.threshold && humidity > behavior.threshold) ||
+             (behavior.trigger == FakeTrigger::HUMIDITY_BELOW && previous >= behavior.threshold && humidity < behavior.threshold))
+         {
+            to_fire.push_back(behavior);
+         }
+      }
+      m_humidity[id] = humidity;
+   }
+   for (const FakeBehavior& behavior : to_fire)
+   {
+      fireBehavior(behavior);
+   }
+}
+void FakeSubject::fireBehavior(const FakeBehavior& behavior)
+{
+   auto now = std::chrono::steady_clock::now();
+   for (const FakeAction& action : behavior.actions)
+   {
+      m_pending.insert({now + std::chrono::milliseconds(action.delay_ms), action});
+   }
+}
+void FakeSubject::executeAction(const FakeAction& action)
+{
+   switch(action.type)
+   {
+   case FakeActionType::RELAY_SET:
+   {
+      uint16_t state = getI2CState(RELAYS_I2C_ADDRESS);
+      uint16_t mask = hw_stub::relay_mask((RELAY_ID)action.id);
+      /* relays are active low */
+      state = action.value == RELAY_STATE_ON? (state & ~mask) : (state | mask);
+      writeI2C(RELAYS_I2C_ADDRESS, state);
+   }
+   break;
+   case FakeActionType::I2C_WRITE:
+      writeI2C(action.id, action.value);
+      break;
+   case FakeActionType::APP_NTF:
+      sendBytes(CHANNEL_APP_NTF, action.payload);
+      break;
+   case FakeActionType::LOG:
+      sendFrame(CHANNEL_BLUETOOTH, (const char*)action.payload.data(), action.payload.size());
+      break;
+   default:
+      break;
+   }
+}
+void FakeSubject::writeI2C(uint8_t address, uint16_t state)
+{
+   startTransfer(address, false, state);
+}
+void FakeSubject::startTransfer(uint8_t address, bool read, uint16_t state)
+{
+   I2CTransfer transfer = {address, read, state, I2C_RESULT_OK, 0};
+   auto it = m_i2c_bus.find(address);
+   if (it == m_i2c_bus.end())
+   {
+      completeTransfer(transfer);
+      return;
+   }
+   I2CBusDevice& device = it->second;
+   const I2CBusModel& model = device.model;
+   if (device.forced_count > 0)
+   {
+      transfer.result = device.forced_result;
+      device.forced_count--;
+   }
+   else if (model.nack_permille > 0 || model.error_permille > 0)
+   {
+      uint32_t draw = next_random(device.random) % 1000;
+      transfer.result = draw < model.nack_permille? I2C_RESULT_NACK :
+                        draw < (uint32_t)model.nack_permille + model.error_permille? I2C_RESULT_BUS_ERROR : I2C_RESULT_OK;
+   }
+   /* NACK ends transaction after address byte, clock is stretched only by device which answers */
+   transfer.duration_us = hw_stub::i2c_transfer_us(model, transfer.result == I2C_RESULT_NACK? 1 : hw_stub::I2C_BOARD_TRANSFER_BYTES);
+   if (model.stretch_us > 0 && transfer.result != I2C_RESULT_NACK)
+   {
+      transfer.duration_us += next_random(device.random) % (model.stretch_us + 1);
+   }
+
+   /* one transaction on the bus at a time */
+   auto start = std::max(std::chrono::steady_clock::now(), m_bus_free);
+   m_bus_free = start + std::chrono::microseconds(transfer.duration_us);
+   m_transfers.insert({m_bus_free, transfer});
+}
+void FakeSubject::completeTransfer(const I2CTransfer& transfer)
+{
+   /* result reported before the state, so framework has statistics updated when it sees the new state */
+   if (m_i2c_bus.count(transfer.address) > 0)
+   {
+      hw_stub::Frame<I2C_TRANSFER_NTF> frame = hw_stub::make_transfer_frame(transfer.address, transfer.read, transfer.result, transfer.duration_us);
+      char text [hw_stub::text_size<frame.size()>()];
+      sendFrame(CHANNEL_HW_STUB, text, hw_stub::encode(frame, text));
+   }
+   if (transfer.result != I2C_RESULT_OK)
+   {
+      return;
+   }
+   if (transfer.read)
+   {
+      sampleInputs();
+   }
+   else
+   {
+      {
+         std::lock_guard<std::mutex> lock(m_mtx);
+         m_i2c_states[transfer.address] = transfer.state;
+      }
+      hw_stub::Frame<I2C_STATE_NTF> frame = hw_stub::make_i2c_frame<I2C_STATE_NTF>(transfer.address, transfer.state);
+      char text [hw_stub::text_size<frame.size()>()];
+      sendFrame(CHANNEL_HW_STUB, text, hw_stub::encode(frame, text));
+   }
+}
+void FakeSubject::generateTraffic(std::chrono::steady_clock::time_point now)
+{
+   for (uint8_t type = 0; type < (uint8_t)FakeTraffic::COUNT; type++)
+   {
+      std::vector<uint8_t> payload;
+      uint32_t frames = 0;
+      uint16_t counter = 0;
+      {
+         std::lock_guard<std::mutex> lock(m_mtx);
+         TrafficGenerator& traffic = m_traffic[type];
+         if (traffic.frames_per_s == 0)
+         {
+            continue;
+         }
+         auto period = std::chrono::nanoseconds(1000000000ULL / traffic.frames_per_s);
+         while (traffic.next <= now && frames < FAKE_MAX_TRAFFIC_BURST)
+         {
+            traffic.next += period;
+            frames++;
+         }
+         if (traffic.next <= now)
+         {
+            /* cannot keep up with requested rate - do not accumulate the backlog */
+            traffic.next = now + period;
+         }
+         payload = traffic.payload;
+         counter = traffic.counter;
+         traffic.counter += frames;
+      }
+      for (uint32_t i = 0; i < frames; i++)
+      {
+         switch((FakeTraffic)type)
+         {
+         case FakeTraffic::LOGS:
+            sendFrame(CHANNEL_BLUETOOTH, (const char*)payload.data(), payload.size());
+            break;
+         case FakeTraffic::APP_NTF:
+            sendBytes(CHANNEL_APP_NTF, payload);
+            break;
+         case FakeTraffic::I2C_NTF:
+            writeI2C(payload.empty()? SLM_I2C_ADDRESS : payload[0], (uint16_t)(counter + i));
+            break;
+         default:
+            break;
+         }
+      }
+   }
+}
@@ -0,0 +1,217 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <stdio.h>
+#include <algorithm>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "LatencyTracker.h"
+#include "Logger.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define LATENCY_LINEAR_LIMIT (1ULL << (LATENCY_SUB_BUCKET_BITS + 1))
+#define LATENCY_SUB_BUCKETS (1ULL << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_BUCKETS_COUNT (LATENCY_LINEAR_LIMIT + (LATENCY_MAX_EXPONENT - LATENCY_SUB_BUCKET_BITS) * LATENCY_SUB_BUCKETS)
+
+namespace
+{
+const char* stimulus_to_string(StimulusType stimulus)
+{
+   switch(stimulus)
+   {
+   case StimulusType::RELAY_SET: return "RELAY_SET";
+   case StimulusType::INPUT_SET: return "INPUT_SET";
+   case StimulusType::SENSOR_SET: return "SENSOR_SET";
+   case StimulusType::INT_TRIGGER: return "INT_TRIGGER";
+   default: return "UNKNOWN";
+   }
+}
+const char* response_to_string(ResponseType response)
+{
+   switch(response)
+   {
+   case ResponseType::I2C_STATE: return "I2C_STATE";
+   case ResponseType::APP_NTF: return "APP_NTF";
+   default: return "UNKNOWN";
+   }
+}
+}
+
+LatencyHistogram::LatencyHistogram():
+m_counts(LATENCY_BUCKETS_COUNT, 0),
+m_count(0),
+m_min(UINT64_MAX),
+m_max(0),
+m_sum(0)
+{
+}
+size_t LatencyHistogram::bucketIndex(uint64_t value)
+{
+   size_t result = value;
+   if (value >= LATENCY_LINEAR_LIMIT)
+   {
+      /* exponent selects the power of two, top bits of value select linear sub-bucket */
+      uint32_t exponent = 63 - __builtin_clzll(value);
+      uint32_t shift = exponent - LATENCY_SUB_BUCKET_BITS;
+      uint64_t mantissa = value >> shift;
+      result = LATENCY_LINEAR_LIMIT + (exponent - LATENCY_SUB_BUCKET_BITS - 1) * LATENCY_SUB_BUCKETS + (mantissa - LATENCY_SUB_BUCKETS);
+   }
+   return std::min(result, (size_t)LATENCY_BUCKETS_COUNT - 1);
+}
+uint64_t LatencyHistogram::bucketHighestValue(size_t idx)
+{
+   uint64_t result = idx;
+   if (idx >= LATENCY_LINEAR_LIMIT)
+   {
+      uint32_t exponent = (idx - LATENCY_LINEAR_LIMIT) / LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKET_BITS + 1;
+      uint64_t mantissa = (idx - LATENCY_LINEAR_LIMIT) % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS;
+      uint32_t shift = exponent - LATENCY_SUB_BUCKET_BITS;
+      result = (mantissa << shift) + (1ULL << shift) - 1;
+   }
+   return result;
+}
+void LatencyHistogram::record(uint64_t value_us)
+{
+   m_counts[bucketIndex(value_us)]++;
+   m_count++;
+   m_sum += value_us;
+   m_min = std::min(m_min, value_us);
+   m_max = std::max(m_max, value_us);
+}
+void LatencyHistogram::clear()
+{
+   std::fill(m_counts.begin(), m_counts.end(), 0);
+   m_count = 0;
+   m_min = UINT64_MAX;
+   m_max = 0;
+   m_sum = 0;
+}
+uint64_t LatencyHistogram::count() const
+{
+   return m_count;
+}
+uint64_t LatencyHistogram::min() const
+{
+   return m_count > 0? m_min : 0;
+}
+uint64_t LatencyHistogram::max() const
+{
+   return m_max;
+}
+double LatencyHistogram::mean() const
+{
+   return m_count > 0? (double)m_sum / m_count : 0.0;
+}
+uint64_t LatencyHistogram::percentile(double percentile) const
+{
+   uint64_t result = 0;
+   if (m_count > 0)
+   {
+      uint64_t threshold = std::max((uint64_t)1, (uint64_t)((percentile / 100.0) * m_count + 0.5));
+      uint64_t cumulative = 0;
+      for (size_t i = 0; i < m_counts.size(); i++)
+      {
+         cumulative += m_counts[i];
+         if (cumulative >= threshold)
+         {
+            result = std::min(bucketHighestValue(i), m_max);
+            break;
+         }
+      }
+   }
+   return result;
+}
+
+LatencyTracker::LatencyTracker()
+{
+}
+void LatencyTracker::addPair(const std::string& name, StimulusType stimulus, ResponseType response, uint8_t response_id)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   LatencyPair pair;
+   pair.name = name;
+   pair.stimulus = stimulus;
+   pair.response = response;
+   pair.response_id = response_id;
+   pair.armed = false;
+   pair.unanswered = 0;
+   m_pairs.push_back(pair);
+}
+void LatencyTracker::clear()
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   m_pairs.clear();
+}
+LatencyHistogram LatencyTracker::getHistogram(const std::string& name)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   for (LatencyPair& pair : m_pairs)
+   {
+      if (pair.name == name)
+      {
+         return pair.histogram;
+      }
+   }
+   return LatencyHistogram();
+}
+void LatencyTracker::onStimulus(StimulusType stimulus, std::chrono::steady_clock::time_point timestamp)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   for (LatencyPair& pair : m_pairs)
+   {
+      if (pair.stimulus == stimulus)
+      {
+         if (pair.armed)
+         {
+            pair.unanswered++;
+         }
+         pair.armed = true;
+         pair.stimulus_time = timestamp;
+      }
+   }
+}
+void LatencyTracker::onResponse(ResponseType response, uint8_t id, std::chrono::steady_clock::time_point timestamp)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   for (LatencyPair& pair : m_pairs)
+   {
+      if (pair.armed && pair.response == response && pair.response_id == id && timestamp >= pair.stimulus_time)
+      {
+         pair.histogram.record(std::chrono::duration_cast<std::chrono::microseconds>(timestamp - pair.stimulus_time).count());
+         pair.armed = false;
+      }
+   }
+}
+bool LatencyTracker::exportJson(const std::string& file_path, const std::string& test_name)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   if (m_pairs.empty())
+   {
+      return true;
+   }
+   FILE* file = fopen(file_path.c_str(), "w");
+   if (!file)
+   {
+      logger_send(TF_ERROR, __func__, "cannot create %s", file_path.c_str());
+      return false;
+   }
+
+   fprintf(file, "{\n  \"test\": \"%s\",\n  \"unit\": \"us\",\n  \"pairs\": [", test_name.c_str());
+   for (size_t i = 0; i < m_pairs.size(); i++)
+   {
+      const LatencyPair& pair = m_pairs[i];
+      const LatencyHistogram& h = pair.histogram;
+      fprintf(file, "%s\n    {\"name\": \"%s\", \"stimulus\": \"%s\", \"response\": \"%s\", \"response_id\": %u, "
+                    "\"count\": %lu, \"unanswered\": %lu, \"min\": %lu, \"mean\": %.1f, "
+                    "\"p50\": %lu, \"p90\": %lu, \"p99\": %lu, \"p99.9\": %lu, \"max\": %lu}",
+                    i == 0? "" : ",", pair.name.c_str(), stimulus_to_string(pair.stimulus), response_to_string(pair.response), pair.response_id,
+                    (unsigned long)h.count(), (unsigned long)(pair.unanswered + (pair.armed? 1 : 0)), (unsigned long)h.min(), h.mean(),
+                    (unsigned long)h.percentile(50), (unsigned long)h.percentile(90), (unsigned long)h.percentile(99),
+                    (unsigned long)h.percentile(99.9), (unsigned long)h.max());
+   }
+   fprintf(file, "\n  ]\n}\n");
+   fclose(file);
+   return true;
+}
@@ -0,0 +1,277 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <stdio.h>
+#include <algorithm>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "LoadGenerator.h"
+#include "Logger.h"
+#include "TestWait.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define LOAD_LATE_THRESHOLD_US 1000
+
+namespace
+{
+const char* pattern_to_string(LoadPattern pattern)
+{
+   switch(pattern)
+   {
+   case LoadPattern::CONSTANT: return "CONSTANT";
+   case LoadPattern::BURST: return "BURST";
+   case LoadPattern::POISSON: return "POISSON";
+   default: return "UNKNOWN";
+   }
+}
+}
+
+LoadGenerator::LoadGenerator():
+m_running(false),
+m_events(0),
+m_send_failures(0),
+m_late_events(0),
+m_i2c_ntf(0),
+m_app_ntf(0),
+m_responses(0)
+{
+}
+LoadGenerator::~LoadGenerator()
+{
+   stop(0);
+}
+bool LoadGenerator::start(const LoadProfile& profile, LoadStimulus stimulus, LoadQueueProbe probe)
+{
+   bool result = false;
+   do
+   {
+      if (m_running)
+      {
+         logger_send(TF_ERROR, __func__, "load already running");
+         break;
+      }
+      if (profile.rate_per_s == 0 || profile.inputs.empty() || !stimulus)
+      {
+         logger_send(TF_ERROR, __func__, "invalid profile, rate %u, inputs %u", profile.rate_per_s, profile.inputs.size());
+         break;
+      }
+      m_profile = profile;
+      m_profile.burst_size = std::max(profile.burst_size, (uint32_t)1);
+      m_stimulus = stimulus;
+      m_probe = probe;
+      m_random.seed(profile.seed);
+      m_events = 0;
+      m_send_failures = 0;
+      m_late_events = 0;
+      m_i2c_ntf = 0;
+      m_app_ntf = 0;
+      m_responses = 0;
+      m_samples.clear();
+      m_start = std::chrono::steady_clock::now();
+      m_generation_end = profile.duration_ms > 0? m_start + std::chrono::milliseconds(profile.duration_ms) :
+                                                  std::chrono::steady_clock::time_point::max();
+      m_running = true;
+      m_thread = std::thread(&LoadGenerator::threadExecute, this);
+      result = true;
+   }while(0);
+
+   logger_send(TF_TC, __func__, "%s %u/s, burst %u, %u ms, %u inputs => %u", pattern_to_string(profile.pattern), profile.rate_per_s,
+                                                                           profile.burst_size, profile.duration_ms, profile.inputs.size(), result);
+   return result;
+}
+LoadReport LoadGenerator::stop(uint32_t drain_ms)
+{
+   LoadReport report;
+   if (!m_running)
+   {
+      return report;
+   }
+
+   /* stop emitting events, but keep sampling while responses are drained */
+   auto stop_time = std::chrono::steady_clock::now();
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      m_generation_end = std::min(m_generation_end, stop_time);
+      m_cv.notify_all();
+   }
+   TestWait::sleep(TEST_WAIT_SITE, std::chrono::milliseconds(drain_ms));
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      m_running = false;
+      m_cv.notify_all();
+   }
+   m_thread.join();
+
+   auto end = std::chrono::steady_clock::now();
+   takeSample(end);
+   double generation_s = std::chrono::duration<double>(m_generation_end - m_start).count();
+   double total_s = std::chrono::duration<double>(end - m_start).count();
+
+   report.events = m_events;
+   report.send_failures = m_send_failures;
+   report.late_events = m_late_events;
+   report.i2c_ntf = m_i2c_ntf;
+   report.app_ntf = m_app_ntf;
+   report.responses = m_responses;
+   report.dropped = report.events > report.responses? report.events - report.responses : 0;
+   report.duration_ms = (uint32_t)(total_s * 1000);
+   report.event_rate = generation_s > 0? report.events / generation_s : 0;
+   report.response_rate = total_s > 0? report.responses / total_s : 0;
+   report.samples = m_samples;
+
+   /* least squares slope of backlog during generation - positive value means application cannot keep up */
+   double n = 0, sum_t = 0, sum_b = 0, sum_tt = 0, sum_tb = 0;
+   for (const LoadSample& sample : m_samples)
+   {
+      report.max_backlog = std::max(report.max_backlog, sample.backlog);
+      report.max_tx_queue_bytes = std::max(report.max_tx_queue_bytes, sample.tx_queue_bytes);
+      if (sample.elapsed_ms <= generation_s * 1000)
+      {
+         double t = sample.elapsed_ms / 1000.0;
+         /* sustained rate measured while events were generated, drained responses would bias it */
+         report.response_rate = t > 0? sample.responses / t : report.response_rate;
+         n++;
+         sum_t += t;
+         sum_b += sample.backlog;
+         sum_tt += t * t;
+         sum_tb += t * sample.backlog;
+      }
+   }
+   if (n > 1 && (n * sum_tt - sum_t * sum_t) > 0)
+   {
+      report.backlog_growth = (n * sum_tb - sum_t * sum_b) / (n * sum_tt - sum_t * sum_t);
+   }
+
+   logger_send(TF_TC, __func__, "events %lu (%.1f/s, late %lu, failed %lu), responses %lu (%.1f/s), dropped %lu, max backlog %lu, growth %.1f/s",
+               (unsigned long)report.events, report.event_rate, (unsigned long)report.late_events, (unsigned long)report.send_failures,
+               (unsigned long)report.responses, report.response_rate, (unsigned long)report.dropped, (unsigned long)report.max_backlog,
+               report.backlog_growth);
+   return report;
+}
+bool LoadGenerator::isRunning()
+{
+   return m_running;
+}
+void LoadGenerator::onI2CNotification(uint8_t address)
+{
+   if (m_running)
+   {
+      m_i2c_ntf++;
+      if (m_profile.response == ResponseType::I2C_STATE && m_profile.response_id == address)
+      {
+         m_responses++;
+      }
+   }
+}
+void LoadGenerator::onAppNotification(uint8_t id)
+{
+   if (m_running)
+   {
+      m_app_ntf++;
+      if (m_profile.response == ResponseType::APP_NTF && m_profile.response_id == id)
+      {
+         m_responses++;
+      }
+   }
+}
+std::chrono::nanoseconds LoadGenerator::nextInterval(uint64_t event_no)
+{
+   double interval_s = 1.0 / m_profile.rate_per_s;
+   switch(m_profile.pattern)
+   {
+   case LoadPattern::BURST:
+      /* events inside burst are sent back-to-back, whole burst time is kept after last event of the burst */
+      interval_s = (event_no % m_profile.burst_size) == 0? interval_s * m_profile.burst_size : 0;
+      break;
+   case LoadPattern::POISSON:
+   {
+      std::exponential_distribution<double> distribution(m_profile.rate_per_s);
+      interval_s = distribution(m_random);
+   }
+   break;
+   default:
+      break;
+   }
+   return std::chrono::nanoseconds((int64_t)(interval_s * 1e9));
+}
+void LoadGenerator::takeSample(std::chrono::steady_clock::time_point now)
+{
+   LoadSample sample;
+   sample.elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_start).count();
+   sample.events = m_events;
+   sample.responses = m_responses;
+   sample.backlog = sample.events > sample.responses? sample.events - sample.responses : 0;
+   sample.tx_queue_bytes = m_probe? m_probe() : 0;
+   m_samples.push_back(sample);
+}
+void LoadGenerator::threadExecute()
+{
+   uint64_t event_no = 0;
+   auto next_event = m_start;
+   auto next_sample = m_start + std::chrono::milliseconds(LOAD_SAMPLE_PERIOD_MS);
+
+   std::unique_lock<std::mutex> lock(m_mtx);
+   while (m_running)
+   {
+      auto now = std::chrono::steady_clock::now();
+      if (now >= next_sample)
+      {
+         takeSample(now);
+         next_sample += std::chrono::milliseconds(LOAD_SAMPLE_PERIOD_MS);
+      }
+      /* every event scheduled before the end is emitted, even if generator is behind - event count follows the schedule */
+      bool generating = next_event < m_generation_end;
+      if (generating && now >= next_event)
+      {
+         /* open loop - events behind schedule are sent immediately, schedule is not shifted */
+         if (now - next_event > std::chrono::microseconds(LOAD_LATE_THRESHOLD_US))
+         {
+            m_late_events++;
+         }
+         INPUT_ID id = m_profile.inputs[event_no % m_profile.inputs.size()];
+         lock.unlock();
+         bool sent = m_stimulus(id);
+         lock.lock();
+         m_events++;
+         if (!sent)
+         {
+            m_send_failures++;
+         }
+         event_no++;
+         next_event += nextInterval(event_no);
+         continue;
+      }
+      m_cv.wait_until(lock, generating? std::min(next_event, next_sample) : next_sample);
+   }
+}
+bool LoadGenerator::exportJson(const LoadReport& report, const std::string& file_path, const std::string& test_name)
+{
+   FILE* file = fopen(file_path.c_str(), "w");
+   if (!file)
+   {
+      logger_send(TF_ERROR, __func__, "cannot create %s", file_path.c_str());
+      return false;
+   }
+
+   fprintf(file, "{\n  \"test\": \"%s\",\n  \"pattern\": \"%s\",\n  \"rate_per_s\": %u,\n  \"burst_size\": %u,\n  \"inputs\": %zu,\n"
+                 "  \"events\": %lu,\n  \"send_failures\": %lu,\n  \"late_events\": %lu,\n  \"i2c_ntf\": %lu,\n  \"app_ntf\": %lu,\n"
+                 "  \"responses\": %lu,\n  \"dropped\": %lu,\n  \"duration_ms\": %u,\n  \"event_rate\": %.1f,\n  \"response_rate\": %.1f,\n"
+                 "  \"max_backlog\": %lu,\n  \"backlog_growth_per_s\": %.2f,\n  \"max_tx_queue_bytes\": %lu,\n  \"samples\": [",
+                 test_name.c_str(), pattern_to_string(m_profile.pattern), m_profile.rate_per_s, m_profile.burst_size, m_profile.inputs.size(),
+                 (unsigned long)report.events, (unsigned long)report.send_failures, (unsigned long)report.late_events,
+                 (unsigned long)report.i2c_ntf, (unsigned long)report.app_ntf, (unsigned long)report.responses, (unsigned long)report.dropped,
+                 report.duration_ms, report.event_rate, report.response_rate, (unsigned long)report.max_backlog, report.backlog_growth,
+                 (unsigned long)report.max_tx_queue_bytes);
+   for (size_t i = 0; i < report.samples.size(); i++)
+   {
+      const LoadSample& sample = report.samples[i];
+      fprintf(file, "%s\n    {\"ms\": %u, \"events\": %lu, \"responses\": %lu, \"backlog\": %lu, \"tx_queue_bytes\": %lu}", i == 0? "" : ",",
+                    sample.elapsed_ms, (unsigned long)sample.events, (unsigned long)sample.responses, (unsigned long)sample.backlog,
+                    (unsigned long)sample.tx_queue_bytes);
+   }
+   fprintf(file, "\n  ]\n}\n");
+   fclose(file);
+   return true;
+}
@@ -0,0 +1,166 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <queue>
+#include <chrono>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "LogMatcher.h"
+#include "Logger.h"
+
+LogMatcher::LogMatcher():
+m_next_id(1),
+m_class_count(1)
+{
+   build();
+}
+LogPatternId LogMatcher::add(const std::string& pattern)
+{
+   LogPatternId result = 0;
+   if (!pattern.empty())
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      result = m_next_id++;
+      m_patterns[result] = {pattern, 0};
+      build();
+   }
+   logger_send_if(result == 0, TF_ERROR, __func__, "empty pattern");
+   return result;
+}
+void LogMatcher::remove(LogPatternId id)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   if (m_patterns.erase(id) > 0)
+   {
+      build();
+   }
+}
+void LogMatcher::clear()
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   m_patterns.clear();
+   build();
+}
+size_t LogMatcher::scan(const uint8_t* data, size_t size)
+{
+   size_t result = 0;
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      if (m_patterns.empty())
+      {
+         return 0;
+      }
+      uint32_t state = 0;
+      for (size_t i = 0; i < size; i++)
+      {
+         state = m_next[state * m_class_count + m_classes[data[i]]];
+         for (uint32_t out = m_output_begin[state]; out < m_output_begin[state + 1]; out++)
+         {
+            m_outputs[out]->hits++;
+            result++;
+         }
+      }
+   }
+   if (result > 0)
+   {
+      m_cv.notify_all();
+   }
+   return result;
+}
+uint32_t LogMatcher::hits(LogPatternId id)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   auto it = m_patterns.find(id);
+   return it != m_patterns.end()? it->second.hits : 0;
+}
+bool LogMatcher::waitForHit(LogPatternId id, uint32_t timeout_ms)
+{
+   std::unique_lock<std::mutex> lock(m_mtx);
+   return m_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]()
+                        {
+                           auto it = m_patterns.find(id);
+                           return it != m_patterns.end() && it->second.hits > 0;
+                        });
+}
+size_t LogMatcher::patterns()
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   return m_patterns.size();
+}
+void LogMatcher::build()
+{
+   /* bytes not used in any pattern share class 0 - table size depends on patterns only */
+   m_classes.fill(0);
+   m_class_count = 1;
+   for (const auto& pattern : m_patterns)
+   {
+      for (unsigned char c : pattern.second.text)
+      {
+         if (m_classes[c] == 0)
+         {
+            m_classes[c] = m_class_count++;
+         }
+      }
+   }
+
+   /* trie, missing transitions marked as 0 (root cannot be a target of trie edge) */
+   std::vector<uint32_t> next(m_class_count, 0);
+   std::vector<std::vector<Pattern*>> outputs(1);
+   for (auto& pattern : m_patterns)
+   {
+      uint32_t state = 0;
+      for (unsigned char c : pattern.second.text)
+      {
+         uint32_t& target = next[state * m_class_count + m_classes[c]];
+         if (target == 0)
+         {
+            target = outputs.size();
+            outputs.emplace_back();
+            next.resize(next.size() + m_class_count, 0);
+         }
+         state = next[state * m_class_count + m_classes[c]];
+      }
+      outputs[state].push_back(&pattern.second);
+   }
+
+   /* failure links in BFS order, missing transitions taken from the failure state */
+   std::vector<uint32_t> fail(outputs.size(), 0);
+   std::queue<uint32_t> queue;
+   for (size_t c = 0; c < m_class_count; c++)
+   {
+      if (next[c] != 0)
+      {
+         queue.push(next[c]);
+      }
+   }
+   while (!queue.empty())
+   {
+      uint32_t state = queue.front();
+      queue.pop();
+      outputs[state].insert(outputs[state].end(), outputs[fail[state]].begin(), outputs[fail[state]].end());
+      for (size_t c = 0; c < m_class_count; c++)
+      {
+         uint32_t& target = next[state * m_class_count + c];
+         uint32_t fallback = next[fail[state] * m_class_count + c];
+         if (target != 0)
+         {
+            fail[target] = fallback;
+            queue.push(target);
+         }
+         else
+         {
+            target = fallback;
+         }
+      }
+   }
+
+   m_next = std::move(next);
+   m_output_begin.assign(1, 0);
+   m_outputs.clear();
+   for (const auto& state_outputs : outputs)
+   {
+      m_outputs.insert(m_outputs.end(), state_outputs.begin(), state_outputs.end());
+      m_output_begin.push_back(m_outputs.size());
+   }
+}
@@ -39,7 +39,7 @@ typedef struct LOG_GROUP
 /* =============================
  *      Module variables
  * =============================*/
-std::vector<char> m_logger_buffer;
+std::vector<char> m_logger_buffer(LOGGER_BUFFER_SIZE);
 LOG_GROUP LOGGER_GROUPS[LOG_ENUM_MAX] = {
                         {STM_BLUETOOTH, "STM_BLUETOOTH"},
                         {STM_WIFI_NTF, "STM_WIFI_NTF"},
@@ -47,7 +47,9 @@ LOG_GROUP LOGGER_GROUPS[LOG_ENUM_MAX] = {
                         {TF_TEST_MARKER, "TF_TEST_MARKER"},
                         {TF_ERROR, "TF_ERROR"},
                         {TF_SOCKDRV, "TF_SOCKDRV"},
-                        {TF_TC, "TF_TC"}};
+                        {TF_TC, "TF_TC"},
+                        {TF_FAKE, "TF_FAKE"},
+                        {TF_CLUSTER, "TF_CLUSTER"}};
 
 LOGGER m_logger;
 
@@ -78,7 +80,7 @@ bool logger_initialize(const std::string& logfile_path)
 
 void logger_deinitialize()
 {
-   m_logger_buffer.clear();
+   /* buffer is kept - logs are still printed to console outside of the test (e.g. by executor threads) */
    m_logger.logfile.close();
    m_logger.logfile_opened = false;
    m_logger.logfile_path = "";
@@ -104,7 +106,7 @@ void logger_send(LogGroup group, const char* prefix, const char* fmt, ...)
          std::time_t tt = std::chrono::system_clock::to_time_t ( currentTime );
          auto timeinfo = localtime (&tt);
          int idx = strftime (m_logger_buffer.data(),80,"[%F %H:%M:%S",timeinfo);
-         idx = sprintf(m_logger_buffer.data(), "%s:%03d] %s - %s - ",m_logger_buffer.data(),(int)millis, LOGGER_GROUPS[group].name, prefix);
+         idx += sprintf(m_logger_buffer.data() + idx, ":%03d] %s - %s - ",(int)millis, LOGGER_GROUPS[group].name, prefix);
          va_start(va, fmt);
          {
              idx += vsprintf(m_logger_buffer.data() + idx, fmt, va);
@@ -132,7 +134,7 @@ void logger_send_if(uint8_t cond_bool, LogGroup group, const char* prefix, const
          std::time_t tt = std::chrono::system_clock::to_time_t ( currentTime );
          auto timeinfo = localtime (&tt);
          int idx = strftime (m_logger_buffer.data(),80,"[%F %H:%M:%S",timeinfo);
-         idx = sprintf(m_logger_buffer.data(), "%s:%03d] %s - %s - ",m_logger_buffer.data(),(int)millis, LOGGER_GROUPS[group].name, prefix);
+         idx += sprintf(m_logger_buffer.data() + idx, ":%03d] %s - %s - ",(int)millis, LOGGER_GROUPS[group].name, prefix);
          va_start(va, fmt);
          {
              idx += vsprintf(m_logger_buffer.data() + idx, fmt, va);
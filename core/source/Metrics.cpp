@@ -0,0 +1,225 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <poll.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "Metrics.h"
+#include "Logger.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define METRICS_SERVER_POLL_MS 100
+#define METRICS_REQUEST_SIZE 1024
+
+MetricsRegistry::MetricsRegistry():
+m_server_fd(-1),
+m_server_port(0),
+m_server_running(false)
+{
+}
+MetricsRegistry::~MetricsRegistry()
+{
+   stopServer();
+}
+void MetricsRegistry::add(const std::string& name, const std::string& help, MetricType type, const std::string& label, const MetricValue* value)
+{
+   MetricEntry entry;
+   size_t separator = label.find('=');
+   entry.name = name;
+   entry.help = help;
+   entry.type = type;
+   entry.label_key = separator != std::string::npos? label.substr(0, separator) : "";
+   entry.label_value = separator != std::string::npos? label.substr(separator + 1) : "";
+   entry.value = value;
+
+   std::lock_guard<std::mutex> lock(m_mtx);
+   m_entries.push_back(entry);
+}
+void MetricsRegistry::add(const std::string& name, const std::string& help, MetricType type, const std::string& label, MetricSampler sampler)
+{
+   add(name, help, type, label, (const MetricValue*)nullptr);
+   std::lock_guard<std::mutex> lock(m_mtx);
+   m_entries.back().sampler = sampler;
+}
+void MetricsRegistry::clear()
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   m_entries.clear();
+}
+std::string MetricsRegistry::format(MetricsFormat format)
+{
+   std::string result;
+   char line [512];
+   std::lock_guard<std::mutex> lock(m_mtx);
+
+   if (format == MetricsFormat::JSON)
+   {
+      result = "{\n  \"metrics\": [";
+   }
+   std::vector<bool> printed (m_entries.size(), false);
+   bool first = true;
+   for (size_t i = 0; i < m_entries.size(); i++)
+   {
+      if (printed[i])
+      {
+         continue;
+      }
+      const MetricEntry& group = m_entries[i];
+      const char* type = group.type == MetricType::COUNTER? "counter" : "gauge";
+      if (format == MetricsFormat::PROMETHEUS)
+      {
+         snprintf(line, sizeof(line), "# HELP %s%s %s\n# TYPE %s%s %s\n", METRICS_PREFIX, group.name.c_str(), group.help.c_str(),
+                                                                          METRICS_PREFIX, group.name.c_str(), type);
+         result += line;
+      }
+      /* all entries with the same name are printed together */
+      for (size_t j = i; j < m_entries.size(); j++)
+      {
+         const MetricEntry& entry = m_entries[j];
+         if (entry.name != group.name)
+         {
+            continue;
+         }
+         printed[j] = true;
+         unsigned long value = entry.sampler? entry.sampler() : (entry.value? entry.value->get() : 0);
+         if (format == MetricsFormat::PROMETHEUS)
+         {
+            if (entry.label_key.empty())
+            {
+               snprintf(line, sizeof(line), "%s%s %lu\n", METRICS_PREFIX, entry.name.c_str(), value);
+            }
+            else
+            {
+               snprintf(line, sizeof(line), "%s%s{%s=\"%s\"} %lu\n", METRICS_PREFIX, entry.name.c_str(), entry.label_key.c_str(),
+                                                                     entry.label_value.c_str(), value);
+            }
+         }
+         else
+         {
+            snprintf(line, sizeof(line), "%s\n    {\"name\": \"%s%s\", \"type\": \"%s\", \"labels\": {%s%s%s%s%s}, \"value\": %lu}",
+                     first? "" : ",", METRICS_PREFIX, entry.name.c_str(), type,
+                     entry.label_key.empty()? "" : "\"", entry.label_key.c_str(), entry.label_key.empty()? "" : "\": \"",
+                     entry.label_value.c_str(), entry.label_key.empty()? "" : "\"", value);
+            first = false;
+         }
+         result += line;
+      }
+   }
+   if (format == MetricsFormat::JSON)
+   {
+      result += "\n  ]\n}\n";
+   }
+   return result;
+}
+bool MetricsRegistry::writeFile(const std::string& file_path, MetricsFormat format)
+{
+   bool result = false;
+   FILE* file = fopen(file_path.c_str(), "w");
+   if (file)
+   {
+      std::string text = this->format(format);
+      result = fwrite(text.data(), 1, text.size(), file) == text.size();
+      fclose(file);
+   }
+   logger_send_if(!result, TF_ERROR, __func__, "cannot write metrics to %s", file_path.c_str());
+   return result;
+}
+bool MetricsRegistry::startServer(uint16_t port)
+{
+   bool result = false;
+   stopServer();
+   do
+   {
+      m_server_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+      if (m_server_fd < 0)
+      {
+         logger_send(TF_ERROR, __func__, "cannot create socket: %s", strerror(errno));
+         break;
+      }
+      int enable = 1;
+      setsockopt(m_server_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+      struct sockaddr_in addr = {};
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(port);
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      if (bind(m_server_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(m_server_fd, 4) != 0)
+      {
+         logger_send(TF_ERROR, __func__, "[%d] cannot start metrics server: %s", port, strerror(errno));
+         ::close(m_server_fd);
+         m_server_fd = -1;
+         break;
+      }
+      socklen_t addr_len = sizeof(addr);
+      getsockname(m_server_fd, (struct sockaddr*)&addr, &addr_len);
+      m_server_port = ntohs(addr.sin_port);
+      m_server_running = true;
+      m_server_thread = std::thread(&MetricsRegistry::serverExecute, this);
+      result = true;
+   }while(0);
+   logger_send(TF_TC, __func__, "[%d] => %u, port %u", port, result, m_server_port);
+   return result;
+}
+uint16_t MetricsRegistry::serverPort()
+{
+   return m_server_port;
+}
+void MetricsRegistry::stopServer()
+{
+   if (m_server_running)
+   {
+      m_server_running = false;
+      m_server_thread.join();
+   }
+   if (m_server_fd >= 0)
+   {
+      ::close(m_server_fd);
+      m_server_fd = -1;
+   }
+}
+void MetricsRegistry::serverExecute()
+{
+   char request [METRICS_REQUEST_SIZE + 1];
+   while (m_server_running)
+   {
+      struct pollfd fd = {m_server_fd, POLLIN, 0};
+      if (poll(&fd, 1, METRICS_SERVER_POLL_MS) <= 0)
+      {
+         continue;
+      }
+      int client = accept(m_server_fd, NULL, NULL);
+      if (client < 0)
+      {
+         continue;
+      }
+      /* request is optional - client which only connects gets Prometheus format */
+      struct pollfd client_fd = {client, POLLIN, 0};
+      ssize_t request_size = 0;
+      if (poll(&client_fd, 1, METRICS_SERVER_POLL_MS) > 0)
+      {
+         request_size = recv(client, request, METRICS_REQUEST_SIZE, 0);
+      }
+      request[request_size > 0? request_size : 0] = 0x00;
+      bool json = strstr(request, "json") != NULL;
+      bool http = strncmp(request, "GET ", 4) == 0;
+
+      std::string body = format(json? MetricsFormat::JSON : MetricsFormat::PROMETHEUS);
+      std::string response;
+      if (http)
+      {
+         response = std::string("HTTP/1.0 200 OK\r\nContent-Type: ") + (json? "application/json" : "text/plain; version=0.0.4") +
+                    "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+      }
+      response += body;
+      send(client, response.data(), response.size(), MSG_NOSIGNAL);
+      ::close(client);
+   }
+}
@@ -0,0 +1,261 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "ResourceSampler.h"
+#include "Logger.h"
+/* =============================
+ *          Defines
+ * =============================*/
+#define SAMPLER_READ_BUFFER_SIZE 2048
+
+namespace
+{
+/* reads whole /proc file from offset 0, returns number of bytes or -1 when process is gone */
+ssize_t read_proc_file(int fd, char* buffer, size_t size)
+{
+   ssize_t bytes = pread(fd, buffer, size - 1, 0);
+   if (bytes >= 0)
+   {
+      buffer[bytes] = 0x00;
+   }
+   return bytes;
+}
+uint64_t read_status_field(const char* status, const char* field)
+{
+   unsigned long value = 0;
+   const char* line = strstr(status, field);
+   if (line)
+   {
+      sscanf(line + strlen(field), "%lu", &value);
+   }
+   return value;
+}
+}
+
+ResourceSampler::ResourceSampler():
+m_pid(0),
+m_period_ms(SAMPLER_DEFAULT_PERIOD_MS),
+m_stat_fd(-1),
+m_statm_fd(-1),
+m_status_fd(-1),
+m_page_size(sysconf(_SC_PAGESIZE)),
+m_clock_ticks(sysconf(_SC_CLK_TCK)),
+m_timeline(nullptr),
+m_running(false)
+{
+}
+ResourceSampler::~ResourceSampler()
+{
+   stop();
+}
+bool ResourceSampler::start(pid_t pid, uint32_t period_ms, const std::string& timeline_path)
+{
+   bool result = false;
+   if (!m_running && m_thread.joinable())
+   {
+      /* previous sampling ended on its own (process exited) and was not stopped */
+      m_thread.join();
+      closeFiles();
+   }
+   do
+   {
+      if (m_running || pid <= 0 || period_ms == 0)
+      {
+         logger_send(TF_ERROR, __func__, "cannot start, running %u, pid %d, period %u", m_running.load(), pid, period_ms);
+         break;
+      }
+      char path [64];
+      snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+      m_stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+      snprintf(path, sizeof(path), "/proc/%d/statm", pid);
+      m_statm_fd = open(path, O_RDONLY | O_CLOEXEC);
+      snprintf(path, sizeof(path), "/proc/%d/status", pid);
+      m_status_fd = open(path, O_RDONLY | O_CLOEXEC);
+      if (m_stat_fd < 0 || m_statm_fd < 0 || m_status_fd < 0)
+      {
+         logger_send(TF_ERROR, __func__, "cannot open /proc files of %d: %s", pid, strerror(errno));
+         closeFiles();
+         break;
+      }
+      if (!timeline_path.empty())
+      {
+         m_timeline = fopen(timeline_path.c_str(), "w");
+         logger_send_if(!m_timeline, TF_ERROR, __func__, "cannot create %s", timeline_path.c_str());
+      }
+      if (m_timeline)
+      {
+         fprintf(m_timeline, "ms,user_ticks,system_ticks,rss_kb,vm_kb,peak_rss_kb,threads,voluntary_switches,involuntary_switches\n");
+      }
+      m_pid = pid;
+      m_period_ms = period_ms;
+      m_samples.clear();
+      m_start = std::chrono::steady_clock::now();
+      m_running = true;
+      m_thread = std::thread(&ResourceSampler::threadExecute, this);
+      result = true;
+   }while(0);
+   return result;
+}
+void ResourceSampler::stop()
+{
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      m_running = false;
+      m_cv.notify_all();
+   }
+   if (m_thread.joinable())
+   {
+      m_thread.join();
+   }
+   closeFiles();
+}
+bool ResourceSampler::isRunning()
+{
+   return m_running;
+}
+uint32_t ResourceSampler::elapsed()
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   return m_samples.empty()? 0 : m_samples.back().elapsed_ms;
+}
+void ResourceSampler::closeFiles()
+{
+   for (int* fd : {&m_stat_fd, &m_statm_fd, &m_status_fd})
+   {
+      if (*fd >= 0)
+      {
+         close(*fd);
+         *fd = -1;
+      }
+   }
+   if (m_timeline)
+   {
+      fclose(m_timeline);
+      m_timeline = nullptr;
+   }
+}
+bool ResourceSampler::takeSample(ResourceSample& sample)
+{
+   char buffer [SAMPLER_READ_BUFFER_SIZE];
+   sample = {};
+   sample.elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start).count();
+
+   /* comm field may contain spaces and parentheses - parsing starts after the last ')' */
+   if (read_proc_file(m_stat_fd, buffer, sizeof(buffer)) <= 0)
+   {
+      return false;
+   }
+   const char* fields = strrchr(buffer, ')');
+   unsigned long utime = 0, stime = 0;
+   long threads = 0;
+   if (!fields || sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu %*d %*d %*d %*d %ld",
+                         &utime, &stime, &threads) != 3)
+   {
+      return false;
+   }
+   sample.user_ticks = utime;
+   sample.system_ticks = stime;
+   sample.threads = threads;
+
+   unsigned long vm_pages = 0, rss_pages = 0;
+   if (read_proc_file(m_statm_fd, buffer, sizeof(buffer)) <= 0 || sscanf(buffer, "%lu %lu", &vm_pages, &rss_pages) != 2)
+   {
+      return false;
+   }
+   sample.vm_bytes = (uint64_t)vm_pages * m_page_size;
+   sample.rss_bytes = (uint64_t)rss_pages * m_page_size;
+
+   if (read_proc_file(m_status_fd, buffer, sizeof(buffer)) <= 0)
+   {
+      return false;
+   }
+   sample.peak_rss_bytes = read_status_field(buffer, "VmHWM:") * 1024;
+   sample.voluntary_switches = read_status_field(buffer, "\nvoluntary_ctxt_switches:");
+   sample.involuntary_switches = read_status_field(buffer, "\nnonvoluntary_ctxt_switches:");
+   return true;
+}
+void ResourceSampler::threadExecute()
+{
+   auto next_sample = m_start;
+   std::unique_lock<std::mutex> lock(m_mtx);
+   while (m_running)
+   {
+      ResourceSample sample;
+      lock.unlock();
+      bool sampled = takeSample(sample);
+      lock.lock();
+      if (!sampled)
+      {
+         /* process exited */
+         m_running = false;
+         break;
+      }
+      m_samples.push_back(sample);
+      if (m_timeline)
+      {
+         fprintf(m_timeline, "%u,%lu,%lu,%lu,%lu,%lu,%u,%lu,%lu\n", sample.elapsed_ms, (unsigned long)sample.user_ticks,
+                 (unsigned long)sample.system_ticks, (unsigned long)(sample.rss_bytes / 1024), (unsigned long)(sample.vm_bytes / 1024),
+                 (unsigned long)(sample.peak_rss_bytes / 1024), sample.threads, (unsigned long)sample.voluntary_switches,
+                 (unsigned long)sample.involuntary_switches);
+      }
+      next_sample += std::chrono::milliseconds(m_period_ms);
+      m_cv.wait_until(lock, next_sample, [&](){ return !m_running; });
+   }
+   logger_send(TF_TC, __func__, "pid %d, %zu samples", m_pid, m_samples.size());
+}
+ResourceSummary ResourceSampler::summarize(uint32_t window_ms)
+{
+   ResourceSummary summary;
+   std::lock_guard<std::mutex> lock(m_mtx);
+   if (m_samples.empty())
+   {
+      return summary;
+   }
+
+   const ResourceSample& last = m_samples.back();
+   auto first = m_samples.begin();
+   if (window_ms > 0 && last.elapsed_ms > window_ms)
+   {
+      first = std::lower_bound(m_samples.begin(), m_samples.end(), last.elapsed_ms - window_ms,
+                               [](const ResourceSample& sample, uint32_t ms){ return sample.elapsed_ms < ms; });
+   }
+   summary.samples = std::distance(first, m_samples.end());
+   summary.duration_ms = last.elapsed_ms - first->elapsed_ms;
+   if (summary.duration_ms > 0 && m_clock_ticks > 0)
+   {
+      uint64_t ticks = (last.user_ticks + last.system_ticks) - (first->user_ticks + first->system_ticks);
+      summary.cpu_percent = 100.0 * ticks / m_clock_ticks / (summary.duration_ms / 1000.0);
+   }
+
+   /* least squares slope of RSS, single outlier (e.g. short living buffer) does not fail growth check */
+   double n = 0, sum_t = 0, sum_r = 0, sum_tt = 0, sum_tr = 0;
+   for (auto it = first; it != m_samples.end(); it++)
+   {
+      summary.max_rss_bytes = std::max({summary.max_rss_bytes, it->rss_bytes, it->peak_rss_bytes});
+      double t = (it->elapsed_ms - first->elapsed_ms) / 1000.0;
+      n++;
+      sum_t += t;
+      sum_r += it->rss_bytes;
+      sum_tt += t * t;
+      sum_tr += t * it->rss_bytes;
+   }
+   if (n > 1 && (n * sum_tt - sum_t * sum_t) > 0)
+   {
+      double slope = (n * sum_tr - sum_t * sum_r) / (n * sum_tt - sum_t * sum_t);
+      summary.rss_growth_bytes = slope * summary.duration_ms / 1000.0;
+   }
+   return summary;
+}
+std::vector<ResourceSample> ResourceSampler::getSamples()
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   return m_samples;
+}
@@ -0,0 +1,181 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "ResultCache.h"
+#include "Logger.h"
+
+namespace
+{
+/* FIPS 180-4 SHA-256 */
+class Sha256
+{
+public:
+   Sha256():
+   m_state{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19},
+   m_block_size(0),
+   m_length(0)
+   {
+   }
+   void update(const uint8_t* data, size_t size)
+   {
+      m_length += size;
+      while (size > 0)
+      {
+         size_t chunk = std::min(size, sizeof(m_block) - m_block_size);
+         memcpy(m_block + m_block_size, data, chunk);
+         m_block_size += chunk;
+         data += chunk;
+         size -= chunk;
+         if (m_block_size == sizeof(m_block))
+         {
+            transform();
+            m_block_size = 0;
+         }
+      }
+   }
+   std::string hex()
+   {
+      uint64_t bits = m_length * 8;
+      uint8_t padding [72] = {0x80};
+      size_t padding_size = (m_block_size < 56? 56 : 120) - m_block_size;
+      for (size_t i = 0; i < 8; i++)
+      {
+         padding[padding_size + i] = bits >> (56 - 8 * i);
+      }
+      update(padding, padding_size + 8);
+      char result [65];
+      for (size_t i = 0; i < 8; i++)
+      {
+         snprintf(result + 8 * i, 9, "%.8x", m_state[i]);
+      }
+      return std::string(result, 64);
+   }
+private:
+   static uint32_t rotr(uint32_t x, uint32_t n)
+   {
+      return (x >> n) | (x << (32 - n));
+   }
+   void transform()
+   {
+      static const uint32_t k [64] = {
+         0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+         0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+         0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+         0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+         0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+         0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+         0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+         0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+      uint32_t w [64];
+      for (size_t i = 0; i < 16; i++)
+      {
+         w[i] = (uint32_t)m_block[4 * i] << 24 | (uint32_t)m_block[4 * i + 1] << 16 | (uint32_t)m_block[4 * i + 2] << 8 | m_block[4 * i + 3];
+      }
+      for (size_t i = 16; i < 64; i++)
+      {
+         uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+         uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+         w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+      }
+      uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+      uint32_t e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+      for (size_t i = 0; i < 64; i++)
+      {
+         uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+         uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+         h = g; g = f; f = e; e = d + t1;
+         d = c; c = b; b = a; a = t1 + t2;
+      }
+      m_state[0] += a; m_state[1] += b; m_state[2] += c; m_state[3] += d;
+      m_state[4] += e; m_state[5] += f; m_state[6] += g; m_state[7] += h;
+   }
+
+   uint32_t m_state [8];
+   uint8_t m_block [64];
+   size_t m_block_size;
+   uint64_t m_length;
+};
+}
+
+bool ResultCache::open(const std::string& cache_dir, const std::vector<std::string>& inputs)
+{
+   std::string digests;
+   for (const std::string& input : inputs)
+   {
+      std::string digest = hashFile(input);
+      logger_send_if(digest.empty(), TF_ERROR, __func__, "cannot read %s", input.c_str());
+      digests += digest.empty()? "missing:" + input : digest;
+      digests += '\n';
+   }
+   m_inputs_digest = hashText(digests);
+   m_dir = cache_dir;
+
+   bool result = mkdir(m_dir.c_str(), 0755) == 0 || errno == EEXIST;
+   logger_send_if(!result, TF_ERROR, __func__, "cannot create %s: %s", m_dir.c_str(), strerror(errno));
+   return result;
+}
+bool ResultCache::isPassed(const std::string& test_name)
+{
+   return !m_dir.empty() && access(entryPath(test_name).c_str(), F_OK) == 0;
+}
+void ResultCache::storePass(const std::string& test_name)
+{
+   if (m_dir.empty())
+   {
+      return;
+   }
+   /* written under temporary name, so concurrent runs never see partial entry */
+   std::string path = entryPath(test_name);
+   std::string tmp_path = path + ".tmp" + std::to_string(getpid());
+   FILE* file = fopen(tmp_path.c_str(), "w");
+   if (file)
+   {
+      fprintf(file, "%s\n", test_name.c_str());
+      fclose(file);
+      rename(tmp_path.c_str(), path.c_str());
+   }
+   logger_send_if(!file, TF_ERROR, __func__, "cannot write %s", path.c_str());
+}
+std::string ResultCache::hashFile(const std::string& path)
+{
+   FILE* file = fopen(path.c_str(), "rb");
+   if (!file)
+   {
+      return "";
+   }
+   Sha256 sha;
+   uint8_t buffer [65536];
+   size_t bytes = 0;
+   while ((bytes = fread(buffer, 1, sizeof(buffer), file)) > 0)
+   {
+      sha.update(buffer, bytes);
+   }
+   fclose(file);
+   return sha.hex();
+}
+std::string ResultCache::hashText(const std::string& text)
+{
+   Sha256 sha;
+   sha.update((const uint8_t*)text.data(), text.size());
+   return sha.hex();
+}
+std::string ResultCache::entryPath(const std::string& test_name)
+{
+   return m_dir + "/" + hashText(m_inputs_digest + "\n" + test_name);
+}
+void ResultCache::Listener::OnTestEnd(const testing::TestInfo& test_info)
+{
+   if (test_info.result()->Passed() && !test_info.result()->Skipped())
+   {
+      m_cache.storePass(std::string(test_info.test_suite_name()) + "." + test_info.name());
+   }
+}
@@ -11,9 +11,13 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <algorithm>
+#include <chrono>
 #include <string.h>
 #include "notification_types.h"
 
@@ -32,6 +36,10 @@ __attribute__((weak)) ssize_t send(int socket, const void *message, size_t lengt
 {
    return ::send(socket, message, length, flags);
 }
+__attribute__((weak)) ssize_t sendmsg(int socket, const struct msghdr *message, int flags)
+{
+   return ::sendmsg(socket, message, flags);
+}
 __attribute__((weak)) int socket(int domain, int type, int protocol)
 {
    return ::socket(domain, type, protocol);
@@ -58,6 +66,29 @@ m_thread_running(false),
 m_sock_fd(-1),
 m_client(-1)
 {
+   m_impairment.setSink(ImpairmentDirection::INBOUND, [this](std::vector<uint8_t>& frame)
+                        {
+                           /* listeners expect zero terminated data */
+                           size_t size = frame.size();
+                           frame.push_back(0x00);
+                           notify_callbacks(DriverEvent::DRIVER_DATA_RECV, frame, size);
+                        });
+   m_impairment.setSink(ImpairmentDirection::OUTBOUND, [this](std::vector<uint8_t>& frame)
+                        {
+                           SocketFrame socket_frame = {frame.data(), frame.size()};
+                           size_t payload_size = 0;
+                           std::lock_guard<std::mutex> lock(m_send_mutex);
+                           if (sendFrames(&socket_frame, 1, payload_size))
+                           {
+                              /* impaired frames are counted when they leave impairment, dropped ones never */
+                              m_metrics.frames_out.add();
+                              m_metrics.bytes_out.add(payload_size);
+                           }
+                           else
+                           {
+                              m_metrics.write_failures.add();
+                           }
+                        });
 }
 bool SocketDriver::connect(const std::string& ip_address, uint16_t port)
 {
@@ -151,6 +182,9 @@ void SocketDriver::threadExecute()
          m_client = accept(m_sock_fd, (struct sockaddr *)&m_serv_addr, (socklen_t*)&addrlen);
          if (m_client >= 0)
          {
+            /* stimulus frames are small and sent back-to-back - do not let Nagle algorithm hold them */
+            int enable = 1;
+            system_call::setsockopt(m_client, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
             logger_send(TF_SOCKDRV, __func__, "[%d] got client", m_server_port);
             notify_callbacks(DriverEvent::DRIVER_CONNECTED, {}, 0);
          }
@@ -170,8 +204,24 @@ void SocketDriver::threadExecute()
             recv_bytes = recv(m_client, recv_buffer.data(), len_to_read, 0);
             if (recv_bytes > 0)
             {
-               recv_buffer[recv_bytes] = 0x00;
-               notify_callbacks(DriverEvent::DRIVER_DATA_RECV, recv_buffer, recv_bytes);
+               int queued = 0;
+               if (ioctl(m_client, FIONREAD, &queued) == 0)
+               {
+                  m_metrics.rx_queue_bytes.set(queued);
+               }
+               m_metrics.frames_in.add();
+               m_metrics.bytes_in.add(recv_bytes);
+               /* frame read when receive is paused is held, socket is not read until the pause ends */
+               m_impairment.waitReceive();
+               if (m_impairment.isActive(ImpairmentDirection::INBOUND))
+               {
+                  m_impairment.submit(ImpairmentDirection::INBOUND, recv_buffer.data(), recv_bytes);
+               }
+               else
+               {
+                  recv_buffer[recv_bytes] = 0x00;
+                  notify_callbacks(DriverEvent::DRIVER_DATA_RECV, recv_buffer, recv_bytes);
+               }
             }
          }
 
@@ -214,7 +264,15 @@ void SocketDriver::notify_callbacks(DriverEvent ev, const std::vector<uint8_t>&
 
    if (m_listener)
    {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
       m_listener(ev, data, count);
+      if (ev == DriverEvent::DRIVER_DATA_RECV)
+      {
+         uint64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+         m_metrics.callback_count.add();
+         m_metrics.callback_time_ns.add(duration);
+         m_metrics.callback_time_max_ns.setMax(duration);
+      }
    }
 }
 bool SocketDriver::disconnect()
@@ -223,6 +281,17 @@ bool SocketDriver::disconnect()
    if (m_thread_running)
    {
       m_thread_running = false;
+      m_impairment.pauseReceive(std::chrono::microseconds(0));
+      /* wake up the thread blocked in accept() or recv() */
+      int client = m_client;
+      if (client >= 0)
+      {
+         shutdown(client, SHUT_RDWR);
+      }
+      if (m_sock_fd >= 0)
+      {
+         shutdown(m_sock_fd, SHUT_RDWR);
+      }
       m_thread.join();
       result = true;
    }
@@ -230,6 +299,7 @@ bool SocketDriver::disconnect()
    if (m_sock_fd >= 0)
    {
       close(m_sock_fd);
+      m_sock_fd = -1;
    }
    return result;
 
@@ -250,36 +320,166 @@ void SocketDriver::removeListener()
 }
 bool SocketDriver::write(const std::vector<uint8_t>& data, size_t size)
 {
-   bool result = false;
-   ssize_t bytes_to_write = size == 0? data.size() : size;
-   logger_send(TF_SOCKDRV, __func__, "[%d] writing %u bytes", m_server_port, size);
-   uint8_t msg_header [SOCK_MSG_HEADER_SIZE + 1];
-   if (bytes_to_write <= SOCKDRV_MAX_RW_SIZE)
+   return write(data.data(), size == 0? data.size() : size);
+}
+bool SocketDriver::write(const uint8_t* data, size_t size)
+{
+   SocketFrame frame = {data, size};
+   return write(&frame, 1);
+}
+bool SocketDriver::write(const SocketFrame* frames, size_t count)
+{
+   bool result = true;
+   bool impaired = m_impairment.isActive(ImpairmentDirection::OUTBOUND);
+   size_t payload_size = 0;
+   if (impaired)
    {
-      std::snprintf((char*)msg_header, SOCK_MSG_HEADER_SIZE + 1, "%.4ld", size);
-      send(m_client, msg_header, SOCK_MSG_HEADER_SIZE, 0);
-
-      ssize_t bytes_written = 0;
-      ssize_t current_write = 0;
-      result = true;
-      while (bytes_to_write > 0)
+      for (size_t i = 0; i < count; i++)
       {
-         current_write = system_call::send(m_client, data.data() + bytes_written, bytes_to_write, 0);
-         if (current_write > 0)
+         if (frames[i].size > SOCKDRV_MAX_RW_SIZE)
          {
-            bytes_written += current_write;
+            result = false;
+            break;
          }
-         else
+         m_impairment.submit(ImpairmentDirection::OUTBOUND, frames[i].data, frames[i].size);
+         payload_size += frames[i].size;
+      }
+   }
+   else
+   {
+      std::lock_guard<std::mutex> lock(m_send_mutex);
+      result = sendFrames(frames, count, payload_size);
+   }
+   logger_send(TF_SOCKDRV, __func__, "[%d] writing %u frames, %u bytes", m_server_port, count, payload_size);
+
+   if (result && !impaired)
+   {
+      m_metrics.frames_out.add(count);
+      m_metrics.bytes_out.add(payload_size);
+   }
+   else if (!result)
+   {
+      m_metrics.write_failures.add();
+   }
+   logger_send_if(!result, TF_ERROR, __func__, "[%d] cannot write %u frames", m_server_port, count);
+   return result;
+}
+bool SocketDriver::sendFrames(const SocketFrame* frames, size_t count, size_t& payload_size)
+{
+   bool result = true;
+   /* headers and data of all frames passed to one sendmsg() - separate small writes are delayed by Nagle algorithm,
+      frame data is not copied */
+   char headers [SOCKDRV_MAX_BATCH_FRAMES][SOCK_MSG_HEADER_SIZE + 1];
+   struct iovec iov [SOCKDRV_MAX_BATCH_FRAMES * 2];
+   size_t i = 0;
+   while (result && i < count)
+   {
+      size_t batch = 0;
+      for (; i < count && batch < SOCKDRV_MAX_BATCH_FRAMES; i++, batch++)
+      {
+         if (frames[i].size > SOCKDRV_MAX_RW_SIZE)
          {
             result = false;
             break;
          }
-         bytes_to_write -= bytes_written;
+         std::snprintf(headers[batch], SOCK_MSG_HEADER_SIZE + 1, "%.4u", (unsigned)frames[i].size);
+         iov[2 * batch] = {headers[batch], SOCK_MSG_HEADER_SIZE};
+         iov[2 * batch + 1] = {(void*)frames[i].data, frames[i].size};
+         payload_size += frames[i].size;
+      }
+      if (batch > 0)
+      {
+         result = sendAll(iov, 2 * batch) && result;
+      }
+   }
+   return result;
+}
+bool SocketDriver::sendAll(struct iovec* iov, size_t count)
+{
+   bool result = true;
+   struct msghdr message = {};
+   message.msg_iov = iov;
+   message.msg_iovlen = count;
+   while (message.msg_iovlen > 0)
+   {
+      ssize_t current_write = system_call::sendmsg(m_client, &message, MSG_NOSIGNAL);
+      if (current_write <= 0)
+      {
+         result = false;
+         break;
+      }
+      m_metrics.socket_writes.add();
+      /* partial write - continue from the first byte not sent */
+      size_t written = current_write;
+      while (message.msg_iovlen > 0 && written >= message.msg_iov->iov_len)
+      {
+         written -= message.msg_iov->iov_len;
+         message.msg_iov++;
+         message.msg_iovlen--;
+      }
+      if (message.msg_iovlen > 0)
+      {
+         message.msg_iov->iov_base = (uint8_t*)message.msg_iov->iov_base + written;
+         message.msg_iov->iov_len -= written;
       }
    }
-   logger_send_if(!result, TF_ERROR, __func__, "[%d] cannot write %u bytes", size, m_server_port);
    return result;
 }
+void SocketDriver::registerMetrics(MetricsRegistry& registry, const std::string& channel)
+{
+   std::string label = "channel=" + channel;
+   registry.add("frames_received_total", "Frames received from tested application", MetricType::COUNTER, label, &m_metrics.frames_in);
+   registry.add("bytes_received_total", "Payload bytes received from tested application", MetricType::COUNTER, label, &m_metrics.bytes_in);
+   registry.add("frames_sent_total", "Frames sent to tested application", MetricType::COUNTER, label, &m_metrics.frames_out);
+   registry.add("bytes_sent_total", "Payload bytes sent to tested application", MetricType::COUNTER, label, &m_metrics.bytes_out);
+   registry.add("write_failures_total", "Frames which could not be sent", MetricType::COUNTER, label, &m_metrics.write_failures);
+   registry.add("socket_writes_total", "send() calls on the socket", MetricType::COUNTER, label, &m_metrics.socket_writes);
+   registry.add("rx_queue_bytes", "Bytes waiting in socket receive queue", MetricType::GAUGE, label, &m_metrics.rx_queue_bytes);
+   registry.add("tx_queue_bytes", "Bytes sent, but not acknowledged by tested application", MetricType::GAUGE, label, [this]() -> uint64_t
+                 {
+                    return pendingTxBytes();
+                 });
+   registry.add("callbacks_total", "Listener calls with received data", MetricType::COUNTER, label, &m_metrics.callback_count);
+   registry.add("callback_time_ns_total", "Time spent in listener", MetricType::COUNTER, label, &m_metrics.callback_time_ns);
+   registry.add("callback_time_max_ns", "Longest listener call", MetricType::GAUGE, label, &m_metrics.callback_time_max_ns);
+   /* registry has one label per metric - direction is part of the name */
+   const ImpairmentMetrics& inbound = m_impairment.getMetrics(ImpairmentDirection::INBOUND);
+   const ImpairmentMetrics& outbound = m_impairment.getMetrics(ImpairmentDirection::OUTBOUND);
+   registry.add("impaired_in_frames_total", "Received frames passed through impairment", MetricType::COUNTER, label, &inbound.frames_delayed);
+   registry.add("impaired_in_dropped_total", "Received frames dropped by impairment", MetricType::COUNTER, label, &inbound.frames_dropped);
+   registry.add("impaired_in_queued_frames", "Received frames held by impairment", MetricType::GAUGE, label, &inbound.queued_frames);
+   registry.add("impaired_out_frames_total", "Written frames passed through impairment", MetricType::COUNTER, label, &outbound.frames_delayed);
+   registry.add("impaired_out_dropped_total", "Written frames dropped by impairment", MetricType::COUNTER, label, &outbound.frames_dropped);
+   registry.add("impaired_out_queued_frames", "Written frames held by impairment", MetricType::GAUGE, label, &outbound.queued_frames);
+}
+const SocketMetrics& SocketDriver::getMetrics()
+{
+   return m_metrics;
+}
+uint64_t SocketDriver::pendingTxBytes()
+{
+   int queued = 0;
+   int client = m_client;
+   if (client < 0 || ioctl(client, SIOCOUTQ, &queued) != 0)
+   {
+      queued = 0;
+   }
+   return queued;
+}
+void SocketDriver::setImpairment(ImpairmentDirection direction, const ImpairmentProfile& profile)
+{
+   logger_send(TF_SOCKDRV, __func__, "[%d]", m_server_port);
+   m_impairment.configure(direction, profile);
+}
+void SocketDriver::pauseReceive(uint32_t duration_ms)
+{
+   logger_send(TF_SOCKDRV, __func__, "[%d] %u ms", m_server_port, duration_ms);
+   m_impairment.pauseReceive(std::chrono::milliseconds(duration_ms));
+}
+void SocketDriver::clearImpairments()
+{
+   m_impairment.reset();
+}
 void SocketDriver::setDelimiter(char c)
 {
    std::lock_guard<std::mutex> lock (m_mutex);
@@ -0,0 +1,453 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "StepReportListener.h"
+#include "Logger.h"
+
+namespace
+{
+std::string xml_escape(const std::string& text)
+{
+   std::string result;
+   for (char c : text)
+   {
+      switch(c)
+      {
+      case '<': result += "&lt;"; break;
+      case '>': result += "&gt;"; break;
+      case '&': result += "&amp;"; break;
+      case '"': result += "&quot;"; break;
+      default: result += c; break;
+      }
+   }
+   return result;
+}
+const char* outcome_to_string(StepOutcome outcome)
+{
+   switch(outcome)
+   {
+   case StepOutcome::DONE: return "done";
+   case StepOutcome::PASSED: return "passed";
+   case StepOutcome::FAILED: return "failed";
+   default: return "unknown";
+   }
+}
+double to_s(uint64_t us)
+{
+   return us / 1000000.0;
+}
+const char* file_name(const char* path)
+{
+   const char* name = strrchr(path, '/');
+   return name? name + 1 : path;
+}
+/* spool fields are separated with tabs, one record per line */
+std::string spool_escape(const std::string& text)
+{
+   std::string result;
+   for (char c : text)
+   {
+      switch(c)
+      {
+      case '\\': result += "\\\\"; break;
+      case '\t': result += "\\t"; break;
+      case '\n': result += "\\n"; break;
+      default: result += c; break;
+      }
+   }
+   return result;
+}
+std::vector<std::string> spool_fields(const std::string& line)
+{
+   std::vector<std::string> result(1);
+   for (size_t i = 0; i < line.size(); i++)
+   {
+      if (line[i] == '\t')
+      {
+         result.emplace_back();
+      }
+      else if (line[i] == '\\' && i + 1 < line.size())
+      {
+         i++;
+         result.back() += line[i] == 't'? '\t' : (line[i] == 'n'? '\n' : line[i]);
+      }
+      else
+      {
+         result.back() += line[i];
+      }
+   }
+   return result;
+}
+}
+
+StepReportListener::StepReportListener(const std::string& report_name):
+m_report_name(report_name),
+m_test_running(false)
+{
+   m_hook_id = TestStep::addHook([this](const StepEvent& event)
+                                 {
+                                    this->onStep(event);
+                                 });
+   m_wait_hook_id = TestWait::addHook([this](const WaitEvent& event)
+                                      {
+                                         this->onWait(event);
+                                      });
+}
+StepReportListener::~StepReportListener()
+{
+   TestStep::removeHook(m_hook_id);
+   TestWait::removeHook(m_wait_hook_id);
+}
+bool StepReportListener::install(const std::string& report_name)
+{
+   testing::UnitTest::GetInstance()->listeners().Append(new StepReportListener(report_name));
+   return true;
+}
+void StepReportListener::OnTestProgramStart(const testing::UnitTest&)
+{
+   const char* spool = getenv(STEP_REPORT_MERGE_ENV);
+   if (spool)
+   {
+      readSpool(spool);
+      unlink(spool);
+   }
+}
+void StepReportListener::OnTestStart(const testing::TestInfo& test_info)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   m_current = StepTestRecord();
+   m_current.suite = test_info.test_suite_name();
+   m_current.name = test_info.name();
+   m_current.start = std::chrono::steady_clock::now();
+   m_test_running = true;
+}
+void StepReportListener::OnTestEnd(const testing::TestInfo& test_info)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   m_current.duration_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_current.start).count();
+   m_current.failed = test_info.result()->Failed();
+   m_current.skipped = test_info.result()->Skipped();
+   m_records.push_back(m_current);
+   m_test_running = false;
+}
+void StepReportListener::OnTestProgramEnd(const testing::UnitTest&)
+{
+   const char* spool = getenv(STEP_REPORT_SPOOL_ENV);
+   if (spool)
+   {
+      writeSpool(spool);
+      return;
+   }
+   std::string base_path = std::string(PROJECT_ROOT_PATH) + "/logs/" + m_report_name;
+   writeJUnit(base_path + ".steps.xml");
+   FILE* file = fopen((base_path + ".steps.txt").c_str(), "w");
+   if (file)
+   {
+      writeSummary(file);
+      fclose(file);
+   }
+   writeSummary(stdout);
+   file = fopen((base_path + ".waits.txt").c_str(), "w");
+   if (file)
+   {
+      writeWaits(file, SIZE_MAX);
+      fclose(file);
+   }
+   writeWaits(stdout, STEP_REPORT_SLOWEST_COUNT);
+}
+std::vector<StepTestRecord> StepReportListener::getRecords()
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   return m_records;
+}
+void StepReportListener::onStep(const StepEvent& event)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   if (m_test_running)
+   {
+      m_current.steps.push_back(event);
+   }
+}
+void StepReportListener::onWait(const WaitEvent& event)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   if (m_test_running)
+   {
+      m_current.waits.push_back(event);
+   }
+}
+bool StepReportListener::writeJUnit(const std::string& file_path)
+{
+   FILE* file = fopen(file_path.c_str(), "w");
+   if (!file)
+   {
+      logger_send(TF_ERROR, __func__, "cannot create %s", file_path.c_str());
+      return false;
+   }
+   std::lock_guard<std::mutex> lock(m_mtx);
+   uint64_t total_us = 0;
+   size_t total_steps = 0;
+   size_t total_failures = 0;
+   for (const StepTestRecord& test : m_records)
+   {
+      total_us += test.duration_us;
+      total_steps += test.steps.size();
+      for (const StepEvent& step : test.steps)
+      {
+         total_failures += test.failed && step.outcome == StepOutcome::FAILED;
+      }
+   }
+
+   fprintf(file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+   fprintf(file, "<testsuites name=\"%s\" tests=\"%zu\" failures=\"%zu\" time=\"%.6f\">\n", xml_escape(m_report_name).c_str(),
+                                                                                         total_steps, total_failures, to_s(total_us));
+   for (const StepTestRecord& test : m_records)
+   {
+      const std::string test_name = xml_escape(test.suite + "." + test.name);
+      uint64_t wait_us = 0;
+      size_t failures = 0;
+      for (const StepEvent& step : test.steps)
+      {
+         wait_us += step.wait_us;
+         failures += test.failed && step.outcome == StepOutcome::FAILED;
+      }
+      fprintf(file, "  <testsuite name=\"%s\" tests=\"%zu\" failures=\"%zu\" skipped=\"%zu\" time=\"%.6f\">\n", test_name.c_str(),
+                                     test.steps.size(), failures, test.skipped? test.steps.size() : 0, to_s(test.duration_us));
+      fprintf(file, "    <properties>\n");
+      fprintf(file, "      <property name=\"result\" value=\"%s\"/>\n", test.failed? "failed" : (test.skipped? "skipped" : "passed"));
+      fprintf(file, "      <property name=\"wait_time\" value=\"%.6f\"/>\n", to_s(wait_us));
+      fprintf(file, "    </properties>\n");
+      for (size_t i = 0; i < test.steps.size(); i++)
+      {
+         const StepEvent& step = test.steps[i];
+         uint64_t offset_us = std::chrono::duration_cast<std::chrono::microseconds>(step.start - test.start).count();
+         fprintf(file, "    <testcase classname=\"%s\" name=\"%.3zu %s\" time=\"%.6f\">\n", test_name.c_str(), i + 1,
+                                                                                           xml_escape(step.name).c_str(), to_s(step.duration_us));
+         fprintf(file, "      <properties>\n");
+         fprintf(file, "        <property name=\"start\" value=\"%.6f\"/>\n", to_s(offset_us));
+         fprintf(file, "        <property name=\"wait_time\" value=\"%.6f\"/>\n", to_s(step.wait_us));
+         fprintf(file, "        <property name=\"outcome\" value=\"%s\"/>\n", outcome_to_string(step.outcome));
+         fprintf(file, "      </properties>\n");
+         if (test.failed && step.outcome == StepOutcome::FAILED)
+         {
+            fprintf(file, "      <failure message=\"%s\"/>\n", xml_escape(step.detail).c_str());
+         }
+         if (!step.detail.empty())
+         {
+            fprintf(file, "      <system-out>%s</system-out>\n", xml_escape(step.detail).c_str());
+         }
+         fprintf(file, "    </testcase>\n");
+      }
+      fprintf(file, "  </testsuite>\n");
+   }
+   fprintf(file, "</testsuites>\n");
+   fclose(file);
+   return true;
+}
+bool StepReportListener::writeSummary(FILE* file)
+{
+   struct SlowStep
+   {
+      const StepTestRecord* test;
+      const StepEvent* step;
+   };
+   struct StepTotal
+   {
+      size_t count = 0;
+      uint64_t duration_us = 0;
+      uint64_t wait_us = 0;
+   };
+   std::lock_guard<std::mutex> lock(m_mtx);
+   uint64_t suite_us = 0;
+   std::vector<SlowStep> slowest;
+   std::map<std::string, StepTotal> totals;
+   for (const StepTestRecord& test : m_records)
+   {
+      suite_us += test.duration_us;
+      for (const StepEvent& step : test.steps)
+      {
+         slowest.push_back({&test, &step});
+         StepTotal& total = totals[step.name];
+         total.count++;
+         total.duration_us += step.duration_us;
+         total.wait_us += step.wait_us;
+      }
+   }
+   size_t count = std::min(slowest.size(), (size_t)STEP_REPORT_SLOWEST_COUNT);
+   std::partial_sort(slowest.begin(), slowest.begin() + count, slowest.end(), [](const SlowStep& a, const SlowStep& b)
+                                                                              {
+                                                                                 return a.step->duration_us > b.step->duration_us;
+                                                                              });
+   std::vector<std::pair<std::string, StepTotal>> by_type(totals.begin(), totals.end());
+   std::sort(by_type.begin(), by_type.end(), [](const std::pair<std::string, StepTotal>& a, const std::pair<std::string, StepTotal>& b)
+                                             {
+                                                return a.second.duration_us > b.second.duration_us;
+                                             });
+
+   fprintf(file, "[ STEPS    ] %s: %zu tests, %.3f s\n", m_report_name.c_str(), m_records.size(), to_s(suite_us));
+   fprintf(file, "[ STEPS    ] slowest steps:\n");
+   for (size_t i = 0; i < count; i++)
+   {
+      fprintf(file, "[ STEPS    ] %9.3f s (wait %9.3f s) %s.%s: %s\n", to_s(slowest[i].step->duration_us), to_s(slowest[i].step->wait_us),
+                    slowest[i].test->suite.c_str(), slowest[i].test->name.c_str(),
+                    slowest[i].step->detail.empty()? slowest[i].step->name.c_str() : slowest[i].step->detail.c_str());
+   }
+   fprintf(file, "[ STEPS    ] time per step type:\n");
+   for (auto& type : by_type)
+   {
+      fprintf(file, "[ STEPS    ] %9.3f s (wait %9.3f s, %5.1f%% of tests) %6zu x %s\n", to_s(type.second.duration_us), to_s(type.second.wait_us),
+                    suite_us? 100.0 * type.second.duration_us / suite_us : 0.0, type.second.count, type.first.c_str());
+   }
+   fflush(file);
+   return true;
+}
+bool StepReportListener::writeWaits(FILE* file, size_t max_sites)
+{
+   struct WaitTotal
+   {
+      size_t count = 0;
+      size_t sleeps = 0;
+      size_t already_satisfied = 0;
+      uint64_t waited_us = 0;
+      uint64_t idle_us = 0;
+   };
+   auto add = [](WaitTotal& total, const WaitEvent& wait)
+              {
+                 total.count++;
+                 total.sleeps += !wait.conditional;
+                 total.already_satisfied += wait.already_satisfied;
+                 total.waited_us += wait.waited_us;
+                 total.idle_us += wait.idle_us;
+              };
+   std::lock_guard<std::mutex> lock(m_mtx);
+   uint64_t suite_us = 0;
+   WaitTotal all;
+   std::map<std::string, WaitTotal> suites;
+   std::map<std::string, WaitTotal> sites;
+   for (const StepTestRecord& test : m_records)
+   {
+      suite_us += test.duration_us;
+      for (const WaitEvent& wait : test.waits)
+      {
+         add(all, wait);
+         add(suites[test.suite], wait);
+         add(sites[std::string(file_name(wait.site.file)) + ":" + std::to_string(wait.site.line)], wait);
+      }
+   }
+   std::vector<std::pair<std::string, WaitTotal>> by_idle(sites.begin(), sites.end());
+   std::sort(by_idle.begin(), by_idle.end(), [](const std::pair<std::string, WaitTotal>& a, const std::pair<std::string, WaitTotal>& b)
+                                             {
+                                                return a.second.idle_us > b.second.idle_us;
+                                             });
+
+   fprintf(file, "[ WAITS    ] %s: %.3f s of %.3f s in waits (%.1f%%), removable idle %.3f s\n", m_report_name.c_str(), to_s(all.waited_us),
+                 to_s(suite_us), suite_us? 100.0 * all.waited_us / suite_us : 0.0, to_s(all.idle_us));
+   fprintf(file, "[ WAITS    ] per test suite:\n");
+   for (auto& suite : suites)
+   {
+      fprintf(file, "[ WAITS    ] %9.3f s (idle %9.3f s) %6zu waits %s\n", to_s(suite.second.waited_us), to_s(suite.second.idle_us),
+                    suite.second.count, suite.first.c_str());
+   }
+   fprintf(file, "[ WAITS    ] idle per call site:\n");
+   for (size_t i = 0; i < by_idle.size() && i < max_sites; i++)
+   {
+      const WaitTotal& total = by_idle[i].second;
+      fprintf(file, "[ WAITS    ] %9.3f s (of %9.3f s) %6zu x sleep, %6zu x until (%zu already true) %s\n", to_s(total.idle_us),
+                    to_s(total.waited_us), total.sleeps, total.count - total.sleeps, total.already_satisfied, by_idle[i].first.c_str());
+   }
+   fflush(file);
+   return true;
+}
+bool StepReportListener::writeSpool(const std::string& file_path)
+{
+   FILE* file = fopen(file_path.c_str(), "a");
+   if (!file)
+   {
+      logger_send(TF_ERROR, __func__, "cannot open %s", file_path.c_str());
+      return false;
+   }
+   std::lock_guard<std::mutex> lock(m_mtx);
+   for (const StepTestRecord& test : m_records)
+   {
+      fprintf(file, "T\t%s\t%s\t%lu\t%u\t%u\n", spool_escape(test.suite).c_str(), spool_escape(test.name).c_str(),
+                    (unsigned long)test.duration_us, test.failed, test.skipped);
+      for (const StepEvent& step : test.steps)
+      {
+         uint64_t offset_us = std::chrono::duration_cast<std::chrono::microseconds>(step.start - test.start).count();
+         fprintf(file, "S\t%s\t%s\t%lu\t%lu\t%lu\t%u\n", spool_escape(step.name).c_str(), spool_escape(step.detail).c_str(),
+                       (unsigned long)offset_us, (unsigned long)step.duration_us, (unsigned long)step.wait_us, (unsigned)step.outcome);
+      }
+      for (const WaitEvent& wait : test.waits)
+      {
+         fprintf(file, "W\t%s\t%d\t%u\t%u\t%u\t%lu\t%lu\t%lu\n", spool_escape(wait.site.file).c_str(), wait.site.line, wait.conditional,
+                       wait.satisfied, wait.already_satisfied, (unsigned long)wait.requested_us, (unsigned long)wait.waited_us,
+                       (unsigned long)wait.idle_us);
+      }
+   }
+   fclose(file);
+   return true;
+}
+bool StepReportListener::readSpool(const std::string& file_path)
+{
+   std::ifstream file(file_path);
+   if (!file)
+   {
+      logger_send(TF_ERROR, __func__, "cannot open %s", file_path.c_str());
+      return false;
+   }
+   std::lock_guard<std::mutex> lock(m_mtx);
+   std::string line;
+   while (std::getline(file, line))
+   {
+      std::vector<std::string> fields = spool_fields(line);
+      if (fields[0] == "T" && fields.size() == 6)
+      {
+         StepTestRecord test;
+         test.suite = fields[1];
+         test.name = fields[2];
+         test.start = std::chrono::steady_clock::now();
+         test.duration_us = strtoull(fields[3].c_str(), NULL, 10);
+         test.failed = fields[4] == "1";
+         test.skipped = fields[5] == "1";
+         m_records.push_back(test);
+      }
+      else if (fields[0] == "S" && fields.size() == 7 && !m_records.empty())
+      {
+         StepEvent step;
+         step.name = fields[1];
+         step.detail = fields[2];
+         step.start = m_records.back().start + std::chrono::microseconds(strtoull(fields[3].c_str(), NULL, 10));
+         step.duration_us = strtoull(fields[4].c_str(), NULL, 10);
+         step.wait_us = strtoull(fields[5].c_str(), NULL, 10);
+         step.outcome = (StepOutcome)atoi(fields[6].c_str());
+         m_records.back().steps.push_back(step);
+      }
+      else if (fields[0] == "W" && fields.size() == 9 && !m_records.empty())
+      {
+         WaitEvent wait = {};
+         wait.site.file = m_site_files.insert(fields[1]).first->c_str();
+         wait.site.line = atoi(fields[2].c_str());
+         wait.conditional = fields[3] == "1";
+         wait.satisfied = fields[4] == "1";
+         wait.already_satisfied = fields[5] == "1";
+         wait.requested_us = strtoull(fields[6].c_str(), NULL, 10);
+         wait.waited_us = strtoull(fields[7].c_str(), NULL, 10);
+         wait.idle_us = strtoull(fields[8].c_str(), NULL, 10);
+         m_records.back().waits.push_back(wait);
+      }
+      else
+      {
+         logger_send(TF_ERROR, __func__, "invalid line in %s: %s", file_path.c_str(), line.c_str());
+      }
+   }
+   return true;
+}
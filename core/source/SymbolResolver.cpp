@@ -0,0 +1,214 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <elf.h>
+#include <cxxabi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "SymbolResolver.h"
+#include "Logger.h"
+
+namespace
+{
+typedef struct
+{
+   uint64_t address;
+   uint64_t size;
+   std::string name;
+} ElfSymbol;
+
+typedef struct
+{
+   uint64_t offset;
+   uint64_t size;
+   uint64_t vaddr;
+} ElfSegment;
+
+}
+
+/* symbol table of single ELF file - .symtab if not stripped, .dynsym otherwise */
+class ElfSymbols
+{
+public:
+   bool load(const std::string& path)
+   {
+      int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      struct stat st = {};
+      if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Elf64_Ehdr))
+      {
+         if (fd >= 0) close(fd);
+         return false;
+      }
+      void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if (map == MAP_FAILED)
+      {
+         return false;
+      }
+      const uint8_t* file = (const uint8_t*)map;
+      size_t file_size = st.st_size;
+      const Elf64_Ehdr* ehdr = (const Elf64_Ehdr*)file;
+      bool result = memcmp(ehdr->e_ident, ELFMAG, SELFMAG) == 0 && ehdr->e_ident[EI_CLASS] == ELFCLASS64 &&
+                    ehdr->e_phoff + (size_t)ehdr->e_phnum * sizeof(Elf64_Phdr) <= file_size &&
+                    ehdr->e_shoff + (size_t)ehdr->e_shnum * sizeof(Elf64_Shdr) <= file_size;
+      if (result)
+      {
+         const Elf64_Phdr* phdrs = (const Elf64_Phdr*)(file + ehdr->e_phoff);
+         for (size_t i = 0; i < ehdr->e_phnum; i++)
+         {
+            if (phdrs[i].p_type == PT_LOAD)
+            {
+               m_segments.push_back({phdrs[i].p_offset, phdrs[i].p_filesz, phdrs[i].p_vaddr});
+            }
+         }
+         const Elf64_Shdr* shdrs = (const Elf64_Shdr*)(file + ehdr->e_shoff);
+         for (uint32_t wanted : {SHT_SYMTAB, SHT_DYNSYM})
+         {
+            for (size_t i = 0; i < ehdr->e_shnum && m_symbols.empty(); i++)
+            {
+               if (shdrs[i].sh_type == wanted && shdrs[i].sh_link < ehdr->e_shnum)
+               {
+                  readSymbols(file, file_size, shdrs[i], shdrs[shdrs[i].sh_link]);
+               }
+            }
+         }
+         std::sort(m_symbols.begin(), m_symbols.end(), [](const ElfSymbol& a, const ElfSymbol& b){ return a.address < b.address; });
+      }
+      munmap(map, file_size);
+      return result;
+   }
+   /* converts file offset to symbol name, empty if not found */
+   std::string find(uint64_t file_offset)
+   {
+      for (const ElfSegment& segment : m_segments)
+      {
+         if (file_offset >= segment.offset && file_offset < segment.offset + segment.size)
+         {
+            uint64_t vaddr = file_offset - segment.offset + segment.vaddr;
+            auto it = std::upper_bound(m_symbols.begin(), m_symbols.end(), vaddr,
+                                       [](uint64_t address, const ElfSymbol& symbol){ return address < symbol.address; });
+            if (it != m_symbols.begin() && vaddr < (it - 1)->address + (it - 1)->size)
+            {
+               return (it - 1)->name;
+            }
+            break;
+         }
+      }
+      return "";
+   }
+private:
+   void readSymbols(const uint8_t* file, size_t file_size, const Elf64_Shdr& symtab, const Elf64_Shdr& strtab)
+   {
+      if (symtab.sh_offset + symtab.sh_size > file_size || strtab.sh_offset + strtab.sh_size > file_size)
+      {
+         return;
+      }
+      const Elf64_Sym* symbols = (const Elf64_Sym*)(file + symtab.sh_offset);
+      const char* names = (const char*)(file + strtab.sh_offset);
+      for (size_t i = 0; i < symtab.sh_size / sizeof(Elf64_Sym); i++)
+      {
+         if (ELF64_ST_TYPE(symbols[i].st_info) == STT_FUNC && symbols[i].st_value != 0 && symbols[i].st_name < strtab.sh_size)
+         {
+            m_symbols.push_back({symbols[i].st_value, std::max(symbols[i].st_size, (Elf64_Xword)1), demangle(names + symbols[i].st_name)});
+         }
+      }
+   }
+   static std::string demangle(const char* name)
+   {
+      int status = 0;
+      char* demangled = abi::__cxa_demangle(name, NULL, NULL, &status);
+      std::string result = (status == 0 && demangled)? demangled : name;
+      free(demangled);
+      /* ';' separates frames in folded format */
+      std::replace(result.begin(), result.end(), ';', ':');
+      return result;
+   }
+
+   std::vector<ElfSegment> m_segments;
+   std::vector<ElfSymbol> m_symbols;
+};
+
+SymbolResolver::SymbolResolver()
+{
+}
+SymbolResolver::~SymbolResolver()
+{
+   /* defined here, where ElfSymbols is complete */
+}
+bool SymbolResolver::loadMappings(pid_t pid)
+{
+   char path [64];
+   snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+   FILE* maps = fopen(path, "r");
+   if (!maps)
+   {
+      logger_send(TF_ERROR, __func__, "cannot read %s, symbols will not be resolved", path);
+      return false;
+   }
+   char line [512];
+   while (fgets(line, sizeof(line), maps))
+   {
+      addMapping(line);
+   }
+   fclose(maps);
+   return true;
+}
+bool SymbolResolver::addMapping(const char* maps_line)
+{
+   unsigned long start = 0, end = 0, offset = 0;
+   char perms [8] = {};
+   int name_pos = 0;
+   /* only executable mappings contain code addresses */
+   if (sscanf(maps_line, "%lx-%lx %7s %lx %*s %*s %n", &start, &end, perms, &offset, &name_pos) >= 4 && perms[2] == 'x')
+   {
+      std::string name = maps_line + name_pos;
+      name.erase(name.find_last_not_of(" \n") + 1);
+      m_mappings.push_back({start, end, offset, name});
+      return true;
+   }
+   return false;
+}
+std::string SymbolResolver::resolve(uint64_t address)
+{
+   char text [64];
+   for (const SymbolMapping& mapping : m_mappings)
+   {
+      if (address >= mapping.start && address < mapping.end)
+      {
+         uint64_t file_offset = address - mapping.start + mapping.offset;
+         if (!mapping.path.empty() && mapping.path[0] == '/')
+         {
+            std::unique_ptr<ElfSymbols>& symbols = m_files[mapping.path];
+            if (!symbols)
+            {
+               symbols.reset(new ElfSymbols());
+               symbols->load(mapping.path);
+            }
+            std::string symbol = symbols->find(file_offset);
+            if (!symbol.empty())
+            {
+               return symbol;
+            }
+         }
+         const char* module = strrchr(mapping.path.c_str(), '/');
+         snprintf(text, sizeof(text), "%s+0x%lx", module? module + 1 : mapping.path.c_str(), (unsigned long)file_offset);
+         return text;
+      }
+   }
+   snprintf(text, sizeof(text), "[unknown 0x%lx]", (unsigned long)address);
+   return text;
+}
+void SymbolResolver::clear()
+{
+   m_mappings.clear();
+   m_files.clear();
+}
@@ -0,0 +1,711 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <map>
+#include <algorithm>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "TestCluster.h"
+#include "TestSubjectExecutor.h"
+#include "HwStubEncoder.h"
+#include "SocketDriver.h"
+#include "TestStep.h"
+#include "system_config_values.h"
+#include "Logger.h"
+
+namespace
+{
+enum ClusterChannel : uint8_t
+{
+   CLUSTER_HW_STUB,
+   CLUSTER_BLUETOOTH,
+   CLUSTER_APP_NTF,
+   CLUSTER_CHANNEL_COUNT,
+};
+const char* CHANNEL_NAMES [CLUSTER_CHANNEL_COUNT] = {"hw_stub", "bluetooth", "app_ntf"};
+
+/* epoll data: subject index, channel and listening socket flag */
+const uint64_t WAKEUP_TAG = UINT64_MAX;
+uint64_t make_tag(size_t idx, uint8_t channel, bool listener)
+{
+   return ((uint64_t)idx << 8) | ((uint64_t)channel << 1) | (listener? 1 : 0);
+}
+
+std::string subject_to_string(size_t subject)
+{
+   return subject == CLUSTER_ALL_SUBJECTS? "all" : std::to_string(subject);
+}
+
+/* text of the longest stimulus frame (DHT_STATE_SET) */
+const size_t STIMULUS_TEXT_SIZE = hw_stub::text_size<hw_stub::FrameTraits<DHT_STATE_SET>::LENGTH + 2>();
+
+/**
+ * @brief Compares notification kept in subject history with expected one.
+ *        Notification longer than HISTORY_PAYLOAD_SIZE is kept truncated and never matches.
+ */
+bool ntf_matches(const HistoryRecord& record, NTF_CMD_ID id, const std::vector<uint8_t>& msg)
+{
+   bool result = false;
+   if (record.id == id && record.size == msg.size())
+   {
+      if (record.flags & HISTORY_FLAG_TRUNCATED)
+      {
+         logger_send(TF_ERROR, __func__, "notification %u longer than %u bytes, not compared", id, HISTORY_PAYLOAD_SIZE);
+      }
+      else
+      {
+         result = memcmp(record.payload, msg.data(), msg.size()) == 0;
+      }
+   }
+   return result;
+}
+}
+
+struct ClusterLink
+{
+   int listen_fd = -1;
+   int fd = -1;
+   std::vector<char> rx;                  /**< Received, not complete frame */
+   std::vector<char> tx;                  /**< Not sent yet, socket was full */
+};
+
+/**
+ * @brief State of single subject. Links are used only by reactor thread (or when it is not running),
+ *        remaining fields are protected by TestCluster::m_mtx.
+ */
+struct ClusterSubject
+{
+   ClusterSubject(size_t idx):
+   index(idx),
+   executor("")
+   {
+   }
+   size_t index;
+   FakeSubject fake;
+   TestSubjectExecutor executor;
+   pid_t pid = 0;
+   ClusterLink links [CLUSTER_CHANNEL_COUNT];
+   uint16_t inputs = 0xFFFF;              /**< Inputs board state set by stimuli */
+   std::map<uint8_t, uint16_t> i2c_states;
+   HistoryRecord ntfs [CLUSTER_NTF_HISTORY];
+   size_t ntf_count = 0;
+   ClusterSubjectStats stats;
+};
+
+TestCluster::TestCluster():
+m_base_port(CLUSTER_BASE_PORT),
+m_epoll_fd(-1),
+m_wakeup_fd(-1),
+m_thread_running(false),
+m_sequence(0)
+{
+}
+TestCluster::~TestCluster()
+{
+   stop();
+}
+void TestCluster::addBehavior(const FakeBehavior& behavior)
+{
+   m_behaviors.push_back(behavior);
+}
+void TestCluster::setBasePort(uint16_t port)
+{
+   m_base_port = port;
+}
+bool TestCluster::start(size_t count, bool as_child)
+{
+   TestStep step(__func__);
+   bool result = false;
+   do
+   {
+      if (!m_subjects.empty() || count == 0 || count > CLUSTER_MAX_SUBJECTS ||
+          (size_t)m_base_port + CLUSTER_CHANNEL_COUNT * count > UINT16_MAX)
+      {
+         logger_send(TF_ERROR, __func__, "cannot start %zu subjects from port %u, %zu running", count, m_base_port, m_subjects.size());
+         break;
+      }
+      /* listening, server and in-process client socket of every channel */
+      struct rlimit limit;
+      rlim_t needed = 3 * CLUSTER_CHANNEL_COUNT * count + 64;
+      if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < needed)
+      {
+         limit.rlim_cur = std::min(needed, limit.rlim_max);
+         setrlimit(RLIMIT_NOFILE, &limit);
+         logger_send_if(limit.rlim_cur < needed, TF_ERROR, __func__, "descriptor limit %lu too low for %zu subjects",
+                        (unsigned long)limit.rlim_cur, count);
+      }
+
+      bool listening = true;
+      for (size_t i = 0; i < count && listening; i++)
+      {
+         m_subjects.emplace_back(new ClusterSubject(i));
+         listening = openListeners(*m_subjects.back(), i);
+      }
+      if (!listening)
+      {
+         break;
+      }
+
+      /* children are forked before reactor exists, so they do not inherit its descriptors and accepted sockets */
+      for (auto& subject : m_subjects)
+      {
+         uint16_t port = m_base_port + CLUSTER_CHANNEL_COUNT * subject->index;
+         subject->fake.setPorts(port + CLUSTER_HW_STUB, port + CLUSTER_BLUETOOTH, port + CLUSTER_APP_NTF);
+         for (const FakeBehavior& behavior : m_behaviors)
+         {
+            subject->fake.addBehavior(behavior);
+         }
+         subject->executor.set_resource_sampling(0, "");
+         subject->executor.use_fake_subject(&subject->fake, as_child);
+         subject->pid = subject->executor.start_test_subject();
+      }
+
+      m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+      m_wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if (m_epoll_fd < 0 || m_wakeup_fd < 0)
+      {
+         logger_send(TF_ERROR, __func__, "cannot create reactor: %s", strerror(errno));
+         break;
+      }
+      struct epoll_event event = {};
+      event.events = EPOLLIN;
+      event.data.u64 = WAKEUP_TAG;
+      epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wakeup_fd, &event);
+      for (auto& subject : m_subjects)
+      {
+         for (uint8_t ch = 0; ch < CLUSTER_CHANNEL_COUNT; ch++)
+         {
+            event.data.u64 = make_tag(subject->index, ch, true);
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, subject->links[ch].listen_fd, &event);
+         }
+      }
+      m_thread_running = true;
+      m_thread = std::thread(&TestCluster::threadExecute, this);
+
+      result = waitFor(CLUSTER_ALL_SUBJECTS, CLUSTER_CONNECT_TIMEOUT_MS, [](ClusterSubject& subject) { return subject.stats.connected; });
+      logger_send_if(!result, TF_ERROR, __func__, "only %zu of %zu subjects connected", getStats().connected, count);
+   } while(0);
+
+   if (!result)
+   {
+      stop();
+   }
+   step.finish(result, "%s : %zu subjects%s => %u", __func__, count, as_child? " in child processes" : "", result);
+   return result;
+}
+bool TestCluster::openListeners(ClusterSubject& subject, size_t idx)
+{
+   bool result = true;
+   for (uint8_t ch = 0; ch < CLUSTER_CHANNEL_COUNT && result; ch++)
+   {
+      uint16_t port = m_base_port + CLUSTER_CHANNEL_COUNT * idx + ch;
+      int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      int enable = 1;
+      struct sockaddr_in addr = {};
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(port);
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      result = fd >= 0 &&
+               setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) == 0 &&
+               bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 &&
+               listen(fd, 4) == 0;
+      logger_send_if(!result, TF_ERROR, __func__, "[%u] cannot open %s server: %s", port, CHANNEL_NAMES[ch], strerror(errno));
+      subject.links[ch].listen_fd = fd;
+   }
+   return result;
+}
+void TestCluster::stop()
+{
+   if (m_subjects.empty())
+   {
+      return;
+   }
+   TestStep step(__func__);
+   /* all children are shutting down in parallel, stop_test_subject() only reaps them */
+   for (auto& subject : m_subjects)
+   {
+      if (subject->pid > 0)
+      {
+         kill(subject->pid, SIGINT);
+      }
+   }
+   size_t clean_exits = 0;
+   for (auto& subject : m_subjects)
+   {
+      clean_exits += subject->executor.stop_test_subject(subject->pid);
+   }
+
+   if (m_thread_running)
+   {
+      m_thread_running = false;
+      uint64_t value = 1;
+      if (::write(m_wakeup_fd, &value, sizeof(value)) < 0)
+      {
+         logger_send(TF_ERROR, __func__, "cannot wake up reactor: %s", strerror(errno));
+      }
+      m_thread.join();
+   }
+   for (auto& subject : m_subjects)
+   {
+      for (uint8_t ch = 0; ch < CLUSTER_CHANNEL_COUNT; ch++)
+      {
+         closeChannel(*subject, ch);
+         if (subject->links[ch].listen_fd >= 0)
+         {
+            ::close(subject->links[ch].listen_fd);
+         }
+      }
+   }
+   for (int* fd : {&m_epoll_fd, &m_wakeup_fd})
+   {
+      if (*fd >= 0)
+      {
+         ::close(*fd);
+         *fd = -1;
+      }
+   }
+   size_t count = m_subjects.size();
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      m_subjects.clear();
+      m_stimuli = decltype(m_stimuli)();
+   }
+   step.done("%s : %zu subjects, %zu stopped cleanly", __func__, count, clean_exits);
+}
+size_t TestCluster::size()
+{
+   return m_subjects.size();
+}
+bool TestCluster::setInputState(size_t subject, INPUT_ID id, INPUT_STATE state, uint32_t delay_ms)
+{
+   TestStep step(__func__);
+   bool result = schedule({{}, 0, subject, StimulusType::INPUT, (uint8_t)id, (uint8_t)state, 0, 0}, delay_ms);
+   step.finish(result, "%s:%s %u %u +%u ms => %u", __func__, subject_to_string(subject).c_str(), id, state, delay_ms, result);
+   return result;
+}
+bool TestCluster::setSensorState(size_t subject, DHT_SENSOR_ID id, DHT_SENSOR_TYPE type, int8_t temp, int8_t hum, uint32_t delay_ms)
+{
+   TestStep step(__func__);
+   bool result = schedule({{}, 0, subject, StimulusType::SENSOR, (uint8_t)id, (uint8_t)type, temp, hum}, delay_ms);
+   step.finish(result, "%s:%s %u %u %d %d +%u ms => %u", __func__, subject_to_string(subject).c_str(), id, type, temp, hum, delay_ms, result);
+   return result;
+}
+bool TestCluster::triggerInterrupt(size_t subject, uint32_t delay_ms)
+{
+   TestStep step(__func__);
+   bool result = schedule({{}, 0, subject, StimulusType::INTERRUPT, 0, 0, 0, 0}, delay_ms);
+   step.finish(result, "%s:%s +%u ms => %u", __func__, subject_to_string(subject).c_str(), delay_ms, result);
+   return result;
+}
+bool TestCluster::schedule(Stimulus stimulus, uint32_t delay_ms)
+{
+   if (!m_thread_running || (stimulus.subject != CLUSTER_ALL_SUBJECTS && stimulus.subject >= m_subjects.size()))
+   {
+      return false;
+   }
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      stimulus.due = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay_ms);
+      stimulus.sequence = m_sequence++;
+      m_stimuli.push(stimulus);
+   }
+   uint64_t value = 1;
+   return ::write(m_wakeup_fd, &value, sizeof(value)) == sizeof(value);
+}
+uint16_t TestCluster::getI2CState(size_t subject, uint8_t address)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   uint16_t result = 0xFFFF;
+   if (subject < m_subjects.size())
+   {
+      auto it = m_subjects[subject]->i2c_states.find(address);
+      result = it != m_subjects[subject]->i2c_states.end()? it->second : 0xFFFF;
+   }
+   return result;
+}
+bool TestCluster::waitForI2CState(size_t subject, uint8_t address, uint16_t state, uint32_t timeout_ms)
+{
+   TestStep step(__func__);
+   bool result = waitFor(subject, timeout_ms, [address, state](ClusterSubject& s)
+                                              {
+                                                 auto it = s.i2c_states.find(address);
+                                                 return it != s.i2c_states.end() && it->second == state;
+                                              });
+   step.finish(result, "%s:%s %u 0x%.4x => %u (%zu subjects in state)", __func__, subject_to_string(subject).c_str(), address, state, result, countI2CState(address, state));
+   return result;
+}
+bool TestCluster::waitForAppNtf(size_t subject, NTF_CMD_ID id, const std::vector<uint8_t>& msg, uint32_t timeout_ms)
+{
+   TestStep step(__func__);
+   auto sent = [id, &msg](ClusterSubject& s)
+   {
+      bool result = false;
+      for (size_t i = 0; i < std::min(s.ntf_count, (size_t)CLUSTER_NTF_HISTORY) && !result; i++)
+      {
+         result = ntf_matches(s.ntfs[i], id, msg);
+      }
+      return result;
+   };
+   bool result = waitFor(subject, timeout_ms, sent);
+   step.finish(result, "%s:%s %u => %u (%zu subjects sent)", __func__, subject_to_string(subject).c_str(), id, result, countAppNtfSent(id, msg));
+   return result;
+}
+size_t TestCluster::countI2CState(uint8_t address, uint16_t state)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   return std::count_if(m_subjects.begin(), m_subjects.end(), [address, state](std::unique_ptr<ClusterSubject>& s)
+                                                              {
+                                                                 auto it = s->i2c_states.find(address);
+                                                                 return it != s->i2c_states.end() && it->second == state;
+                                                              });
+}
+size_t TestCluster::countAppNtfSent(NTF_CMD_ID id, const std::vector<uint8_t>& msg)
+{
+   size_t result = 0;
+   std::lock_guard<std::mutex> lock(m_mtx);
+   for (auto& s : m_subjects)
+   {
+      for (size_t i = 0; i < std::min(s->ntf_count, (size_t)CLUSTER_NTF_HISTORY); i++)
+      {
+         if (ntf_matches(s->ntfs[i], id, msg))
+         {
+            result++;
+            break;
+         }
+      }
+   }
+   return result;
+}
+ClusterSubjectStats TestCluster::getSubjectStats(size_t subject)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   return subject < m_subjects.size()? m_subjects[subject]->stats : ClusterSubjectStats();
+}
+ClusterStats TestCluster::getStats()
+{
+   ClusterStats result;
+   std::lock_guard<std::mutex> lock(m_mtx);
+   result.subjects = m_subjects.size();
+   for (auto& s : m_subjects)
+   {
+      result.connected += s->stats.connected;
+      result.total.frames_in += s->stats.frames_in;
+      result.total.bytes_in += s->stats.bytes_in;
+      result.total.frames_out += s->stats.frames_out;
+      result.total.bytes_out += s->stats.bytes_out;
+      result.total.write_failures += s->stats.write_failures;
+      result.total.i2c_ntfs += s->stats.i2c_ntfs;
+      result.total.app_ntfs += s->stats.app_ntfs;
+      result.total.logs += s->stats.logs;
+   }
+   return result;
+}
+bool TestCluster::waitFor(size_t subject, uint32_t timeout_ms, const std::function<bool(ClusterSubject&)>& predicate)
+{
+   if (subject != CLUSTER_ALL_SUBJECTS && subject >= m_subjects.size())
+   {
+      return false;
+   }
+   auto check = [this, subject, &predicate]()
+   {
+      return subject == CLUSTER_ALL_SUBJECTS?
+             std::all_of(m_subjects.begin(), m_subjects.end(), [&predicate](std::unique_ptr<ClusterSubject>& s) { return predicate(*s); }) :
+             predicate(*m_subjects[subject]);
+   };
+   std::unique_lock<std::mutex> lock(m_mtx);
+   auto wait_start = std::chrono::steady_clock::now();
+   bool result = m_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), check);
+   TestStep::recordWait(std::chrono::steady_clock::now() - wait_start);
+   return result;
+}
+void TestCluster::threadExecute()
+{
+   struct epoll_event events [CLUSTER_MAX_EPOLL_EVENTS];
+   std::vector<Stimulus> due;
+   while (m_thread_running)
+   {
+      int count = epoll_wait(m_epoll_fd, events, CLUSTER_MAX_EPOLL_EVENTS, nextTimeout());
+      for (int i = 0; i < count; i++)
+      {
+         uint64_t tag = events[i].data.u64;
+         if (tag == WAKEUP_TAG)
+         {
+            uint64_t value;
+            while (::read(m_wakeup_fd, &value, sizeof(value)) > 0);
+            continue;
+         }
+         size_t idx = tag >> 8;
+         uint8_t channel = (tag >> 1) & 0x7F;
+         if (tag & 1)
+         {
+            onAccept(idx, channel);
+            continue;
+         }
+         if (events[i].events & EPOLLOUT)
+         {
+            onWritable(idx, channel);
+         }
+         if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !onReadable(idx, channel))
+         {
+            logger_send(TF_CLUSTER, __func__, "subject %zu: %s disconnected", idx, CHANNEL_NAMES[channel]);
+            closeChannel(*m_subjects[idx], channel);
+         }
+      }
+
+      {
+         std::lock_guard<std::mutex> lock(m_mtx);
+         auto now = std::chrono::steady_clock::now();
+         while (!m_stimuli.empty() && m_stimuli.top().due <= now)
+         {
+            due.push_back(m_stimuli.top());
+            m_stimuli.pop();
+         }
+      }
+      for (const Stimulus& stimulus : due)
+      {
+         if (stimulus.subject == CLUSTER_ALL_SUBJECTS)
+         {
+            for (auto& subject : m_subjects)
+            {
+               executeStimulus(*subject, stimulus);
+            }
+         }
+         else
+         {
+            executeStimulus(*m_subjects[stimulus.subject], stimulus);
+         }
+      }
+      due.clear();
+   }
+}
+int TestCluster::nextTimeout()
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   int result = -1;
+   if (!m_stimuli.empty())
+   {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(m_stimuli.top().due - std::chrono::steady_clock::now());
+      /* rounded up, so stimulus is not executed before its time */
+      result = left.count() < 0? 0 : left.count() + 1;
+   }
+   return result;
+}
+void TestCluster::onAccept(size_t idx, uint8_t channel)
+{
+   ClusterSubject& subject = *m_subjects[idx];
+   ClusterLink& link = subject.links[channel];
+   int fd = accept4(link.listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+   if (fd < 0)
+   {
+      return;
+   }
+   if (link.fd >= 0)
+   {
+      logger_send(TF_CLUSTER, __func__, "subject %zu: %s reconnected", idx, CHANNEL_NAMES[channel]);
+      closeChannel(subject, channel);
+   }
+   int enable = 1;
+   setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+   struct epoll_event event = {};
+   event.events = EPOLLIN;
+   event.data.u64 = make_tag(idx, channel, false);
+   epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+   link.fd = fd;
+
+   bool connected = std::all_of(std::begin(subject.links), std::end(subject.links), [](const ClusterLink& l) { return l.fd >= 0; });
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      subject.stats.connected = connected;
+   }
+   m_cv.notify_all();
+}
+bool TestCluster::onReadable(size_t idx, uint8_t channel)
+{
+   ClusterSubject& subject = *m_subjects[idx];
+   ClusterLink& link = subject.links[channel];
+   char buffer [SOCKDRV_RECV_BUFFER_SIZE];
+   while (true)
+   {
+      ssize_t count = recv(link.fd, buffer, sizeof(buffer), 0);
+      if (count > 0)
+      {
+         link.rx.insert(link.rx.end(), buffer, buffer + count);
+      }
+      else if (count < 0 && errno == EINTR)
+      {
+         continue;
+      }
+      else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      {
+         break;
+      }
+      else
+      {
+         return false;
+      }
+   }
+
+   size_t pos = 0;
+   while (link.rx.size() - pos >= SOCK_MSG_HEADER_SIZE)
+   {
+      char header [SOCK_MSG_HEADER_SIZE + 1];
+      memcpy(header, link.rx.data() + pos, SOCK_MSG_HEADER_SIZE);
+      header[SOCK_MSG_HEADER_SIZE] = 0x00;
+      size_t size = atoi(header);
+      if (size > SOCKDRV_RECV_BUFFER_SIZE)
+      {
+         logger_send(TF_ERROR, __func__, "subject %zu: invalid %s frame size %zu", idx, CHANNEL_NAMES[channel], size);
+         return false;
+      }
+      if (link.rx.size() - pos - SOCK_MSG_HEADER_SIZE < size)
+      {
+         break;
+      }
+      onFrame(subject, channel, link.rx.data() + pos + SOCK_MSG_HEADER_SIZE, size);
+      pos += SOCK_MSG_HEADER_SIZE + size;
+   }
+   link.rx.erase(link.rx.begin(), link.rx.begin() + pos);
+   return true;
+}
+void TestCluster::onFrame(ClusterSubject& subject, uint8_t channel, const char* data, size_t size)
+{
+   uint8_t bytes [SOCKDRV_RECV_BUFFER_SIZE / 2 + 1];
+   size_t count = channel == CLUSTER_BLUETOOTH? 0 : hw_stub::decode(data, size, bytes, sizeof(bytes));
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      subject.stats.frames_in++;
+      subject.stats.bytes_in += size;
+      if (channel == CLUSTER_HW_STUB && count == 5 && bytes[0] == I2C_STATE_NTF && bytes[1] == 3)
+      {
+         subject.i2c_states[bytes[2]] = bytes[3] | (bytes[4] << 8);
+         subject.stats.i2c_ntfs++;
+      }
+      else if (channel == CLUSTER_APP_NTF && count > 0)
+      {
+         subject.ntfs[subject.ntf_count++ % CLUSTER_NTF_HISTORY] = EventHistory::makeRecord(bytes[0], 0, bytes, count);
+         subject.stats.app_ntfs++;
+      }
+      else if (channel == CLUSTER_BLUETOOTH)
+      {
+         subject.stats.logs++;
+      }
+   }
+   m_cv.notify_all();
+}
+void TestCluster::executeStimulus(ClusterSubject& subject, const Stimulus& stimulus)
+{
+   char text [STIMULUS_TEXT_SIZE];
+   size_t size = 0;
+   switch (stimulus.type)
+   {
+   case StimulusType::INPUT:
+      if (stimulus.state == INPUT_STATE_ACTIVE)
+      {
+         subject.inputs &= ~hw_stub::input_mask((INPUT_ID)stimulus.id);
+      }
+      else
+      {
+         subject.inputs |= hw_stub::input_mask((INPUT_ID)stimulus.id);
+      }
+      size = hw_stub::encode(hw_stub::make_i2c_frame<I2C_STATE_SET>(INPUTS_I2C_ADDRESS, subject.inputs), text);
+      break;
+   case StimulusType::SENSOR:
+      size = hw_stub::encode(hw_stub::make_dht_frame(stimulus.id, stimulus.state, stimulus.temp, stimulus.hum), text);
+      break;
+   case StimulusType::INTERRUPT:
+      size = hw_stub::encode(hw_stub::make_frame<I2C_INT_TRIGGER>(), text);
+      break;
+   default:
+      break;
+   }
+   sendFrame(subject, CLUSTER_HW_STUB, text, size);
+}
+void TestCluster::sendFrame(ClusterSubject& subject, uint8_t channel, const char* data, size_t size)
+{
+   ClusterLink& link = subject.links[channel];
+   bool result = link.fd >= 0 && size <= SOCKDRV_MAX_RW_SIZE;
+   if (result)
+   {
+      char frame [SOCK_MSG_HEADER_SIZE + SOCKDRV_MAX_RW_SIZE + 1];
+      snprintf(frame, sizeof(frame), "%.4u", (unsigned)size);
+      memcpy(frame + SOCK_MSG_HEADER_SIZE, data, size);
+      size_t frame_size = SOCK_MSG_HEADER_SIZE + size;
+      size_t sent = 0;
+      if (link.tx.empty())
+      {
+         ssize_t count = ::send(link.fd, frame, frame_size, MSG_NOSIGNAL);
+         sent = count > 0? count : 0;
+         result = count >= 0 || errno == EAGAIN || errno == EWOULDBLOCK;
+      }
+      if (result && sent < frame_size)
+      {
+         /* socket buffer full - rest is sent when socket becomes writable */
+         bool was_empty = link.tx.empty();
+         link.tx.insert(link.tx.end(), frame + sent, frame + frame_size);
+         if (was_empty)
+         {
+            struct epoll_event event = {};
+            event.events = EPOLLIN | EPOLLOUT;
+            event.data.u64 = make_tag(subject.index, channel, false);
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, link.fd, &event);
+         }
+      }
+   }
+   std::lock_guard<std::mutex> lock(m_mtx);
+   if (result)
+   {
+      subject.stats.frames_out++;
+      subject.stats.bytes_out += size;
+   }
+   else
+   {
+      subject.stats.write_failures++;
+   }
+}
+void TestCluster::onWritable(size_t idx, uint8_t channel)
+{
+   ClusterLink& link = m_subjects[idx]->links[channel];
+   ssize_t count = link.tx.empty()? 0 : ::send(link.fd, link.tx.data(), link.tx.size(), MSG_NOSIGNAL);
+   if (count > 0)
+   {
+      link.tx.erase(link.tx.begin(), link.tx.begin() + count);
+   }
+   if (link.tx.empty())
+   {
+      struct epoll_event event = {};
+      event.events = EPOLLIN;
+      event.data.u64 = make_tag(idx, channel, false);
+      epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, link.fd, &event);
+   }
+}
+void TestCluster::closeChannel(ClusterSubject& subject, uint8_t channel)
+{
+   ClusterLink& link = subject.links[channel];
+   if (link.fd >= 0)
+   {
+      if (m_epoll_fd >= 0)
+      {
+         epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, link.fd, nullptr);
+      }
+      ::close(link.fd);
+      link.fd = -1;
+      link.rx.clear();
+      link.tx.clear();
+      std::lock_guard<std::mutex> lock(m_mtx);
+      subject.stats.connected = false;
+   }
+}
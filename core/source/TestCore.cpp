@@ -1,6 +1,8 @@
 /* =============================
  *   Includes of common headers
  * =============================*/
+#include <string.h>
+#include <algorithm>
 /* =============================
  *   Includes of project headers
  * =============================*/
@@ -9,16 +11,47 @@
 #include "Logger.h"
 
 TestCore::TestCore():
+m_history_limit(HISTORY_DEFAULT_MEMORY_LIMIT),
+m_sampling_period_ms(SAMPLER_DEFAULT_PERIOD_MS),
+m_profiling_frequency_hz(0),
+m_alloc_tracking(false),
 m_bin_exec(TEST_BINARY_ABSOLUTE_PATH),
-m_test_bin_pid(0)
+m_test_running(false),
+m_test_bin_pid(0),
+m_next_event_hook_id(0)
 {
    m_i2c_map[RELAYS_I2C_ADDRESS].i2c_address = RELAYS_I2C_ADDRESS;
    m_i2c_map[INPUTS_I2C_ADDRESS].i2c_address = INPUTS_I2C_ADDRESS;
    m_i2c_map[SLM_I2C_ADDRESS].i2c_address = SLM_I2C_ADDRESS;
 
 }
+void TestCore::useFakeSubject(FakeSubject* subject, bool as_child)
+{
+   m_bin_exec.use_fake_subject(subject, as_child);
+}
+void TestCore::setHistoryLimit(size_t memory_limit)
+{
+   m_history_limit = memory_limit;
+}
+void TestCore::setResourceSampling(uint32_t period_ms)
+{
+   m_sampling_period_ms = period_ms;
+}
+void TestCore::enableProfiling(uint32_t frequency_hz)
+{
+   m_profiling_frequency_hz = frequency_hz;
+}
+bool TestCore::isProfiling()
+{
+   return m_bin_exec.get_profiler().isRunning();
+}
+void TestCore::enableAllocTracking(bool enable)
+{
+   m_alloc_tracking = enable;
+}
 bool TestCore::runTest(const std::string& test_name)
 {
+   TestStep step(__func__);
    bool result = false;
    if (!logger_initialize(test_name))
    {
@@ -26,6 +59,28 @@ bool TestCore::runTest(const std::string& test_name)
    }
 
    logger_send(TF_TEST_MARKER, "TEST_BEGIN", "%s", test_name.c_str());
+   m_test_name = test_name;
+   m_test_running = true;
+
+   char trace_path [512];
+   snprintf(trace_path, 512, "%s/logs/%s.trace", PROJECT_ROOT_PATH, test_name.c_str());
+   if (!m_recorder.open(trace_path))
+   {
+      logger_send(TF_ERROR, __func__, "Cannot create trace file - frames will not be recorded");
+   }
+   char spill_path [512];
+   snprintf(spill_path, 512, "%s/logs/%s.app_ntf.spill", PROJECT_ROOT_PATH, test_name.c_str());
+   m_app_ntfs.configure(spill_path, m_history_limit);
+   for (auto& board : m_i2c_map)
+   {
+      snprintf(spill_path, 512, "%s/logs/%s.i2c_%.2x_history.spill", PROJECT_ROOT_PATH, test_name.c_str(), board.first);
+      board.second.history.configure(spill_path, m_history_limit);
+      board.second.history_cursor = 0;
+      snprintf(spill_path, 512, "%s/logs/%s.i2c_%.2x_buffer.spill", PROJECT_ROOT_PATH, test_name.c_str(), board.first);
+      board.second.buffer.configure(spill_path, m_history_limit);
+      board.second.bus = I2CBusStats();
+   }
+   registerMetrics();
 
    m_hwstub_driver.addListener([&](DriverEvent ev, const std::vector<uint8_t>& data, size_t size)
                                  {
@@ -41,71 +96,140 @@ bool TestCore::runTest(const std::string& test_name)
                                  });
 
    /* run tested binary */
+   char timeline_path [512];
+   snprintf(timeline_path, 512, "%s/logs/%s.resources.csv", PROJECT_ROOT_PATH, test_name.c_str());
+   m_bin_exec.set_resource_sampling(m_sampling_period_ms, timeline_path);
+   char folded_path [512];
+   snprintf(folded_path, 512, "%s/logs/%s.folded", PROJECT_ROOT_PATH, test_name.c_str());
+   m_bin_exec.set_profiling(m_profiling_frequency_hz, folded_path);
+   char alloc_raw_path [512];
+   char alloc_report_path [512];
+   snprintf(alloc_raw_path, 512, "%s/logs/%s.alloc.raw", PROJECT_ROOT_PATH, test_name.c_str());
+   snprintf(alloc_report_path, 512, "%s/logs/%s.alloc.json", PROJECT_ROOT_PATH, test_name.c_str());
+   m_bin_exec.set_alloc_tracking(m_alloc_tracking? alloc_raw_path : "", alloc_report_path, test_name);
    m_test_bin_pid = m_bin_exec.start_test_subject();
 
    m_hwstub_driver.connect("127.0.0.1", HW_STUB_CONTROL_PORT);
    m_bluetooth_driver.connect("127.0.0.1", BLUETOOTH_FORWARDING_PORT);
    m_app_ntf_driver.connect("127.0.0.1", WIFI_NTF_FORWARDING_PORT);
+   m_debug.start([this](const SocketFrame* frames, size_t count) -> bool
+                 {
+                    for (size_t i = 0; i < count; i++)
+                    {
+                       m_recorder.record(TraceChannel::BLUETOOTH, TraceDirection::OUTBOUND, frames[i].data, frames[i].size);
+                    }
+                    return m_bluetooth_driver.write(frames, count);
+                 });
 
-   auto time = std::chrono::system_clock::now();
-   while ( (std::chrono::system_clock::now() - time) < std::chrono::seconds(SOCK_CLIENT_WAIT_TMOUT_S))
-   {
-      if (m_hwstub_driver.isConnected() &&
-          m_bluetooth_driver.isConnected() &&
-          m_app_ntf_driver.isConnected())
-      {
-         result = true;
-         break;
-      }
-      else
-      {
-         std::this_thread::sleep_for(std::chrono::milliseconds(10));
-      }
-   }
+   result = TestWait::until(TEST_WAIT_SITE, std::chrono::seconds(SOCK_CLIENT_WAIT_TMOUT_S), [this]()
+                            {
+                               return m_hwstub_driver.isConnected() &&
+                                      m_bluetooth_driver.isConnected() &&
+                                      m_app_ntf_driver.isConnected();
+                            });
    logger_send_if(!result, TF_ERROR, __func__, "init error, conn status: STUB:%u BT:%u APP:%u", m_hwstub_driver.isConnected(),
                                                                                                 m_bluetooth_driver.isConnected(),
                                                                                                 m_app_ntf_driver.isConnected());
-   WAIT_S(5); /* test binary need to wakeup */
+   if (!m_bin_exec.is_fake_subject())
+   {
+      WAIT_S(5); /* test binary need to wakeup */
+   }
+   step.finish(result);
    return result;
 }
 void TestCore::stopTest()
 {
+   if (!m_test_running)
+   {
+      return;
+   }
+   m_test_running = false;
+   TestStep step(__func__);
+   if (m_load.isRunning())
+   {
+      stopLoad(0);
+   }
    logger_send(TF_TEST_MARKER, "TEST_END", "");
-   logger_deinitialize();
    m_hwstub_driver.removeListener();
    m_bluetooth_driver.removeListener();
    m_app_ntf_driver.removeListener();
+   m_hwstub_driver.clearImpairments();
+   m_bluetooth_driver.clearImpairments();
+   m_app_ntf_driver.clearImpairments();
+   m_debug.stop();
+   m_log_matcher.clear();
 
+   /* waits for the subject are recorded by executor */
    m_bin_exec.stop_test_subject(m_test_bin_pid);
+   m_test_bin_pid = 0;
 
    m_hwstub_driver.disconnect();
    m_bluetooth_driver.disconnect();
    m_app_ntf_driver.disconnect();
+   m_recorder.close();
 
+   char latency_path [512];
+   snprintf(latency_path, 512, "%s/logs/%s.latency.json", PROJECT_ROOT_PATH, m_test_name.c_str());
+   m_latency.exportJson(latency_path, m_test_name);
+   char subject_path [512];
+   snprintf(subject_path, 512, "%s/logs/%s.subject.json", PROJECT_ROOT_PATH, m_test_name.c_str());
+   m_bin_exec.export_json(subject_path, m_test_name);
+   exportMetrics();
+   /* closed last - reaping the subject and exports still log to the test file */
+   logger_deinitialize();
 }
 void TestCore::onStubEvent(DriverEvent ev, const std::vector<uint8_t>& data, size_t count)
 {
    if (ev == DriverEvent::DRIVER_DATA_RECV)
    {
+      auto timestamp = std::chrono::steady_clock::now();
+      m_recorder.record(TraceChannel::HW_STUB, TraceDirection::INBOUND, data.data(), count);
+      TestWait::markActivity();
       logger_send(STM_HW_STUB, __func__, "%s", data.data());
+      m_log_matcher.scan(data.data(), count);
       std::lock_guard<std::mutex> lock(m_buf_mtx);
       if (decodeBytesFromString(data, count))
       {
-         if (m_buffer[1] == m_buffer.size() - 2)
+         if (m_buffer.size() >= 2 && m_buffer[1] == m_buffer.size() - 2)
          {
             switch((HW_STUB_EVENT_ID)m_buffer[0])
             {
             case I2C_STATE_NTF:
+            if (m_buffer.size() == hw_stub::FrameTraits<I2C_STATE_NTF>::LENGTH + 2)
             {
                uint16_t state = m_buffer[4] << 8;
                state |= (m_buffer[3] & 0x00FF);
-               m_i2c_map[m_buffer[2]].state = state;
-               if (m_i2c_map[m_buffer[2]].buffering_enabled)
+               I2C_Board& board = m_i2c_map[m_buffer[2]];
+               if (board.history.empty() || board.history.back()->value != state)
                {
-                  m_i2c_map[m_buffer[2]].buffer.push_back(state);
+                  board.history.push(EventHistory::makeRecord(board.i2c_address, state, nullptr, 0));
                }
+               board.state = state;
+               if (board.buffering_enabled)
+               {
+                  board.buffer.push(EventHistory::makeRecord(board.i2c_address, state, nullptr, 0));
+               }
+               m_i2c_cv.notify_all();
+               notifyEvent({TestEventType::I2C_STATE, board.i2c_address, state, {}});
+               m_latency.onResponse(ResponseType::I2C_STATE, board.i2c_address, timestamp);
+               m_load.onI2CNotification(board.i2c_address);
                logger_send(TF_TC, __func__, "got i2c data addr %x, state %.4x", m_buffer[2], state);
             }
+            else
+            {
+               m_stub_decoder_metrics.incomplete_frames.add();
+               logger_send(TF_TC, __func__, "i2c state frame of invalid length %zu", m_buffer.size());
+            }
+            break;
+            case I2C_TRANSFER_NTF:
+            if (m_buffer.size() == hw_stub::FrameTraits<I2C_TRANSFER_NTF>::LENGTH + 2 && m_buffer[4] < I2C_RESULT_COUNT)
+            {
+               uint32_t duration_us = m_buffer[5] | (m_buffer[6] << 8) | (m_buffer[7] << 16);
+               I2CBusStats& bus = m_i2c_map[m_buffer[2]].bus;
+               bus.results[m_buffer[4]]++;
+               bus.duration.record(duration_us);
+               logger_send(TF_TC, __func__, "i2c %s addr %x, result %u, %u us", m_buffer[3]? "read" : "write", m_buffer[2], m_buffer[4], duration_us);
+            }
             break;
             default:
                break;
@@ -113,11 +237,13 @@ void TestCore::onStubEvent(DriverEvent ev, const std::vector<uint8_t>& data, siz
          }
          else
          {
+            m_stub_decoder_metrics.incomplete_frames.add();
             logger_send(TF_TC, __func__, "incomplete data");
          }
       }
       else
       {
+         m_stub_decoder_metrics.decode_failures.add();
          logger_send(TF_TC, __func__, "cannot decode data", data.data());
       }
    }
@@ -126,23 +252,47 @@ void TestCore::onBluetoothEvent(DriverEvent ev, const std::vector<uint8_t>& data
 {
    if (ev == DriverEvent::DRIVER_DATA_RECV)
    {
+      m_recorder.record(TraceChannel::BLUETOOTH, TraceDirection::INBOUND, data.data(), count);
+      TestWait::markActivity();
       logger_send(STM_BLUETOOTH, __func__, "%s", data.data());
+      if (!m_debug.onFrame(data.data(), count))
+      {
+         m_log_matcher.scan(data.data(), count);
+      }
    }
 }
 void TestCore::onAppEvent(DriverEvent ev, const std::vector<uint8_t>& data, size_t count)
 {
    if (ev == DriverEvent::DRIVER_DATA_RECV)
    {
+      auto timestamp = std::chrono::steady_clock::now();
+      m_recorder.record(TraceChannel::APP_NTF, TraceDirection::INBOUND, data.data(), count);
+      TestWait::markActivity();
       logger_send(STM_WIFI_NTF, __func__, "%s", data.data());
-      if (data.size() >= NTF_HEADER_SIZE)
+      if (data.size() < NTF_HEADER_SIZE)
+      {
+         m_app_decoder_metrics.decode_failures.add();
+         logger_send(TF_TC, __func__, "frame too short (%zu bytes)", data.size());
+      }
+      else
       {
          std::lock_guard<std::mutex> lock(m_buf_mtx);
-         if (decodeBytesFromString(data, count))
+         if (!decodeBytesFromString(data, count))
+         {
+            m_app_decoder_metrics.decode_failures.add();
+         }
+         else if (m_buffer.size() < NTF_HEADER_SIZE)
+         {
+            m_app_decoder_metrics.incomplete_frames.add();
+         }
+         else
          {
-            APP_NTF ntf;
-            ntf.id = (NTF_CMD_ID) m_buffer[0];
-            ntf.payload.insert(ntf.payload.begin(), m_buffer.begin(), m_buffer.end());
-            m_app_ntfs.push_back(ntf);
+            uint8_t id = m_buffer[0];
+            m_app_ntfs.push(id, 0, m_buffer.data(), m_buffer.size());
+            m_app_ntf_count.set(m_app_ntfs.size());
+            m_latency.onResponse(ResponseType::APP_NTF, id, timestamp);
+            m_load.onAppNotification(id);
+            notifyEvent({TestEventType::APP_NTF, id, 0, m_buffer});
          }
       }
    }
@@ -150,26 +300,12 @@ void TestCore::onAppEvent(DriverEvent ev, const std::vector<uint8_t>& data, size
 bool TestCore::decodeBytesFromString(const std::vector<uint8_t>& data, size_t size)
 {
    bool result = false;
-   char byte [4];
-   uint8_t byte_idx = 0;
    m_buffer.clear();
    if (data.size() > 0)
    {
-      for (uint8_t i = 0; i < size; i++)
-      {
-         if (data[i] != ' ')
-         {
-            byte[byte_idx++] = (char)data[i];
-         }
-         else
-         {
-            byte[byte_idx] = 0x00;
-            m_buffer.push_back(atoi(byte));
-            byte_idx = 0;
-         }
-      }
-      byte[byte_idx] = 0x00;
-      m_buffer.push_back(atoi(byte));
+      size = std::min(size, data.size());
+      m_buffer.resize((size + 1) / 2);
+      m_buffer.resize(hw_stub::decode((const char*)data.data(), size, m_buffer.data(), m_buffer.size()));
       result = true;
    }
    logger_send(TF_TC, __func__, "decoded %u bytes", m_buffer.size());
@@ -177,258 +313,730 @@ bool TestCore::decodeBytesFromString(const std::vector<uint8_t>& data, size_t si
 }
 bool TestCore::setRelayState(RELAY_ID id, RELAY_STATE state)
 {
-   std::vector<uint8_t> cmd;
+   TestStep step(__func__);
    bool result = true;
+   uint16_t& board_state = m_transaction.active? queueI2CState(RELAYS_I2C_ADDRESS) : m_i2c_map[RELAYS_I2C_ADDRESS].state;
    if (state == RELAY_STATE_ON)
    {
-      m_i2c_map[RELAYS_I2C_ADDRESS].state &= ~rel_id_to_mask(id);
+      board_state &= ~hw_stub::relay_mask(id);
    }
    else
    {
-      m_i2c_map[RELAYS_I2C_ADDRESS].state |= rel_id_to_mask(id);
+      board_state |= hw_stub::relay_mask(id);
    }
 
-   cmd.push_back(I2C_STATE_SET);
-   cmd.push_back(0x03);
-   cmd.push_back(RELAYS_I2C_ADDRESS);
-   cmd.push_back(m_i2c_map[RELAYS_I2C_ADDRESS].state & 0xFF);
-   cmd.push_back((m_i2c_map[RELAYS_I2C_ADDRESS].state >>8) & 0xFF);
-
-   if (!sendToHwStub(cmd))
+   if (!m_transaction.active && !sendToHwStub(hw_stub::make_i2c_frame<I2C_STATE_SET>(RELAYS_I2C_ADDRESS, board_state)))
    {
       result = false;
       logger_send(TF_ERROR, __func__, "cannot write relays state to hw stub");
    }
-   logger_send(TF_TEST_MARKER, "TEST_STEP", "%s:%u %u => %u", __func__, id, state, result);
+   step.finish(result, "%s:%u %u => %u%s", __func__, id, state, result, m_transaction.active? " (queued)" : "");
    return result;
 }
-uint16_t TestCore::rel_id_to_mask(RELAY_ID id)
+template <size_t N>
+bool TestCore::sendToHwStub(const std::array<uint8_t, N>& frame)
 {
-   return rel_relay_to_mask(rel_id_to_relay_no(id));
+   /* frame encoded on the stack and passed to sendmsg() without copy, so the stimulus path does not allocate
+    * (unless outbound impairment copies it). It is not lock-free - trace recorder, latency tracker, logger
+    * and driver send mutex are taken on the way */
+   hw_stub::FrameBatch<hw_stub::text_size<N>(), 1> batch;
+   batch.add(frame);
+   return sendToHwStub(batch);
 }
-
-uint8_t TestCore::rel_id_to_relay_no(RELAY_ID id)
+template <typename BATCH>
+bool TestCore::sendToHwStub(const BATCH& batch)
 {
-   uint8_t result = 0;
-   for (uint8_t i = 0; i < (sizeof(m_rel_id_match) / sizeof(m_rel_id_match[0])); i++)
+   for (size_t i = 0; i < batch.count(); i++)
    {
-      if (m_rel_id_match[i] == id)
-      {
-         result = i;
-         break;
-      }
+      /* stimulus registered before write - response may come before write() returns */
+      registerStimulus((HW_STUB_EVENT_ID)batch.event(i), batch.address(i));
    }
-   return result;
-}
-uint16_t TestCore::rel_relay_to_mask(uint8_t relay_no)
-{
-   return (uint16_t)(1 << (relay_no - 1));
+   return sendToHwStub(batch.frames(), batch.count());
 }
-bool TestCore::sendToHwStub(const std::vector<uint8_t>& data)
+bool TestCore::sendToHwStub(const SocketFrame* frames, size_t count)
 {
-   bool result = false;
-   char bytes_formatted [1024];
-   size_t byte_idx = 0;
-
-   for (auto i : data)
+   for (size_t i = 0; i < count; i++)
    {
-      byte_idx += snprintf(bytes_formatted + byte_idx, 1024, "%d ", i);
+      m_recorder.record(TraceChannel::HW_STUB, TraceDirection::OUTBOUND, frames[i].data, frames[i].size);
    }
-   bytes_formatted[--byte_idx] = 0x00;
-
-   std::lock_guard<std::mutex> lock(m_send_buf_mtx);
-   m_send_buf.clear();
-   m_send_buf.insert(m_send_buf.begin(), bytes_formatted, bytes_formatted + byte_idx);
-   result = m_hwstub_driver.write(m_send_buf, m_send_buf.size());
-   return result;
+   return m_hwstub_driver.write(frames, count);
 }
-
-uint16_t TestCore::inp_id_to_mask(INPUT_ID id)
+void TestCore::registerStimulus(HW_STUB_EVENT_ID event, uint8_t address)
 {
-   return inp_input_to_mask(inp_id_to_input_no(id));
-}
-
-uint8_t TestCore::inp_id_to_input_no(INPUT_ID id)
-{
-   uint8_t result = 0;
-   for (uint8_t i =0 ; i < INPUTS_INPUT_COUNT + 1; i++)
+   auto timestamp = std::chrono::steady_clock::now();
+   switch(event)
    {
-      if (m_inp_id_match[i] == id)
+   case I2C_STATE_SET:
+      if (address == RELAYS_I2C_ADDRESS || address == INPUTS_I2C_ADDRESS)
       {
-         result = i;
-         break;
+         m_latency.onStimulus(address == RELAYS_I2C_ADDRESS? StimulusType::RELAY_SET : StimulusType::INPUT_SET, timestamp);
       }
+      break;
+   case DHT_STATE_SET:
+      m_latency.onStimulus(StimulusType::SENSOR_SET, timestamp);
+      break;
+   case I2C_INT_TRIGGER:
+      m_latency.onStimulus(StimulusType::INT_TRIGGER, timestamp);
+      break;
+   default:
+      break;
    }
-   return result;
-}
-
-uint16_t TestCore::inp_input_to_mask(uint8_t input)
-{
-   uint16_t result = 0;
-
-   if (input < 9){
-       result = 1 << (16 - input);
-   }
-   else
-   {
-       result = 1 << (input-9);
-   }
-
-   return result;
 }
 bool TestCore::setInputState(INPUT_ID id, INPUT_STATE state)
 {
+   TestStep step(__func__);
    bool result = true;
-   std::vector<uint8_t> cmd;
+   uint16_t& board_state = m_transaction.active? queueI2CState(INPUTS_I2C_ADDRESS) : m_i2c_map[INPUTS_I2C_ADDRESS].state;
    if (state == INPUT_STATE_ACTIVE)
    {
-      m_i2c_map[INPUTS_I2C_ADDRESS].state &= ~inp_id_to_mask(id);
+      board_state &= ~hw_stub::input_mask(id);
    }
    else
    {
-      m_i2c_map[INPUTS_I2C_ADDRESS].state |= inp_id_to_mask(id);
+      board_state |= hw_stub::input_mask(id);
    }
 
-   cmd.push_back(I2C_STATE_SET);
-   cmd.push_back(0x03);
-   cmd.push_back(INPUTS_I2C_ADDRESS);
-   cmd.push_back(m_i2c_map[INPUTS_I2C_ADDRESS].state & 0xFF);
-   cmd.push_back((m_i2c_map[INPUTS_I2C_ADDRESS].state >>8) & 0xFF);
-
-   if (!sendToHwStub(cmd))
+   if (!m_transaction.active && !sendToHwStub(hw_stub::make_i2c_frame<I2C_STATE_SET>(INPUTS_I2C_ADDRESS, board_state)))
    {
       result = false;
       logger_send(TF_ERROR, __func__, "cannot write inputs state to hw stub");
    }
-   logger_send(TF_TEST_MARKER, "TEST_STEP", "%s:%u %u => %u", __func__, id, state, result);
+   step.finish(result, "%s:%u %u => %u%s", __func__, id, state, result, m_transaction.active? " (queued)" : "");
    return result;
 }
 bool TestCore::setSensorState(DHT_SENSOR_ID id, DHT_SENSOR_TYPE type, int8_t temp, int8_t hum)
 {
+   TestStep step(__func__);
    bool result = true;
-   std::vector<uint8_t> cmd;
-
-   cmd.push_back(DHT_STATE_SET);
-   cmd.push_back(0x06);
-   cmd.push_back(id);
-   cmd.push_back(type);
-   cmd.push_back(temp);
-   cmd.push_back(0x00);
-   cmd.push_back(hum);
-   cmd.push_back(0x00);
 
-   if (!sendToHwStub(cmd))
+   if (m_transaction.active)
+   {
+      auto it = std::find_if(m_transaction.sensors.begin(), m_transaction.sensors.end(), [id](const DHT_Device& dev){ return dev.id == id; });
+      if (it == m_transaction.sensors.end())
+      {
+         it = m_transaction.sensors.insert(it, DHT_Device());
+      }
+      it->id = id;
+      it->type = type;
+      it->temp_h = temp;
+      it->hum_h = hum;
+      m_transaction.changes++;
+   }
+   else if (!sendToHwStub(hw_stub::make_dht_frame(id, type, temp, hum)))
    {
       result = false;
       logger_send(TF_ERROR, __func__, "cannot write DHT sensor data");
    }
-   logger_send(TF_TEST_MARKER, "TEST_STEP", "%s:%u %u %d %u => %u", __func__, id, type, temp, hum, result);
+   step.finish(result, "%s:%u %u %d %u => %u%s", __func__, id, type, temp, hum, result, m_transaction.active? " (queued)" : "");
    return result;
 }
 bool TestCore::triggerInterrupt()
 {
+   TestStep step(__func__);
    bool result = true;
-   std::vector<uint8_t> cmd;
 
-   cmd.push_back(I2C_INT_TRIGGER);
-   cmd.push_back(0x00);
-
-   if (!sendToHwStub(cmd))
+   if (m_transaction.active)
+   {
+      m_transaction.trigger_interrupt = true;
+   }
+   else if (!sendToHwStub(hw_stub::make_frame<I2C_INT_TRIGGER>()))
    {
       result = false;
       logger_send(TF_ERROR, __func__, "cannot trigger interrupt data");
    }
-   logger_send(TF_TEST_MARKER, "TEST_STEP", "%s => %u", __func__, result);
+   step.finish(result, "%s => %u%s", __func__, result, m_transaction.active? " (queued)" : "");
+   return result;
+}
+void TestCore::begin()
+{
+   TestStep(__func__).done("%s", __func__);
+   logger_send_if(m_transaction.active, TF_ERROR, __func__, "transaction already started, %u changes pending", m_transaction.changes);
+   m_transaction.active = true;
+}
+uint16_t& TestCore::queueI2CState(uint8_t address)
+{
+   auto it = std::find_if(m_transaction.i2c_states.begin(), m_transaction.i2c_states.end(),
+                          [address](const std::pair<uint8_t, uint16_t>& board){ return board.first == address; });
+   if (it == m_transaction.i2c_states.end())
+   {
+      std::lock_guard<std::mutex> lock(m_buf_mtx);
+      it = m_transaction.i2c_states.insert(it, {address, m_i2c_map[address].state});
+   }
+   m_transaction.changes++;
+   return it->second;
+}
+bool TestCore::commit(bool trigger_interrupt)
+{
+   TestStep step(__func__);
+   bool result = true;
+   hw_stub::FrameBatch<TC_TRANSACTION_MAX_FRAMES * hw_stub::text_size<sizeof(hw_stub::Frame<DHT_STATE_SET>)>(), TC_TRANSACTION_MAX_FRAMES> batch;
+
+   for (const std::pair<uint8_t, uint16_t>& board : m_transaction.i2c_states)
+   {
+      result &= batch.add(hw_stub::make_i2c_frame<I2C_STATE_SET>(board.first, board.second));
+   }
+   for (const DHT_Device& sensor : m_transaction.sensors)
+   {
+      result &= batch.add(hw_stub::make_dht_frame(sensor.id, sensor.type, sensor.temp_h, sensor.hum_h));
+   }
+   trigger_interrupt |= m_transaction.trigger_interrupt;
+   if (trigger_interrupt)
+   {
+      result &= batch.add(hw_stub::make_frame<I2C_INT_TRIGGER>());
+   }
+   if (!result)
+   {
+      logger_send(TF_ERROR, __func__, "too many frames in transaction, max %u", TC_TRANSACTION_MAX_FRAMES);
+   }
+   else if (batch.count() > 0 && !sendToHwStub(batch))
+   {
+      result = false;
+      logger_send(TF_ERROR, __func__, "cannot write transaction to hw stub");
+   }
+   if (result)
+   {
+      /* boards keep previous state if transaction was not sent */
+      std::lock_guard<std::mutex> lock(m_buf_mtx);
+      for (const std::pair<uint8_t, uint16_t>& board : m_transaction.i2c_states)
+      {
+         m_i2c_map[board.first].state = board.second;
+      }
+   }
+   step.finish(result, "%s : %zu changes, %zu frames, int %u => %u", __func__, m_transaction.changes, batch.count(),
+                                                                  trigger_interrupt, result);
+   m_transaction = Transaction();
    return result;
 }
 bool TestCore::checkRelayState(RELAY_ID id, RELAY_STATE state)
 {
+   TestStep step(__func__);
    bool result = getRelayState(id) == state;
-   logger_send(TF_TEST_MARKER, "TEST_STEP", "%s : %u %u => %u", __func__, id, state, result);
+   step.finish(result, "%s : %u %u => %u", __func__, id, state, result);
    return result;
 }
 bool TestCore::checkInputState(INPUT_ID id, INPUT_STATE state)
 {
+   TestStep step(__func__);
    bool result = getInputState(id) == state;
-   logger_send(TF_TEST_MARKER, "TEST_STEP", "%s : %u %u => %u", __func__, id, state, result);
+   step.finish(result, "%s : %u %u => %u", __func__, id, state, result);
    return result;
 }
 RELAY_STATE TestCore::getRelayState(RELAY_ID id)
 {
-   RELAY_STATE state = m_i2c_map[RELAYS_I2C_ADDRESS].state & rel_id_to_mask(id)? RELAY_STATE_OFF : RELAY_STATE_ON;
+   RELAY_STATE state = m_i2c_map[RELAYS_I2C_ADDRESS].state & hw_stub::relay_mask(id)? RELAY_STATE_OFF : RELAY_STATE_ON;
    return state;
 }
 INPUT_STATE TestCore::getInputState(INPUT_ID id)
 {
-   INPUT_STATE state = m_i2c_map[INPUTS_I2C_ADDRESS].state & inp_id_to_mask(id)? INPUT_STATE_INACTIVE : INPUT_STATE_ACTIVE;
+   INPUT_STATE state = m_i2c_map[INPUTS_I2C_ADDRESS].state & hw_stub::input_mask(id)? INPUT_STATE_INACTIVE : INPUT_STATE_ACTIVE;
    return state;
 }
+uint16_t TestCore::getI2CState(uint8_t address)
+{
+   std::lock_guard<std::mutex> lock(m_buf_mtx);
+   return m_i2c_map[address].state;
+}
+int TestCore::addEventHook(TestEventHook hook)
+{
+   std::lock_guard<std::mutex> lock(m_buf_mtx);
+   m_event_hooks.push_back({m_next_event_hook_id, hook});
+   return m_next_event_hook_id++;
+}
+void TestCore::removeEventHook(int id)
+{
+   std::lock_guard<std::mutex> lock(m_buf_mtx);
+   for (auto it = m_event_hooks.begin(); it != m_event_hooks.end(); it++)
+   {
+      if (it->first == id)
+      {
+         m_event_hooks.erase(it);
+         break;
+      }
+   }
+}
+bool TestCore::setI2CBusModel(uint8_t address, const I2CBusModel& model)
+{
+   TestStep step(__func__);
+   bool result = sendToHwStub(hw_stub::make_bus_frame(address, model));
+   step.finish(result, "%s : addr %x, latency %u us, clock %u kHz, stretch %u us, nack %u/1000, error %u/1000 => %u", __func__, address,
+                       model.latency_us, model.clock_khz, model.stretch_us, model.nack_permille, model.error_permille, result);
+   return result;
+}
+bool TestCore::setI2CTransactionResult(uint8_t address, I2C_RESULT result, uint8_t count)
+{
+   TestStep step(__func__);
+   bool sent = sendToHwStub(hw_stub::make_frame<I2C_RESULT_SET>(address, result, count));
+   step.finish(sent, "%s : addr %x, result %u x%u => %u", __func__, address, result, count, sent);
+   return sent;
+}
+I2CBusStats TestCore::getI2CBusStats(uint8_t address)
+{
+   std::lock_guard<std::mutex> lock(m_buf_mtx);
+   return m_i2c_map[address].bus;
+}
+void TestCore::setChannelImpairment(TraceChannel channel, ImpairmentDirection direction, const ImpairmentProfile& profile)
+{
+   TestStep(__func__).done("%s : channel %u, %s, delay %u us, jitter %u us, %u B/s, drop %u/1000", __func__, (unsigned)channel,
+                           direction == ImpairmentDirection::INBOUND? "in" : "out", profile.delay_us, profile.jitter_us,
+                           profile.bandwidth_bps, profile.drop_permille);
+   getDriver(channel).setImpairment(direction, profile);
+}
+void TestCore::pauseChannelReceive(TraceChannel channel, uint32_t duration_ms)
+{
+   TestStep(__func__).done("%s : channel %u, %u ms", __func__, (unsigned)channel, duration_ms);
+   getDriver(channel).pauseReceive(duration_ms);
+}
+SocketDriver& TestCore::getDriver(TraceChannel channel)
+{
+   switch (channel)
+   {
+   case TraceChannel::BLUETOOTH:
+      return m_bluetooth_driver;
+   case TraceChannel::APP_NTF:
+      return m_app_ntf_driver;
+   default:
+      return m_hwstub_driver;
+   }
+}
+void TestCore::notifyEvent(const TestEvent& event)
+{
+   /* called with m_buf_mtx locked */
+   for (auto& hook : m_event_hooks)
+   {
+      hook.second(event);
+   }
+}
 void TestCore::startI2CBuffering(uint8_t address)
 {
-   logger_send(TF_TEST_MARKER, "TEST_STEP", "%s", __func__);
+   TestStep(__func__).done("%s", __func__);
    m_i2c_map[address].buffering_enabled = true;
 }
 void TestCore::stopI2CBuffering(uint8_t address)
 {
-   logger_send(TF_TEST_MARKER, "TEST_STEP", "%s", __func__);
+   TestStep(__func__).done("%s", __func__);
    m_i2c_map[address].buffering_enabled = false;
 }
 void TestCore::clearI2CBuffer(uint8_t address)
 {
-   logger_send(TF_TEST_MARKER, "TEST_STEP", "%s", __func__);
+   TestStep(__func__).done("%s", __func__);
+   std::lock_guard<std::mutex> lock(m_buf_mtx);
    m_i2c_map[address].buffer.clear();
 }
 bool TestCore::waitForI2CNotification(uint8_t address, uint16_t state, uint32_t timeout_ms)
 {
+   TestStep step(__func__);
+   bool result = TestWait::until(TEST_WAIT_SITE, std::chrono::milliseconds(timeout_ms), [&]()
+                                 {
+                                    std::lock_guard<std::mutex> lock(m_buf_mtx);
+                                    return m_i2c_map[address].state == state;
+                                 });
+   step.finish(result, "%s : %u %u %u => %d", __func__, address, state, timeout_ms, result);
+   return result;
+}
+bool TestCore::expectI2CSequence(uint8_t address, const std::vector<uint16_t>& states, uint32_t step_timeout_ms, uint32_t total_timeout_ms)
+{
+   TestStep step(__func__);
+   if (states.empty())
+   {
+      logger_send(TF_ERROR, __func__, "empty sequence for addr %x", address);
+      step.finish(false, "%s : %u [0 states] => 0", __func__, address);
+      return false;
+   }
    bool result = false;
-   auto time = std::chrono::system_clock::now();
-   while ( (std::chrono::system_clock::now() - time) < std::chrono::milliseconds(timeout_ms))
+   bool stalled = false;
+   size_t best_pos = 0;
+   size_t best_matched = 0;
+   auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(total_timeout_ms);
+   uint64_t step_timeout_ns = (uint64_t)step_timeout_ms * 1000000;
+
+   std::unique_lock<std::mutex> lock(m_buf_mtx);
+   I2C_Board& board = m_i2c_map[address];
+   size_t scan_from = board.history_cursor;
+   best_pos = scan_from;
+
+   while (true)
    {
+      /* look for the first place in history, where whole sequence matches */
+      EventHistory& history = board.history;
+      HistoryRecord current;
+      HistoryRecord previous;
+      bool open = false;      /* some candidate matches up to the last received transition and waits for the next one */
+      for (size_t pos = scan_from; pos < history.size(); pos++)
       {
-         std::lock_guard<std::mutex> lock(m_buf_mtx);
-         if (m_i2c_map[address].state == state)
+         size_t matched = 0;
+         while (matched < states.size() && history.get(pos + matched, current) &&
+                current.value == states[matched] &&
+                (matched == 0 || (current.timestamp_ns - previous.timestamp_ns) <= step_timeout_ns))
+         {
+            previous = current;
+            matched++;
+         }
+         if (matched > best_matched || matched == states.size())
+         {
+            best_matched = matched;
+            best_pos = pos;
+         }
+         if (matched == states.size())
          {
             result = true;
             break;
          }
+         if (matched > 0 && (pos + matched) == history.size())
+         {
+            open = true;
+         }
+         if ((pos + matched) < history.size() && pos == scan_from)
+         {
+            /* candidate diverged on already received data - no need to check it again */
+            scan_from++;
+         }
+      }
+      if (result)
+      {
+         board.history_cursor = best_pos + states.size();
+         break;
+      }
+      /* started sequence fails as soon as the next state is late, not at the total timeout */
+      auto wake_at = deadline;
+      size_t received = history.size();
+      if (open && history.get(received - 1, current))
+      {
+         std::chrono::steady_clock::time_point step_deadline(std::chrono::nanoseconds(current.timestamp_ns + step_timeout_ns));
+         wake_at = std::min(wake_at, step_deadline);
+      }
+      auto wait_start = std::chrono::steady_clock::now();
+      m_i2c_cv.wait_until(lock, wake_at);
+      auto now = std::chrono::steady_clock::now();
+      TestStep::recordWait(now - wait_start);
+      if (now >= deadline)
+      {
+         break;
+      }
+      if (now >= wake_at && history.size() == received)
+      {
+         stalled = true;
+         break;
       }
-      std::this_thread::sleep_for(std::chrono::milliseconds(10));
    }
-   logger_send(TF_TEST_MARKER, "TEST_STEP", "%s : %u %u %u => %d", __func__, address, state, timeout_ms, result);
+
+   logI2CSequenceResult(board, states, best_pos, best_matched, result);
+   logger_send_if(stalled, TF_TC, __func__, "addr %x, no state within %u ms after step %zu", address, step_timeout_ms, best_matched - 1);
+   step.finish(result, "%s : %u [%zu states] %u %u => %d", __func__, address, states.size(), step_timeout_ms, total_timeout_ms, result);
    return result;
 }
+void TestCore::logI2CSequenceResult(I2C_Board& board, const std::vector<uint16_t>& states, size_t pos, size_t matched, bool result)
+{
+   char line [1024];
+   size_t idx = 0;
+   HistoryRecord current;
+   HistoryRecord previous = {};
+   if (result)
+   {
+      board.history.get(pos, previous);
+      for (size_t i = 1; i < states.size() && idx < sizeof(line); i++)
+      {
+         board.history.get(pos + i, current);
+         idx += snprintf(line + idx, sizeof(line) - idx, " %ld", (long)((current.timestamp_ns - previous.timestamp_ns) / 1000000));
+         previous = current;
+      }
+      line[std::min(idx, sizeof(line) - 1)] = 0x00;
+      logger_send(TF_TC, __func__, "addr %x, sequence matched, step intervals [ms]:%s", board.i2c_address, line);
+   }
+   else
+   {
+      logger_send(TF_TC, __func__, "addr %x, sequence not matched, %u of %u states received in order", board.i2c_address, matched, states.size());
+      for (size_t i = 0; i < states.size(); i++)
+      {
+         if (matched == 0 || !board.history.get(pos + i, current))
+         {
+            logger_send(TF_TC, __func__, "  step %u: exp %.4x, got -", i, states[i]);
+            continue;
+         }
+         long interval = i == 0? 0 : (long)((current.timestamp_ns - previous.timestamp_ns) / 1000000);
+         logger_send(TF_TC, __func__, "  step %u: exp %.4x, got %.4x (+%ld ms)%s", i, states[i], current.value, interval,
+                                                                                 i == matched? " <= diverged" : "");
+         previous = current;
+      }
+   }
+}
 bool TestCore::checkI2CBufferSize(uint8_t address, size_t size)
 {
+   TestStep step(__func__);
+   std::lock_guard<std::mutex> lock(m_buf_mtx);
    size_t buf_size = m_i2c_map[address].buffer.size();
-   logger_send(TF_TEST_MARKER, "TEST_STEP", "%s => %d", __func__, buf_size);
-   return (size == buf_size)? true : false;
+   bool result = size == buf_size;
+   step.finish(result, "%s => %zu", __func__, buf_size);
+   return result;
 }
 bool TestCore::checkI2CBufferElement(uint8_t address, uint16_t idx, uint16_t exp)
 {
-   bool result = false;
-   if (idx < m_i2c_map[address].buffer.size())
-   {
-      result = m_i2c_map[address].buffer[idx] == exp;
-   }
-   logger_send(TF_TEST_MARKER, "TEST_STEP", "%s : %u %u %u => %d", __func__, address, idx, exp, result);
+   TestStep step(__func__);
+   std::lock_guard<std::mutex> lock(m_buf_mtx);
+   HistoryRecord record;
+   bool result = m_i2c_map[address].buffer.get(idx, record) && record.value == exp;
+   step.finish(result, "%s : %u %u %u => %d", __func__, address, idx, exp, result);
    return result;
 }
 void TestCore::clearAppDataBuffer()
 {
-   logger_send(TF_TEST_MARKER, "TEST_STEP", "%s", __func__);
+   TestStep(__func__).done("%s", __func__);
+   std::lock_guard<std::mutex> lock(m_buf_mtx);
    m_app_ntfs.clear();
+   m_app_ntf_count.set(0);
+}
+std::future<DebugResponse> TestCore::sendDebugCommand(const std::string& command, uint32_t timeout_ms)
+{
+   TestStep(__func__).done("%s : %s", __func__, command.c_str());
+   return m_debug.send(command, timeout_ms);
+}
+std::vector<std::future<DebugResponse>> TestCore::sendDebugCommands(const std::vector<std::string>& commands, uint32_t timeout_ms)
+{
+   TestStep(__func__).done("%s : %zu commands", __func__, commands.size());
+   return m_debug.send(commands, timeout_ms);
+}
+bool TestCore::checkDebugResponse(const std::string& command, const std::string& response, uint32_t timeout_ms)
+{
+   TestStep step(__func__);
+   std::future<DebugResponse> future = m_debug.send(command, timeout_ms);
+   auto wait_start = std::chrono::steady_clock::now();
+   DebugResponse received = future.get();
+   TestStep::recordWait(std::chrono::steady_clock::now() - wait_start);
+   bool result = received.status == DebugStatus::OK && received.text == response;
+   step.finish(result, "%s : %s => %u (status %u, %s)", __func__, command.c_str(), result, (uint8_t)received.status, received.text.c_str());
+   return result;
+}
+LogPatternId TestCore::watchLog(const std::string& pattern)
+{
+   LogPatternId id = m_log_matcher.add(pattern);
+   TestStep(__func__).finish(id != 0, "%s : %s => %u", __func__, pattern.c_str(), id);
+   return id;
+}
+bool TestCore::waitForLog(LogPatternId id, uint32_t timeout_ms)
+{
+   TestStep step(__func__);
+   auto wait_start = std::chrono::steady_clock::now();
+   bool result = m_log_matcher.waitForHit(id, timeout_ms);
+   TestStep::recordWait(std::chrono::steady_clock::now() - wait_start);
+   m_log_matcher.remove(id);
+   step.finish(result, "%s : %u %u => %u", __func__, id, timeout_ms, result);
+   return result;
+}
+bool TestCore::waitForLog(const std::string& pattern, uint32_t timeout_ms)
+{
+   return waitForLog(watchLog(pattern), timeout_ms);
+}
+bool TestCore::expectNoLog(const std::string& pattern, uint32_t window_ms)
+{
+   TestStep step(__func__);
+   LogPatternId id = m_log_matcher.add(pattern);
+   auto wait_start = std::chrono::steady_clock::now();
+   bool result = id != 0 && !m_log_matcher.waitForHit(id, window_ms);
+   TestStep::recordWait(std::chrono::steady_clock::now() - wait_start);
+   m_log_matcher.remove(id);
+   step.finish(result, "%s : %s %u => %u", __func__, pattern.c_str(), window_ms, result);
+   return result;
 }
 bool TestCore::wasAppNtfSent(NTF_CMD_ID id, const std::vector<uint8_t>& msg)
 {
+   TestStep step(__func__);
    bool result = false;
-   for (APP_NTF& ntf : m_app_ntfs)
+   std::lock_guard<std::mutex> lock(m_buf_mtx);
+   for (size_t i = 0; i < m_app_ntfs.size() && !result; i++)
    {
-      if (ntf.id == id && ntf.payload == msg)
+      const HistoryRecord* record = m_app_ntfs.at(i);
+      if (record && record->id == id && record->size == msg.size())
       {
-         result = true;
-         break;
+         const uint8_t* payload = m_app_ntfs.payload(*record);
+         /* notification which cannot be compared completely never matches */
+         logger_send_if(!payload, TF_ERROR, __func__, "notification %u [%zu] lost beyond %u bytes, not compared", id, i, HISTORY_PAYLOAD_SIZE);
+         result = payload && memcmp(payload, msg.data(), msg.size()) == 0;
+      }
+   }
+   step.finish(result, "%s:%u => %u", __func__, id, result);
+   return result;
+}
+bool TestCore::findAppNtf(NTF_CMD_ID id, const std::function<bool(const uint8_t*, size_t)>& match)
+{
+   /* reported as the user-facing call, wasAppNtfSent<ID>(predicate) */
+   TestStep step("wasAppNtfSent");
+   bool result = false;
+   std::lock_guard<std::mutex> lock(m_buf_mtx);
+   for (size_t i = 0; i < m_app_ntfs.size() && !result; i++)
+   {
+      const HistoryRecord* record = m_app_ntfs.at(i);
+      if (record && record->id == id)
+      {
+         /* decoded in place - record in slab or spill file, long payload in arena */
+         const uint8_t* payload = m_app_ntfs.payload(*record);
+         logger_send_if(!payload, TF_ERROR, __func__, "notification %u [%zu] lost beyond %u bytes, not decoded", id, i, HISTORY_PAYLOAD_SIZE);
+         result = payload && match(payload, record->size);
+      }
+   }
+   step.finish(result, "wasAppNtfSent<%u> => %u", id, result);
+   return result;
+}
+void TestCore::addLatencyPair(const std::string& name, StimulusType stimulus, ResponseType response, uint8_t response_id)
+{
+   TestStep(__func__).done("%s : %s", __func__, name.c_str());
+   m_latency.addPair(name, stimulus, response, response_id);
+}
+LatencyHistogram TestCore::getLatencyHistogram(const std::string& name)
+{
+   return m_latency.getHistogram(name);
+}
+bool TestCore::startMetricsServer(uint16_t port)
+{
+   TestStep step(__func__);
+   bool result = m_metrics.startServer(port);
+   step.finish(result, "%s : %u => %u", __func__, port, result);
+   return result;
+}
+uint16_t TestCore::getMetricsServerPort()
+{
+   return m_metrics.serverPort();
+}
+std::string TestCore::getMetrics(MetricsFormat format)
+{
+   return m_metrics.format(format);
+}
+void TestCore::registerMetrics()
+{
+   m_metrics.clear();
+   m_hwstub_driver.registerMetrics(m_metrics, "hw_stub");
+   m_bluetooth_driver.registerMetrics(m_metrics, "bluetooth");
+   m_app_ntf_driver.registerMetrics(m_metrics, "app_ntf");
+   m_debug.registerMetrics(m_metrics);
+   m_metrics.add("decode_failures_total", "Frames which could not be decoded", MetricType::COUNTER, "channel=hw_stub", &m_stub_decoder_metrics.decode_failures);
+   m_metrics.add("decode_failures_total", "Frames which could not be decoded", MetricType::COUNTER, "channel=app_ntf", &m_app_decoder_metrics.decode_failures);
+   m_metrics.add("incomplete_frames_total", "Frames with length not matching the header", MetricType::COUNTER, "channel=hw_stub", &m_stub_decoder_metrics.incomplete_frames);
+   m_metrics.add("incomplete_frames_total", "Frames with length not matching the header", MetricType::COUNTER, "channel=app_ntf", &m_app_decoder_metrics.incomplete_frames);
+   m_metrics.add("app_ntf_queue_size", "Application notifications kept for verification", MetricType::GAUGE, "", &m_app_ntf_count);
+   for (auto& board : m_i2c_map)
+   {
+      char label [32];
+      uint8_t address = board.first;
+      snprintf(label, sizeof(label), "address=0x%.2x", address);
+      m_metrics.add("i2c_history_size", "I2C state transitions kept for verification", MetricType::GAUGE, label, [this, address]() -> uint64_t
+                     {
+                        std::lock_guard<std::mutex> lock(m_buf_mtx);
+                        return m_i2c_map[address].history.size();
+                     });
+      m_metrics.add("i2c_buffer_size", "I2C states buffered for verification", MetricType::GAUGE, label, [this, address]() -> uint64_t
+                     {
+                        std::lock_guard<std::mutex> lock(m_buf_mtx);
+                        return m_i2c_map[address].buffer.size();
+                     });
+      /* registry has one label per metric - result is part of the name */
+      static const char* result_metrics [I2C_RESULT_COUNT][2] = {{"i2c_transactions_ok_total", "Modelled I2C transactions completed"},
+                                                                 {"i2c_transactions_nack_total", "Modelled I2C transactions not acknowledged"},
+                                                                 {"i2c_transactions_bus_error_total", "Modelled I2C transactions aborted on the bus"}};
+      for (uint8_t i2c_result = 0; i2c_result < I2C_RESULT_COUNT; i2c_result++)
+      {
+         m_metrics.add(result_metrics[i2c_result][0], result_metrics[i2c_result][1], MetricType::COUNTER, label, [this, address, i2c_result]() -> uint64_t
+                        {
+                           std::lock_guard<std::mutex> lock(m_buf_mtx);
+                           return m_i2c_map[address].bus.results[i2c_result];
+                        });
       }
+      m_metrics.add("i2c_transaction_max_us", "Longest modelled I2C transaction", MetricType::GAUGE, label, [this, address]() -> uint64_t
+                     {
+                        std::lock_guard<std::mutex> lock(m_buf_mtx);
+                        return m_i2c_map[address].bus.duration.max();
+                     });
    }
-   logger_send(TF_TEST_MARKER, "TEST_STEP", "%s:%u => %u", __func__, id, result);
+   m_metrics.add("trace_dropped_frames_total", "Frames not written to trace file", MetricType::COUNTER, "", [this]() -> uint64_t
+                  {
+                     return m_recorder.droppedFrames();
+                  });
+   m_metrics.add("trace_write_errors_total", "Failed writes of trace file", MetricType::COUNTER, "", [this]() -> uint64_t
+                  {
+                     return m_recorder.writeErrors();
+                  });
+}
+void TestCore::exportMetrics()
+{
+   char metrics_path [512];
+   m_metrics.stopServer();
+   snprintf(metrics_path, 512, "%s/logs/%s.metrics.prom", PROJECT_ROOT_PATH, m_test_name.c_str());
+   m_metrics.writeFile(metrics_path, MetricsFormat::PROMETHEUS);
+   snprintf(metrics_path, 512, "%s/logs/%s.metrics.json", PROJECT_ROOT_PATH, m_test_name.c_str());
+   m_metrics.writeFile(metrics_path, MetricsFormat::JSON);
+}
+bool TestCore::startLoad(const LoadProfile& profile)
+{
+   TestStep step(__func__);
+   bool trigger_interrupt = profile.trigger_interrupt;
+   bool result = m_load.start(profile, [this, trigger_interrupt](INPUT_ID id) -> bool
+                              {
+                                 uint16_t state = 0;
+                                 {
+                                    std::lock_guard<std::mutex> lock(m_buf_mtx);
+                                    uint16_t& board_state = m_i2c_map[INPUTS_I2C_ADDRESS].state;
+                                    board_state ^= hw_stub::input_mask(id);
+                                    state = board_state;
+                                 }
+                                 hw_stub::FrameBatch<2 * hw_stub::text_size<sizeof(hw_stub::Frame<I2C_STATE_SET>)>(), 2> batch;
+                                 batch.add(hw_stub::make_i2c_frame<I2C_STATE_SET>(INPUTS_I2C_ADDRESS, state));
+                                 if (trigger_interrupt)
+                                 {
+                                    batch.add(hw_stub::make_frame<I2C_INT_TRIGGER>());
+                                 }
+                                 return sendToHwStub(batch);
+                              },
+                              [this]() -> uint64_t
+                              {
+                                 return m_hwstub_driver.pendingTxBytes();
+                              });
+   step.finish(result, "%s : %u/s, %u ms => %u", __func__, profile.rate_per_s, profile.duration_ms, result);
+   return result;
+}
+LoadReport TestCore::stopLoad(uint32_t drain_ms)
+{
+   TestStep step(__func__);
+   /* drain (waiting for responses to the last events) is recorded by TestWait */
+   LoadReport report = m_load.stop(drain_ms);
+   char load_path [512];
+   snprintf(load_path, 512, "%s/logs/%s.load.json", PROJECT_ROOT_PATH, m_test_name.c_str());
+   m_load.exportJson(report, load_path, m_test_name);
+   step.done("%s : events %lu, responses %lu, dropped %lu, max backlog %lu", __func__, (unsigned long)report.events,
+             (unsigned long)report.responses, (unsigned long)report.dropped, (unsigned long)report.max_backlog);
+   return report;
+}
+ResourceSummary TestCore::waitForResourceWindow(uint32_t window_ms)
+{
+   ResourceSampler& sampler = m_bin_exec.get_resource_sampler();
+   uint32_t elapsed = sampler.elapsed();
+   if (sampler.isRunning() && elapsed < window_ms)
+   {
+      /* one more period, so the last sample is taken after the window is covered */
+      WAIT_MS(window_ms - elapsed + m_sampling_period_ms);
+   }
+   return sampler.summarize(window_ms);
+}
+bool TestCore::expectMaxRss(uint64_t bytes)
+{
+   TestStep step(__func__);
+   ResourceSummary summary = m_bin_exec.get_resource_sampler().summarize(0);
+   bool result = summary.samples > 0 && summary.max_rss_bytes <= bytes;
+   step.finish(result, "%s : %lu, max %lu (%zu samples) => %d", __func__, (unsigned long)bytes,
+                       (unsigned long)summary.max_rss_bytes, summary.samples, result);
+   return result;
+}
+bool TestCore::expectCpuBelow(double percent, uint32_t window_ms)
+{
+   TestStep step(__func__);
+   ResourceSummary summary = waitForResourceWindow(window_ms);
+   bool result = summary.samples > 1 && summary.cpu_percent < percent;
+   step.finish(result, "%s : %.1f%% %u ms, cpu %.1f%% in %u ms (%zu samples) => %d", __func__, percent, window_ms,
+                       summary.cpu_percent, summary.duration_ms, summary.samples, result);
+   return result;
+}
+bool TestCore::expectNoMemoryGrowth(uint32_t window_ms, uint64_t tolerance_bytes)
+{
+   TestStep step(__func__);
+   ResourceSummary summary = waitForResourceWindow(window_ms);
+   bool result = summary.samples > 1 && summary.rss_growth_bytes <= tolerance_bytes;
+   step.finish(result, "%s : %u ms %lu, growth %.0f in %u ms (%zu samples) => %d", __func__, window_ms,
+                       (unsigned long)tolerance_bytes, summary.rss_growth_bytes, summary.duration_ms, summary.samples, result);
    return result;
 }
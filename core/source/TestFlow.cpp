@@ -0,0 +1,263 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <algorithm>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "TestFlow.h"
+#include "Logger.h"
+
+Flow::Flow(std::coroutine_handle<promise_type> handle):
+m_handle(handle)
+{
+}
+Flow::Flow(Flow&& other):
+m_handle(std::exchange(other.m_handle, nullptr))
+{
+}
+Flow& Flow::operator=(Flow&& other)
+{
+   if (this != &other)
+   {
+      if (m_handle)
+      {
+         m_handle.destroy();
+      }
+      m_handle = std::exchange(other.m_handle, nullptr);
+   }
+   return *this;
+}
+Flow::~Flow()
+{
+   if (m_handle)
+   {
+      m_handle.destroy();
+   }
+}
+std::coroutine_handle<Flow::promise_type> Flow::handle()
+{
+   return m_handle;
+}
+
+FlowWait::FlowWait(TestFlows& flows, FlowWaitType type, uint8_t id, uint16_t value, const std::vector<uint8_t>& payload, uint32_t timeout_ms):
+type(type),
+deadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms)),
+m_flows(flows),
+m_id(id),
+m_value(value),
+m_payload(payload),
+m_result(false)
+{
+}
+bool FlowWait::await_ready()
+{
+   bool result = false;
+   if (type == FlowWaitType::TIMER)
+   {
+      result = deadline <= std::chrono::steady_clock::now();
+   }
+   else if (type == FlowWaitType::I2C_STATE)
+   {
+      uint16_t state = 0;
+      result = m_flows.deliveredI2CState(m_id, state) && state == m_value;
+   }
+   m_result = result;
+   return result;
+}
+void FlowWait::await_suspend(std::coroutine_handle<> handle)
+{
+   this->handle = handle;
+   m_flows.addWait(this);
+}
+bool FlowWait::await_resume()
+{
+   return m_result;
+}
+bool FlowWait::matches(const TestEvent& event)
+{
+   bool result = false;
+   if (type == FlowWaitType::I2C_STATE)
+   {
+      result = event.type == TestEventType::I2C_STATE && event.id == m_id && event.value == m_value;
+   }
+   else if (type == FlowWaitType::APP_NTF)
+   {
+      result = event.type == TestEventType::APP_NTF && event.id == m_id && (m_payload.empty() || m_payload == event.payload);
+   }
+   return result;
+}
+void FlowWait::complete(bool result)
+{
+   m_result = result;
+}
+
+TestFlows::TestFlows(TestCore& core):
+m_core(core)
+{
+   m_hook_id = m_core.addEventHook([this](const TestEvent& event)
+                                   {
+                                      std::lock_guard<std::mutex> lock(m_mtx);
+                                      m_events.push_back(event);
+                                      m_cv.notify_one();
+                                   });
+}
+TestFlows::~TestFlows()
+{
+   m_core.removeEventHook(m_hook_id);
+}
+void TestFlows::spawn(std::function<Flow(TestFlows&)> body)
+{
+   /* coroutine frame refers to the function object - it has to stay in place while flow exists */
+   m_bodies.push_back(body);
+   m_flows.push_back(m_bodies.back()(*this));
+   m_ready.push_back(m_flows.back().handle());
+}
+bool TestFlows::run(uint32_t timeout_ms)
+{
+   TestStep step(__func__);
+   auto start = std::chrono::steady_clock::now();
+   auto deadline = start + std::chrono::milliseconds(timeout_ms);
+   auto all_done = [this]()
+   {
+      return std::all_of(m_flows.begin(), m_flows.end(), [](Flow& flow) { return flow.handle().done(); });
+   };
+   {
+      /* only events received while flows run are delivered */
+      std::lock_guard<std::mutex> lock(m_mtx);
+      m_events.clear();
+   }
+   m_pending.clear();
+   m_i2c_states.clear();
+
+   resumeReady();
+   while (!all_done() && std::chrono::steady_clock::now() < deadline)
+   {
+      auto wake_up = deadline;
+      for (FlowWait* wait : m_waits)
+      {
+         wake_up = std::min(wake_up, wait->deadline);
+      }
+      {
+         std::unique_lock<std::mutex> lock(m_mtx);
+         auto wait_start = std::chrono::steady_clock::now();
+         m_cv.wait_until(lock, wake_up, [this]() { return !m_events.empty(); });
+         TestStep::recordWait(std::chrono::steady_clock::now() - wait_start);
+         m_pending.insert(m_pending.end(), m_events.begin(), m_events.end());
+         m_events.clear();
+      }
+      /* flows completed by an event are resumed before the next event, so their next wait can match it */
+      while (!m_pending.empty())
+      {
+         TestEvent event = std::move(m_pending.front());
+         m_pending.pop_front();
+         dispatch(event);
+         resumeReady();
+      }
+      expire();
+      resumeReady();
+   }
+
+   size_t finished = std::count_if(m_flows.begin(), m_flows.end(), [](Flow& flow) { return flow.handle().done(); });
+   bool result = finished == m_flows.size();
+   logger_send_if(!result, TF_ERROR, __func__, "%zu flows not finished in %u ms, %zu still waiting", m_flows.size() - finished,
+                                              timeout_ms, m_waits.size());
+   /* suspended flows are destroyed together with awaitables in their frames */
+   m_waits.clear();
+   m_ready.clear();
+   m_pending.clear();
+   size_t count = m_flows.size();
+   m_flows.clear();
+   m_bodies.clear();
+   step.finish(result, "%s : %zu flows, %zu finished in %u ms => %u", __func__, count, finished,
+               (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count(), result);
+   return result;
+}
+FlowWait TestFlows::i2cState(uint8_t address, uint16_t state, uint32_t timeout_ms)
+{
+   return FlowWait(*this, FlowWaitType::I2C_STATE, address, state, {}, timeout_ms);
+}
+FlowWait TestFlows::appNtf(NTF_CMD_ID id, const std::vector<uint8_t>& notification, uint32_t timeout_ms)
+{
+   return FlowWait(*this, FlowWaitType::APP_NTF, id, 0, notification, timeout_ms);
+}
+FlowWait TestFlows::after(uint32_t ms)
+{
+   return FlowWait(*this, FlowWaitType::TIMER, 0, 0, {}, ms);
+}
+TestCore& TestFlows::core()
+{
+   return m_core;
+}
+void TestFlows::addWait(FlowWait* wait)
+{
+   m_waits.push_back(wait);
+}
+bool TestFlows::deliveredI2CState(uint8_t address, uint16_t& state)
+{
+   auto delivered = m_i2c_states.find(address);
+   if (delivered != m_i2c_states.end())
+   {
+      state = delivered->second;
+      return true;
+   }
+   /* nothing delivered in this run - current state is valid only if no newer state is waiting for delivery */
+   auto is_state = [address](const TestEvent& event) { return event.type == TestEventType::I2C_STATE && event.id == address; };
+   if (std::any_of(m_pending.begin(), m_pending.end(), is_state))
+   {
+      return false;
+   }
+   /* state is read first - TestCore calls hooks with its lock held, so the event of newer state is already in m_events */
+   state = m_core.getI2CState(address);
+   std::lock_guard<std::mutex> lock(m_mtx);
+   return std::none_of(m_events.begin(), m_events.end(), is_state);
+}
+void TestFlows::complete(std::vector<FlowWait*>::iterator& it, bool result)
+{
+   (*it)->complete(result);
+   m_ready.push_back((*it)->handle);
+   it = m_waits.erase(it);
+}
+void TestFlows::dispatch(const TestEvent& event)
+{
+   if (event.type == TestEventType::I2C_STATE)
+   {
+      m_i2c_states[event.id] = event.value;
+   }
+   for (auto it = m_waits.begin(); it != m_waits.end();)
+   {
+      if ((*it)->matches(event))
+      {
+         complete(it, true);
+      }
+      else
+      {
+         it++;
+      }
+   }
+}
+void TestFlows::expire()
+{
+   auto now = std::chrono::steady_clock::now();
+   for (auto it = m_waits.begin(); it != m_waits.end();)
+   {
+      if ((*it)->deadline <= now)
+      {
+         /* timer completes successfully, event wait times out */
+         complete(it, (*it)->type == FlowWaitType::TIMER);
+      }
+      else
+      {
+         it++;
+      }
+   }
+}
+void TestFlows::resumeReady()
+{
+   while (!m_ready.empty())
+   {
+      std::coroutine_handle<> handle = m_ready.front();
+      m_ready.pop_front();
+      handle.resume();
+   }
+}
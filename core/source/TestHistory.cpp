@@ -0,0 +1,148 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "TestHistory.h"
+#include "Logger.h"
+
+namespace
+{
+uint8_t priority(const TestHistoryEntry* entry)
+{
+   if (!entry)
+   {
+      return 2;
+   }
+   if (entry->failures & 0x01)
+   {
+      return 0;
+   }
+   return entry->failures? 1 : 3;
+}
+}
+
+bool TestHistory::load(const std::string& file_path)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   m_path = file_path;
+   m_entries.clear();
+   FILE* file = fopen(file_path.c_str(), "r");
+   if (!file)
+   {
+      return false;
+   }
+   char line [1024];
+   while (fgets(line, sizeof(line), file))
+   {
+      unsigned long long duration_us = 0;
+      unsigned failures = 0;
+      unsigned runs = 0;
+      char name [1024];
+      if (sscanf(line, "%llu %x %u %1023s", &duration_us, &failures, &runs, name) == 4)
+      {
+         TestHistoryEntry& entry = m_entries[name];
+         entry.duration_us = duration_us;
+         entry.failures = failures;
+         entry.runs = std::min(runs, (unsigned)TEST_HISTORY_RUNS);
+      }
+   }
+   fclose(file);
+   return true;
+}
+void TestHistory::record(const std::string& test_name, bool failed, uint64_t duration_us)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   TestHistoryEntry& entry = m_entries[test_name];
+   /* average of recent runs, single slow run does not change the order much */
+   entry.duration_us = entry.runs == 0? duration_us : (entry.duration_us * 3 + duration_us) / 4;
+   entry.failures = (entry.failures << 1) | (failed? 1 : 0);
+   entry.runs = std::min(entry.runs + 1, TEST_HISTORY_RUNS);
+   save();
+}
+bool TestHistory::get(const std::string& test_name, TestHistoryEntry& entry)
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   auto it = m_entries.find(test_name);
+   if (it == m_entries.end())
+   {
+      return false;
+   }
+   entry = it->second;
+   return true;
+}
+std::vector<std::string> TestHistory::schedule(const std::vector<std::string>& tests)
+{
+   struct Item
+   {
+      const std::string* name;
+      const TestHistoryEntry* entry;
+   };
+   std::lock_guard<std::mutex> lock(m_mtx);
+   std::vector<Item> items;
+   items.reserve(tests.size());
+   for (const std::string& test : tests)
+   {
+      auto it = m_entries.find(test);
+      items.push_back({&test, it != m_entries.end()? &it->second : nullptr});
+   }
+   std::stable_sort(items.begin(), items.end(), [](const Item& a, const Item& b)
+                    {
+                       uint8_t a_priority = priority(a.entry);
+                       uint8_t b_priority = priority(b.entry);
+                       if (a_priority != b_priority || !a.entry)
+                       {
+                          return a_priority < b_priority;
+                       }
+                       int a_failures = __builtin_popcount(a.entry->failures);
+                       int b_failures = __builtin_popcount(b.entry->failures);
+                       if (a_failures != b_failures)
+                       {
+                          return a_failures > b_failures;
+                       }
+                       return a.entry->duration_us > b.entry->duration_us;
+                    });
+   std::vector<std::string> result;
+   result.reserve(items.size());
+   for (const Item& item : items)
+   {
+      result.push_back(*item.name);
+   }
+   return result;
+}
+bool TestHistory::save()
+{
+   if (m_path.empty())
+   {
+      return false;
+   }
+   /* written under temporary name, history is never left half written */
+   std::string tmp_path = m_path + ".tmp" + std::to_string(getpid());
+   FILE* file = fopen(tmp_path.c_str(), "w");
+   if (!file)
+   {
+      logger_send(TF_ERROR, __func__, "cannot write %s", tmp_path.c_str());
+      return false;
+   }
+   for (auto& entry : m_entries)
+   {
+      fprintf(file, "%llu %.2x %u %s\n", (unsigned long long)entry.second.duration_us, entry.second.failures,
+                    entry.second.runs, entry.first.c_str());
+   }
+   fclose(file);
+   return rename(tmp_path.c_str(), m_path.c_str()) == 0;
+}
+void TestHistory::Listener::OnTestEnd(const testing::TestInfo& test_info)
+{
+   const testing::TestResult* result = test_info.result();
+   if (!result->Skipped())
+   {
+      m_history.record(std::string(test_info.test_suite_name()) + "." + test_info.name(), result->Failed(),
+                       (uint64_t)result->elapsed_time() * 1000);
+   }
+}
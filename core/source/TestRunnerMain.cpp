@@ -0,0 +1,192 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "gtest/gtest.h"
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "ResultCache.h"
+#include "TestHistory.h"
+#include "StepReportListener.h"
+#include "system_config_values.h"
+
+/**
+ * Test runner used instead of gtest_main - tests which passed before with the same tested binary, test
+ * executable and configuration (see ResultCache) are filtered out. All tests are run with --force argument
+ * or TEST_CACHE_FORCE=1 environment variable (passes are still stored).
+ * Remaining tests are run in order given by TestHistory - recently failing first, then new and longest.
+ * gtest runs tests in order of registration, so the schedule is split to groups kept in that order and every group
+ * is run by own child process (crash of the test does not stop the following groups).
+ * Tests share the ports of the subject, so they are run one by one.
+ */
+namespace
+{
+std::vector<std::string> split(const std::string& text, char separator)
+{
+   std::vector<std::string> result;
+   size_t start = 0;
+   while (start < text.size())
+   {
+      size_t end = text.find(separator, start);
+      end = end == std::string::npos? text.size() : end;
+      if (end > start)
+      {
+         result.push_back(text.substr(start, end - start));
+      }
+      start = end + 1;
+   }
+   return result;
+}
+/* runs the test executable again with given arguments, returns exit status (-1 if not run or killed) */
+int run_group(const std::vector<std::string>& args, const char* spool_env, const std::string& spool)
+{
+   std::vector<char*> argv;
+   for (const std::string& arg : args)
+   {
+      argv.push_back((char*)arg.c_str());
+   }
+   argv.push_back(nullptr);
+   /* output of this process printed so far comes before output of the group */
+   fflush(stdout);
+   pid_t pid = fork();
+   if (pid == 0)
+   {
+      setenv(spool_env, spool.c_str(), 1);
+      execv("/proc/self/exe", argv.data());
+      _exit(127);
+   }
+   int status = 0;
+   if (pid < 0 || waitpid(pid, &status, 0) != pid)
+   {
+      fprintf(stderr, "cannot run test group: %s\n", strerror(errno));
+      return -1;
+   }
+   return WIFEXITED(status)? WEXITSTATUS(status) : -1;
+}
+}
+
+int main(int argc, char** argv)
+{
+   std::vector<std::string> original_args(argv, argv + argc);
+   testing::InitGoogleTest(&argc, argv);
+   const char* force_env = getenv("TEST_CACHE_FORCE");
+   bool force = force_env && strcmp(force_env, "1") == 0;
+   for (int i = 1; i < argc; i++)
+   {
+      force |= strcmp(argv[i], "--force") == 0;
+   }
+
+   testing::UnitTest* unit_test = testing::UnitTest::GetInstance();
+   std::vector<std::string> tests;
+   for (int i = 0; i < unit_test->total_test_suite_count(); i++)
+   {
+      const testing::TestSuite* suite = unit_test->GetTestSuite(i);
+      for (int j = 0; j < suite->total_test_count(); j++)
+      {
+         std::string name = std::string(suite->name()) + "." + suite->GetTestInfo(j)->name();
+         if (name.find("DISABLED_") == std::string::npos)
+         {
+            tests.push_back(name);
+         }
+      }
+   }
+
+   std::vector<std::string> inputs = {TEST_BINARY_ABSOLUTE_PATH, "/proc/self/exe"};
+   for (const std::string& config : split(TEST_CONFIG_FILES, ';'))
+   {
+      inputs.push_back(config);
+   }
+   const std::string cache_dir = std::string(PROJECT_ROOT_PATH) + "/" + RESULT_CACHE_DIR;
+   ResultCache cache;
+   std::vector<std::string> to_run;
+   if (cache.open(cache_dir, inputs))
+   {
+      std::string skipped;
+      size_t cached = 0;
+      for (const std::string& name : tests)
+      {
+         if (!force && cache.isPassed(name))
+         {
+            skipped += (cached++ == 0? "" : ":") + name;
+         }
+         else
+         {
+            to_run.push_back(name);
+         }
+      }
+      if (cached > 0)
+      {
+         std::string& filter = testing::GTEST_FLAG(filter);
+         filter += (filter.find('-') == std::string::npos? "-" : ":") + skipped;
+         printf("[ CACHED   ] %zu tests passed before with the same binaries and configuration, not run (--force to run them)\n", cached);
+      }
+      unit_test->listeners().Append(new ResultCache::Listener(cache));
+   }
+   else
+   {
+      to_run = tests;
+   }
+
+   TestHistory history;
+   history.load(cache_dir + "/" + TEST_HISTORY_FILE);
+
+   /* gtest runs tests in order of registration - scheduled order is split to groups, where it is kept,
+      every group is run by child process; explicit filter, shuffle, repeat or gtest report are left to gtest */
+   bool ordered = testing::GTEST_FLAG(filter) == "*" && !testing::GTEST_FLAG(shuffle) && testing::GTEST_FLAG(repeat) == 1 &&
+                  testing::GTEST_FLAG(output).empty();
+   std::vector<std::string> groups;
+   if (ordered)
+   {
+      std::map<std::string, size_t> index;
+      for (size_t i = 0; i < tests.size(); i++)
+      {
+         index[tests[i]] = i;
+      }
+      size_t failing = 0;
+      size_t previous = 0;
+      for (const std::string& name : history.schedule(to_run))
+      {
+         TestHistoryEntry entry;
+         failing += history.get(name, entry) && entry.failures;
+         if (groups.empty() || index[name] < previous)
+         {
+            groups.emplace_back();
+         }
+         groups.back() += (groups.back().empty()? "" : ":") + name;
+         previous = index[name];
+      }
+      if (groups.size() > 1)
+      {
+         printf("[ ORDER    ] %zu recently failing tests first, then new and longest tests (%zu groups)\n", failing, groups.size());
+      }
+   }
+   if (groups.size() <= 1)
+   {
+      unit_test->listeners().Append(new TestHistory::Listener(history));
+      return RUN_ALL_TESTS();
+   }
+
+   /* intermediate groups spool step records, the last one merges them into reports of the whole run */
+   const std::string spool = std::string(PROJECT_ROOT_PATH) + "/logs/.steps." + std::to_string(getpid()) + ".spool";
+   unlink(spool.c_str());
+   int result = 0;
+   for (size_t i = 0; i < groups.size(); i++)
+   {
+      std::vector<std::string> args = original_args;
+      args.push_back("--gtest_filter=" + groups[i]);
+      /* cached tests are not in any group */
+      args.push_back("--force");
+      int status = run_group(args, i + 1 < groups.size()? STEP_REPORT_SPOOL_ENV : STEP_REPORT_MERGE_ENV, spool);
+      result |= status != 0;
+   }
+   return result;
+}
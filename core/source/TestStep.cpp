@@ -0,0 +1,128 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <stdio.h>
+#include <stdarg.h>
+#include <mutex>
+#include <vector>
+#include <utility>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "TestStep.h"
+#include "Logger.h"
+
+namespace
+{
+thread_local TestStep* t_current_step = nullptr;
+thread_local uint64_t t_current_wait_us = 0;
+struct StepHooks
+{
+   std::mutex mtx;
+   std::vector<std::pair<int, StepHook>> hooks;
+   int next_id = 0;
+};
+/* hooks may be added during static initialization (see StepReportListener::install()) */
+StepHooks& step_hooks()
+{
+   static StepHooks hooks;
+   return hooks;
+}
+}
+
+TestStep::TestStep(const char* name):
+m_finished(false),
+m_parent(t_current_step)
+{
+   m_event.name = name;
+   m_event.start = std::chrono::steady_clock::now();
+   m_event.duration_us = 0;
+   m_event.outcome = StepOutcome::DONE;
+   /* wait of the parent step collected so far is kept aside */
+   m_event.wait_us = t_current_wait_us;
+   t_current_wait_us = 0;
+   t_current_step = this;
+}
+TestStep::~TestStep()
+{
+   if (!m_finished)
+   {
+      complete(StepOutcome::DONE, nullptr);
+   }
+}
+void TestStep::done(const char* fmt, ...)
+{
+   char detail [TEST_STEP_DETAIL_SIZE];
+   va_list args;
+   va_start(args, fmt);
+   vsnprintf(detail, sizeof(detail), fmt, args);
+   va_end(args);
+   complete(StepOutcome::DONE, detail);
+}
+void TestStep::finish(bool result, const char* fmt, ...)
+{
+   char detail [TEST_STEP_DETAIL_SIZE];
+   va_list args;
+   va_start(args, fmt);
+   vsnprintf(detail, sizeof(detail), fmt, args);
+   va_end(args);
+   complete(result? StepOutcome::PASSED : StepOutcome::FAILED, detail);
+}
+void TestStep::finish(bool result)
+{
+   complete(result? StepOutcome::PASSED : StepOutcome::FAILED, nullptr);
+}
+void TestStep::complete(StepOutcome outcome, const char* detail)
+{
+   if (m_finished)
+   {
+      return;
+   }
+   m_finished = true;
+   m_event.outcome = outcome;
+   m_event.duration_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_event.start).count();
+   uint64_t parent_wait_us = m_event.wait_us;
+   m_event.wait_us = t_current_wait_us;
+   /* waiting of nested step is also waiting of its parent */
+   t_current_wait_us = parent_wait_us + m_event.wait_us;
+   t_current_step = m_parent;
+   if (detail)
+   {
+      m_event.detail = detail;
+      logger_send(TF_TEST_MARKER, "TEST_STEP", "%s", detail);
+   }
+
+   StepHooks& hooks = step_hooks();
+   std::lock_guard<std::mutex> lock(hooks.mtx);
+   for (auto& hook : hooks.hooks)
+   {
+      hook.second(m_event);
+   }
+}
+void TestStep::recordWait(std::chrono::steady_clock::duration wait)
+{
+   if (t_current_step)
+   {
+      t_current_wait_us += std::chrono::duration_cast<std::chrono::microseconds>(wait).count();
+   }
+}
+int TestStep::addHook(StepHook hook)
+{
+   StepHooks& hooks = step_hooks();
+   std::lock_guard<std::mutex> lock(hooks.mtx);
+   hooks.hooks.push_back({hooks.next_id, hook});
+   return hooks.next_id++;
+}
+void TestStep::removeHook(int id)
+{
+   StepHooks& hooks = step_hooks();
+   std::lock_guard<std::mutex> lock(hooks.mtx);
+   for (auto it = hooks.hooks.begin(); it != hooks.hooks.end(); it++)
+   {
+      if (it->first == id)
+      {
+         hooks.hooks.erase(it);
+         break;
+      }
+   }
+}
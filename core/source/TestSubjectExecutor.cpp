@@ -2,36 +2,397 @@
  *   Includes of project headers
  * =============================*/
 #include "TestSubjectExecutor.h"
+#include "Logger.h"
+#include "TestStep.h"
+#include "TestWait.h"
 /* =============================
  *   Includes of common headers
  * =============================*/
 #include <unistd.h>
 #include <signal.h>
-#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+extern char** environ;
+
+namespace
+{
+int open_pidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+   return syscall(SYS_pidfd_open, pid, 0);
+#else
+   errno = ENOSYS;
+   return -1;
+#endif
+}
+int send_signal(pid_t pid, int pidfd, int signal)
+{
+#ifdef SYS_pidfd_send_signal
+   if (pidfd >= 0)
+   {
+      return syscall(SYS_pidfd_send_signal, pidfd, signal, NULL, 0);
+   }
+#endif
+   return kill(pid, signal);
+}
+uint64_t timeval_to_us(const struct timeval& tv)
+{
+   return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+}
 
 TestSubjectExecutor::TestSubjectExecutor(const std::string& process_path):
-m_test_subject_path(process_path)
+m_test_subject_path(process_path),
+m_mode(SubjectMode::BINARY),
+m_fake_subject(nullptr),
+m_sampling_period_ms(SAMPLER_DEFAULT_PERIOD_MS),
+m_profiling_frequency_hz(0)
 {
 
 }
 
+void TestSubjectExecutor::use_fake_subject(FakeSubject* subject, bool as_child)
+{
+   m_fake_subject = subject;
+   m_mode = subject? (as_child? SubjectMode::FAKE_CHILD : SubjectMode::FAKE_IN_PROCESS) : SubjectMode::BINARY;
+}
+
+bool TestSubjectExecutor::is_fake_subject()
+{
+   return m_mode != SubjectMode::BINARY;
+}
+
 pid_t TestSubjectExecutor::start_test_subject()
 {
-   pid_t pid = fork();
-   if (pid == 0)
+   pid_t pid = 0;
+   m_exit_info = {};
+   logger_send_if(!m_alloc_raw_path.empty() && m_mode != SubjectMode::BINARY, TF_ERROR, __func__,
+                  "allocation tracking requires binary subject, fake subject is not tracked");
+   if (m_mode == SubjectMode::FAKE_IN_PROCESS)
+   {
+      m_fake_subject->start();
+      return pid;
+   }
+
+   int start_gate [2] = {-1, -1};
+   if (m_mode == SubjectMode::FAKE_CHILD)
+   {
+      /* FakeSubject code has to run in the child, it cannot be spawned.
+       * Child waits until sampler and profiler are attached, so its threads are profiled too. */
+      if (pipe2(start_gate, O_CLOEXEC) != 0)
+      {
+         start_gate[0] = start_gate[1] = -1;
+      }
+      pid = fork();
+      if (pid == 0)
+      {
+         char gate = 0;
+         if (start_gate[0] >= 0)
+         {
+            close(start_gate[1]);
+            while (read(start_gate[0], &gate, 1) < 0 && errno == EINTR);
+            close(start_gate[0]);
+         }
+         _exit(m_fake_subject->runAsChild());
+      }
+   }
+   else
+   {
+      char* const argv [] = {(char*)m_test_subject_path.c_str(), NULL};
+      std::vector<std::string> env = build_environment();
+      std::vector<char*> envp;
+      for (std::string& variable : env)
+      {
+         envp.push_back((char*)variable.c_str());
+      }
+      envp.push_back(NULL);
+      int res = posix_spawn(&pid, m_test_subject_path.c_str(), NULL, NULL, argv, envp.data());
+      if (res != 0)
+      {
+         logger_send(TF_ERROR, __func__, "cannot spawn %s: %s", m_test_subject_path.c_str(), strerror(res));
+         pid = 0;
+      }
+   }
+   logger_send_if(pid < 0, TF_ERROR, __func__, "cannot fork: %s", strerror(errno));
+   if (pid > 0 && m_sampling_period_ms > 0)
+   {
+      m_sampler.start(pid, m_sampling_period_ms, m_timeline_path);
+   }
+   if (pid > 0 && m_profiling_frequency_hz > 0)
+   {
+      m_profiler.start(pid, m_profiling_frequency_hz);
+   }
+   if (start_gate[0] >= 0)
+   {
+      /* closing write end releases the child */
+      close(start_gate[0]);
+      close(start_gate[1]);
+   }
+   return pid > 0? pid : 0;
+}
+
+bool TestSubjectExecutor::stop_test_subject(pid_t pid)
+{
+   if (m_mode == SubjectMode::FAKE_IN_PROCESS)
+   {
+      m_fake_subject->stop();
+      return true;
+   }
+   if (pid <= 0)
+   {
+      return false;
+   }
+   /* shutdown is not part of the timeline, profiler needs mappings of running process */
+   m_sampler.stop();
+   m_profiler.stop(m_folded_path);
+   request_alloc_report(pid);
+
+   /* pidfd allows to wait with timeout without polling, it also cannot refer to recycled PID */
+   int pidfd = open_pidfd(pid);
+   auto start = std::chrono::steady_clock::now();
+   const struct
+   {
+      int signal;
+      uint32_t timeout_ms;
+   } escalation [] = {{SIGINT, SUBJECT_SIGINT_TIMEOUT_MS}, {SIGTERM, SUBJECT_SIGTERM_TIMEOUT_MS}, {SIGKILL, 0}};
+
+   bool reaped = wait_for_exit(pid, pidfd, 0);
+   for (auto& step : escalation)
+   {
+      if (reaped)
+      {
+         break;
+      }
+      send_signal(pid, pidfd, step.signal);
+      m_exit_info.stop_signal = step.signal;
+      /* after SIGKILL child has to be reaped, wait without timeout */
+      reaped = wait_for_exit(pid, pidfd, step.signal == SIGKILL? UINT32_MAX : step.timeout_ms);
+      logger_send_if(!reaped, TF_ERROR, __func__, "pid %d still running %u ms after signal %d", pid, step.timeout_ms, step.signal);
+   }
+   m_exit_info.shutdown_ms = m_exit_info.stop_signal?
+                             std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() : 0;
+   if (pidfd >= 0)
+   {
+      close(pidfd);
+   }
+   export_alloc_report();
+
+   const SubjectExitInfo& info = m_exit_info;
+   logger_send(TF_TC, __func__, "pid %d: %s %d after signal %d in %u ms, cpu %lu/%lu us, max rss %lu kB, faults %lu/%lu, ctx switches %lu/%lu",
+               pid, info.exited? "exit code" : "signal", info.exited? info.exit_code : info.term_signal, info.stop_signal, info.shutdown_ms,
+               (unsigned long)info.user_cpu_us, (unsigned long)info.system_cpu_us, (unsigned long)info.max_rss_kb,
+               (unsigned long)info.minor_faults, (unsigned long)info.major_faults,
+               (unsigned long)info.voluntary_switches, (unsigned long)info.involuntary_switches);
+   return info.reaped && info.exited && info.exit_code == 0 && info.stop_signal != SIGTERM && info.stop_signal != SIGKILL;
+}
+
+bool TestSubjectExecutor::wait_for_exit(pid_t pid, int pidfd, uint32_t timeout_ms)
+{
+   int status = 0;
+   struct rusage usage = {};
+   pid_t result = 0;
+   auto wait_start = std::chrono::steady_clock::now();
+   auto deadline = wait_start + std::chrono::milliseconds(timeout_ms == UINT32_MAX? 0 : timeout_ms);
+   /* wait4() gives usage of this child only, getrusage(RUSAGE_CHILDREN) would sum all children of the test */
+   if (pidfd < 0 && timeout_ms != UINT32_MAX)
+   {
+      /* without pidfd exit can only be polled */
+      TestWait::until(TEST_WAIT_SITE, std::chrono::milliseconds(timeout_ms), [&]()
+                      {
+                         result = wait4(pid, &status, WNOHANG, &usage);
+                         return result != 0;
+                      }, std::chrono::milliseconds(SUBJECT_POLL_PERIOD_MS));
+   }
+   while (pidfd >= 0 || timeout_ms == UINT32_MAX)
+   {
+      result = wait4(pid, &status, timeout_ms == UINT32_MAX? 0 : WNOHANG, &usage);
+      if (result != 0 || (timeout_ms != UINT32_MAX && std::chrono::steady_clock::now() >= deadline))
+      {
+         break;
+      }
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+      struct pollfd fd = {pidfd, POLLIN, 0};
+      poll(&fd, 1, std::max((int)left, 1));
+   }
+   if (pidfd >= 0 || timeout_ms == UINT32_MAX)
+   {
+      TestStep::recordWait(std::chrono::steady_clock::now() - wait_start);
+   }
+   if (result != pid)
+   {
+      /* on error there is nothing to wait for (e.g. already reaped), escalation is not needed */
+      logger_send_if(result < 0, TF_ERROR, __func__, "wait for %d failed: %s", pid, strerror(errno));
+      return result < 0;
+   }
+
+   m_exit_info.reaped = true;
+   m_exit_info.exited = WIFEXITED(status);
+   m_exit_info.exit_code = WIFEXITED(status)? WEXITSTATUS(status) : 0;
+   m_exit_info.term_signal = WIFSIGNALED(status)? WTERMSIG(status) : 0;
+   m_exit_info.user_cpu_us = timeval_to_us(usage.ru_utime);
+   m_exit_info.system_cpu_us = timeval_to_us(usage.ru_stime);
+   m_exit_info.max_rss_kb = usage.ru_maxrss;
+   m_exit_info.minor_faults = usage.ru_minflt;
+   m_exit_info.major_faults = usage.ru_majflt;
+   m_exit_info.voluntary_switches = usage.ru_nvcsw;
+   m_exit_info.involuntary_switches = usage.ru_nivcsw;
+   return true;
+}
+
+void TestSubjectExecutor::set_resource_sampling(uint32_t period_ms, const std::string& timeline_path)
+{
+   m_sampling_period_ms = period_ms;
+   m_timeline_path = timeline_path;
+}
+
+void TestSubjectExecutor::set_profiling(uint32_t frequency_hz, const std::string& folded_path)
+{
+   m_profiling_frequency_hz = frequency_hz;
+   m_folded_path = folded_path;
+}
+
+CpuProfiler& TestSubjectExecutor::get_profiler()
+{
+   return m_profiler;
+}
+
+ResourceSampler& TestSubjectExecutor::get_resource_sampler()
+{
+   return m_sampler;
+}
+
+void TestSubjectExecutor::set_alloc_tracking(const std::string& raw_path, const std::string& report_path, const std::string& test_name)
+{
+   m_alloc_raw_path = raw_path;
+   m_alloc_report_path = report_path;
+   m_alloc_test_name = test_name;
+}
+
+std::vector<std::string> TestSubjectExecutor::build_environment()
+{
+   std::vector<std::string> env;
+   std::string preload = ALLOC_TRACKER_LIBRARY_PATH;
+   bool tracking = !m_alloc_raw_path.empty();
+   for (char** variable = environ; *variable; variable++)
    {
-      int res = execl(m_test_subject_path.c_str(), NULL);
-      if (res < 0)
+      if (tracking && strncmp(*variable, "LD_PRELOAD=", 11) == 0)
       {
-         printf("returned %d, %s\n", res, strerror(errno));
+         preload += std::string(":") + (*variable + 11);
       }
-      exit(1);
+      else if (!tracking || strncmp(*variable, ALLOC_TRACKER_OUTPUT_ENV "=", strlen(ALLOC_TRACKER_OUTPUT_ENV) + 1) != 0)
+      {
+         env.push_back(*variable);
+      }
+   }
+   if (tracking)
+   {
+      unlink(m_alloc_raw_path.c_str());
+      env.push_back("LD_PRELOAD=" + preload);
+      env.push_back(ALLOC_TRACKER_OUTPUT_ENV "=" + m_alloc_raw_path);
    }
-   return pid;
+   return env;
 }
 
-void TestSubjectExecutor::stop_test_subject(pid_t pid)
+void TestSubjectExecutor::request_alloc_report(pid_t pid)
 {
-   kill(pid, SIGINT);
+   if (m_alloc_raw_path.empty() || m_mode != SubjectMode::BINARY)
+   {
+      return;
+   }
+   /* signal is sent only if preload library installed its handler - default action would kill the subject */
+   char path [64];
+   snprintf(path, sizeof(path), "/proc/%d/status", pid);
+   FILE* status = fopen(path, "r");
+   unsigned long long caught = 0;
+   char state = 0;
+   char line [256];
+   while (status && fgets(line, sizeof(line), status))
+   {
+      sscanf(line, "State: %c", &state);
+      if (sscanf(line, "SigCgt: %llx", &caught) == 1)
+      {
+         break;
+      }
+   }
+   if (status)
+   {
+      fclose(status);
+   }
+   if (!status || state == 'Z' || state == 'X')
+   {
+      /* nothing to request, report of the library was written at exit (if subject exited normally) */
+      logger_send(TF_TC, __func__, "pid %d already exited, report written at exit", pid);
+      return;
+   }
+   if (!(caught & (1ULL << (ALLOC_TRACKER_DUMP_SIGNAL - 1))))
+   {
+      logger_send(TF_ERROR, __func__, "allocation tracker not active in %d, report only at exit", pid);
+      return;
+   }
+   kill(pid, ALLOC_TRACKER_DUMP_SIGNAL);
+   bool written = TestWait::until(TEST_WAIT_SITE, std::chrono::milliseconds(SUBJECT_ALLOC_REPORT_TIMEOUT_MS), [this]()
+                                  {
+                                     return access(m_alloc_raw_path.c_str(), F_OK) == 0;
+                                  }, std::chrono::milliseconds(SUBJECT_POLL_PERIOD_MS));
+   logger_send_if(!written, TF_ERROR, __func__, "allocation report of %d not written in %u ms", pid, SUBJECT_ALLOC_REPORT_TIMEOUT_MS);
+}
+
+void TestSubjectExecutor::export_alloc_report()
+{
+   if (m_alloc_raw_path.empty() || m_mode != SubjectMode::BINARY)
+   {
+      return;
+   }
+   /* report written at exit (if subject exited normally) replaces the one requested before stop */
+   m_alloc_report.load(m_alloc_raw_path);
+   const AllocSummary& summary = m_alloc_report.summary();
+   logger_send(TF_TC, __func__, "allocations %lu, frees %lu, requested %lu B, peak live %lu B, top site %s", (unsigned long)summary.allocations,
+               (unsigned long)summary.frees, (unsigned long)summary.requested_bytes, (unsigned long)summary.peak_live_bytes,
+               summary.hot_spots.empty()? "-" : summary.hot_spots[0].site.c_str());
+   m_alloc_report.exportJson(m_alloc_report_path, m_alloc_test_name);
+}
+
+const AllocSummary& TestSubjectExecutor::get_alloc_summary()
+{
+   return m_alloc_report.summary();
+}
+
+const SubjectExitInfo& TestSubjectExecutor::get_exit_info()
+{
+   return m_exit_info;
+}
+
+bool TestSubjectExecutor::export_json(const std::string& file_path, const std::string& test_name)
+{
+   if (m_mode == SubjectMode::FAKE_IN_PROCESS)
+   {
+      return true;
+   }
+   FILE* file = fopen(file_path.c_str(), "w");
+   if (!file)
+   {
+      logger_send(TF_ERROR, __func__, "cannot create %s", file_path.c_str());
+      return false;
+   }
+   const SubjectExitInfo& info = m_exit_info;
+   fprintf(file, "{\n  \"test\": \"%s\",\n  \"reaped\": %s,\n  \"exited\": %s,\n  \"exit_code\": %d,\n  \"term_signal\": %d,\n"
+                 "  \"stop_signal\": %d,\n  \"shutdown_ms\": %u,\n  \"user_cpu_us\": %lu,\n  \"system_cpu_us\": %lu,\n"
+                 "  \"max_rss_kb\": %lu,\n  \"minor_faults\": %lu,\n  \"major_faults\": %lu,\n"
+                 "  \"voluntary_switches\": %lu,\n  \"involuntary_switches\": %lu\n}\n",
+                 test_name.c_str(), info.reaped? "true" : "false", info.exited? "true" : "false", info.exit_code, info.term_signal,
+                 info.stop_signal, info.shutdown_ms, (unsigned long)info.user_cpu_us, (unsigned long)info.system_cpu_us,
+                 (unsigned long)info.max_rss_kb, (unsigned long)info.minor_faults, (unsigned long)info.major_faults,
+                 (unsigned long)info.voluntary_switches, (unsigned long)info.involuntary_switches);
+   fclose(file);
+   return true;
 }
@@ -0,0 +1,120 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <algorithm>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "TestWait.h"
+#include "TestStep.h"
+
+namespace
+{
+typedef std::chrono::steady_clock::time_point time_point;
+/* steady_clock ticks of the last received frame, 0 - nothing received yet */
+std::atomic<int64_t> g_last_activity(0);
+struct WaitHooks
+{
+   std::mutex mtx;
+   std::vector<std::pair<int, WaitHook>> hooks;
+   int next_id = 0;
+};
+WaitHooks& wait_hooks()
+{
+   static WaitHooks hooks;
+   return hooks;
+}
+uint64_t to_us(std::chrono::steady_clock::duration time)
+{
+   return std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+}
+/* time of the last activity within [start, end], start if there was no activity in that time */
+time_point last_activity(time_point start, time_point end)
+{
+   time_point activity = time_point(std::chrono::steady_clock::duration(g_last_activity.load(std::memory_order_relaxed)));
+   return (activity > start && activity <= end)? activity : start;
+}
+void report(WaitEvent& event, time_point start, time_point end)
+{
+   event.waited_us = to_us(end - start);
+   TestStep::recordWait(end - start);
+   WaitHooks& hooks = wait_hooks();
+   std::lock_guard<std::mutex> lock(hooks.mtx);
+   for (auto& hook : hooks.hooks)
+   {
+      hook.second(event);
+   }
+}
+}
+
+void TestWait::sleep(const WaitSite& site, std::chrono::steady_clock::duration time)
+{
+   time_point start = std::chrono::steady_clock::now();
+   std::this_thread::sleep_for(time);
+   time_point end = std::chrono::steady_clock::now();
+
+   WaitEvent event = {};
+   event.site = site;
+   event.conditional = false;
+   event.requested_us = to_us(time);
+   time_point activity = last_activity(start, end);
+   event.satisfied = activity != start;
+   event.idle_us = to_us(end - activity);
+   report(event, start, end);
+}
+bool TestWait::until(const WaitSite& site, std::chrono::steady_clock::duration timeout, const std::function<bool()>& condition,
+                     std::chrono::steady_clock::duration poll)
+{
+   WaitEvent event = {};
+   event.site = site;
+   event.conditional = true;
+   event.requested_us = to_us(timeout);
+   time_point start = std::chrono::steady_clock::now();
+   time_point deadline = start + timeout;
+   time_point previous_check = start;
+   event.satisfied = condition();
+   event.already_satisfied = event.satisfied;
+   while (!event.satisfied && std::chrono::steady_clock::now() < deadline)
+   {
+      previous_check = std::chrono::steady_clock::now();
+      std::this_thread::sleep_for(std::min(poll, deadline - previous_check));
+      event.satisfied = condition();
+   }
+   time_point end = std::chrono::steady_clock::now();
+   if (event.satisfied && !event.already_satisfied)
+   {
+      /* condition most likely became true with the last frame received since previous check */
+      event.idle_us = to_us(end - std::max(previous_check, last_activity(start, end)));
+   }
+   report(event, start, end);
+   return event.satisfied;
+}
+void TestWait::markActivity()
+{
+   g_last_activity.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+}
+int TestWait::addHook(WaitHook hook)
+{
+   WaitHooks& hooks = wait_hooks();
+   std::lock_guard<std::mutex> lock(hooks.mtx);
+   hooks.hooks.push_back({hooks.next_id, hook});
+   return hooks.next_id++;
+}
+void TestWait::removeHook(int id)
+{
+   WaitHooks& hooks = wait_hooks();
+   std::lock_guard<std::mutex> lock(hooks.mtx);
+   for (auto it = hooks.hooks.begin(); it != hooks.hooks.end(); it++)
+   {
+      if (it->first == id)
+      {
+         hooks.hooks.erase(it);
+         break;
+      }
+   }
+}
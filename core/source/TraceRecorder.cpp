@@ -0,0 +1,390 @@
+/* =============================
+ *   Includes of common headers
+ * =============================*/
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <chrono>
+/* =============================
+ *   Includes of project headers
+ * =============================*/
+#include "TraceRecorder.h"
+#include "Logger.h"
+
+TraceRecorder::TraceRecorder():
+m_fd(-1),
+m_thread_running(false),
+m_accepting(false),
+m_seq(0),
+m_file_offset(0),
+m_dropped(0),
+m_write_errors(0)
+{
+}
+TraceRecorder::~TraceRecorder()
+{
+   close();
+}
+bool TraceRecorder::open(const std::string& file_path)
+{
+   bool result = false;
+   close();
+   do
+   {
+      m_fd = ::open(file_path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+      if (m_fd < 0)
+      {
+         logger_send(TF_ERROR, __func__, "cannot create trace file %s: %s", file_path.c_str(), strerror(errno));
+         break;
+      }
+      TraceFileHeader header = {};
+      memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC));
+      header.version = TRACE_FILE_VERSION;
+      header.header_size = sizeof(TraceFileHeader);
+      if (::write(m_fd, &header, sizeof(header)) != sizeof(header))
+      {
+         logger_send(TF_ERROR, __func__, "cannot write trace header: %s", strerror(errno));
+         ::close(m_fd);
+         m_fd = -1;
+         break;
+      }
+      m_active_buf.clear();
+      m_pending_buf.clear();
+      m_active_buf.reserve(TRACE_BUFFER_SIZE);
+      m_pending_buf.reserve(TRACE_BUFFER_SIZE);
+      m_index.clear();
+      m_seq = 0;
+      m_dropped = 0;
+      m_write_errors = 0;
+      m_file_offset = sizeof(TraceFileHeader);
+      m_accepting = true;
+      m_thread_running = true;
+      m_thread = std::thread(&TraceRecorder::threadExecute, this);
+      result = true;
+   }while(0);
+
+   return result;
+}
+void TraceRecorder::close()
+{
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      if (m_fd < 0)
+      {
+         return;
+      }
+      /* frames delivered by driver threads from now on are not recorded, writer flushes what was accepted */
+      m_accepting = false;
+      m_thread_running = false;
+      m_cv.notify_one();
+   }
+   m_thread.join();
+
+   if (m_write_errors > 0)
+   {
+      /* without index reader stops at the last complete record */
+      logger_send(TF_ERROR, __func__, "trace file incomplete, %lu write errors", (unsigned long)m_write_errors);
+      ::close(m_fd);
+      m_fd = -1;
+      return;
+   }
+
+   TraceFileHeader header = {};
+   memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC));
+   header.version = TRACE_FILE_VERSION;
+   header.header_size = sizeof(TraceFileHeader);
+   header.record_count = m_seq;
+   header.dropped_count = m_dropped;
+   header.index_offset = m_file_offset;
+   header.index_count = m_index.size();
+
+   size_t index_bytes = m_index.size() * sizeof(TraceIndexEntry);
+   if (::pwrite(m_fd, m_index.data(), index_bytes, m_file_offset) != (ssize_t)index_bytes ||
+       ::pwrite(m_fd, &header, sizeof(header), 0) != sizeof(header))
+   {
+      logger_send(TF_ERROR, __func__, "cannot write trace index: %s", strerror(errno));
+   }
+   logger_send_if(m_dropped > 0, TF_ERROR, __func__, "trace closed, %lu frames dropped", (unsigned long)m_dropped);
+   ::close(m_fd);
+   m_fd = -1;
+}
+bool TraceRecorder::isOpened()
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   return m_fd >= 0;
+}
+void TraceRecorder::record(TraceChannel channel, TraceDirection direction, const uint8_t* data, size_t size)
+{
+   size_t padded_size = (size + 7) & ~((size_t)7);
+   size_t total_size = sizeof(TraceRecordHeader) + padded_size;
+
+   std::lock_guard<std::mutex> lock(m_mtx);
+   if (!m_accepting)
+   {
+      return;
+   }
+   if (m_active_buf.size() + total_size > TRACE_BUFFER_SIZE && m_pending_buf.empty())
+   {
+      std::swap(m_active_buf, m_pending_buf);
+      m_cv.notify_one();
+   }
+   if (m_active_buf.size() + total_size > TRACE_BUFFER_SIZE)
+   {
+      /* writer cannot keep up - do not block the caller */
+      m_dropped++;
+      return;
+   }
+
+   TraceRecordHeader header = {};
+   header.seq = m_seq++;
+   header.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+   header.length = size;
+   header.channel = (uint8_t)channel;
+   header.direction = (uint8_t)direction;
+   if (header.seq % TRACE_INDEX_INTERVAL == 0)
+   {
+      m_index.push_back({header.seq, header.timestamp_ns, m_file_offset});
+   }
+
+   const uint8_t* header_bytes = (const uint8_t*)&header;
+   m_active_buf.insert(m_active_buf.end(), header_bytes, header_bytes + sizeof(header));
+   m_active_buf.insert(m_active_buf.end(), data, data + size);
+   m_active_buf.resize(m_active_buf.size() + padded_size - size, 0x00);
+   m_file_offset += total_size;
+}
+uint64_t TraceRecorder::recordedFrames()
+{
+   std::lock_guard<std::mutex> lock(m_mtx);
+   return m_seq;
+}
+uint64_t TraceRecorder::droppedFrames()
+{
+   return m_dropped;
+}
+uint64_t TraceRecorder::writeErrors()
+{
+   return m_write_errors;
+}
+void TraceRecorder::threadExecute()
+{
+   std::unique_lock<std::mutex> lock(m_mtx);
+   while (true)
+   {
+      m_cv.wait_for(lock, std::chrono::milliseconds(TRACE_FLUSH_PERIOD_MS), [&](){ return !m_pending_buf.empty() || !m_thread_running; });
+      if (m_pending_buf.empty() && !m_active_buf.empty())
+      {
+         std::swap(m_active_buf, m_pending_buf);
+      }
+      if (m_pending_buf.empty())
+      {
+         if (!m_thread_running)
+         {
+            break;
+         }
+         continue;
+      }
+      /* pending buffer is not touched by record() until it is cleared */
+      lock.unlock();
+      if (m_write_errors == 0 && !writeToFile(m_pending_buf))
+      {
+         /* file is short from now on - rest of the trace is discarded */
+         m_write_errors++;
+      }
+      lock.lock();
+      m_pending_buf.clear();
+   }
+}
+bool TraceRecorder::writeToFile(const std::vector<uint8_t>& data)
+{
+   size_t bytes_written = 0;
+   while (bytes_written < data.size())
+   {
+      ssize_t current_write = ::write(m_fd, data.data() + bytes_written, data.size() - bytes_written);
+      if (current_write <= 0)
+      {
+         logger_send(TF_ERROR, __func__, "trace write failed: %s", strerror(errno));
+         return false;
+      }
+      bytes_written += current_write;
+   }
+   return true;
+}
+
+TraceReader::TraceReader():
+m_data(nullptr),
+m_size(0),
+m_header(nullptr),
+m_index(nullptr),
+m_index_count(0),
+m_records_end(0),
+m_offset(0)
+{
+}
+TraceReader::~TraceReader()
+{
+   close();
+}
+bool TraceReader::open(const std::string& file_path)
+{
+   bool result = false;
+   close();
+   int fd = ::open(file_path.c_str(), O_RDONLY);
+   do
+   {
+      if (fd < 0)
+      {
+         logger_send(TF_ERROR, __func__, "cannot open trace file %s: %s", file_path.c_str(), strerror(errno));
+         break;
+      }
+      struct stat st;
+      if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TraceFileHeader))
+      {
+         logger_send(TF_ERROR, __func__, "invalid trace file %s", file_path.c_str());
+         break;
+      }
+      void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED)
+      {
+         logger_send(TF_ERROR, __func__, "cannot map trace file: %s", strerror(errno));
+         break;
+      }
+      m_data = (const uint8_t*)data;
+      m_size = st.st_size;
+      m_header = (const TraceFileHeader*)m_data;
+      if (memcmp(m_header->magic, TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC)) != 0 || m_header->version != TRACE_FILE_VERSION)
+      {
+         logger_send(TF_ERROR, __func__, "unsupported trace file %s", file_path.c_str());
+         close();
+         break;
+      }
+      m_records_end = m_size;
+      if (m_header->index_offset != 0 &&
+          m_header->index_offset + m_header->index_count * sizeof(TraceIndexEntry) <= m_size)
+      {
+         m_records_end = m_header->index_offset;
+         m_index = (const TraceIndexEntry*)(m_data + m_header->index_offset);
+         m_index_count = m_header->index_count;
+      }
+      setFilter(TraceFilter());
+      result = true;
+   }while(0);
+
+   if (fd >= 0)
+   {
+      ::close(fd);
+   }
+   return result;
+}
+void TraceReader::close()
+{
+   if (m_data)
+   {
+      munmap((void*)m_data, m_size);
+   }
+   m_data = nullptr;
+   m_size = 0;
+   m_header = nullptr;
+   m_index = nullptr;
+   m_index_count = 0;
+   m_records_end = 0;
+   m_offset = 0;
+}
+uint64_t TraceReader::frameCount()
+{
+   uint64_t result = 0;
+   if (m_index)
+   {
+      result = m_header->record_count;
+   }
+   else if (m_data)
+   {
+      /* trace not closed correctly - count records one by one */
+      TraceFilter filter = m_filter;
+      uint64_t offset = m_offset;
+      TraceFrame frame;
+      setFilter(TraceFilter());
+      while (next(frame))
+      {
+         result++;
+      }
+      m_filter = filter;
+      m_offset = offset;
+   }
+   return result;
+}
+uint64_t TraceReader::droppedFrames()
+{
+   return m_header? m_header->dropped_count : 0;
+}
+void TraceReader::setFilter(const TraceFilter& filter)
+{
+   m_filter = filter;
+   rewind();
+}
+void TraceReader::rewind()
+{
+   m_offset = findOffset(m_filter.from_seq);
+}
+bool TraceReader::next(TraceFrame& frame)
+{
+   while (m_data && m_offset + sizeof(TraceRecordHeader) <= m_records_end)
+   {
+      const TraceRecordHeader* record = (const TraceRecordHeader*)(m_data + m_offset);
+      uint64_t padded_size = (record->length + 7) & ~((uint64_t)7);
+      if (m_offset + sizeof(TraceRecordHeader) + padded_size > m_records_end)
+      {
+         /* record not completely written */
+         break;
+      }
+      m_offset += sizeof(TraceRecordHeader) + padded_size;
+
+      if (record->seq > m_filter.to_seq)
+      {
+         m_offset = m_records_end;
+         break;
+      }
+      if (record->seq < m_filter.from_seq ||
+          !(m_filter.channel_mask & (1 << record->channel)) ||
+          !(m_filter.direction_mask & (1 << record->direction)))
+      {
+         continue;
+      }
+      frame.seq = record->seq;
+      frame.timestamp_ns = record->timestamp_ns;
+      frame.channel = (TraceChannel)record->channel;
+      frame.direction = (TraceDirection)record->direction;
+      frame.data = (const uint8_t*)(record + 1);
+      frame.size = record->length;
+      return true;
+   }
+   return false;
+}
+uint64_t TraceReader::findOffset(uint64_t seq)
+{
+   uint64_t result = sizeof(TraceFileHeader);
+   if (m_index && m_index_count > 0)
+   {
+      /* last index entry not greater than requested sequence number */
+      uint64_t low = 0;
+      uint64_t high = m_index_count;
+      while (low < high)
+      {
+         uint64_t mid = (low + high) / 2;
+         if (m_index[mid].seq <= seq)
+         {
+            low = mid + 1;
+         }
+         else
+         {
+            high = mid;
+         }
+      }
+      if (low > 0)
+      {
+         result = m_index[low - 1].offset;
+      }
+   }
+   return result;
+}
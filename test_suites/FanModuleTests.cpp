@@ -1,5 +1,6 @@
 #include "gtest/gtest.h"
 #include "TestCore.h"
+#include "StepReportListener.h"
 #include "notification_types.h"
 #include "fan_types.h"
 
@@ -19,6 +20,9 @@
  */
 /* ==================================================================================================================== */
 
+/* timing of test steps - logs/FanModuleTests.steps.xml and logs/FanModuleTests.steps.txt */
+static const bool step_report_installed = StepReportListener::install("FanModuleTests");
+
 struct FanModuleTestFixture : public testing::Test
 {
 
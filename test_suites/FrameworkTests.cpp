@@ -0,0 +1,1218 @@
+#include "gtest/gtest.h"
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <thread>
+#include <fstream>
+#include "TestCore.h"
+#include "StepReportListener.h"
+#include "TestFlow.h"
+#include "TestCluster.h"
+#include "ResultCache.h"
+#include "TestHistory.h"
+#include "EventHistory.h"
+#include "ChannelImpairment.h"
+#include "TimerWheel.h"
+#include "FakeSubject.h"
+#include "notification_types.h"
+#include "stairs_led_types.h"
+
+/* ==================================================================================================================== */
+/**
+ * @file FrameworkTests.cpp
+ *
+ * @brief Tests of the test framework itself, performed against FakeSubject instead of SmartHome binary.
+ *
+ * @tests
+ * - I2C_sequence_received_after_input_activation
+ * - I2C_sequence_divergence_detected
+ * - I2C_sequence_stall_detected_at_step_timeout
+ * - I2C_bus_timing_and_errors_applied
+ * - Relay_and_notification_set_when_humidity_rised
+ * - App_notifications_matched_by_fields
+ * - Fake_subject_running_as_child_process
+ * - Latency_of_response_measured
+ * - Channel_metrics_collected
+ * - Transaction_sent_in_one_write
+ * - Frames_traced_in_order_and_filtered
+ * - Input_storm_throughput_measured
+ * - History_spilled_to_file_remains_queryable
+ * - Long_payloads_kept_within_memory_limit
+ * - Subject_resources_within_budget
+ * - Subject_profiled_to_folded_stacks
+ * - Step_duration_and_wait_reported
+ * - Idle_time_of_waits_reported
+ * - Concurrent_flows_run_on_one_thread
+ * - Flows_see_events_received_back_to_back
+ * - Debug_commands_pipelined
+ * - Subject_traces_awaited
+ * - Channel_impairment_applied
+ * - Subject_exit_status_and_rusage_captured
+ * - Subject_allocations_tracked
+ * - Sampler_restarted_after_process_exited
+ * - Subjects_served_by_one_reactor_thread
+ * - Same_seed_gives_same_impairment
+ * - Timer_wheel_releases_items_beyond_one_revolution_in_order
+ * - Cached_pass_invalidated_when_input_changes
+ * - Failing_tests_scheduled_first_then_longest
+ *
+ * @author Jacek Skowronek
+ * @date 19/10/2026
+ */
+/* ==================================================================================================================== */
+
+/* timing of test steps - logs/FrameworkTests.steps.xml and logs/FrameworkTests.steps.txt */
+static const bool step_report_installed = StepReportListener::install("FrameworkTests");
+
+/* delay of the first SLM state written by the fake subject after input activation */
+static const uint32_t SLM_FIRST_STATE_DELAY_MS = 10;
+
+struct FrameworkTestFixture : public testing::Test
+{
+
+   FrameworkTestFixture ()
+   {
+   }
+
+   ~FrameworkTestFixture ()
+   {
+   }
+   virtual void SetUp()
+   {
+      subject.addBehavior({FakeTrigger::INPUT_ACTIVATED, INPUT_STAIRS_SENSOR, 0,
+                           {{FakeActionType::I2C_WRITE, SLM_FIRST_STATE_DELAY_MS, SLM_I2C_ADDRESS, 0x0001, {}},
+                            {FakeActionType::I2C_WRITE, 20, SLM_I2C_ADDRESS, 0x0003, {}},
+                            {FakeActionType::I2C_WRITE, 30, SLM_I2C_ADDRESS, 0x0007, {}},
+                            {FakeActionType::APP_NTF, 30, 0, 0, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ON}}}});
+      subject.addBehavior({FakeTrigger::HUMIDITY_ABOVE, DHT_SENSOR2, 70,
+                           {{FakeActionType::RELAY_SET, 10, RELAY_BATHROOM_FAN, RELAY_STATE_ON, {}},
+                            {FakeActionType::APP_NTF, 10, 0, 0, {NTF_RELAYS_STATE, NTF_NTF, 2, 11, RELAY_STATE_ON}}}});
+   }
+
+   virtual void TearDown()
+   {
+      tc.stopTest();
+   }
+
+   void run(bool as_child)
+   {
+      tc.useFakeSubject(&subject, as_child);
+      ASSERT_TRUE(tc.runTest(::testing::UnitTest::GetInstance()->current_test_info()->name()));
+   }
+
+   std::string queryMetricsServer(uint16_t port, const std::string& request)
+   {
+      std::string result;
+      char buffer [4096];
+      int fd = socket(AF_INET, SOCK_STREAM, 0);
+      struct sockaddr_in addr = {};
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(port);
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0)
+      {
+         send(fd, request.data(), request.size(), 0);
+         ssize_t bytes = 0;
+         while ((bytes = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+         {
+            result.append(buffer, bytes);
+         }
+      }
+      close(fd);
+      return result;
+   }
+
+   FakeSubject subject;
+   TestCore tc;
+};
+
+TEST_F(FrameworkTestFixture, I2C_sequence_received_after_input_activation)
+{
+   /**
+    * <b>scenario</b>: Input activated, subject writes I2C sequence and sends notification.<br>
+    * <b>expected</b>: Sequence matched, notification received.<br>
+    * ************************************************
+    */
+   run(false);
+   tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
+   tc.triggerInterrupt();
+
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x0001, 0x0003, 0x0007}, 100, 1000));
+   WAIT_MS(50);
+   EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ON}));
+}
+
+TEST_F(FrameworkTestFixture, I2C_sequence_divergence_detected)
+{
+   /**
+    * <b>scenario</b>: Input activated, subject writes I2C sequence different than expected.<br>
+    * <b>expected</b>: Sequence not matched.<br>
+    * ************************************************
+    */
+   run(false);
+   tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
+   tc.triggerInterrupt();
+
+   EXPECT_FALSE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x0001, 0x0007}, 100, 300));
+}
+
+TEST_F(FrameworkTestFixture, I2C_sequence_stall_detected_at_step_timeout)
+{
+   /**
+    * <b>scenario</b>: Input activated, subject stops after the third state of expected sequence.<br>
+    * <b>expected</b>: Sequence not matched, reported at step timeout instead of total timeout.<br>
+    * ************************************************
+    */
+   run(false);
+   tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
+   tc.triggerInterrupt();
+
+   auto start = std::chrono::steady_clock::now();
+   EXPECT_FALSE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x0001, 0x0003, 0x0007, 0x000F}, 100, 20000));
+   EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20000));
+   EXPECT_FALSE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {}, 100, 100));
+}
+
+TEST_F(FrameworkTestFixture, I2C_bus_timing_and_errors_applied)
+{
+   /**
+    * <b>scenario</b>: Read of inputs board fails on the bus, then input activated again with first SLM write not acknowledged.<br>
+    * <b>expected</b>: SLM effect started only after successful read, NACKed state not written, transactions timed by the model.<br>
+    * ************************************************
+    */
+   I2CBusModel slm_bus;
+   slm_bus.latency_us = 2000;
+   slm_bus.clock_khz = 100;
+   I2CBusModel inputs_bus;
+   inputs_bus.error_permille = 1000;
+   run(false);
+   tc.setI2CBusModel(SLM_I2C_ADDRESS, slm_bus);
+   tc.setI2CTransactionResult(SLM_I2C_ADDRESS, I2C_RESULT_NACK);
+   tc.setI2CBusModel(INPUTS_I2C_ADDRESS, inputs_bus);
+   tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
+   tc.triggerInterrupt();
+
+   EXPECT_TRUE(TestWait::until(TEST_WAIT_SITE, std::chrono::milliseconds(1000), [&]()
+                               {
+                                  return tc.getI2CBusStats(INPUTS_I2C_ADDRESS).results[I2C_RESULT_BUS_ERROR] == 1;
+                               }));
+   EXPECT_FALSE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x0003}, 100, 100));
+
+   inputs_bus.error_permille = 0;
+   tc.setI2CBusModel(INPUTS_I2C_ADDRESS, inputs_bus);
+   tc.triggerInterrupt();
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x0003, 0x0007}, 100, 1000));
+
+   I2CBusStats stats = tc.getI2CBusStats(SLM_I2C_ADDRESS);
+   EXPECT_EQ(stats.results[I2C_RESULT_NACK], 1u);
+   EXPECT_EQ(stats.results[I2C_RESULT_OK], 2u);
+   EXPECT_EQ(stats.duration.min(), hw_stub::i2c_transfer_us(slm_bus, 1));
+   EXPECT_EQ(stats.duration.max(), hw_stub::i2c_transfer_us(slm_bus, hw_stub::I2C_BOARD_TRANSFER_BYTES));
+   EXPECT_EQ(tc.getI2CBusStats(INPUTS_I2C_ADDRESS).results[I2C_RESULT_OK], 1u);
+}
+
+TEST_F(FrameworkTestFixture, Relay_and_notification_set_when_humidity_rised)
+{
+   /**
+    * <b>scenario</b>: Humidity rised above threshold.<br>
+    * <b>expected</b>: Relay enabled, notification received.<br>
+    * ************************************************
+    */
+   run(false);
+   ASSERT_TRUE(tc.checkRelayState(RELAY_BATHROOM_FAN, RELAY_STATE_OFF));
+   tc.setSensorState(DHT_SENSOR2, DHT_TYPE_DHT11, 24, 71);
+   WAIT_MS(100);
+   EXPECT_TRUE(tc.checkRelayState(RELAY_BATHROOM_FAN, RELAY_STATE_ON));
+   EXPECT_TRUE(tc.wasAppNtfSent(NTF_RELAYS_STATE, {NTF_RELAYS_STATE, NTF_NTF, 2, 11, RELAY_STATE_ON}));
+}
+
+TEST_F(FrameworkTestFixture, App_notifications_matched_by_fields)
+{
+   /**
+    * <b>scenario</b>: Humidity rised above threshold, subject sends sensor reading, state of all relays and
+    *                  state of 30 relays (longer than payload kept inline in history).<br>
+    * <b>expected</b>: Notifications matched by decoded fields, malformed notification not decoded,
+    *                  long notification matched by all its bytes.<br>
+    * ************************************************
+    */
+   std::vector<uint8_t> long_ntf = {NTF_RELAYS_STATE_ALL, NTF_NTF, 60};
+   for (uint8_t relay = 1; relay <= 30; relay++)
+   {
+      long_ntf.push_back(100 + relay);
+      long_ntf.push_back(RELAY_STATE_ON);
+   }
+   long_ntf.back() = RELAY_STATE_OFF;
+   subject.addBehavior({FakeTrigger::HUMIDITY_ABOVE, DHT_SENSOR3, 60,
+                        {{FakeActionType::APP_NTF, 10, 0, 0, {NTF_ENV_SENSOR_DATA, NTF_NTF, 5, DHT_SENSOR3, 24, 0, 65, 0}},
+                         {FakeActionType::APP_NTF, 10, 0, 0, {NTF_RELAYS_STATE_ALL, NTF_NTF, 4, RELAY_BATHROOM_FAN, RELAY_STATE_ON, RELAY_SOCKETS, RELAY_STATE_OFF}},
+                         {FakeActionType::APP_NTF, 10, 0, 0, {NTF_FAN_STATE, NTF_NTF, 2, FAN_STATE_ON, 0}},
+                         {FakeActionType::APP_NTF, 10, 0, 0, long_ntf}}});
+   run(false);
+   tc.setSensorState(DHT_SENSOR3, DHT_TYPE_DHT11, 24, 65);
+   WAIT_MS(100);
+
+   EXPECT_TRUE(tc.wasAppNtfSent<NTF_ENV_SENSOR_DATA>([](const app_ntf::EnvReadingView& ntf)
+               {
+                  return ntf.sensor() == DHT_SENSOR3 && ntf.temperature() == 24 && ntf.humidity() > 60;
+               }));
+   EXPECT_TRUE(tc.wasAppNtfSent<NTF_RELAYS_STATE_ALL>(app_ntf::relay_is(RELAY_SOCKETS, RELAY_STATE_OFF)));
+   EXPECT_TRUE(tc.wasAppNtfSent<NTF_RELAYS_STATE_ALL>([](const app_ntf::RelayListView& ntf)
+               {
+                  return ntf.count() == 2 && ntf[0].id == RELAY_BATHROOM_FAN && ntf[0].state == RELAY_STATE_ON;
+               }));
+   EXPECT_FALSE(tc.wasAppNtfSent<NTF_RELAYS_STATE_ALL>(app_ntf::relay_is(RELAY_SOCKETS, RELAY_STATE_ON)));
+   /* fan notification carries 2 bytes of data, schema allows 1 */
+   EXPECT_FALSE(tc.wasAppNtfSent<NTF_FAN_STATE>(app_ntf::fan_is(FAN_STATE_ON)));
+
+   EXPECT_TRUE(tc.wasAppNtfSent<NTF_RELAYS_STATE_ALL>(app_ntf::relay_is((RELAY_ID)130, RELAY_STATE_OFF)));
+   EXPECT_TRUE(tc.wasAppNtfSent(NTF_RELAYS_STATE_ALL, long_ntf));
+   /* difference beyond inline payload */
+   long_ntf.back() = RELAY_STATE_ON;
+   EXPECT_FALSE(tc.wasAppNtfSent(NTF_RELAYS_STATE_ALL, long_ntf));
+}
+
+TEST_F(FrameworkTestFixture, Fake_subject_running_as_child_process)
+{
+   /**
+    * <b>scenario</b>: Fake subject started in child process, input activated.<br>
+    * <b>expected</b>: Sequence matched.<br>
+    * ************************************************
+    */
+   run(true);
+   tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
+   tc.triggerInterrupt();
+
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x0001, 0x0003, 0x0007}, 100, 1000));
+}
+
+TEST_F(FrameworkTestFixture, Latency_of_response_measured)
+{
+   /**
+    * <b>scenario</b>: Latency pairs declared, input activated several times.<br>
+    * <b>expected</b>: Every response measured.<br>
+    * ************************************************
+    */
+   run(false);
+   tc.addLatencyPair("interrupt_to_slm", StimulusType::INT_TRIGGER, ResponseType::I2C_STATE, SLM_I2C_ADDRESS);
+   tc.addLatencyPair("interrupt_to_slm_ntf", StimulusType::INT_TRIGGER, ResponseType::APP_NTF, NTF_SLM_STATE);
+   for (uint8_t i = 0; i < 3; i++)
+   {
+      tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
+      tc.triggerInterrupt();
+      EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x0001, 0x0003, 0x0007}, 100, 1000));
+      tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_INACTIVE);
+      tc.triggerInterrupt();
+   }
+   EXPECT_EQ(tc.getLatencyHistogram("interrupt_to_slm").count(), 3u);
+   EXPECT_GE(tc.getLatencyHistogram("interrupt_to_slm").min(), SLM_FIRST_STATE_DELAY_MS * 1000u);
+}
+
+TEST_F(FrameworkTestFixture, Channel_metrics_collected)
+{
+   /**
+    * <b>scenario</b>: Metrics server started, input activated.<br>
+    * <b>expected</b>: Frames counted per channel, metrics available over local socket.<br>
+    * ************************************************
+    */
+   run(false);
+   ASSERT_TRUE(tc.startMetricsServer(0));
+   uint16_t port = tc.getMetricsServerPort();
+   ASSERT_NE(port, 0u);
+   tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
+   tc.triggerInterrupt();
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x0001, 0x0003, 0x0007}, 100, 1000));
+   WAIT_MS(50);
+
+   std::string metrics = tc.getMetrics(MetricsFormat::PROMETHEUS);
+   EXPECT_NE(metrics.find("smarthome_tf_frames_sent_total{channel=\"hw_stub\"} 2\n"), std::string::npos);
+   EXPECT_NE(metrics.find("smarthome_tf_frames_received_total{channel=\"app_ntf\"} 1\n"), std::string::npos);
+   EXPECT_NE(metrics.find("smarthome_tf_decode_failures_total{channel=\"hw_stub\"} 0\n"), std::string::npos);
+
+   std::string response = queryMetricsServer(port, "GET /metrics.json HTTP/1.0\r\n\r\n");
+   EXPECT_EQ(response.find("HTTP/1.0 200 OK"), 0u);
+   EXPECT_NE(response.find("\"name\": \"smarthome_tf_frames_sent_total\", \"type\": \"counter\", \"labels\": {\"channel\": \"hw_stub\"}, \"value\": 2}"), std::string::npos);
+}
+
+TEST_F(FrameworkTestFixture, Transaction_sent_in_one_write)
+{
+   /**
+    * <b>scenario</b>: Several relays and inputs changed in transaction, committed with interrupt.<br>
+    * <b>expected</b>: One frame per board and interrupt sent in one socket write, subject sees final states.<br>
+    * ************************************************
+    */
+   run(false);
+   tc.begin();
+   tc.setRelayState(RELAY_BATHROOM_FAN, RELAY_STATE_ON);
+   tc.setRelayState(RELAY_KITCHEN_WALL, RELAY_STATE_ON);
+   tc.setRelayState(RELAY_KITCHEN_WALL, RELAY_STATE_OFF);
+   tc.setInputState(INPUT_SOCKETS, INPUT_STATE_ACTIVE);
+   tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
+   EXPECT_TRUE(tc.commit(true));
+
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x0001, 0x0003, 0x0007}, 100, 1000));
+   std::string metrics = tc.getMetrics(MetricsFormat::PROMETHEUS);
+   EXPECT_NE(metrics.find("smarthome_tf_frames_sent_total{channel=\"hw_stub\"} 3\n"), std::string::npos);
+   EXPECT_NE(metrics.find("smarthome_tf_socket_writes_total{channel=\"hw_stub\"} 1\n"), std::string::npos);
+   EXPECT_EQ(subject.getI2CState(RELAYS_I2C_ADDRESS), (uint16_t)~hw_stub::relay_mask(RELAY_BATHROOM_FAN));
+   EXPECT_EQ(subject.getI2CState(INPUTS_I2C_ADDRESS), (uint16_t)~(hw_stub::input_mask(INPUT_SOCKETS) | hw_stub::input_mask(INPUT_STAIRS_SENSOR)));
+}
+
+TEST_F(FrameworkTestFixture, Frames_traced_in_order_and_filtered)
+{
+   /**
+    * <b>scenario</b>: Input activated, then I2C traffic received for 300 ms, trace read after the test
+    *                  and again from its copy without index (as left by crashed test).<br>
+    * <b>expected</b>: Frames of all channels read in order of sequence numbers, filtered by channel, direction
+    *                  and sequence range, reading from the middle of trace gives the same frames with and without index.<br>
+    * ************************************************
+    */
+   const std::string trace_path = PROJECT_ROOT_PATH "/logs/Frames_traced_in_order_and_filtered.trace";
+   const std::string copy_path = trace_path + ".noindex";
+   run(false);
+   tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
+   tc.triggerInterrupt();
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x0001, 0x0003, 0x0007}, 100, 1000));
+   WAIT_MS(50);
+   EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ON}));
+   subject.setTraffic(FakeTraffic::I2C_NTF, 2000, {RELAYS_I2C_ADDRESS});
+   WAIT_MS(300);
+   subject.setTraffic(FakeTraffic::I2C_NTF, 0, {});
+   tc.stopTest();
+
+   TraceReader reader;
+   ASSERT_TRUE(reader.open(trace_path));
+   uint64_t count = reader.frameCount();
+   EXPECT_GT(count, 2u * TRACE_INDEX_INTERVAL);
+   EXPECT_EQ(reader.droppedFrames(), 0u);
+
+   TraceFrame frame;
+   uint64_t expected_seq = 0;
+   uint64_t last_timestamp = 0;
+   while (reader.next(frame))
+   {
+      EXPECT_EQ(frame.seq, expected_seq++);
+      EXPECT_GE(frame.timestamp_ns, last_timestamp);
+      last_timestamp = frame.timestamp_ns;
+   }
+   EXPECT_EQ(expected_seq, count);
+
+   TraceFilter filter;
+   filter.channel_mask = 1 << (uint8_t)TraceChannel::APP_NTF;
+   reader.setFilter(filter);
+   bool slm_ntf_found = false;
+   while (reader.next(frame))
+   {
+      EXPECT_EQ(frame.channel, TraceChannel::APP_NTF);
+      EXPECT_EQ(frame.direction, TraceDirection::INBOUND);
+      /* notifications are sent as hex text */
+      uint8_t id = 0;
+      slm_ntf_found |= hw_stub::decode((const char*)frame.data, std::min<size_t>(frame.size, 2), &id, 1) == 1 && id == NTF_SLM_STATE;
+   }
+   EXPECT_TRUE(slm_ntf_found);
+
+   filter.channel_mask = 1 << (uint8_t)TraceChannel::HW_STUB;
+   filter.direction_mask = 1 << (uint8_t)TraceDirection::OUTBOUND;
+   reader.setFilter(filter);
+   uint64_t outbound = 0;
+   while (reader.next(frame))
+   {
+      EXPECT_EQ(frame.channel, TraceChannel::HW_STUB);
+      EXPECT_EQ(frame.direction, TraceDirection::OUTBOUND);
+      outbound++;
+   }
+   EXPECT_GE(outbound, 2u);
+
+   /* range starting past the first index entry - reader seeks instead of scanning from the beginning */
+   TraceFilter range;
+   range.from_seq = TRACE_INDEX_INTERVAL + 10;
+   range.to_seq = range.from_seq + 19;
+   std::vector<uint64_t> indexed;
+   reader.setFilter(range);
+   while (reader.next(frame))
+   {
+      indexed.push_back(frame.seq);
+   }
+   ASSERT_EQ(indexed.size(), 20u);
+   EXPECT_EQ(indexed.front(), range.from_seq);
+   EXPECT_EQ(indexed.back(), range.to_seq);
+   reader.close();
+
+   /* header and records only, as written before the trace is closed */
+   std::ifstream trace(trace_path, std::ios::binary);
+   std::vector<char> content((std::istreambuf_iterator<char>(trace)), std::istreambuf_iterator<char>());
+   ASSERT_GE(content.size(), sizeof(TraceFileHeader));
+   TraceFileHeader header;
+   memcpy(&header, content.data(), sizeof(header));
+   ASSERT_LE(header.index_offset, content.size());
+   content.resize(header.index_offset);
+   header.record_count = 0;
+   header.dropped_count = 0;
+   header.index_offset = 0;
+   header.index_count = 0;
+   memcpy(content.data(), &header, sizeof(header));
+   std::ofstream(copy_path, std::ios::binary).write(content.data(), content.size());
+
+   ASSERT_TRUE(reader.open(copy_path));
+   EXPECT_EQ(reader.frameCount(), count);
+   std::vector<uint64_t> scanned;
+   reader.setFilter(range);
+   while (reader.next(frame))
+   {
+      scanned.push_back(frame.seq);
+   }
+   EXPECT_EQ(scanned, indexed);
+   reader.close();
+   unlink(copy_path.c_str());
+}
+
+TEST_F(FrameworkTestFixture, Input_storm_throughput_measured)
+{
+   /**
+    * <b>scenario</b>: Input toggled 200 times per second for 300 ms, subject notifies every change.<br>
+    * <b>expected</b>: Every event answered, backlog does not grow.<br>
+    * ************************************************
+    */
+   subject.addBehavior({FakeTrigger::INPUT_ACTIVATED, INPUT_SOCKETS, 0, {{FakeActionType::APP_NTF, 0, 0, 0, {NTF_INPUTS_STATE, NTF_NTF, 2, INPUT_SOCKETS, INPUT_STATE_ACTIVE}}}});
+   subject.addBehavior({FakeTrigger::INPUT_DEACTIVATED, INPUT_SOCKETS, 0, {{FakeActionType::APP_NTF, 0, 0, 0, {NTF_INPUTS_STATE, NTF_NTF, 2, INPUT_SOCKETS, INPUT_STATE_INACTIVE}}}});
+   run(false);
+
+   LoadProfile profile;
+   profile.pattern = LoadPattern::CONSTANT;
+   profile.rate_per_s = 200;
+   profile.duration_ms = 300;
+   profile.inputs = {INPUT_SOCKETS};
+   profile.response = ResponseType::APP_NTF;
+   profile.response_id = NTF_INPUTS_STATE;
+   ASSERT_TRUE(tc.startLoad(profile));
+   WAIT_MS(300);
+   LoadReport report = tc.stopLoad(200);
+
+   EXPECT_EQ(report.events, (uint64_t)profile.rate_per_s * profile.duration_ms / 1000);
+   EXPECT_EQ(report.send_failures, 0u);
+   EXPECT_EQ(report.responses, report.events);
+   EXPECT_EQ(report.dropped, 0u);
+   EXPECT_FALSE(report.samples.empty());
+}
+
+TEST_F(FrameworkTestFixture, History_spilled_to_file_remains_queryable)
+{
+   /**
+    * <b>scenario</b>: History limited to two segments, notifications (one longer than inline payload)
+    *                  received followed by heavy traffic.<br>
+    * <b>expected</b>: Old events moved to spill files, still found by queries.<br>
+    * ************************************************
+    */
+   std::vector<uint8_t> long_ntf = {NTF_RELAYS_STATE_ALL, NTF_NTF, 60};
+   for (uint8_t relay = 1; relay <= 30; relay++)
+   {
+      long_ntf.push_back(100 + relay);
+      long_ntf.push_back(relay % 2? RELAY_STATE_ON : RELAY_STATE_OFF);
+   }
+   subject.addBehavior({FakeTrigger::HUMIDITY_ABOVE, DHT_SENSOR3, 60, {{FakeActionType::APP_NTF, 0, 0, 0, long_ntf}}});
+   tc.setHistoryLimit(2 * HISTORY_SEGMENT_SIZE);
+   run(false);
+   tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
+   tc.triggerInterrupt();
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x0001, 0x0003, 0x0007}, 100, 1000));
+   tc.setSensorState(DHT_SENSOR3, DHT_TYPE_DHT11, 24, 65);
+   WAIT_MS(50);
+
+   subject.setTraffic(FakeTraffic::APP_NTF, 2000, {NTF_RELAYS_STATE, NTF_NTF, 2, 11, RELAY_STATE_OFF});
+   subject.setTraffic(FakeTraffic::I2C_NTF, 2000, {RELAYS_I2C_ADDRESS});
+   WAIT_MS(400);
+   subject.setTraffic(FakeTraffic::APP_NTF, 0, {});
+   subject.setTraffic(FakeTraffic::I2C_NTF, 0, {});
+   WAIT_MS(50);
+
+   EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ON}));
+   EXPECT_TRUE(tc.expectI2CSequence(RELAYS_I2C_ADDRESS, {0x0001, 0x0002, 0x0003}, 100, 100));
+   EXPECT_NE(access(PROJECT_ROOT_PATH "/logs/History_spilled_to_file_remains_queryable.app_ntf.spill", F_OK), -1);
+   EXPECT_TRUE(tc.wasAppNtfSent(NTF_RELAYS_STATE_ALL, long_ntf));
+   EXPECT_NE(access(PROJECT_ROOT_PATH "/logs/History_spilled_to_file_remains_queryable.app_ntf.spill.payload", F_OK), -1);
+}
+
+TEST(EventHistoryTest, Long_payloads_kept_within_memory_limit)
+{
+   /**
+    * <b>scenario</b>: Limited history receives 10 MB of payloads longer than inline payload.<br>
+    * <b>expected</b>: Memory usage and RSS do not grow after the limit is reached, payloads kept in memory and spill file.<br>
+    * ************************************************
+    */
+   auto rss = []()
+   {
+      long size = 0;
+      long pages = 0;
+      FILE* statm = fopen("/proc/self/statm", "r");
+      if (statm)
+      {
+         EXPECT_EQ(fscanf(statm, "%ld %ld", &size, &pages), 2);
+         fclose(statm);
+      }
+      return (size_t)pages * sysconf(_SC_PAGESIZE);
+   };
+   const size_t limit = 16 * HISTORY_SEGMENT_SIZE;
+   const size_t count = 50000;
+   std::vector<uint8_t> payload(200);
+   EventHistory history;
+   history.configure(PROJECT_ROOT_PATH "/logs/Long_payloads_kept_within_memory_limit.spill", limit);
+
+   for (size_t i = 0; i < count; i++)
+   {
+      payload[0] = i % 256;
+      history.push(NTF_RELAYS_STATE_ALL, 0, payload.data(), payload.size());
+      if (i == count / 10)
+      {
+         EXPECT_EQ(history.memoryUsage(), limit);
+      }
+   }
+   size_t rss_before = rss();
+   for (size_t i = 0; i < count; i++)
+   {
+      payload[0] = i % 256;
+      history.push(NTF_RELAYS_STATE_ALL, 0, payload.data(), payload.size());
+   }
+   EXPECT_EQ(history.memoryUsage(), limit);
+   EXPECT_LT(rss(), rss_before + 256 * 1024);
+
+   const HistoryRecord* newest = history.back();
+   ASSERT_NE(newest, nullptr);
+   ASSERT_NE(history.payload(*newest), nullptr);
+   EXPECT_EQ(history.payload(*newest)[0], (count - 1) % 256);
+   EXPECT_EQ(history.droppedCount(), 0u);
+   const HistoryRecord* oldest = history.at(1);
+   ASSERT_NE(oldest, nullptr);
+   ASSERT_NE(history.payload(*oldest), nullptr);
+   EXPECT_EQ(history.payload(*oldest)[0], 1);
+   EXPECT_EQ(memcmp(history.payload(*oldest) + 1, payload.data() + 1, payload.size() - 1), 0);
+}
+
+TEST_F(FrameworkTestFixture, Subject_resources_within_budget)
+{
+   /**
+    * <b>scenario</b>: Fake subject run as child process, sampled every 20 ms while idle.<br>
+    * <b>expected</b>: Timeline written, RSS, CPU and memory growth within budget.<br>
+    * ************************************************
+    */
+   tc.setResourceSampling(20);
+   run(true);
+   EXPECT_TRUE(tc.expectCpuBelow(50, 300));
+   EXPECT_TRUE(tc.expectNoMemoryGrowth(300));
+   EXPECT_TRUE(tc.expectMaxRss(64 * 1024 * 1024));
+   EXPECT_FALSE(tc.expectMaxRss(1024));
+   EXPECT_NE(access(PROJECT_ROOT_PATH "/logs/Subject_resources_within_budget.resources.csv", F_OK), -1);
+}
+
+TEST_F(FrameworkTestFixture, Subject_profiled_to_folded_stacks)
+{
+   /**
+    * <b>scenario</b>: Profiling enabled, fake subject run as child process handles input storm.<br>
+    * <b>expected</b>: Folded stacks written with symbols resolved from the binary.<br>
+    * ************************************************
+    */
+   subject.addBehavior({FakeTrigger::INPUT_ACTIVATED, INPUT_SOCKETS, 0, {{FakeActionType::APP_NTF, 0, 0, 0, {NTF_INPUTS_STATE, NTF_NTF, 2, INPUT_SOCKETS, INPUT_STATE_ACTIVE}}}});
+   tc.enableProfiling(4999);
+   run(true);
+   if (!tc.isProfiling())
+   {
+      GTEST_SKIP() << "perf events not permitted (see /proc/sys/kernel/perf_event_paranoid)";
+   }
+   LoadProfile profile;
+   profile.rate_per_s = 2000;
+   profile.duration_ms = 300;
+   profile.inputs = {INPUT_SOCKETS};
+   ASSERT_TRUE(tc.startLoad(profile));
+   WAIT_MS(300);
+   tc.stopLoad(100);
+   tc.stopTest();
+
+   FILE* file = fopen(PROJECT_ROOT_PATH "/logs/Subject_profiled_to_folded_stacks.folded", "r");
+   ASSERT_NE(file, nullptr);
+   char line [4096];
+   bool resolved = false;
+   while (fgets(line, sizeof(line), file))
+   {
+      resolved |= strstr(line, "FakeSubject::") != nullptr;
+   }
+   fclose(file);
+   EXPECT_TRUE(resolved);
+}
+
+TEST_F(FrameworkTestFixture, Step_duration_and_wait_reported)
+{
+   /**
+    * <b>scenario</b>: Step hook registered, notification which never comes is awaited and relay state checked.<br>
+    * <b>expected</b>: Waiting step reported as failed with its timeout accounted as wait, check reported as passed.<br>
+    * ************************************************
+    */
+   std::vector<StepEvent> events;
+   int hook = TestStep::addHook([&](const StepEvent& event)
+                                {
+                                   events.push_back(event);
+                                });
+   run(false);
+   EXPECT_FALSE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x1234, 100));
+   EXPECT_TRUE(tc.checkRelayState(RELAY_BATHROOM_FAN, RELAY_STATE_OFF));
+   TestStep::removeHook(hook);
+
+   ASSERT_EQ(events.size(), 3u);
+   EXPECT_EQ(events[0].name, "runTest");
+   EXPECT_EQ(events[0].outcome, StepOutcome::PASSED);
+   EXPECT_EQ(events[1].name, "waitForI2CNotification");
+   EXPECT_EQ(events[1].outcome, StepOutcome::FAILED);
+   EXPECT_GE(events[1].duration_us, 100000u);
+   EXPECT_GE(events[1].wait_us, 90000u);
+   EXPECT_LE(events[1].wait_us, events[1].duration_us);
+   EXPECT_EQ(events[2].name, "checkRelayState");
+   EXPECT_EQ(events[2].outcome, StepOutcome::PASSED);
+   EXPECT_EQ(events[2].wait_us, 0u);
+   EXPECT_NE(events[2].detail.find("checkRelayState"), std::string::npos);
+}
+
+TEST_F(FrameworkTestFixture, Idle_time_of_waits_reported)
+{
+   /**
+    * <b>scenario</b>: Wait hook registered, input activated and fixed time waited for the I2C sequence,
+    *                  then final state awaited and nothing happens during another fixed wait.<br>
+    * <b>expected</b>: Waits reported with call sites, time after the sequence reported as idle, awaited
+    *                  state reported as already reached.<br>
+    * ************************************************
+    */
+   std::vector<WaitEvent> waits;
+   int hook = TestWait::addHook([&](const WaitEvent& event)
+                                {
+                                   waits.push_back(event);
+                                });
+   run(false);
+   tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
+   tc.triggerInterrupt();
+   int sequence_line = __LINE__ + 1;
+   WAIT_MS(300);
+   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0007, 1000));
+   WAIT_MS(50);
+   TestWait::removeHook(hook);
+
+   /* connection wait of runTest() and the three waits of the test */
+   ASSERT_EQ(waits.size(), 4u);
+   EXPECT_TRUE(waits[0].conditional);
+   EXPECT_TRUE(waits[0].satisfied);
+   EXPECT_STREQ(waits[1].site.file, __FILE__);
+   EXPECT_EQ(waits[1].site.line, sequence_line);
+   EXPECT_FALSE(waits[1].conditional);
+   EXPECT_TRUE(waits[1].satisfied);
+   EXPECT_EQ(waits[1].requested_us, 300000u);
+   EXPECT_GE(waits[1].waited_us, 300000u);
+   /* sequence takes 30 ms */
+   EXPECT_GE(waits[1].idle_us, 200000u);
+   EXPECT_LT(waits[1].idle_us, waits[1].waited_us);
+   EXPECT_TRUE(waits[2].conditional);
+   EXPECT_TRUE(waits[2].already_satisfied);
+   EXPECT_EQ(waits[2].idle_us, 0u);
+   EXPECT_FALSE(waits[3].satisfied);
+   EXPECT_EQ(waits[3].idle_us, waits[3].waited_us);
+}
+
+TEST_F(FrameworkTestFixture, Concurrent_flows_run_on_one_thread)
+{
+   /**
+    * <b>scenario</b>: Three flows run concurrently - stairs sensor activation, humidity rise started while
+    *                  stairs sequence is ongoing and a wait for notification which never comes.<br>
+    * <b>expected</b>: Both sequences verified, missing notification times out, flows resumed in the order of events,
+    *                  all of them in the test thread.<br>
+    * ************************************************
+    */
+   run(false);
+   TestFlows flows(tc);
+   std::vector<std::string> order;
+   std::vector<std::thread::id> threads;
+   auto mark = [&](const char* name)
+   {
+      order.push_back(name);
+      threads.push_back(std::this_thread::get_id());
+   };
+   flows.spawn([&](TestFlows& tc) -> Flow
+               {
+                  tc.core().setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
+                  tc.core().triggerInterrupt();
+                  bool slm_started = co_await tc.i2cState(SLM_I2C_ADDRESS, 0x0001, 500);
+                  EXPECT_TRUE(slm_started);
+                  mark("slm_1");
+                  std::vector<uint8_t> slm_on_ntf = {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ON};
+                  bool slm_on = co_await tc.appNtf(NTF_SLM_STATE, slm_on_ntf, 500);
+                  EXPECT_TRUE(slm_on);
+                  /* last state is sent together with notification - completes immediately if already reached */
+                  bool slm_sequence = co_await tc.i2cState(SLM_I2C_ADDRESS, 0x0007, 500);
+                  EXPECT_TRUE(slm_sequence);
+                  mark("slm_on");
+               });
+   flows.spawn([&](TestFlows& tc) -> Flow
+               {
+                  /* started exactly when stairs sequence begins, no timing guess */
+                  bool humidity_start = co_await tc.i2cState(SLM_I2C_ADDRESS, 0x0001, 500);
+                  EXPECT_TRUE(humidity_start);
+                  co_await tc.after(1);
+                  mark("humidity");
+                  tc.core().setSensorState(DHT_SENSOR2, DHT_TYPE_DHT11, 24, 71);
+                  std::vector<uint8_t> fan_on_ntf = {NTF_RELAYS_STATE, NTF_NTF, 2, 11, RELAY_STATE_ON};
+                  bool fan_ntf = co_await tc.appNtf(NTF_RELAYS_STATE, fan_on_ntf, 500);
+                  EXPECT_TRUE(fan_ntf);
+                  mark("fan_on");
+               });
+   flows.spawn([&](TestFlows& tc) -> Flow
+               {
+                  bool fan_ntf_missing = co_await tc.appNtf(NTF_FAN_STATE, {}, 100);
+                  EXPECT_FALSE(fan_ntf_missing);
+                  mark("timeout");
+               });
+
+   EXPECT_TRUE(flows.run(2000));
+   ASSERT_EQ(order.size(), 5u);
+   EXPECT_EQ(order[0], "slm_1");
+   EXPECT_EQ(order[1], "humidity");
+   /* sequences end in any order, before the third flow times out */
+   EXPECT_TRUE((order[2] == "slm_on" && order[3] == "fan_on") || (order[2] == "fan_on" && order[3] == "slm_on"));
+   EXPECT_EQ(order[4], "timeout");
+   for (const std::thread::id& id : threads)
+   {
+      EXPECT_EQ(id, std::this_thread::get_id());
+   }
+}
+
+TEST_F(FrameworkTestFixture, Flows_see_events_received_back_to_back)
+{
+   /**
+    * <b>scenario</b>: Subject sends two notifications and I2C states 1, 3, 1, 7 back to back while flow thread is busy,
+    *                  flows wait for the events one after another.<br>
+    * <b>expected</b>: Every wait started after the previous event matches the next one, also the state 1 which is not the current one.<br>
+    * ************************************************
+    */
+   subject.addBehavior({FakeTrigger::INPUT_ACTIVATED, INPUT_SOCKETS, 0,
+                        {{FakeActionType::I2C_WRITE, 0, SLM_I2C_ADDRESS, 0x0001, {}},
+                         {FakeActionType::I2C_WRITE, 0, SLM_I2C_ADDRESS, 0x0003, {}},
+                         {FakeActionType::I2C_WRITE, 0, SLM_I2C_ADDRESS, 0x0001, {}},
+                         {FakeActionType::I2C_WRITE, 0, SLM_I2C_ADDRESS, 0x0007, {}},
+                         {FakeActionType::APP_NTF, 0, 0, 0, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ON}},
+                         {FakeActionType::APP_NTF, 0, 0, 0, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_OFF}}}});
+   run(false);
+   TestFlows flows(tc);
+   flows.spawn([&](TestFlows& tc) -> Flow
+               {
+                  tc.core().setInputState(INPUT_SOCKETS, INPUT_STATE_ACTIVE);
+                  tc.core().triggerInterrupt();
+                  /* all events are received before the flows get them */
+                  WAIT_MS(50);
+                  std::vector<uint8_t> slm_on_ntf = {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ON};
+                  std::vector<uint8_t> slm_off_ntf = {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_OFF};
+                  bool slm_on = co_await tc.appNtf(NTF_SLM_STATE, slm_on_ntf, 500);
+                  EXPECT_TRUE(slm_on);
+                  bool slm_off = co_await tc.appNtf(NTF_SLM_STATE, slm_off_ntf, 500);
+                  EXPECT_TRUE(slm_off);
+               });
+   flows.spawn([&](TestFlows& tc) -> Flow
+               {
+                  bool second = co_await tc.i2cState(SLM_I2C_ADDRESS, 0x0003, 500);
+                  EXPECT_TRUE(second);
+                  bool third = co_await tc.i2cState(SLM_I2C_ADDRESS, 0x0001, 500);
+                  EXPECT_TRUE(third);
+               });
+   EXPECT_TRUE(flows.run(2000));
+   EXPECT_EQ(tc.getI2CState(SLM_I2C_ADDRESS), 0x0007);
+}
+
+TEST_F(FrameworkTestFixture, Debug_commands_pipelined)
+{
+   /**
+    * <b>scenario</b>: Slow debug command sent, then 500 commands in one batch, then commands with unknown and late response.<br>
+    * <b>expected</b>: Batch answered while slow command is still pending, every response matched to its command,
+    *                  late response reported as timeout.<br>
+    * ************************************************
+    */
+   subject.addDebugResponse("env get 1", "T:24 H:51");
+   subject.addDebugResponse("version", "SmartHome 1.0");
+   subject.addDebugResponse("slow", "done", 500);
+   subject.addDebugResponse("hang", "too late", 300);
+   run(false);
+
+   std::future<DebugResponse> slow = tc.sendDebugCommand("slow", 2000);
+   std::vector<std::future<DebugResponse>> futures = tc.sendDebugCommands(std::vector<std::string>(500, "env get 1"));
+   size_t answered = 0;
+   for (std::future<DebugResponse>& future : futures)
+   {
+      DebugResponse response = future.get();
+      answered += response.status == DebugStatus::OK && response.text == "T:24 H:51";
+   }
+   EXPECT_EQ(answered, 500u);
+   EXPECT_NE(slow.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+
+   EXPECT_TRUE(tc.checkDebugResponse("version", "SmartHome 1.0"));
+   EXPECT_TRUE(tc.checkDebugResponse("reboot", FAKE_DEBUG_UNKNOWN_RESPONSE));
+   EXPECT_EQ(tc.sendDebugCommand("hang", 50).get().status, DebugStatus::TIMEOUT);
+
+   DebugResponse response = slow.get();
+   EXPECT_EQ(response.status, DebugStatus::OK);
+   EXPECT_EQ(response.text, "done");
+   EXPECT_GE(response.latency_us, 500000u);
+}
+
+static std::vector<uint8_t> make_text(const std::string& text)
+{
+   return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+TEST_F(FrameworkTestFixture, Subject_traces_awaited)
+{
+   /**
+    * <b>scenario</b>: Input activated, subject sends traces on bluetooth channel.<br>
+    * <b>expected</b>: Watched traces received, trace not sent by subject not received.<br>
+    * ************************************************
+    */
+   subject.addBehavior({FakeTrigger::INPUT_ACTIVATED, INPUT_SOCKETS, 0,
+                        {{FakeActionType::LOG, 20, 0, 0, make_text("[SLM] effect started, step 1")},
+                         {FakeActionType::LOG, 60, 0, 0, make_text("[SLM] effect finished")}}});
+   run(false);
+   LogPatternId started = tc.watchLog("effect started");
+   tc.setInputState(INPUT_SOCKETS, INPUT_STATE_ACTIVE);
+   tc.triggerInterrupt();
+
+   EXPECT_TRUE(tc.waitForLog("effect finished", 1000));
+   EXPECT_TRUE(tc.waitForLog(started, 0));
+   EXPECT_TRUE(tc.expectNoLog("watchdog", 100));
+}
+
+TEST_F(FrameworkTestFixture, Channel_impairment_applied)
+{
+   /**
+    * <b>scenario</b>: hw_stub frames from subject delayed, app notifications dropped, then app_ntf channel not read for a while.
+    *                  Then frames to subject dropped and delayed.<br>
+    * <b>expected</b>: I2C sequence received later by the delay, dropped notification not received, notification sent during the stall received after it.
+    *                  Frame to subject counted as sent when released by impairment, dropped frame not counted.<br>
+    * ************************************************
+    */
+   ImpairmentProfile delayed;
+   delayed.delay_us = 50000;
+   ImpairmentProfile lossy;
+   lossy.drop_permille = 1000;
+   run(false);
+   tc.setChannelImpairment(TraceChannel::HW_STUB, ImpairmentDirection::INBOUND, delayed);
+   tc.setChannelImpairment(TraceChannel::APP_NTF, ImpairmentDirection::INBOUND, lossy);
+   auto start = std::chrono::steady_clock::now();
+   tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
+   tc.triggerInterrupt();
+
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x0001, 0x0003, 0x0007}, 100, 1000));
+   EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(80));
+   WAIT_MS(50);
+   EXPECT_FALSE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ON}));
+
+   tc.setChannelImpairment(TraceChannel::APP_NTF, ImpairmentDirection::INBOUND, ImpairmentProfile());
+   tc.pauseChannelReceive(TraceChannel::APP_NTF, 200);
+   tc.setSensorState(DHT_SENSOR2, DHT_TYPE_DHT11, 24, 71);
+   WAIT_MS(100);
+   EXPECT_FALSE(tc.wasAppNtfSent(NTF_RELAYS_STATE, {NTF_RELAYS_STATE, NTF_NTF, 2, 11, RELAY_STATE_ON}));
+   WAIT_MS(200);
+   EXPECT_TRUE(tc.wasAppNtfSent(NTF_RELAYS_STATE, {NTF_RELAYS_STATE, NTF_NTF, 2, 11, RELAY_STATE_ON}));
+
+   auto frames_sent = [this]()
+   {
+      const std::string name = "smarthome_tf_frames_sent_total{channel=\"hw_stub\"} ";
+      std::string metrics = tc.getMetrics(MetricsFormat::PROMETHEUS);
+      size_t pos = metrics.find(name);
+      return pos == std::string::npos? -1 : atol(metrics.c_str() + pos + name.size());
+   };
+   long sent = frames_sent();
+   tc.setChannelImpairment(TraceChannel::HW_STUB, ImpairmentDirection::OUTBOUND, lossy);
+   tc.setInputState(INPUT_SOCKETS, INPUT_STATE_ACTIVE);
+   WAIT_MS(20);
+   EXPECT_EQ(frames_sent(), sent);
+   tc.setChannelImpairment(TraceChannel::HW_STUB, ImpairmentDirection::OUTBOUND, delayed);
+   tc.setInputState(INPUT_SOCKETS, INPUT_STATE_ACTIVE);
+   EXPECT_EQ(frames_sent(), sent);
+   WAIT_MS(100);
+   EXPECT_EQ(frames_sent(), sent + 1);
+}
+
+TEST(SubjectExecutorTest, Subject_exit_status_and_rusage_captured)
+{
+   /**
+    * <b>scenario</b>: Binary which exits immediately and fake subject in child process are stopped.<br>
+    * <b>expected</b>: Both children reaped, exit status and resource usage captured.<br>
+    * ************************************************
+    */
+   TestSubjectExecutor executor("/bin/true");
+   pid_t pid = executor.start_test_subject();
+   ASSERT_GT(pid, 0);
+   WAIT_MS(100);
+   EXPECT_TRUE(executor.stop_test_subject(pid));
+   EXPECT_TRUE(executor.get_exit_info().reaped);
+   EXPECT_TRUE(executor.get_exit_info().exited);
+   EXPECT_EQ(executor.get_exit_info().exit_code, 0);
+   EXPECT_EQ(executor.get_exit_info().stop_signal, 0);
+
+   FakeSubject subject;
+   executor.use_fake_subject(&subject, true);
+   pid = executor.start_test_subject();
+   ASSERT_GT(pid, 0);
+   WAIT_MS(100);
+   EXPECT_TRUE(executor.stop_test_subject(pid));
+   EXPECT_TRUE(executor.get_exit_info().exited);
+   EXPECT_EQ(executor.get_exit_info().stop_signal, SIGINT);
+   EXPECT_LT(executor.get_exit_info().shutdown_ms, (uint32_t)SUBJECT_SIGINT_TIMEOUT_MS);
+   EXPECT_GT(executor.get_exit_info().max_rss_kb, 0u);
+   EXPECT_EQ(waitpid(pid, NULL, WNOHANG), -1);
+}
+
+TEST(SubjectExecutorTest, Subject_allocations_tracked)
+{
+   /**
+    * <b>scenario</b>: Binary is run with allocation tracker preloaded.<br>
+    * <b>expected</b>: Report written at exit of the binary, allocations counted and resolved to call sites.<br>
+    * ************************************************
+    */
+   const std::string report_path = std::string(PROJECT_ROOT_PATH) + "/logs/Subject_allocations_tracked.alloc.json";
+   TestSubjectExecutor executor("/bin/date");
+   executor.set_alloc_tracking(std::string(PROJECT_ROOT_PATH) + "/logs/Subject_allocations_tracked.alloc.raw", report_path,
+                               "Subject_allocations_tracked");
+   pid_t pid = executor.start_test_subject();
+   ASSERT_GT(pid, 0);
+   WAIT_MS(100);
+   EXPECT_TRUE(executor.stop_test_subject(pid));
+   const AllocSummary& summary = executor.get_alloc_summary();
+   EXPECT_TRUE(summary.complete);
+   EXPECT_GT(summary.allocations, 0u);
+   EXPECT_GE(summary.requested_bytes, summary.allocations);
+   EXPECT_FALSE(summary.hot_spots.empty());
+   EXPECT_EQ(access(report_path.c_str(), R_OK), 0);
+}
+
+TEST(ResourceSamplerTest, Sampler_restarted_after_process_exited)
+{
+   /**
+    * <b>scenario</b>: Sampled process exits on its own, sampler is started again for another process
+    *                  without being stopped.<br>
+    * <b>expected</b>: Sampling ends with the process, second start succeeds.<br>
+    * ************************************************
+    */
+   ResourceSampler sampler;
+   pid_t pid = fork();
+   if (pid == 0)
+   {
+      usleep(50000);
+      _exit(0);
+   }
+   ASSERT_GT(pid, 0);
+   ASSERT_TRUE(sampler.start(pid, 10, ""));
+   EXPECT_TRUE(TestWait::until(TEST_WAIT_SITE, std::chrono::seconds(2), [&](){ return waitpid(pid, nullptr, WNOHANG) == pid; }));
+   EXPECT_TRUE(TestWait::until(TEST_WAIT_SITE, std::chrono::seconds(2), [&](){ return !sampler.isRunning(); }));
+
+   pid = fork();
+   if (pid == 0)
+   {
+      pause();
+      _exit(0);
+   }
+   ASSERT_GT(pid, 0);
+   EXPECT_TRUE(sampler.start(pid, 10, ""));
+   EXPECT_TRUE(sampler.isRunning());
+   sampler.stop();
+   kill(pid, SIGKILL);
+   waitpid(pid, nullptr, 0);
+}
+
+static size_t count_threads()
+{
+   size_t result = 0;
+   char line [128];
+   FILE* status = fopen("/proc/self/status", "r");
+   while (status && fgets(line, sizeof(line), status))
+   {
+      if (sscanf(line, "Threads: %zu", &result) == 1)
+      {
+         break;
+      }
+   }
+   if (status)
+   {
+      fclose(status);
+   }
+   return result;
+}
+
+TEST(TestClusterTest, Subjects_served_by_one_reactor_thread)
+{
+   /**
+    * <b>scenario</b>: 64 fake subjects started in child processes, stairs sequence triggered in all of them,
+    *                  humidity changed in one of them.<br>
+    * <b>expected</b>: Only one thread added to test process, sequence finished in every subject,
+    *                  fan notification sent only by the selected subject.<br>
+    * ************************************************
+    */
+   const size_t SUBJECTS = 64;
+   const size_t SELECTED = 7;
+   TestCluster cluster;
+   cluster.addBehavior({FakeTrigger::INPUT_ACTIVATED, INPUT_STAIRS_SENSOR, 0,
+                        {{FakeActionType::I2C_WRITE, 10, SLM_I2C_ADDRESS, 0x0001, {}},
+                         {FakeActionType::I2C_WRITE, 20, SLM_I2C_ADDRESS, 0x0007, {}},
+                         {FakeActionType::APP_NTF, 20, 0, 0, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ON}}}});
+   cluster.addBehavior({FakeTrigger::HUMIDITY_ABOVE, DHT_SENSOR2, 70,
+                        {{FakeActionType::APP_NTF, 10, 0, 0, {NTF_RELAYS_STATE, NTF_NTF, 2, 11, RELAY_STATE_ON}}}});
+   size_t threads = count_threads();
+   ASSERT_TRUE(cluster.start(SUBJECTS, true));
+   EXPECT_EQ(count_threads(), threads + 1);
+   EXPECT_EQ(cluster.getStats().connected, SUBJECTS);
+
+   EXPECT_TRUE(cluster.setInputState(CLUSTER_ALL_SUBJECTS, INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE));
+   EXPECT_TRUE(cluster.triggerInterrupt(CLUSTER_ALL_SUBJECTS, 5));
+   EXPECT_TRUE(cluster.waitForI2CState(CLUSTER_ALL_SUBJECTS, SLM_I2C_ADDRESS, 0x0007, 3000));
+   EXPECT_TRUE(cluster.waitForAppNtf(CLUSTER_ALL_SUBJECTS, NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ON}, 1000));
+   EXPECT_EQ(cluster.countAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ON}), SUBJECTS);
+
+   EXPECT_TRUE(cluster.setSensorState(SELECTED, DHT_SENSOR2, DHT_TYPE_DHT11, 24, 71));
+   EXPECT_TRUE(cluster.waitForAppNtf(SELECTED, NTF_RELAYS_STATE, {NTF_RELAYS_STATE, NTF_NTF, 2, 11, RELAY_STATE_ON}, 1000));
+   EXPECT_EQ(cluster.countAppNtfSent(NTF_RELAYS_STATE, {NTF_RELAYS_STATE, NTF_NTF, 2, 11, RELAY_STATE_ON}), 1u);
+   EXPECT_EQ(cluster.getSubjectStats(SELECTED).frames_out, 3u);
+   EXPECT_EQ(cluster.getStats().total.frames_out, 2 * SUBJECTS + 1);
+   EXPECT_EQ(cluster.getStats().total.write_failures, 0u);
+
+   cluster.stop();
+   EXPECT_EQ(cluster.size(), 0u);
+   EXPECT_EQ(count_threads(), threads);
+}
+
+TEST(ChannelImpairmentTest, Same_seed_gives_same_impairment)
+{
+   /**
+    * <b>scenario</b>: The same frames passed twice through impairment with drops, jitter and bandwidth limit, seeded the same way.<br>
+    * <b>expected</b>: The same frames dropped, remaining frames released in order, not earlier than bandwidth allows.<br>
+    * ************************************************
+    */
+   const uint32_t FRAMES = 200;
+   ImpairmentProfile profile;
+   profile.jitter_us = 2000;
+   profile.bandwidth_bps = 100000;
+   profile.drop_permille = 200;
+   profile.seed = 7;
+
+   std::vector<uint8_t> released [2];
+   for (std::vector<uint8_t>& frames : released)
+   {
+      std::mutex mtx;
+      ChannelImpairment impairment;
+      impairment.setSink(ImpairmentDirection::OUTBOUND, [&](std::vector<uint8_t>& frame)
+                         {
+                            std::lock_guard<std::mutex> lock(mtx);
+                            frames.push_back(frame[0]);
+                         });
+      impairment.configure(ImpairmentDirection::OUTBOUND, profile);
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < FRAMES; i++)
+      {
+         uint8_t frame [10] = {(uint8_t)i};
+         impairment.submit(ImpairmentDirection::OUTBOUND, frame, sizeof(frame));
+      }
+      const ImpairmentMetrics& metrics = impairment.getMetrics(ImpairmentDirection::OUTBOUND);
+      EXPECT_TRUE(TestWait::until(TEST_WAIT_SITE, std::chrono::seconds(1), [&]() { return metrics.queued_frames.get() == 0; }));
+      /* 10 bytes per frame at 100000 B/s */
+      EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::microseconds(100 * (FRAMES - metrics.frames_dropped.get())));
+      EXPECT_GT(metrics.frames_dropped.get(), 0u);
+      EXPECT_EQ(metrics.frames_dropped.get() + metrics.frames_delayed.get(), FRAMES);
+      EXPECT_TRUE(std::is_sorted(frames.begin(), frames.end()));
+   }
+   EXPECT_EQ(released[0], released[1]);
+}
+
+TEST(TimerWheelTest, Timer_wheel_releases_items_beyond_one_revolution_in_order)
+{
+   /**
+    * <b>scenario</b>: Items scheduled within and beyond one revolution of 8-bucket wheel, some of them to the same tick.<br>
+    * <b>expected</b>: Next expiry is the earliest item, items released not earlier than scheduled, by tick and in order of scheduling.<br>
+    * ************************************************
+    */
+   const auto tick = std::chrono::milliseconds(1);
+   TimerWheel<int> wheel(tick, 8);
+   auto origin = TimerWheel<int>::Clock::now();
+   EXPECT_EQ(wheel.nextExpiry(), TimerWheel<int>::Clock::time_point::max());
+   wheel.schedule(origin + 20 * tick, 3);
+   wheel.schedule(origin + 30 * tick, 5);
+   wheel.schedule(origin + 20 * tick, 4);
+   wheel.schedule(origin + 5 * tick, 1);
+   EXPECT_LE(wheel.nextExpiry(), origin + 6 * tick);
+   EXPECT_GE(wheel.nextExpiry(), origin + 5 * tick);
+
+   std::vector<int> released;
+   auto collect = [&released](int& item) { released.push_back(item); };
+   wheel.advance(origin + 4 * tick, collect);
+   EXPECT_TRUE(released.empty());
+   wheel.advance(origin + 15 * tick, collect);
+   EXPECT_EQ(released, std::vector<int>({1}));
+   /* already moved from overflow, scheduled after the items of the same tick */
+   wheel.schedule(origin + 20 * tick, 2);
+   wheel.schedule(origin + 19 * tick, 0);
+   EXPECT_LE(wheel.nextExpiry(), origin + 20 * tick);
+   wheel.advance(origin + 21 * tick, collect);
+   EXPECT_EQ(released, std::vector<int>({1, 0, 3, 4, 2}));
+   EXPECT_EQ(wheel.size(), 1u);
+   wheel.advance(origin + 100 * tick, collect);
+   EXPECT_EQ(released, std::vector<int>({1, 0, 3, 4, 2, 5}));
+   EXPECT_TRUE(wheel.empty());
+   EXPECT_EQ(wheel.nextExpiry(), TimerWheel<int>::Clock::time_point::max());
+}
+
+TEST(ResultCacheTest, Cached_pass_invalidated_when_input_changes)
+{
+   /**
+    * <b>scenario</b>: Test pass stored in cache, then one of the inputs is modified.<br>
+    * <b>expected</b>: Pass found only for the same inputs and test name.<br>
+    * ************************************************
+    */
+   const std::string dir = std::string(PROJECT_ROOT_PATH) + "/logs/Cached_pass_invalidated_when_input_changes";
+   const std::string input = dir + ".input";
+   FILE* file = fopen(input.c_str(), "w");
+   ASSERT_NE(file, nullptr);
+   fputs("binary v1", file);
+   fclose(file);
+
+   ResultCache cache;
+   ASSERT_TRUE(cache.open(dir, {input, "/proc/self/exe"}));
+   cache.storePass("Suite.Test");
+   EXPECT_TRUE(cache.isPassed("Suite.Test"));
+   EXPECT_FALSE(cache.isPassed("Suite.Other"));
+
+   file = fopen(input.c_str(), "a");
+   ASSERT_NE(file, nullptr);
+   fputs(" patched", file);
+   fclose(file);
+   ResultCache changed;
+   ASSERT_TRUE(changed.open(dir, {input, "/proc/self/exe"}));
+   EXPECT_FALSE(changed.isPassed("Suite.Test"));
+   EXPECT_EQ(ResultCache::hashText("abc"), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+}
+
+TEST(TestHistoryTest, Failing_tests_scheduled_first_then_longest)
+{
+   /**
+    * <b>scenario</b>: History with passing tests of different duration, test failed in the last run,
+    *                  test failed in the run before and test without history.<br>
+    * <b>expected</b>: Last failed first, then earlier failed, new, and the rest from the longest.<br>
+    * ************************************************
+    */
+   const std::string path = std::string(PROJECT_ROOT_PATH) + "/logs/Failing_tests_scheduled_first_then_longest.txt";
+   unlink(path.c_str());
+   TestHistory history;
+   history.load(path);
+   history.record("Suite.Short", false, 1000);
+   history.record("Suite.Long", false, 900000);
+   history.record("Suite.Failed_before", true, 1000);
+   history.record("Suite.Failed_before", false, 1000);
+   history.record("Suite.Failed_last", false, 1000);
+   history.record("Suite.Failed_last", true, 1000);
+
+   TestHistory loaded;
+   ASSERT_TRUE(loaded.load(path));
+   TestHistoryEntry entry;
+   ASSERT_TRUE(loaded.get("Suite.Failed_before", entry));
+   EXPECT_EQ(entry.runs, 2u);
+   EXPECT_EQ(entry.failures, 0x02u);
+   std::vector<std::string> expected = {"Suite.Failed_last", "Suite.Failed_before", "Suite.New", "Suite.Long", "Suite.Short"};
+   EXPECT_EQ(loaded.schedule({"Suite.Short", "Suite.New", "Suite.Failed_before", "Suite.Long", "Suite.Failed_last"}), expected);
+}
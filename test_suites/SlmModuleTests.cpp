@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
 #include "TestCore.h"
+#include "StepReportListener.h"
+#include "TestFlow.h"
 #include "notification_types.h"
 #include "stairs_led_types.h"
 
@@ -19,6 +21,9 @@
  */
 /* ==================================================================================================================== */
 
+/* timing of test steps - logs/SlmModuleTests.steps.xml and logs/SlmModuleTests.steps.txt */
+static const bool step_report_installed = StepReportListener::install("SlmModuleTests");
+
 struct SlmModuleTestFixture : public testing::Test
 {
 
@@ -56,13 +61,7 @@ TEST_F(SlmModuleTestFixture, LedProgram_started_and_completed_without_interrupti
    tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
    tc.triggerInterrupt();
 
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0001, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0003, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0007, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x000F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x001F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x0001, 0x0003, 0x0007, 0x000F, 0x001F, 0x007F, 0x00FF}, 500, 3500));
 
    tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_INACTIVE);
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ONGOING_ON}));
@@ -70,26 +69,11 @@ TEST_F(SlmModuleTestFixture, LedProgram_started_and_completed_without_interrupti
 
    WAIT_S(19)
 
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 5000));
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x007F, 0x00FF, 0x007F, 0x00FF, 0x007F, 0x00FF, 0x007F, 0x00FF, 0x007F, 0x00FF}, 500, 9500));
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_OFF_EFFECT}));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
+   /* effect ready has to be reported before leds are faded out */
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_OFF_EFFECT_READY}));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x001F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x000F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0007, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0003, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0001, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0000, 500));
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x007F, 0x001F, 0x000F, 0x0007, 0x0003, 0x0001, 0x0000}, 500, 3500));
 
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ONGOING_OFF}));
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_OFF}));
@@ -105,13 +89,7 @@ TEST_F(SlmModuleTestFixture, LedProgram_started_and_completed_without_interrupti
    tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
    tc.triggerInterrupt();
 
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0001, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0003, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0007, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x000F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x001F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x0001, 0x0003, 0x0007, 0x000F, 0x001F, 0x007F, 0x00FF}, 500, 3500));
 
    tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_INACTIVE);
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ONGOING_ON}));
@@ -119,26 +97,11 @@ TEST_F(SlmModuleTestFixture, LedProgram_started_and_completed_without_interrupti
 
    WAIT_S(19)
 
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 5000));
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x007F, 0x00FF, 0x007F, 0x00FF, 0x007F, 0x00FF, 0x007F, 0x00FF, 0x007F, 0x00FF}, 500, 9500));
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_OFF_EFFECT}));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
+   /* effect ready has to be reported before leds are faded out */
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_OFF_EFFECT_READY}));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x001F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x000F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0007, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0003, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0001, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0000, 500));
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x007F, 0x001F, 0x000F, 0x0007, 0x0003, 0x0001, 0x0000}, 500, 3500));
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ONGOING_OFF}));
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_OFF}));
 
@@ -156,13 +119,7 @@ TEST_F(SlmModuleTestFixture, LedProgram_started_sensor_active_when_module_starts
    tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
    tc.triggerInterrupt();
 
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0001, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0003, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0007, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x000F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x001F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x0001, 0x0003, 0x0007, 0x000F, 0x001F, 0x007F, 0x00FF}, 500, 3500));
 
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ONGOING_ON}));
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ON}));
@@ -171,26 +128,11 @@ TEST_F(SlmModuleTestFixture, LedProgram_started_sensor_active_when_module_starts
    tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_INACTIVE);
    WAIT_S(9);
 
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 5000));
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x007F, 0x00FF, 0x007F, 0x00FF, 0x007F, 0x00FF, 0x007F, 0x00FF, 0x007F, 0x00FF}, 500, 9500));
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_OFF_EFFECT}));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
+   /* effect ready has to be reported before leds are faded out */
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_OFF_EFFECT_READY}));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x001F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x000F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0007, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0003, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0001, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0000, 500));
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x007F, 0x001F, 0x000F, 0x0007, 0x0003, 0x0001, 0x0000}, 500, 3500));
 
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ONGOING_OFF}));
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_OFF}));
@@ -209,57 +151,46 @@ TEST_F(SlmModuleTestFixture, LedProgram_started_sensor_reactivated_when_off_effe
    tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
    tc.triggerInterrupt();
 
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0001, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0003, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0007, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x000F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x001F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x0001, 0x0003, 0x0007, 0x000F, 0x001F, 0x007F, 0x00FF}, 500, 3500));
 
    tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_INACTIVE);
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ONGOING_ON}));
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ON}));
    tc.clearAppDataBuffer();
-   WAIT_S(18)
-
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 5000));
-   EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_OFF_EFFECT}));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
 
-   /* interrupt trigger when OFF effect is ongoing */
-   tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
-   tc.triggerInterrupt();
-
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   WAIT_S(1);
-   EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ON}));
+   /* interrupt triggered when OFF effect is ongoing - after two blinks reported by the subject, not after a guessed time */
+   TestFlows flows(tc);
+   flows.spawn([&](TestFlows& flows) -> Flow
+               {
+                  std::vector<uint8_t> off_effect_ntf = {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_OFF_EFFECT};
+                  bool off_effect = co_await flows.appNtf(NTF_SLM_STATE, off_effect_ntf, 25000);
+                  EXPECT_TRUE(off_effect);
+                  for (int blink = 0; blink < 2; blink++)
+                  {
+                     bool dimmed = co_await flows.i2cState(SLM_I2C_ADDRESS, 0x007F, 1000);
+                     EXPECT_TRUE(dimmed);
+                     bool lit = co_await flows.i2cState(SLM_I2C_ADDRESS, 0x00FF, 1000);
+                     EXPECT_TRUE(lit);
+                  }
+                  flows.core().setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_ACTIVE);
+                  flows.core().triggerInterrupt();
+                  /* notification and leds state may come in any order, state wait completes if it is already reached */
+                  std::vector<uint8_t> on_ntf = {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ON};
+                  bool on = co_await flows.appNtf(NTF_SLM_STATE, on_ntf, 1500);
+                  EXPECT_TRUE(on);
+                  bool all_leds_on = co_await flows.i2cState(SLM_I2C_ADDRESS, 0x00FF, 500);
+                  EXPECT_TRUE(all_leds_on);
+               });
+   EXPECT_TRUE(flows.run(30000));
 
    WAIT_S(18)
    tc.setInputState(INPUT_STAIRS_SENSOR, INPUT_STATE_INACTIVE);
 
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 5000));
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x007F, 0x00FF, 0x007F, 0x00FF, 0x007F, 0x00FF, 0x007F, 0x00FF, 0x007F, 0x00FF}, 500, 9500));
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_OFF_EFFECT}));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
+   /* effect ready has to be reported before leds are faded out */
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_OFF_EFFECT_READY}));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x00FF, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x007F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x001F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x000F, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0007, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0003, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0001, 500));
-   EXPECT_TRUE(tc.waitForI2CNotification(SLM_I2C_ADDRESS, 0x0000, 500));
+   EXPECT_TRUE(tc.expectI2CSequence(SLM_I2C_ADDRESS, {0x007F, 0x001F, 0x000F, 0x0007, 0x0003, 0x0001, 0x0000}, 500, 3500));
 
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_ONGOING_OFF}));
    EXPECT_TRUE(tc.wasAppNtfSent(NTF_SLM_STATE, {NTF_SLM_STATE, NTF_NTF, 1, SLM_STATE_OFF}));